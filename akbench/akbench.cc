@@ -1,47 +1,114 @@
+#include <algorithm>
+#include <climits>
 #include <cstdlib>
 #include <format>
+#include <functional>
 #include <getopt.h>
 #include <iostream>
 #include <map>
 #include <optional>
 #include <print>
+#include <set>
+#include <sstream>
 #include <vector>
 
 #include "aklog.h"
+#include "barrier.h"
+#include "checksum.h"
 #include "common.h"
+#include "data_generator.h"
 #include "getopt_utils.h"
+#include "huge_pages.h"
+#include "message_latency.h"
+#include "multi_pair_bandwidth.h"
+#include "numa.h"
+#include "perf_counters.h"
+#include "topology.h"
+#include "uring.h"
 
 // Latency benchmark headers
 #include "atomic_latency.h"
 #include "atomic_rel_acq_latency.h"
+#include "atomic_wait_latency.h"
 #include "barrier_latency.h"
 #include "condition_variable_latency.h"
+#include "eventfd_latency.h"
+#include "futex_latency.h"
 #include "semaphore_latency.h"
 #include "syscall_latency.h"
 
 // Bandwidth benchmark headers
+#include "cma_bandwidth.h"
+#include "dgram_bandwidth.h"
 #include "fifo_bandwidth.h"
 #include "memcpy_bandwidth.h"
+#include "memcpy_kernels.h"
 #include "memcpy_mt_bandwidth.h"
+#include "memcpy_numa_bandwidth.h"
+#include "memfd_bandwidth.h"
 #include "mmap_bandwidth.h"
 #include "mq_bandwidth.h"
 #include "pipe_bandwidth.h"
 #include "shm_bandwidth.h"
+#include "shm_ring_bandwidth.h"
 #include "tcp_bandwidth.h"
 #include "uds_bandwidth.h"
+#include "uring_bandwidth.h"
 
 // Command line option variables
 static std::string g_type = "";
 static int g_num_iterations = 10;
 static int g_num_warmups = 3;
 static std::optional<uint64_t> g_loop_size = std::nullopt;
-static uint64_t g_data_size = (1ULL << 30); // 1GB default
-static std::optional<uint64_t> g_buffer_size = std::nullopt;
+static std::optional<double> g_min_iteration_time = std::nullopt;
+static std::vector<uint64_t> g_data_sizes = {1ULL << 30}; // 1GB default
+static std::optional<std::vector<uint64_t>> g_buffer_sizes = std::nullopt;
 static std::optional<uint64_t> g_num_threads = std::nullopt;
 static std::string g_log_level = "WARNING";
 static bool g_json_output = false;
+static bool g_csv_output = false;
+static std::string g_barrier_impl = "sem";
+static std::optional<double> g_target_ci = std::nullopt;
+static std::optional<std::string> g_cpus = std::nullopt;
+static std::optional<std::string> g_numa_nodes = std::nullopt;
+static std::optional<int> g_numa_cpu_node = std::nullopt;
+static std::optional<std::string> g_perf_counters = std::nullopt;
+static std::optional<int> g_uring_batch_size = std::nullopt;
+static bool g_uring_sqpoll = false;
+static std::optional<uint64_t> g_ring_slots = std::nullopt;
+static std::optional<uint64_t> g_ring_batch = std::nullopt;
+static std::optional<std::string> g_ring_wait = std::nullopt;
+static std::vector<uint64_t> g_iov_counts = {1};
+static std::optional<uint64_t> g_message_size = std::nullopt;
+static std::optional<std::string> g_page_size = std::nullopt;
+static std::vector<uint64_t> g_num_pairs = {1};
+static std::string g_checksum = "xor";
+static std::optional<uint64_t> g_seed = std::nullopt;
+static std::optional<std::string> g_memcpy_impl = std::nullopt;
+// Kernels of bandwidth_memcpy and bandwidth_memcpy_mt, from g_memcpy_impl
+static std::vector<const MemcpyKernel *> g_memcpy_kernels = {
+    &DefaultMemcpyKernel()};
+static int g_max_iterations = 100;
 
 constexpr uint64_t DEFAULT_BUFFER_SIZE = 1 << 20; // 1 MiByte
+constexpr int TARGET_CI_FIRST_BATCH_SIZE = 5;
+constexpr const char *AVAILABLE_TYPES =
+    "Latency tests: latency_atomic, latency_atomic_rel_acq, latency_barrier, "
+    "latency_condition_variable, latency_semaphore, latency_futex, "
+    "latency_futex_shared, latency_eventfd, latency_eventfd_epoll, "
+    "latency_atomic_wait, latency_tcp, latency_uds, latency_pipe, "
+    "latency_fifo, latency_mq, latency_shm, latency_mmap, latency_statfs, "
+    "latency_fstatfs, latency_getpid, latency_atomic_matrix, latency_all\n"
+    "Bandwidth tests: bandwidth_memcpy, bandwidth_memcpy_mt, "
+    "bandwidth_memcpy_numa, bandwidth_tcp, bandwidth_tcp_zerocopy, "
+    "bandwidth_uds, bandwidth_uds_dgram, bandwidth_uds_seqpacket, "
+    "bandwidth_udp, bandwidth_pipe, bandwidth_pipe_vmsplice, "
+    "bandwidth_pipe_splice, bandwidth_fifo, bandwidth_tcp_uring, "
+    "bandwidth_uds_uring, bandwidth_pipe_uring, bandwidth_fifo_uring, "
+    "bandwidth_mq, bandwidth_mmap, bandwidth_shm, bandwidth_shm_ring, "
+    "bandwidth_memfd, bandwidth_cma, bandwidth_cma_write, bandwidth_all\n"
+    "Combined: all";
+constexpr uint64_t MAX_CALIBRATED_LOOP_SIZE = 1e9;
 
 void PrintUsage(const char *program_name) {
   std::cout << R"(Usage: )" << program_name << R"( <TYPE> [OPTIONS]
@@ -58,23 +125,65 @@ Latency Tests (measure operation latency in nanoseconds):
                                We use this barrier in bandwidth tests.
   latency_condition_variable   Condition variable wait/notify operations
   latency_semaphore            Semaphore wait/post operations
+  latency_futex                Raw FUTEX_WAIT/FUTEX_WAKE between threads
+  latency_futex_shared         Raw FUTEX_WAIT/FUTEX_WAKE between processes
+  latency_eventfd              eventfd write/blocking read between processes
+  latency_eventfd_epoll        eventfd write/epoll_wait and read between
+                               processes
+  latency_atomic_wait          std::atomic wait/notify_one between threads
+  latency_tcp                  Round trips of --message-size bytes over the
+  latency_uds                  transport of the matching bandwidth test
+  latency_pipe
+  latency_fifo
+  latency_mq
+  latency_shm
+  latency_mmap
   latency_statfs               statfs() filesystem syscall
   latency_fstatfs              fstatfs() filesystem syscall
   latency_getpid               getpid() syscall
+  latency_atomic_matrix        Round-trip latency of latency_atomic between
+                               every pair of CPUs, or of the CPUs in --cpus.
+                               Not included in latency_all.
   latency_all                  Run all latency benchmarks
 
 Bandwidth Tests (measure data transfer rate in GiByte/sec):
   bandwidth_memcpy             Memory copy using memcpy()
   bandwidth_memcpy_mt          Multi-threaded memory copy
+  bandwidth_memcpy_numa        Memory copy between buffers bound to each pair
+                               of NUMA nodes. Not included in bandwidth_all.
   bandwidth_tcp                TCP socket communication
+  bandwidth_tcp_zerocopy       TCP with MSG_ZEROCOPY and TCP_ZEROCOPY_RECEIVE.
+                               Falls back to copies where the kernel refuses.
   bandwidth_uds                Unix domain socket communication
+  bandwidth_uds_dgram          Sequence-numbered packets of buffer-size bytes
+  bandwidth_uds_seqpacket      over Unix domain SOCK_DGRAM, SOCK_SEQPACKET and
+  bandwidth_udp                loopback UDP. Buffer sizes are clamped to 65507.
+                               Reports the delivered bandwidth, packets/sec and
+                               dropped and reordered packets per iteration.
   bandwidth_pipe               Anonymous pipe communication
+  bandwidth_pipe_vmsplice      Pipe with vmsplice(SPLICE_F_GIFT) on the
+                               sender side
+  bandwidth_pipe_splice        Pipe with splice() into a memfd on the
+                               receiver side
   bandwidth_fifo               Named pipe (FIFO) communication
+  bandwidth_tcp_uring          bandwidth_tcp, bandwidth_uds, bandwidth_pipe
+  bandwidth_uds_uring          and bandwidth_fifo with io_uring. Reports the
+  bandwidth_pipe_uring         io_uring_enter calls per GiB of each side.
+  bandwidth_fifo_uring
   bandwidth_mq                 POSIX message queue communication
   bandwidth_mmap               Memory-mapped file communication
                                Use double buffering.
   bandwidth_shm                Shared memory communication.
                                Use double buffering.
+  bandwidth_shm_ring           Shared memory single-producer single-consumer
+                               ring of buffer-size slots
+  bandwidth_memfd              Sealed memfd of buffer-size bytes per message
+                               passed with SCM_RIGHTS and mapped by the
+                               receiver
+  bandwidth_cma                Copy out of another process with
+                               process_vm_readv
+  bandwidth_cma_write          Copy into another process with
+                               process_vm_writev
   bandwidth_all                Run all bandwidth benchmarks
 
 Combined:
@@ -85,24 +194,164 @@ Options:
   -w, --num-warmups=N          Number of warmup iterations (default: 3)
   -l, --loop-size=N            Loop size for latency tests
                                The default value varies depending on the test.
+  --min-iteration-time=TIME    Calibrate the loop size of each latency test so
+                               that an iteration takes at least TIME, e.g. 50ms
   -d, --data-size=SIZE         Data size in bytes for bandwidth tests (default: 1GB)
   -b, --buffer-size=SIZE       Buffer size in bytes for I/O operations (default: 1MB)
                                Not applicable to memcpy benchmarks
-  -n, --num-threads=N          Number of threads for bandwidth_memcpy_mt
+                               SIZE accepts K, M, G and T suffixes, e.g. 64K.
+                               A range FIRST:LAST:xFACTOR like 64:1G:x2 for
+                               --data-size or --buffer-size sweeps the sizes
+                               of bandwidth tests in one run.
+  -n, --num-threads=N          Number of threads for bandwidth_memcpy_mt and
+                               bandwidth_memcpy_numa
   --log-level=LEVEL            Log level: INFO, DEBUG, WARNING, ERROR (default: WARNING)
   --json-output                Output results in JSON format
+  --csv-output                 Output latency_atomic_matrix,
+                               bandwidth_memcpy_numa and size sweeps in CSV
+                               format
+  --numa-nodes=NODES           NUMA nodes for bandwidth_memcpy_numa, e.g. 0,1
+                               (default: all online nodes)
+  --numa-cpu-node=NODE         Run the bandwidth_memcpy_numa threads on the CPUs
+                               of NODE (default: the source node)
+  --barrier-impl=IMPL          Process barrier implementation: sem, futex, spin
+                               (default: sem)
+  --target-ci=PCT              Repeat iterations until the 95% confidence
+                               interval is within PCT of the average, e.g. 2%
+                               Overrides --num-iterations.
+  --max-iterations=N           Maximum number of iterations with --target-ci
+                               (default: 100)
+  --cpus=CPUS                  Pin the two peers of each test, e.g. the sender
+                               and receiver processes, to CPUS. Either a CPU
+                               list like 0,2 or one of same-core-smt, same-l3,
+                               cross-l3, cross-socket. Only CPUs that this
+                               process may run on are picked or accepted
+  --perf-counters=EVENTS       Count perf events in the timed region of each
+                               peer and report them per byte or per loop
+                               operation, e.g. cycles,instructions,cache-misses,
+                               context-switches,page-faults. Hardware events
+                               fall back to task-clock when they are not
+                               available. Not reported for memcpy_mt,
+                               memcpy_numa and latency_atomic_matrix.
+  --uring-batch-size=N         Linked writes submitted at once by the sender
+                               of the bandwidth_*_uring tests. The receiver
+                               of the TCP and UDS tests keeps this many
+                               receives in flight, the pipe and FIFO ones read
+                               with linked chains (default: 8)
+  --uring-sqpoll               Let a kernel thread poll the io_uring
+                               submission queue in bandwidth_*_uring tests
+  --ring-slots=N               Number of slots of bandwidth_shm_ring, a power
+                               of two (default: 16)
+  --ring-batch=N               Slots after which each side of
+                               bandwidth_shm_ring publishes its index
+                               (default: 4)
+  --ring-wait=STRATEGY         How the sides of bandwidth_shm_ring wait for
+                               each other: spin, spin-futex, eventfd
+                               (default: spin-futex)
+  --iov-count=N                Number of buffer-size iovecs per system call of
+                               bandwidth_cma and bandwidth_cma_write
+                               (default: 1). A range like 1:64:x4 runs them
+                               with each count.
+  --message-size=SIZE          Message size of latency_tcp, latency_uds,
+                               latency_pipe, latency_fifo, latency_mq,
+                               latency_shm and latency_mmap (default: 64)
+  --page-size=SIZE             Pages backing the buffers of bandwidth_memcpy,
+                               bandwidth_memcpy_mt, bandwidth_shm and
+                               bandwidth_mmap: 4k, thp, 2m, 1g (default: 4k).
+                               The backing actually obtained is reported
+                               as metrics.
+  --num-pairs=N                Number of sender/receiver pairs of
+                               bandwidth_tcp*, bandwidth_uds, bandwidth_pipe*,
+                               bandwidth_fifo, bandwidth_shm and
+                               bandwidth_mmap running at the same time
+                               (default: 1). Reports the aggregate bandwidth,
+                               the bandwidth of each pair and their fairness
+                               index. A range like 1:8:x2 runs them with each
+                               count. Warns if the pairs have more peers than
+                               online CPUs or CPUs in --cpus, which then share
+                               CPUs.
+  --checksum=KIND              Checksum over the data of bandwidth tests:
+                               xor, crc32c (default: xor). crc32c also catches
+                               reordered data. The time spent verifying is
+                               reported as verification_time.
+  --seed=N                     Seed of the data of bandwidth tests
+                               (default: random). The same seed gives the
+                               same data.
+  --memcpy-impl=IMPLS          Copy routines of bandwidth_memcpy and
+                               bandwidth_memcpy_mt, comma separated, or all:
+                               glibc, std-copy, naive, erms, avx2, avx2-nt,
+                               avx512, avx512-nt (default: glibc). Routines
+                               this CPU cannot run are skipped.
   -h, --help                   Display this help message
 )";
 }
 
+// Helper function to output the fields of a benchmark result as JSON. The
+// caller prints the enclosing braces.
+void OutputJsonFields(const std::string &indent, const std::string &name,
+                      const BenchmarkResult &result, const std::string &unit) {
+  std::println(R"({}"name": "{}",)", indent, name);
+  std::println(R"({}"average": {:e},)", indent, result.average);
+  std::println(R"({}"stddev": {:e},)", indent, result.stddev);
+  if (result.loop_size.has_value()) {
+    std::println(R"({}"loop_size": {},)", indent, result.loop_size.value());
+  }
+  if (result.data_size.has_value()) {
+    std::println(R"({}"data_size": {},)", indent, result.data_size.value());
+  }
+  if (result.buffer_size.has_value()) {
+    std::println(R"({}"buffer_size": {},)", indent, result.buffer_size.value());
+  }
+  if (result.statistics.has_value()) {
+    const SampleStatistics &s = result.statistics.value();
+    std::println(R"({}"statistics": {{)", indent);
+    std::println(R"({}  "median": {:e},)", indent, s.median);
+    std::println(R"({}  "mad": {:e},)", indent, s.mad);
+    std::println(R"({}  "ci_low": {:e},)", indent, s.ci_low);
+    std::println(R"({}  "ci_high": {:e},)", indent, s.ci_high);
+    std::println(R"({}  "num_samples": {},)", indent, s.num_samples);
+    std::println(R"({}  "num_outliers": {})", indent, s.num_outliers);
+    std::println(R"({}}},)", indent);
+  }
+  if (result.percentiles.has_value()) {
+    const LatencyPercentiles &p = result.percentiles.value();
+    std::println(R"({}"percentiles": {{)", indent);
+    std::println(R"({}  "min": {:e},)", indent, p.min);
+    std::println(R"({}  "p50": {:e},)", indent, p.p50);
+    std::println(R"({}  "p90": {:e},)", indent, p.p90);
+    std::println(R"({}  "p99": {:e},)", indent, p.p99);
+    std::println(R"({}  "p99.9": {:e},)", indent, p.p999);
+    std::println(R"({}  "max": {:e})", indent, p.max);
+    std::println(R"({}}},)", indent);
+  }
+  if (!result.metrics.empty()) {
+    std::println(R"({}"metrics": {{)", indent);
+    for (size_t i = 0; i < result.metrics.size(); ++i) {
+      const auto &[key, value] = result.metrics[i];
+      std::println(R"({}  "{}": {:e}{})", indent, key, value,
+                   i + 1 < result.metrics.size() ? "," : "");
+    }
+    std::println(R"({}}},)", indent);
+  }
+  if (GetCpuPlacement().has_value()) {
+    const CpuPlacement &placement = GetCpuPlacement().value();
+    std::string cpus;
+    for (size_t i = 0; i < placement.cpus.size(); ++i) {
+      cpus += std::format("{}{}", i == 0 ? "" : ", ", placement.cpus[i]);
+    }
+    std::println(R"({}"cpu_placement": {{)", indent);
+    std::println(R"({}  "spec": "{}",)", indent, placement.spec);
+    std::println(R"({}  "cpus": [{}])", indent, cpus);
+    std::println(R"({}}},)", indent);
+  }
+  std::println(R"({}"unit": "{}")", indent, unit);
+}
+
 // Helper function to output a single benchmark result as JSON
 void OutputJsonResult(const std::string &name, const BenchmarkResult &result,
                       const std::string &unit) {
   std::println(R"({{)");
-  std::println(R"(  "name": "{}",)", name);
-  std::println(R"(  "average": {:e},)", result.average);
-  std::println(R"(  "stddev": {:e},)", result.stddev);
-  std::println(R"(  "unit": "{}")", unit);
+  OutputJsonFields("  ", name, result, unit);
   std::println(R"(}})");
 }
 
@@ -114,10 +363,7 @@ void OutputJsonResults(
   for (size_t i = 0; i < results.size(); ++i) {
     const auto &[name, result] = results[i];
     std::println("  {{");
-    std::println(R"(    "name": "{}",)", name);
-    std::println(R"(    "average": {:e},)", result.average);
-    std::println(R"(    "stddev": {:e},)", result.stddev);
-    std::println(R"(    "unit": "{}")", unit);
+    OutputJsonFields("    ", name, result, unit);
     if (i < results.size() - 1) {
       std::println("  }},");
     } else {
@@ -139,10 +385,7 @@ void OutputJsonDictionary(
   for (size_t i = 0; i < latency_results.size(); ++i) {
     const auto &[name, result] = latency_results[i];
     std::println("    {{");
-    std::println(R"(      "name": "{}",)", name);
-    std::println(R"(      "average": {:e},)", result.average);
-    std::println(R"(      "stddev": {:e},)", result.stddev);
-    std::println(R"(      "unit": "sec")");
+    OutputJsonFields("      ", name, result, "sec");
     if (i < latency_results.size() - 1) {
       std::println("    }},");
     } else {
@@ -156,10 +399,7 @@ void OutputJsonDictionary(
   for (size_t i = 0; i < bandwidth_results.size(); ++i) {
     const auto &[name, result] = bandwidth_results[i];
     std::println("    {{");
-    std::println(R"(      "name": "{}",)", name);
-    std::println(R"(      "average": {:e},)", result.average);
-    std::println(R"(      "stddev": {:e},)", result.stddev);
-    std::println(R"(      "unit": "Byte/sec")");
+    OutputJsonFields("      ", name, result, "Byte/sec");
     if (i < bandwidth_results.size() - 1) {
       std::println("    }},");
     } else {
@@ -171,6 +411,13 @@ void OutputJsonDictionary(
   std::println("}}");
 }
 
+// Helper function to output the metrics of a result, one per line
+void OutputTextMetrics(const BenchmarkResult &result) {
+  for (const auto &[key, value] : result.metrics) {
+    std::println("  {}: {:.6g}", key, value);
+  }
+}
+
 // Helper function to output latency results
 void OutputLatencyResults(const std::map<std::string, BenchmarkResult> &results,
                           bool json_output) {
@@ -185,8 +432,25 @@ void OutputLatencyResults(const std::map<std::string, BenchmarkResult> &results,
     OutputJsonResults(results_vec, "sec");
   } else {
     for (const auto &[name, result] : results) {
-      std::println("{}: {:.3f} ± {:.3f} ns", name, result.average * 1e9,
-                   result.stddev * 1e9);
+      std::string line = std::format("{}: {:.3f} ± {:.3f} ns", name,
+                                     result.average * 1e9, result.stddev * 1e9);
+      if (result.statistics.has_value()) {
+        const SampleStatistics &s = result.statistics.value();
+        line += std::format(" [95% CI {:.3f}, {:.3f}]", s.ci_low * 1e9,
+                            s.ci_high * 1e9);
+      }
+      if (result.percentiles.has_value()) {
+        const LatencyPercentiles &p = result.percentiles.value();
+        line += std::format(" (min {:.3f}, p50 {:.3f}, p90 {:.3f}, p99 {:.3f}, "
+                            "p99.9 {:.3f}, max {:.3f})",
+                            p.min * 1e9, p.p50 * 1e9, p.p90 * 1e9, p.p99 * 1e9,
+                            p.p999 * 1e9, p.max * 1e9);
+      }
+      if (result.loop_size.has_value()) {
+        line += std::format(" [loop size {}]", result.loop_size.value());
+      }
+      std::println("{}", line);
+      OutputTextMetrics(result);
     }
   }
 }
@@ -205,210 +469,536 @@ void OutputBandwidthResults(
     OutputJsonResults(results_vec, "Byte/sec");
   } else {
     for (const auto &[name, result] : results) {
-      std::println("{}: {:.3f} ± {:.3f}{}", name, result.average / (1ULL << 30),
-                   result.stddev / (1ULL << 30), GIBYTE_PER_SEC_UNIT);
+      std::string line = std::format(
+          "{}: {:.3f} ± {:.3f}{}", name, result.average / (1ULL << 30),
+          result.stddev / (1ULL << 30), GIBYTE_PER_SEC_UNIT);
+      if (result.statistics.has_value()) {
+        const SampleStatistics &s = result.statistics.value();
+        line += std::format(" [95% CI {:.3f}, {:.3f}]", s.ci_low / (1ULL << 30),
+                            s.ci_high / (1ULL << 30));
+      }
+      std::println("{}", line);
+      OutputTextMetrics(result);
+    }
+  }
+}
+
+// Helper function to output the results of a size sweep. Text output is one
+// table per benchmark with a row per size and CSV output is one row per
+// result, both in GiByte/sec.
+void OutputBandwidthSweep(
+    const std::vector<std::pair<std::string, BenchmarkResult>> &results,
+    bool json_output, bool csv_output) {
+  if (json_output) {
+    OutputJsonResults(results, "Byte/sec");
+    return;
+  }
+
+  const auto size_or_empty = [](const std::optional<uint64_t> &size) {
+    return size.has_value() ? std::to_string(size.value()) : std::string();
+  };
+  const double scale = 1.0 / (1ULL << 30);
+  if (csv_output) {
+    std::println("name,data_size,buffer_size,average,stddev,ci_low,ci_high");
+    for (const auto &[name, result] : results) {
+      const SampleStatistics &s = result.statistics.value();
+      std::println("{},{},{},{:.3f},{:.3f},{:.3f},{:.3f}", name,
+                   size_or_empty(result.data_size),
+                   size_or_empty(result.buffer_size), result.average * scale,
+                   result.stddev * scale, s.ci_low * scale, s.ci_high * scale);
+    }
+    return;
+  }
+
+  std::map<std::string, std::vector<BenchmarkResult>> tables;
+  for (const auto &[name, result] : results) {
+    tables[name].push_back(result);
+  }
+  for (const auto &[name, rows] : tables) {
+    std::println("{}: bandwidth in GiByte/sec", name);
+    std::println("{:>12} {:>12} {:>10} {:>10} {:>10} {:>10}", "data_size",
+                 "buffer_size", "average", "stddev", "ci_low", "ci_high");
+    for (const BenchmarkResult &result : rows) {
+      const SampleStatistics &s = result.statistics.value();
+      std::println("{:>12} {:>12} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}",
+                   size_or_empty(result.data_size),
+                   size_or_empty(result.buffer_size), result.average * scale,
+                   result.stddev * scale, s.ci_low * scale, s.ci_high * scale);
+    }
+  }
+}
+
+// Helper function to output a matrix of results. JSON output is in the unit of
+// the values and text and CSV output are multiplied by text_scale, e.g. 1e9 to
+// print seconds as nanoseconds. label_name names the rows and columns, e.g.
+// "cpus". Unmeasured cells are empty.
+void OutputMatrix(const std::string &name, const std::string &description,
+                  const std::string &label_name, const BenchmarkMatrix &matrix,
+                  const std::string &unit, double text_scale, bool json_output,
+                  bool csv_output) {
+  const size_t n = matrix.labels.size();
+  if (json_output) {
+    std::println("{{");
+    std::println(R"(  "name": "{}",)", name);
+    std::string labels;
+    for (size_t i = 0; i < n; ++i) {
+      labels += std::format("{}{}", i == 0 ? "" : ", ", matrix.labels[i]);
+    }
+    std::println(R"(  "{}": [{}],)", label_name, labels);
+    std::println(R"(  "values": [)");
+    for (size_t i = 0; i < n; ++i) {
+      std::string row;
+      for (size_t j = 0; j < n; ++j) {
+        const std::optional<double> &value = matrix.values[i][j];
+        row += std::format("{}{}", j == 0 ? "" : ", ",
+                           value.has_value() ? std::format("{:e}", *value)
+                                             : std::string("null"));
+      }
+      std::println("    [{}]{}", row, i + 1 < n ? "," : "");
+    }
+    std::println("  ],");
+    std::println(R"(  "unit": "{}")", unit);
+    std::println("}}");
+  } else if (csv_output) {
+    std::string header = label_name;
+    for (int label : matrix.labels) {
+      header += std::format(",{}", label);
+    }
+    std::println("{}", header);
+    for (size_t i = 0; i < n; ++i) {
+      std::string row = std::to_string(matrix.labels[i]);
+      for (size_t j = 0; j < n; ++j) {
+        const std::optional<double> &value = matrix.values[i][j];
+        row += value.has_value() ? std::format(",{:.3f}", *value * text_scale)
+                                 : ",";
+      }
+      std::println("{}", row);
+    }
+  } else {
+    std::println("{}: {}", name, description);
+    std::string header = std::format("{:>6}", "");
+    for (int label : matrix.labels) {
+      header += std::format(" {:>10}", label);
+    }
+    std::println("{}", header);
+    for (size_t i = 0; i < n; ++i) {
+      std::string row = std::format("{:>6}", matrix.labels[i]);
+      for (size_t j = 0; j < n; ++j) {
+        const std::optional<double> &value = matrix.values[i][j];
+        row += value.has_value()
+                   ? std::format(" {:>10.3f}", *value * text_scale)
+                   : std::format(" {:>10}", "-");
+      }
+      std::println("{}", row);
     }
   }
 }
 
+// Runs a benchmark with num_iterations measurement iterations. With a target
+// confidence interval, it runs batches of iterations instead, starting with
+// TARGET_CI_FIRST_BATCH_SIZE and doubling the number of samples each time,
+// until the 95% confidence interval of all samples is within target_ci of the
+// average or max_iterations samples have been collected.
+BenchmarkResult
+MeasureBenchmark(const std::function<BenchmarkResult(int)> &run,
+                 int num_iterations, const std::optional<double> &target_ci_opt,
+                 int max_iterations) {
+  if (!target_ci_opt.has_value()) {
+    return run(num_iterations);
+  }
+
+  std::vector<double> samples;
+  BenchmarkResult result;
+  int batch_size = TARGET_CI_FIRST_BATCH_SIZE;
+  while (true) {
+    const BenchmarkResult batch = run(batch_size);
+    samples.insert(samples.end(), batch.samples.begin(), batch.samples.end());
+    result = SummarizeSamples(samples);
+    // Percentiles and metrics cannot be merged, so report those of the last
+    // batch.
+    result.percentiles = batch.percentiles;
+    result.metrics = batch.metrics;
+
+    const double ci = RelativeCiHalfWidth(result.statistics.value());
+    AKLOG(aklog::LogLevel::DEBUG,
+          std::format("{} samples, confidence interval ±{:.2f}%",
+                      samples.size(), ci * 100));
+    if (ci <= target_ci_opt.value()) {
+      break;
+    }
+    const int remaining = max_iterations - static_cast<int>(samples.size());
+    if (remaining <= 0) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("Confidence interval ±{:.2f}% did not reach the target "
+                        "±{:.2f}% within {} iterations",
+                        ci * 100, target_ci_opt.value() * 100, samples.size()));
+      break;
+    }
+    batch_size = std::min(static_cast<int>(samples.size()), remaining);
+  }
+  return result;
+}
+
+// Runs a benchmark and adds the perf counters of its timed regions to the
+// metrics, divided by num_units, e.g. the number of bytes transferred. Also
+// adds the time spent verifying one buffer as verification_time, so that it
+// can be told apart from the transfer time.
+BenchmarkResult
+RunWithPerfCounters(const std::function<BenchmarkResult()> &run,
+                    const std::string &unit, double num_units) {
+  ResetPerfCounters();
+  ResetVerificationTime();
+  BenchmarkResult result = run();
+  for (auto &metric : GetPerfCounterMetrics(unit, num_units)) {
+    result.metrics.push_back(std::move(metric));
+  }
+  if (GetNumVerifications() > 0) {
+    result.metrics.emplace_back("verification_time",
+                                GetVerificationTime() /
+                                    GetNumVerifications());
+  }
+  return result;
+}
+
+struct LatencyBenchmark {
+  std::string name;
+  // Key into the default loop sizes
+  std::string loop_size_key;
+  // Number of reported one-trip latencies per loop, used to estimate the
+  // duration of an iteration from the reported latency
+  int trips_per_loop;
+  std::function<BenchmarkResult(int num_iterations, int num_warmups,
+                                uint64_t loop_size)>
+      run;
+};
+
+// Binds the latency benchmark of a transport to --message-size.
+std::function<BenchmarkResult(int, int, uint64_t)> MessageLatencyBenchmark(
+    BenchmarkResult (*run)(int num_iterations, int num_warmups,
+                           uint64_t loop_size, uint64_t message_size)) {
+  return [run](int num_iterations, int num_warmups, uint64_t loop_size) {
+    return run(num_iterations, num_warmups, loop_size,
+               g_message_size.value_or(DEFAULT_MESSAGE_SIZE));
+  };
+}
+
+// All latency benchmarks in the order latency_all runs them
+const std::vector<LatencyBenchmark> LATENCY_BENCHMARKS = {
+    {"latency_atomic", "atomic", 4, RunAtomicLatencyBenchmark},
+    {"latency_atomic_rel_acq", "atomic", 4, RunAtomicRelAcqLatencyBenchmark},
+    {"latency_barrier", "barrier", 1, RunBarrierLatencyBenchmark},
+    {"latency_condition_variable", "condition_variable", 2,
+     RunConditionVariableLatencyBenchmark},
+    {"latency_semaphore", "semaphore", 2, RunSemaphoreLatencyBenchmark},
+    {"latency_futex", "futex", 2, RunFutexLatencyBenchmark},
+    {"latency_futex_shared", "futex", 2, RunFutexSharedLatencyBenchmark},
+    {"latency_eventfd", "eventfd", 2, RunEventfdLatencyBenchmark},
+    {"latency_eventfd_epoll", "eventfd", 2, RunEventfdEpollLatencyBenchmark},
+    {"latency_atomic_wait", "atomic_wait", 2, RunAtomicWaitLatencyBenchmark},
+    {"latency_tcp", "message", 2,
+     MessageLatencyBenchmark(RunTcpLatencyBenchmark)},
+    {"latency_uds", "message", 2,
+     MessageLatencyBenchmark(RunUdsLatencyBenchmark)},
+    {"latency_pipe", "message", 2,
+     MessageLatencyBenchmark(RunPipeLatencyBenchmark)},
+    {"latency_fifo", "message", 2,
+     MessageLatencyBenchmark(RunFifoLatencyBenchmark)},
+    {"latency_mq", "message", 2,
+     MessageLatencyBenchmark(RunMqLatencyBenchmark)},
+    {"latency_shm", "message", 2,
+     MessageLatencyBenchmark(RunShmLatencyBenchmark)},
+    {"latency_mmap", "message", 2,
+     MessageLatencyBenchmark(RunMmapLatencyBenchmark)},
+    {"latency_statfs", "statfs", 1, RunStatfsLatencyBenchmark},
+    {"latency_fstatfs", "fstatfs", 1, RunFstatfsLatencyBenchmark},
+    {"latency_getpid", "getpid", 1, RunGetpidLatencyBenchmark},
+};
+
+// Finds a loop size with which one iteration of the benchmark takes at least
+// min_iteration_time seconds, in the same way as Google Benchmark: start with
+// one operation and grow the loop size by the predicted factor, at most 10x
+// while the measured time is too short to extrapolate from.
+uint64_t CalibrateLoopSize(const LatencyBenchmark &benchmark,
+                           double min_iteration_time) {
+  uint64_t loop_size = 1;
+  while (true) {
+    const BenchmarkResult result = benchmark.run(1, 1, loop_size);
+    const double iteration_time =
+        result.average * benchmark.trips_per_loop * loop_size;
+    AKLOG(aklog::LogLevel::DEBUG,
+          std::format("Calibrating {}: loop size {} takes {:e} sec",
+                      benchmark.name, loop_size, iteration_time));
+    if (iteration_time >= min_iteration_time ||
+        loop_size >= MAX_CALIBRATED_LOOP_SIZE) {
+      return loop_size;
+    }
+
+    // Overshoot a little so that the next attempt is likely the last.
+    double multiplier =
+        min_iteration_time * 1.4 / std::max(iteration_time, 1e-9);
+    if (iteration_time / min_iteration_time <= 0.1) {
+      multiplier = std::min(multiplier, 10.0);
+    }
+    loop_size = std::min<uint64_t>(
+        std::max<uint64_t>(loop_size * multiplier, loop_size + 1),
+        MAX_CALIBRATED_LOOP_SIZE);
+  }
+}
+
+struct BandwidthBenchmark {
+  std::string name;
+  std::function<BenchmarkResult(int num_iterations, int num_warmups,
+                                uint64_t data_size, uint64_t buffer_size)>
+      run;
+};
+
+// Run function of the io_uring benchmark of transport with the io_uring
+// options of the command line
+std::function<BenchmarkResult(int, int, uint64_t, uint64_t)>
+UringBandwidthBenchmark(UringTransport transport) {
+  return [transport](int num_iterations, int num_warmups, uint64_t data_size,
+                     uint64_t buffer_size) {
+    return RunUringBandwidthBenchmark(
+        transport, num_iterations, num_warmups, data_size, buffer_size,
+        g_uring_batch_size.value_or(DEFAULT_URING_BATCH_SIZE),
+        g_uring_sqpoll);
+  };
+}
+
+// All bandwidth benchmarks except bandwidth_memcpy*, which are run with each
+// memcpy kernel and bandwidth_memcpy_mt also with several thread counts, and
+// bandwidth_cma*, which are run with each iovec count, in the order
+// bandwidth_all runs them after bandwidth_memcpy
+const std::vector<BandwidthBenchmark> BANDWIDTH_BENCHMARKS = {
+    {"bandwidth_tcp", RunTcpBandwidthBenchmark},
+    {"bandwidth_tcp_zerocopy", RunTcpZerocopyBandwidthBenchmark},
+    {"bandwidth_uds", RunUdsBandwidthBenchmark},
+    {"bandwidth_uds_dgram", RunUdsDgramBandwidthBenchmark},
+    {"bandwidth_uds_seqpacket", RunUdsSeqpacketBandwidthBenchmark},
+    {"bandwidth_udp", RunUdpBandwidthBenchmark},
+    {"bandwidth_pipe", RunPipeBandwidthBenchmark},
+    {"bandwidth_pipe_vmsplice", RunPipeVmspliceBandwidthBenchmark},
+    {"bandwidth_pipe_splice", RunPipeSpliceBandwidthBenchmark},
+    {"bandwidth_fifo", RunFifoBandwidthBenchmark},
+    {"bandwidth_tcp_uring", UringBandwidthBenchmark(UringTransport::TCP)},
+    {"bandwidth_uds_uring", UringBandwidthBenchmark(UringTransport::UDS)},
+    {"bandwidth_pipe_uring", UringBandwidthBenchmark(UringTransport::PIPE)},
+    {"bandwidth_fifo_uring", UringBandwidthBenchmark(UringTransport::FIFO)},
+    {"bandwidth_mq", RunMqBandwidthBenchmark},
+    {"bandwidth_mmap",
+     [](int num_iterations, int num_warmups, uint64_t data_size,
+        uint64_t buffer_size) {
+       return RunMmapBandwidthBenchmark(
+           num_iterations, num_warmups, data_size, buffer_size,
+           StringToPageSize(g_page_size.value_or("4k")).value());
+     }},
+    {"bandwidth_shm",
+     [](int num_iterations, int num_warmups, uint64_t data_size,
+        uint64_t buffer_size) {
+       return RunShmBandwidthBenchmark(
+           num_iterations, num_warmups, data_size, buffer_size,
+           StringToPageSize(g_page_size.value_or("4k")).value());
+     }},
+    {"bandwidth_shm_ring",
+     [](int num_iterations, int num_warmups, uint64_t data_size,
+        uint64_t buffer_size) {
+       const ShmRingOptions options = {
+           .num_slots = static_cast<uint32_t>(
+               g_ring_slots.value_or(DEFAULT_SHM_RING_SLOTS)),
+           .batch = static_cast<uint32_t>(
+               g_ring_batch.value_or(DEFAULT_SHM_RING_BATCH)),
+           .wait_strategy =
+               StringToRingWaitStrategy(g_ring_wait.value_or("spin-futex"))
+                   .value()};
+       return RunShmRingBandwidthBenchmark(num_iterations, num_warmups,
+                                           data_size, buffer_size, options);
+     }},
+    {"bandwidth_memfd", RunMemfdBandwidthBenchmark},
+};
+
+// Bandwidth benchmarks that fork one sender/receiver pair and can run several
+// pairs at the same time with --num-pairs
+const std::set<std::string> MULTI_PAIR_BENCHMARKS = {
+    "bandwidth_tcp",         "bandwidth_tcp_zerocopy", "bandwidth_uds",
+    "bandwidth_pipe",        "bandwidth_pipe_vmsplice", "bandwidth_pipe_splice",
+    "bandwidth_fifo",        "bandwidth_shm",          "bandwidth_mmap",
+};
+
 std::map<std::string, BenchmarkResult>
 RunLatencyBenchmarks(int num_iterations, int num_warmups,
                      const std::map<std::string, uint64_t> &default_loop_sizes,
                      const std::optional<uint64_t> &loop_size_opt,
-                     const std::string &type) {
-
-  const uint64_t atomic_loop_size = loop_size_opt.has_value()
-                                        ? *loop_size_opt
-                                        : default_loop_sizes.at("atomic");
-  const uint64_t atomic_rel_acq_loop_size =
-      loop_size_opt.has_value() ? *loop_size_opt
-                                : default_loop_sizes.at("atomic");
-  const uint64_t barrier_loop_size = loop_size_opt.has_value()
-                                         ? *loop_size_opt
-                                         : default_loop_sizes.at("barrier");
-  const uint64_t cv_loop_size =
-      loop_size_opt.has_value() ? *loop_size_opt
-                                : default_loop_sizes.at("condition_variable");
-  const uint64_t semaphore_loop_size = loop_size_opt.has_value()
-                                           ? *loop_size_opt
-                                           : default_loop_sizes.at("semaphore");
-  const uint64_t statfs_loop_size = loop_size_opt.has_value()
-                                        ? *loop_size_opt
-                                        : default_loop_sizes.at("statfs");
-  const uint64_t fstatfs_loop_size = loop_size_opt.has_value()
-                                         ? *loop_size_opt
-                                         : default_loop_sizes.at("fstatfs");
-  const uint64_t getpid_loop_size = loop_size_opt.has_value()
-                                        ? *loop_size_opt
-                                        : default_loop_sizes.at("getpid");
-
+                     const std::optional<double> &min_iteration_time_opt,
+                     const std::optional<double> &target_ci_opt,
+                     int max_iterations, const std::string &type) {
   std::map<std::string, BenchmarkResult> results;
-  BenchmarkResult result;
 
-  if (type == "latency_all") {
-    result = RunAtomicLatencyBenchmark(num_iterations, num_warmups,
-                                       atomic_loop_size);
-    results["latency_atomic"] = result;
-
-    result = RunAtomicRelAcqLatencyBenchmark(num_iterations, num_warmups,
-                                             atomic_rel_acq_loop_size);
-    results["latency_atomic_rel_acq"] = result;
-
-    result = RunBarrierLatencyBenchmark(num_iterations, num_warmups,
-                                        barrier_loop_size);
-    results["latency_barrier"] = result;
-
-    result = RunConditionVariableLatencyBenchmark(num_iterations, num_warmups,
-                                                  cv_loop_size);
-    results["latency_condition_variable"] = result;
-
-    result = RunSemaphoreLatencyBenchmark(num_iterations, num_warmups,
-                                          semaphore_loop_size);
-    results["latency_semaphore"] = result;
-
-    result = RunStatfsLatencyBenchmark(num_iterations, num_warmups,
-                                       statfs_loop_size);
-    results["latency_statfs"] = result;
-
-    result = RunFstatfsLatencyBenchmark(num_iterations, num_warmups,
-                                        fstatfs_loop_size);
-    results["latency_fstatfs"] = result;
-
-    result = RunGetpidLatencyBenchmark(num_iterations, num_warmups,
-                                       getpid_loop_size);
-    results["latency_getpid"] = result;
-  } else if (type == "latency_atomic") {
-    result = RunAtomicLatencyBenchmark(num_iterations, num_warmups,
-                                       atomic_loop_size);
-    results["latency_atomic"] = result;
-  } else if (type == "latency_atomic_rel_acq") {
-    result = RunAtomicRelAcqLatencyBenchmark(num_iterations, num_warmups,
-                                             atomic_rel_acq_loop_size);
-    results["latency_atomic_rel_acq"] = result;
-  } else if (type == "latency_barrier") {
-    result = RunBarrierLatencyBenchmark(num_iterations, num_warmups,
-                                        barrier_loop_size);
-    results["latency_barrier"] = result;
-  } else if (type == "latency_condition_variable") {
-    result = RunConditionVariableLatencyBenchmark(num_iterations, num_warmups,
-                                                  cv_loop_size);
-    results["latency_condition_variable"] = result;
-  } else if (type == "latency_semaphore") {
-    result = RunSemaphoreLatencyBenchmark(num_iterations, num_warmups,
-                                          semaphore_loop_size);
-    results["latency_semaphore"] = result;
-  } else if (type == "latency_statfs") {
-    result = RunStatfsLatencyBenchmark(num_iterations, num_warmups,
-                                       statfs_loop_size);
-    results["latency_statfs"] = result;
-  } else if (type == "latency_fstatfs") {
-    result = RunFstatfsLatencyBenchmark(num_iterations, num_warmups,
-                                        fstatfs_loop_size);
-    results["latency_fstatfs"] = result;
-  } else if (type == "latency_getpid") {
-    result = RunGetpidLatencyBenchmark(num_iterations, num_warmups,
-                                       getpid_loop_size);
-    results["latency_getpid"] = result;
+  for (const LatencyBenchmark &benchmark : LATENCY_BENCHMARKS) {
+    if (type != "latency_all" && type != benchmark.name) {
+      continue;
+    }
+    uint64_t loop_size = default_loop_sizes.at(benchmark.loop_size_key);
+    if (loop_size_opt.has_value()) {
+      loop_size = *loop_size_opt;
+    } else if (min_iteration_time_opt.has_value()) {
+      loop_size = CalibrateLoopSize(benchmark, *min_iteration_time_opt);
+    }
+    BenchmarkResult result = MeasureBenchmark(
+        [&](int n) {
+          return RunWithPerfCounters(
+              [&] { return benchmark.run(n, num_warmups, loop_size); }, "op",
+              static_cast<double>(loop_size) * n);
+        },
+        num_iterations, target_ci_opt, max_iterations);
+    result.loop_size = loop_size;
+    results[benchmark.name] = result;
   }
 
   return results;
 }
 
+// run_memcpy is false to skip bandwidth_memcpy and bandwidth_memcpy_mt, which
+// do not depend on buffer_size, when a sweep already ran them for data_size.
 std::map<std::string, BenchmarkResult>
 RunBandwidthBenchmarks(int num_iterations, int num_warmups, uint64_t data_size,
                        uint64_t buffer_size,
                        const std::optional<uint64_t> &num_threads_opt,
-                       const std::string &type) {
+                       const std::optional<double> &target_ci_opt,
+                       int max_iterations, const std::string &type,
+                       bool run_memcpy) {
   std::map<std::string, BenchmarkResult> results;
-  BenchmarkResult benchmark_result;
-
-  if (type == "bandwidth_all") {
-    benchmark_result =
-        RunMemcpyBandwidthBenchmark(num_iterations, num_warmups, data_size);
-    results["bandwidth_memcpy"] = benchmark_result;
-
-    // Run memcpy_mt with 1-4 threads for "bandwidth_all" case
-    for (uint64_t n_threads = 1; n_threads <= 4; ++n_threads) {
-      benchmark_result = RunMemcpyMtBandwidthBenchmark(
-          num_iterations, num_warmups, data_size, n_threads);
-      results["bandwidth_memcpy_mt (" + std::to_string(n_threads) +
-              " threads)"] = benchmark_result;
-    }
-
-    benchmark_result = RunTcpBandwidthBenchmark(num_iterations, num_warmups,
-                                                data_size, buffer_size);
-    results["bandwidth_tcp"] = benchmark_result;
-
-    benchmark_result = RunUdsBandwidthBenchmark(num_iterations, num_warmups,
-                                                data_size, buffer_size);
-    results["bandwidth_uds"] = benchmark_result;
-
-    benchmark_result = RunPipeBandwidthBenchmark(num_iterations, num_warmups,
-                                                 data_size, buffer_size);
-    results["bandwidth_pipe"] = benchmark_result;
-
-    benchmark_result = RunFifoBandwidthBenchmark(num_iterations, num_warmups,
-                                                 data_size, buffer_size);
-    results["bandwidth_fifo"] = benchmark_result;
-
-    benchmark_result = RunMqBandwidthBenchmark(num_iterations, num_warmups,
-                                               data_size, buffer_size);
-    results["bandwidth_mq"] = benchmark_result;
-
-    benchmark_result = RunMmapBandwidthBenchmark(num_iterations, num_warmups,
-                                                 data_size, buffer_size);
-    results["bandwidth_mmap"] = benchmark_result;
-
-    benchmark_result = RunShmBandwidthBenchmark(num_iterations, num_warmups,
-                                                data_size, buffer_size);
-    results["bandwidth_shm"] = benchmark_result;
-  } else if (type == "bandwidth_memcpy") {
-    benchmark_result =
-        RunMemcpyBandwidthBenchmark(num_iterations, num_warmups, data_size);
-    results["bandwidth_memcpy"] = benchmark_result;
-  } else if (type == "bandwidth_memcpy_mt") {
-    if (num_threads_opt.has_value()) {
-      // Run with specified number of threads
-      benchmark_result = RunMemcpyMtBandwidthBenchmark(
-          num_iterations, num_warmups, data_size, num_threads_opt.value());
-      results["bandwidth_memcpy_mt"] = benchmark_result;
-    } else {
-      // Run with 1-4 threads for compatibility
-      for (uint64_t n_threads = 1; n_threads <= 4; ++n_threads) {
-        benchmark_result = RunMemcpyMtBandwidthBenchmark(
-            num_iterations, num_warmups, data_size, n_threads);
-        results["bandwidth_memcpy_mt (" + std::to_string(n_threads) +
-                " threads)"] = benchmark_result;
+
+  // Generate the data once here, before any benchmark forks, so that all
+  // benchmarks and their peers share one copy.
+  GenerateDataToSend(data_size);
+
+  // The kernel is named in the results only if --memcpy-impl is given.
+  const auto memcpy_name = [](const std::string &name,
+                              const MemcpyKernel &kernel,
+                              const std::string &detail = "") {
+    if (!g_memcpy_impl.has_value()) {
+      return detail.empty() ? name : std::format("{} ({})", name, detail);
+    }
+    return detail.empty() ? std::format("{} ({})", name, kernel.name)
+                          : std::format("{} ({}, {})", name, kernel.name,
+                                        detail);
+  };
+  const PageSize page_size =
+      StringToPageSize(g_page_size.value_or("4k")).value();
+
+  if (run_memcpy && (type == "bandwidth_all" || type == "bandwidth_memcpy")) {
+    for (const MemcpyKernel *kernel : g_memcpy_kernels) {
+      results[memcpy_name("bandwidth_memcpy", *kernel)] = MeasureBenchmark(
+          [&](int n) {
+            return RunWithPerfCounters(
+                [&] {
+                  return RunMemcpyBandwidthBenchmark(n, num_warmups, data_size,
+                                                     page_size, *kernel);
+                },
+                "byte", static_cast<double>(data_size) * n);
+          },
+          num_iterations, target_ci_opt, max_iterations);
+    }
+  }
+
+  for (const BandwidthBenchmark &benchmark : BANDWIDTH_BENCHMARKS) {
+    if (type != "bandwidth_all" && type != benchmark.name) {
+      continue;
+    }
+    if (benchmark.name.ends_with("_uring") && !IsIoUringSupported()) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("Skipping {}: io_uring is not available",
+                        benchmark.name));
+      continue;
+    }
+    if ((g_num_pairs.size() > 1 || g_num_pairs.front() != 1) &&
+        MULTI_PAIR_BENCHMARKS.contains(benchmark.name)) {
+      // Results are ordered by name, so pad the counts to sort them by value.
+      const size_t count_width = std::to_string(g_num_pairs.back()).size();
+      for (uint64_t num_pairs : g_num_pairs) {
+        const std::string name =
+            g_num_pairs.size() == 1
+                ? benchmark.name
+                : std::format("{} ({:>{}} pairs)", benchmark.name, num_pairs,
+                              count_width);
+        results[name] = MeasureBenchmark(
+            [&](int n) {
+              return RunWithPerfCounters(
+                  [&] {
+                    return RunMultiPairBandwidthBenchmark(
+                        n, num_warmups, data_size, buffer_size, num_pairs,
+                        benchmark.run);
+                  },
+                  "byte", static_cast<double>(data_size) * n * num_pairs);
+            },
+            num_iterations, target_ci_opt, max_iterations);
       }
+      continue;
+    }
+    results[benchmark.name] = MeasureBenchmark(
+        [&](int n) {
+          return RunWithPerfCounters(
+              [&] {
+                return benchmark.run(n, num_warmups, data_size, buffer_size);
+              },
+              "byte", static_cast<double>(data_size) * n);
+        },
+        num_iterations, target_ci_opt, max_iterations);
+  }
+
+  if (run_memcpy &&
+      (type == "bandwidth_all" || type == "bandwidth_memcpy_mt")) {
+    const auto measure_memcpy_mt = [&](uint64_t n_threads,
+                                       const MemcpyKernel &kernel) {
+      return MeasureBenchmark(
+          [&](int n) {
+            return RunMemcpyMtBandwidthBenchmark(n, num_warmups, data_size,
+                                                 n_threads, page_size, kernel);
+          },
+          num_iterations, target_ci_opt, max_iterations);
+    };
+    for (const MemcpyKernel *kernel : g_memcpy_kernels) {
+      if (num_threads_opt.has_value()) {
+        // Run with specified number of threads
+        results[memcpy_name("bandwidth_memcpy_mt", *kernel)] =
+            measure_memcpy_mt(num_threads_opt.value(), *kernel);
+      } else {
+        // Run with 1-4 threads for compatibility
+        for (uint64_t n_threads = 1; n_threads <= 4; ++n_threads) {
+          results[memcpy_name("bandwidth_memcpy_mt", *kernel,
+                              std::to_string(n_threads) + " threads")] =
+              measure_memcpy_mt(n_threads, *kernel);
+        }
+      }
+    }
+  }
+
+  for (const auto &[cma_name, direction] :
+       {std::pair{"bandwidth_cma", CmaDirection::READ},
+        std::pair{"bandwidth_cma_write", CmaDirection::WRITE}}) {
+    if (type != "bandwidth_all" && type != cma_name) {
+      continue;
+    }
+    // Results are ordered by name, so pad the counts to sort them by value.
+    const size_t count_width = std::to_string(g_iov_counts.back()).size();
+    for (uint64_t iov_count : g_iov_counts) {
+      const std::string name =
+          g_iov_counts.size() == 1
+              ? cma_name
+              : std::format("{} ({:>{}} iovecs)", cma_name, iov_count,
+                            count_width);
+      results[name] = MeasureBenchmark(
+          [&](int n) {
+            return RunWithPerfCounters(
+                [&] {
+                  return RunCmaBandwidthBenchmark(direction, n, num_warmups,
+                                                  data_size, buffer_size,
+                                                  iov_count);
+                },
+                "byte", static_cast<double>(data_size) * n);
+          },
+          num_iterations, target_ci_opt, max_iterations);
     }
-  } else if (type == "bandwidth_tcp") {
-    benchmark_result = RunTcpBandwidthBenchmark(num_iterations, num_warmups,
-                                                data_size, buffer_size);
-    results["bandwidth_tcp"] = benchmark_result;
-  } else if (type == "bandwidth_uds") {
-    benchmark_result = RunUdsBandwidthBenchmark(num_iterations, num_warmups,
-                                                data_size, buffer_size);
-    results["bandwidth_uds"] = benchmark_result;
-  } else if (type == "bandwidth_pipe") {
-    benchmark_result = RunPipeBandwidthBenchmark(num_iterations, num_warmups,
-                                                 data_size, buffer_size);
-    results["bandwidth_pipe"] = benchmark_result;
-  } else if (type == "bandwidth_fifo") {
-    benchmark_result = RunFifoBandwidthBenchmark(num_iterations, num_warmups,
-                                                 data_size, buffer_size);
-    results["bandwidth_fifo"] = benchmark_result;
-  } else if (type == "bandwidth_mq") {
-    benchmark_result = RunMqBandwidthBenchmark(num_iterations, num_warmups,
-                                               data_size, buffer_size);
-    results["bandwidth_mq"] = benchmark_result;
-  } else if (type == "bandwidth_mmap") {
-    benchmark_result = RunMmapBandwidthBenchmark(num_iterations, num_warmups,
-                                                 data_size, buffer_size);
-    results["bandwidth_mmap"] = benchmark_result;
-  } else if (type == "bandwidth_shm") {
-    benchmark_result = RunShmBandwidthBenchmark(num_iterations, num_warmups,
-                                                data_size, buffer_size);
-    results["bandwidth_shm"] = benchmark_result;
   }
 
   return results;
@@ -425,8 +1015,30 @@ int main(int argc, char *argv[]) {
       {"data-size", required_argument, nullptr, 'd'},
       {"buffer-size", required_argument, nullptr, 'b'},
       {"num-threads", required_argument, nullptr, 'n'},
-      {"log-level", required_argument, nullptr, 256}, // No short option
-      {"json-output", no_argument, nullptr, 257},     // No short option
+      // Long options without a short option
+      {"log-level", required_argument, nullptr, 256},
+      {"json-output", no_argument, nullptr, 257},
+      {"barrier-impl", required_argument, nullptr, 258},
+      {"target-ci", required_argument, nullptr, 259},
+      {"max-iterations", required_argument, nullptr, 260},
+      {"min-iteration-time", required_argument, nullptr, 261},
+      {"cpus", required_argument, nullptr, 262},
+      {"csv-output", no_argument, nullptr, 263},
+      {"numa-nodes", required_argument, nullptr, 264},
+      {"numa-cpu-node", required_argument, nullptr, 265},
+      {"perf-counters", required_argument, nullptr, 266},
+      {"uring-batch-size", required_argument, nullptr, 267},
+      {"uring-sqpoll", no_argument, nullptr, 268},
+      {"ring-slots", required_argument, nullptr, 269},
+      {"ring-batch", required_argument, nullptr, 270},
+      {"ring-wait", required_argument, nullptr, 271},
+      {"iov-count", required_argument, nullptr, 272},
+      {"message-size", required_argument, nullptr, 273},
+      {"page-size", required_argument, nullptr, 274},
+      {"num-pairs", required_argument, nullptr, 275},
+      {"checksum", required_argument, nullptr, 276},
+      {"seed", required_argument, nullptr, 277},
+      {"memcpy-impl", required_argument, nullptr, 278},
       {"help", no_argument, nullptr, 'h'},
       {nullptr, 0, nullptr, 0}};
 
@@ -447,10 +1059,10 @@ int main(int argc, char *argv[]) {
         g_loop_size = ParseUint64(optarg);
         break;
       case 'd':
-        g_data_size = ParseUint64(optarg).value();
+        g_data_sizes = ParseUint64Range(optarg);
         break;
       case 'b':
-        g_buffer_size = ParseUint64(optarg);
+        g_buffer_sizes = ParseUint64Range(optarg);
         break;
       case 'n':
         g_num_threads = ParseUint64(optarg);
@@ -461,6 +1073,74 @@ int main(int argc, char *argv[]) {
       case 257: // --json-output
         g_json_output = true;
         break;
+      case 258: // --barrier-impl
+        g_barrier_impl = optarg;
+        break;
+      case 259: // --target-ci
+        g_target_ci = ParseFraction(optarg);
+        break;
+      case 260: // --max-iterations
+        g_max_iterations = ParseInt(optarg);
+        break;
+      case 261: // --min-iteration-time
+        g_min_iteration_time = ParseDuration(optarg);
+        break;
+      case 262: // --cpus
+        g_cpus = optarg;
+        break;
+      case 263: // --csv-output
+        g_csv_output = true;
+        break;
+      case 264: // --numa-nodes
+        g_numa_nodes = optarg;
+        break;
+      case 265: // --numa-cpu-node
+        g_numa_cpu_node = ParseInt(optarg);
+        break;
+      case 266: // --perf-counters
+        g_perf_counters = optarg;
+        break;
+      case 267: // --uring-batch-size
+        g_uring_batch_size = ParseInt(optarg);
+        break;
+      case 268: // --uring-sqpoll
+        g_uring_sqpoll = true;
+        break;
+      case 269: // --ring-slots
+        g_ring_slots = ParseUint64(optarg);
+        break;
+      case 270: // --ring-batch
+        g_ring_batch = ParseUint64(optarg);
+        break;
+      case 271: // --ring-wait
+        g_ring_wait = optarg;
+        break;
+      case 272: // --iov-count
+        g_iov_counts = ParseUint64Range(optarg);
+        break;
+      case 273: // --message-size
+        g_message_size = ParseUint64(optarg);
+        break;
+      case 274: // --page-size
+        g_page_size = optarg;
+        break;
+      case 275: // --num-pairs
+        g_num_pairs = ParseUint64Range(optarg);
+        break;
+      case 276: // --checksum
+        g_checksum = optarg;
+        break;
+      case 277: // --seed
+        g_seed = ParseUint64(optarg);
+        if (!g_seed.has_value()) {
+          AKLOG(aklog::LogLevel::ERROR,
+                std::format("Invalid seed: {}", optarg));
+          return 1;
+        }
+        break;
+      case 278: // --memcpy-impl
+        g_memcpy_impl = optarg;
+        break;
       case 'h':
         PrintUsage(program_name);
         return 0;
@@ -494,21 +1174,26 @@ int main(int argc, char *argv[]) {
   const int num_iterations = g_num_iterations;
   const int num_warmups = g_num_warmups;
   const std::optional<uint64_t> &loop_size_opt = g_loop_size;
-  const uint64_t data_size = g_data_size;
-  const std::optional<uint64_t> &buffer_size_opt = g_buffer_size;
+  const std::optional<double> &min_iteration_time_opt = g_min_iteration_time;
+  const std::vector<uint64_t> &data_sizes = g_data_sizes;
+  const std::optional<std::vector<uint64_t>> &buffer_sizes_opt = g_buffer_sizes;
+  const bool is_size_sweep =
+      data_sizes.size() > 1 ||
+      (buffer_sizes_opt.has_value() && buffer_sizes_opt->size() > 1);
+  const uint64_t data_size = data_sizes.front();
+  const std::optional<uint64_t> buffer_size_opt =
+      buffer_sizes_opt.has_value()
+          ? std::optional<uint64_t>(buffer_sizes_opt->front())
+          : std::nullopt;
   const std::optional<uint64_t> &num_threads_opt = g_num_threads;
+  const std::optional<double> &target_ci_opt = g_target_ci;
+  const int max_iterations = g_max_iterations;
 
   if (type.empty()) {
-    AKLOG(
-        aklog::LogLevel::ERROR,
-        "Must specify TYPE as first argument. Available types:\nLatency tests: "
-        "latency_atomic, latency_atomic_rel_acq, latency_barrier, "
-        "latency_condition_variable, "
-        "latency_semaphore, latency_statfs, latency_fstatfs, latency_getpid, "
-        "latency_all\nBandwidth tests: bandwidth_memcpy, "
-        "bandwidth_memcpy_mt, bandwidth_tcp, bandwidth_uds, bandwidth_pipe, "
-        "bandwidth_fifo, bandwidth_mq, bandwidth_mmap, bandwidth_shm, "
-        "bandwidth_all\nCombined: all");
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("Must specify TYPE as first argument. Available "
+                      "types:\n{}",
+                      AVAILABLE_TYPES));
     return 1;
   }
 
@@ -519,9 +1204,246 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  if (loop_size_opt.has_value() && min_iteration_time_opt.has_value()) {
+    AKLOG(aklog::LogLevel::ERROR,
+          "--loop-size and --min-iteration-time cannot be used together");
+    return 1;
+  }
+
+  if (min_iteration_time_opt.has_value() &&
+      min_iteration_time_opt.value() <= 0.0) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("min_iteration_time must be greater than 0, got: {}",
+                      min_iteration_time_opt.value()));
+    return 1;
+  }
+
+  if (target_ci_opt.has_value() && target_ci_opt.value() <= 0.0) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("target_ci must be greater than 0, got: {}",
+                      target_ci_opt.value()));
+    return 1;
+  }
+
+  if (max_iterations < TARGET_CI_FIRST_BATCH_SIZE) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("max_iterations must be at least {}, got: {}",
+                      TARGET_CI_FIRST_BATCH_SIZE, max_iterations));
+    return 1;
+  }
+
+  if (g_csv_output && type != "latency_atomic_matrix" &&
+      type != "bandwidth_memcpy_numa" && !is_size_sweep) {
+    AKLOG(aklog::LogLevel::ERROR, "CSV output is only applicable to "
+                                  "latency_atomic_matrix, "
+                                  "bandwidth_memcpy_numa and size sweeps");
+    return 1;
+  }
+
+  if (is_size_sweep &&
+      (!type.starts_with("bandwidth_") || type == "bandwidth_memcpy_numa")) {
+    AKLOG(aklog::LogLevel::ERROR,
+          "Size ranges are only applicable to bandwidth benchmark types "
+          "except bandwidth_memcpy_numa");
+    return 1;
+  }
+
+  if ((g_numa_nodes.has_value() || g_numa_cpu_node.has_value()) &&
+      type != "bandwidth_memcpy_numa") {
+    AKLOG(aklog::LogLevel::ERROR, "NUMA options are only applicable to "
+                                  "bandwidth_memcpy_numa");
+    return 1;
+  }
+
+  if ((g_uring_batch_size.has_value() || g_uring_sqpoll) &&
+      !type.ends_with("_uring") && type != "bandwidth_all" && type != "all") {
+    AKLOG(aklog::LogLevel::ERROR,
+          "io_uring options are only applicable to bandwidth_*_uring");
+    return 1;
+  }
+
+  if (g_uring_batch_size.has_value() &&
+      (g_uring_batch_size.value() < 1 ||
+       g_uring_batch_size.value() > MAX_URING_BATCH_SIZE)) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("uring_batch_size must be between 1 and {}, got: {}",
+                      MAX_URING_BATCH_SIZE, g_uring_batch_size.value()));
+    return 1;
+  }
+
+  if ((g_ring_slots.has_value() || g_ring_batch.has_value() ||
+       g_ring_wait.has_value()) &&
+      type != "bandwidth_shm_ring" && type != "bandwidth_all" &&
+      type != "all") {
+    AKLOG(aklog::LogLevel::ERROR,
+          "Ring options are only applicable to bandwidth_shm_ring");
+    return 1;
+  }
+
+  const uint64_t ring_slots = g_ring_slots.value_or(DEFAULT_SHM_RING_SLOTS);
+  if (ring_slots == 0 || (ring_slots & (ring_slots - 1)) != 0 ||
+      ring_slots > UINT32_MAX) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("ring_slots must be a power of two, got: {}",
+                      ring_slots));
+    return 1;
+  }
+
+  const uint64_t ring_batch = g_ring_batch.value_or(
+      std::min<uint64_t>(DEFAULT_SHM_RING_BATCH, ring_slots));
+  if (ring_batch == 0 || ring_batch > ring_slots) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("ring_batch must be between 1 and ring_slots ({}), "
+                      "got: {}",
+                      ring_slots, ring_batch));
+    return 1;
+  }
+  g_ring_batch = ring_batch;
+
+  if (g_ring_wait.has_value() &&
+      !StringToRingWaitStrategy(g_ring_wait.value()).has_value()) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("Invalid ring wait strategy: {}. Available strategies: "
+                      "spin, spin-futex, eventfd",
+                      g_ring_wait.value()));
+    return 1;
+  }
+
+  if ((g_iov_counts.size() > 1 || g_iov_counts.front() != 1) &&
+      !type.starts_with("bandwidth_cma") && type != "bandwidth_all" &&
+      type != "all") {
+    AKLOG(aklog::LogLevel::ERROR,
+          "--iov-count is only applicable to bandwidth_cma and "
+          "bandwidth_cma_write");
+    return 1;
+  }
+
+  if (g_iov_counts.front() == 0 || g_iov_counts.back() > IOV_MAX) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("iov_count must be between 1 and IOV_MAX ({}), got: {}",
+                      IOV_MAX, g_iov_counts.back()));
+    return 1;
+  }
+
+  if ((g_num_pairs.size() > 1 || g_num_pairs.front() != 1) &&
+      !MULTI_PAIR_BENCHMARKS.contains(type) && type != "bandwidth_all" &&
+      type != "all") {
+    AKLOG(aklog::LogLevel::ERROR,
+          "--num-pairs is only applicable to bandwidth_tcp*, bandwidth_uds, "
+          "bandwidth_pipe*, bandwidth_fifo, bandwidth_shm and bandwidth_mmap");
+    return 1;
+  }
+
+  if (g_num_pairs.front() == 0) {
+    AKLOG(aklog::LogLevel::ERROR, "num_pairs must be positive");
+    return 1;
+  }
+
+  // A single pair is the usual two-peer benchmark, which may share a CPU.
+  if (g_num_pairs.back() > 1 &&
+      2 * g_num_pairs.back() > ReadCpuTopology().size()) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("{} pairs have more peers than the {} online CPUs, so "
+                      "peers share CPUs",
+                      g_num_pairs.back(), ReadCpuTopology().size()));
+  }
+
+  if (g_message_size.has_value() && type != "latency_all" && type != "all" &&
+      std::none_of(LATENCY_BENCHMARKS.begin(), LATENCY_BENCHMARKS.end(),
+                   [&type](const LatencyBenchmark &benchmark) {
+                     return benchmark.name == type &&
+                            benchmark.loop_size_key == "message";
+                   })) {
+    AKLOG(aklog::LogLevel::ERROR,
+          "--message-size is only applicable to the latency tests of "
+          "transports, e.g. latency_tcp");
+    return 1;
+  }
+
+  if (g_message_size.has_value() && g_message_size.value() == 0) {
+    AKLOG(aklog::LogLevel::ERROR, "message_size must be positive");
+    return 1;
+  }
+
+  if (g_page_size.has_value() && type != "bandwidth_memcpy" &&
+      type != "bandwidth_memcpy_mt" && type != "bandwidth_shm" &&
+      type != "bandwidth_mmap" && type != "bandwidth_all" && type != "all") {
+    AKLOG(aklog::LogLevel::ERROR,
+          "--page-size is only applicable to bandwidth_memcpy, "
+          "bandwidth_memcpy_mt, bandwidth_shm and bandwidth_mmap");
+    return 1;
+  }
+
+  if (g_memcpy_impl.has_value() && type != "bandwidth_memcpy" &&
+      type != "bandwidth_memcpy_mt" && type != "bandwidth_all" &&
+      type != "all") {
+    AKLOG(aklog::LogLevel::ERROR,
+          "--memcpy-impl is only applicable to bandwidth_memcpy and "
+          "bandwidth_memcpy_mt");
+    return 1;
+  }
+
+  if (g_memcpy_impl.has_value()) {
+    std::vector<std::string> names;
+    if (g_memcpy_impl.value() == "all") {
+      for (const MemcpyKernel &kernel : MemcpyKernels()) {
+        names.push_back(kernel.name);
+      }
+    } else {
+      std::stringstream ss(g_memcpy_impl.value());
+      std::string name;
+      while (std::getline(ss, name, ',')) {
+        names.push_back(name);
+      }
+    }
+    g_memcpy_kernels.clear();
+    for (const std::string &name : names) {
+      const MemcpyKernel *kernel = FindMemcpyKernel(name);
+      if (kernel == nullptr) {
+        std::string available;
+        for (const MemcpyKernel &available_kernel : MemcpyKernels()) {
+          available += std::format("{}{}", available.empty() ? "" : ", ",
+                                   available_kernel.name);
+        }
+        AKLOG(aklog::LogLevel::ERROR,
+              std::format("Invalid memcpy implementation: {}. Available "
+                          "implementations: all, {}",
+                          name, available));
+        return 1;
+      }
+      if (!kernel->is_supported()) {
+        AKLOG(aklog::LogLevel::WARNING,
+              std::format("Skipping memcpy implementation {}: not supported "
+                          "by this CPU",
+                          name));
+        continue;
+      }
+      g_memcpy_kernels.push_back(kernel);
+    }
+    if (g_memcpy_kernels.empty()) {
+      AKLOG(aklog::LogLevel::ERROR,
+            "None of the memcpy implementations can run on this CPU");
+      return 1;
+    }
+  }
+
+  if (g_page_size.has_value() &&
+      !StringToPageSize(g_page_size.value()).has_value()) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("Invalid page size: {}. Available page sizes: 4k, thp, "
+                      "2m, 1g",
+                      g_page_size.value()));
+    return 1;
+  }
+
+  if (g_csv_output && g_json_output) {
+    AKLOG(aklog::LogLevel::ERROR,
+          "--csv-output and --json-output cannot be used together");
+    return 1;
+  }
+
   // Check if buffer_size is specified for incompatible benchmark types
-  if ((type == "bandwidth_memcpy" || type == "bandwidth_memcpy_mt") &&
-      buffer_size_opt.has_value()) {
+  if (type.starts_with("bandwidth_memcpy") && buffer_size_opt.has_value()) {
     AKLOG(
         aklog::LogLevel::ERROR,
         std::format("Buffer size option is not applicable to {} benchmark type",
@@ -530,15 +1452,16 @@ int main(int argc, char *argv[]) {
   }
 
   // Check if num_threads is specified for incompatible benchmark types
-  if (type != "bandwidth_memcpy_mt" && num_threads_opt.has_value()) {
-    AKLOG(aklog::LogLevel::ERROR, "Number of threads option is only applicable "
-                                  "to bandwidth_memcpy_mt benchmark type");
+  if (type != "bandwidth_memcpy_mt" && type != "bandwidth_memcpy_numa" &&
+      num_threads_opt.has_value()) {
+    AKLOG(aklog::LogLevel::ERROR,
+          "Number of threads option is only applicable to bandwidth_memcpy_mt "
+          "and bandwidth_memcpy_numa benchmark types");
     return 1;
   }
 
-  // Validate num_threads for memcpy_mt
-  if (type == "bandwidth_memcpy_mt" && num_threads_opt.has_value() &&
-      num_threads_opt.value() == 0) {
+  // Validate num_threads for memcpy_mt and memcpy_numa
+  if (num_threads_opt.has_value() && num_threads_opt.value() == 0) {
     AKLOG(aklog::LogLevel::ERROR,
           std::format("num_threads must be greater than 0, got: {}",
                       num_threads_opt.value()));
@@ -547,18 +1470,47 @@ int main(int argc, char *argv[]) {
 
   // Get buffer size (use default if not specified)
   uint64_t buffer_size = buffer_size_opt.value_or(DEFAULT_BUFFER_SIZE);
-
-  // Validate buffer_size for bandwidth tests
-  if (type.find("bandwidth_") == 0 && type != "bandwidth_memcpy" &&
-      type != "bandwidth_memcpy_mt") {
-    if (buffer_size == 0) {
+  const std::vector<uint64_t> buffer_sizes =
+      buffer_sizes_opt.value_or(std::vector<uint64_t>{DEFAULT_BUFFER_SIZE});
+
+  // Pairs of data and buffer sizes of a size sweep. Pairs whose buffer is
+  // larger than the data are skipped.
+  std::vector<std::pair<uint64_t, uint64_t>> sweep_sizes;
+  if (is_size_sweep) {
+    for (uint64_t sweep_data_size : data_sizes) {
+      for (uint64_t sweep_buffer_size : buffer_sizes) {
+        if (type.starts_with("bandwidth_memcpy") ||
+            sweep_buffer_size <= sweep_data_size) {
+          sweep_sizes.emplace_back(sweep_data_size, sweep_buffer_size);
+        }
+      }
+    }
+    if (sweep_sizes.empty()) {
       AKLOG(aklog::LogLevel::ERROR,
-            std::format("buffer_size must be greater than 0, got: {}",
-                        buffer_size));
+            "Every buffer_size of the sweep is larger than every data_size");
       return 1;
     }
+    const size_t num_skipped =
+        data_sizes.size() * buffer_sizes.size() - sweep_sizes.size();
+    if (num_skipped > 0) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("Skipping {} pairs of sizes whose buffer_size is "
+                        "larger than data_size",
+                        num_skipped));
+    }
+  }
 
-    if (buffer_size > data_size) {
+  // Validate buffer_size for bandwidth tests
+  if (type.find("bandwidth_") == 0 && !type.starts_with("bandwidth_memcpy")) {
+    for (uint64_t size : buffer_sizes) {
+      if (size == 0) {
+        AKLOG(aklog::LogLevel::ERROR,
+              std::format("buffer_size must be greater than 0, got: {}", size));
+        return 1;
+      }
+    }
+
+    if (!is_size_sweep && buffer_size > data_size) {
       AKLOG(aklog::LogLevel::ERROR,
             std::format("buffer_size ({}) cannot be larger than data_size ({})",
                         buffer_size, data_size));
@@ -569,12 +1521,14 @@ int main(int argc, char *argv[]) {
   // Validate data_size for bandwidth tests
   if (type.find("bandwidth_") == 0 || type == "bandwidth_all" ||
       type == "all") {
-    if (data_size <= CHECKSUM_SIZE) {
-      AKLOG(aklog::LogLevel::ERROR,
-            std::format(
-                "data_size must be larger than CHECKSUM_SIZE ({}), got: {}",
-                CHECKSUM_SIZE, data_size));
-      return 1;
+    for (uint64_t size : data_sizes) {
+      if (size <= CHECKSUM_SIZE) {
+        AKLOG(aklog::LogLevel::ERROR,
+              std::format(
+                  "data_size must be larger than CHECKSUM_SIZE ({}), got: {}",
+                  CHECKSUM_SIZE, size));
+        return 1;
+      }
     }
   }
 
@@ -597,23 +1551,194 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  // Set barrier implementation. This must happen before any benchmark forks.
+  const std::optional<BarrierImpl> barrier_impl =
+      StringToBarrierImpl(g_barrier_impl);
+  if (!barrier_impl.has_value()) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("Invalid barrier implementation: {}. Available "
+                      "implementations: sem, futex, spin",
+                      g_barrier_impl));
+    return 1;
+  }
+  SenseReversingBarrier::SetDefaultImpl(barrier_impl.value());
+
+  // Set the checksum kind. This must also happen before any benchmark forks.
+  const std::optional<ChecksumKind> checksum_kind =
+      StringToChecksumKind(g_checksum);
+  if (!checksum_kind.has_value()) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("Invalid checksum: {}. Available checksums: xor, crc32c",
+                      g_checksum));
+    return 1;
+  }
+  SetChecksumKind(checksum_kind.value());
+  if (g_seed.has_value()) {
+    SetDataSeed(g_seed.value());
+  }
+
+  // Set CPU placement. This must also happen before any benchmark forks.
+  if (g_cpus.has_value()) {
+    const std::optional<CpuPlacement> placement =
+        ResolveCpuPlacement(g_cpus.value(), ReadCpuTopology(), AllowedCpus());
+    if (!placement.has_value()) {
+      AKLOG(aklog::LogLevel::ERROR,
+            std::format("Invalid CPU placement: {}", g_cpus.value()));
+      return 1;
+    }
+    // Pair k pins its peers to the CPUs after the first 2 * k, so fewer CPUs
+    // than peers put several pairs on the same CPUs.
+    if (g_num_pairs.back() > 1 &&
+        placement->cpus.size() < 2 * g_num_pairs.back()) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("{} pairs have more peers than the {} CPUs of --cpus, "
+                        "so pairs share CPUs",
+                        g_num_pairs.back(), placement->cpus.size()));
+    }
+    SetCpuPlacement(placement);
+  }
+
+  // Set perf counters. The totals of the peers are shared through memory
+  // mapped here, so this must also happen before any benchmark forks.
+  if (g_perf_counters.has_value()) {
+    std::vector<std::string> names;
+    std::stringstream ss(g_perf_counters.value());
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+      names.push_back(name);
+    }
+    if (!SetPerfCounters(names)) {
+      std::string available;
+      for (const std::string &available_name : GetAvailablePerfCounterNames()) {
+        available += std::format("{}{}", available.empty() ? "" : ", ",
+                                 available_name);
+      }
+      AKLOG(aklog::LogLevel::ERROR,
+            std::format("Invalid perf counters: {}. Available counters: {}",
+                        g_perf_counters.value(), available));
+      return 1;
+    }
+  }
+
   // Define default loop sizes for latency tests
   const std::map<std::string, uint64_t> default_loop_sizes = {
-      {"atomic", 1e6},    {"barrier", 1e3}, {"condition_variable", 1e5},
-      {"semaphore", 1e5}, {"statfs", 1e6},  {"fstatfs", 1e6},
-      {"getpid", 1e6}};
+      {"atomic", 1e6},      {"barrier", 1e3},     {"condition_variable", 1e5},
+      {"semaphore", 1e5},   {"futex", 1e5},       {"eventfd", 1e5},
+      {"atomic_wait", 1e5}, {"message", 1e4},     {"statfs", 1e6},
+      {"fstatfs", 1e6},     {"getpid", 1e6},      {"atomic_matrix", 1e4}};
+
+  // The matrix is not a single BenchmarkResult, so it is run and printed on
+  // its own and is not part of latency_all.
+  if (type == "latency_atomic_matrix") {
+    std::vector<int> cpus;
+    if (GetCpuPlacement().has_value()) {
+      cpus = GetCpuPlacement()->cpus;
+    } else {
+      // Only the online CPUs that this process may run on, e.g. under taskset
+      // or in a container with a restricted cpuset.
+      const std::vector<int> allowed = AllowedCpus();
+      for (const CpuInfo &info : ReadCpuTopology()) {
+        if (std::binary_search(allowed.begin(), allowed.end(), info.cpu)) {
+          cpus.push_back(info.cpu);
+        }
+      }
+    }
+
+    uint64_t loop_size = default_loop_sizes.at("atomic_matrix");
+    if (loop_size_opt.has_value()) {
+      loop_size = *loop_size_opt;
+    } else if (min_iteration_time_opt.has_value()) {
+      // Same loop as latency_atomic, which is the first latency benchmark.
+      loop_size =
+          CalibrateLoopSize(LATENCY_BENCHMARKS[0], *min_iteration_time_opt);
+    }
+
+    const BenchmarkMatrix matrix = RunAtomicLatencyMatrixBenchmark(
+        num_iterations, num_warmups, loop_size, cpus);
+    OutputMatrix(type,
+                 "round-trip latency in ns (row: parent CPU, column: child "
+                 "CPU)",
+                 "cpus", matrix, "sec", 1e9, g_json_output, g_csv_output);
+    return 0;
+  }
+
+  if (type == "bandwidth_memcpy_numa") {
+    const std::vector<int> online_nodes = GetNumaNodes();
+    std::vector<int> nodes = online_nodes;
+    if (g_numa_nodes.has_value()) {
+      const std::optional<std::vector<int>> parsed =
+          ParseCpuList(g_numa_nodes.value());
+      if (!parsed.has_value()) {
+        AKLOG(aklog::LogLevel::ERROR,
+              std::format("Invalid NUMA node list: {}", g_numa_nodes.value()));
+        return 1;
+      }
+      nodes = parsed.value();
+    }
+    std::vector<int> used_nodes = nodes;
+    if (g_numa_cpu_node.has_value()) {
+      used_nodes.push_back(g_numa_cpu_node.value());
+    }
+    for (int node : used_nodes) {
+      if (std::find(online_nodes.begin(), online_nodes.end(), node) ==
+          online_nodes.end()) {
+        AKLOG(aklog::LogLevel::ERROR,
+              std::format("NUMA node {} is not online", node));
+        return 1;
+      }
+    }
+
+    const BenchmarkMatrix matrix = RunMemcpyNumaBandwidthBenchmark(
+        num_iterations, num_warmups, data_size, num_threads_opt.value_or(1),
+        g_numa_cpu_node, nodes);
+    OutputMatrix(type,
+                 "bandwidth in GiByte/sec (row: source node, column: "
+                 "destination node)",
+                 "nodes", matrix, "Byte/sec", 1.0 / (1ULL << 30),
+                 g_json_output, g_csv_output);
+    return 0;
+  }
+
+  // A size sweep runs the bandwidth benchmarks once per pair of sizes in this
+  // process and prints all results together.
+  if (is_size_sweep) {
+    std::vector<std::pair<std::string, BenchmarkResult>> results;
+    // Data sizes for which the memcpy benchmarks already ran
+    std::set<uint64_t> memcpy_data_sizes;
+    for (const auto &[sweep_data_size, sweep_buffer_size] : sweep_sizes) {
+      AKLOG(aklog::LogLevel::INFO,
+            std::format("Running with data_size {} and buffer_size {}",
+                        sweep_data_size, sweep_buffer_size));
+      const bool run_memcpy =
+          memcpy_data_sizes.insert(sweep_data_size).second;
+      for (auto &[name, result] : RunBandwidthBenchmarks(
+               num_iterations, num_warmups, sweep_data_size, sweep_buffer_size,
+               num_threads_opt, target_ci_opt, max_iterations, type,
+               run_memcpy)) {
+        result.data_size = sweep_data_size;
+        if (!name.starts_with("bandwidth_memcpy")) {
+          result.buffer_size = sweep_buffer_size;
+        }
+        results.emplace_back(name, result);
+      }
+    }
+    OutputBandwidthSweep(results, g_json_output, g_csv_output);
+    return 0;
+  }
 
   // Handle the "all" case which runs all tests
   if (type == "all") {
     // Run all latency benchmarks
     auto latency_results =
         RunLatencyBenchmarks(num_iterations, num_warmups, default_loop_sizes,
-                             loop_size_opt, "latency_all");
+                             loop_size_opt, min_iteration_time_opt,
+                             target_ci_opt, max_iterations, "latency_all");
 
     // Run all bandwidth benchmarks
     auto bandwidth_results =
         RunBandwidthBenchmarks(num_iterations, num_warmups, data_size,
-                               buffer_size, num_threads_opt, "bandwidth_all");
+                               buffer_size, num_threads_opt, target_ci_opt,
+                               max_iterations, "bandwidth_all", true);
 
     if (g_json_output) {
       // For JSON output, output as a dictionary
@@ -638,28 +1763,23 @@ int main(int argc, char *argv[]) {
 
   // Handle latency tests
   if (type.find("latency_") == 0 || type == "latency_all") {
-    auto results = RunLatencyBenchmarks(
-        num_iterations, num_warmups, default_loop_sizes, loop_size_opt, type);
+    auto results = RunLatencyBenchmarks(num_iterations, num_warmups,
+                                        default_loop_sizes, loop_size_opt,
+                                        min_iteration_time_opt, target_ci_opt,
+                                        max_iterations, type);
     OutputLatencyResults(results, g_json_output);
   }
   // Handle bandwidth tests
   else if (type.find("bandwidth_") == 0 || type == "bandwidth_all") {
     auto results =
         RunBandwidthBenchmarks(num_iterations, num_warmups, data_size,
-                               buffer_size, num_threads_opt, type);
+                               buffer_size, num_threads_opt, target_ci_opt,
+                               max_iterations, type, true);
     OutputBandwidthResults(results, g_json_output);
   } else {
     AKLOG(aklog::LogLevel::ERROR,
-          std::format(
-              "Unknown benchmark type: {}. Available types:\nLatency tests: "
-              "latency_atomic, latency_atomic_rel_acq, latency_barrier, "
-              "latency_condition_variable, "
-              "latency_semaphore, latency_statfs, latency_fstatfs, "
-              "latency_getpid, latency_all\nBandwidth tests: bandwidth_memcpy, "
-              "bandwidth_memcpy_mt, bandwidth_tcp, bandwidth_uds, "
-              "bandwidth_pipe, bandwidth_fifo, bandwidth_mq, bandwidth_mmap, "
-              "bandwidth_shm, bandwidth_all\nCombined: all",
-              type));
+          std::format("Unknown benchmark type: {}. Available types:\n{}", type,
+                      AVAILABLE_TYPES));
     return 1;
   }
 
@@ -9,11 +9,15 @@
 #include "aklog.h"
 
 #include "common.h"
+#include "histogram.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 
 void ParentFlip(std::atomic<bool> *parent, const std::atomic<bool> &child,
-                const uint64_t loop_size) {
+                const uint64_t loop_size, LatencyHistogram *histogram) {
+  LatencyRecorder recorder(histogram);
   for (uint64_t i = 0; i < loop_size; ++i) {
     parent->store(true);
     while (!child.load()) {
@@ -23,6 +27,7 @@ void ParentFlip(std::atomic<bool> *parent, const std::atomic<bool> &child,
     while (child.load()) {
       ;
     }
+    recorder.Tick();
   }
 }
 
@@ -44,19 +49,29 @@ void ChildFlip(std::atomic<bool> *child, const std::atomic<bool> &parent,
 
 BenchmarkResult RunAtomicLatencyBenchmark(int num_iterations, int num_warmups,
                                           uint64_t loop_size) {
+  ScopedPeerAffinity affinity(PARENT_PEER);
   std::atomic<bool> parent{false}, child{false};
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   std::vector<double> durations;
   for (int i = 0; i < num_iterations + num_warmups; i++) {
     AKLOG(aklog::LogLevel::DEBUG, std::format("Starting iteration {}/{}", i + 1,
                                               num_iterations + num_warmups));
-    std::thread child_thread([&child, &parent, loop_size]() {
+    const bool is_warmup = i < num_warmups;
+    std::thread child_thread([&child, &parent, loop_size, is_warmup]() {
+      ScopedPeerAffinity affinity(CHILD_PEER);
+      // The child thread lives for one iteration only.
+      PerfCounters child_counters(CHILD_PEER, is_warmup ? 1 : 0);
+      child_counters.Start();
       ChildFlip(&child, parent, loop_size);
+      child_counters.Stop();
     });
 
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
-    ParentFlip(&parent, child, loop_size);
+    ParentFlip(&parent, child, loop_size, nullptr);
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     child_thread.join();
     AKLOG(aklog::LogLevel::DEBUG,
@@ -70,5 +85,52 @@ BenchmarkResult RunAtomicLatencyBenchmark(int num_iterations, int num_warmups,
     }
   }
 
-  return CalculateOneTripDuration(durations);
+  // Time each loop separately in one more pass to get the latency
+  // distribution. The clock reads are kept out of the passes above so that
+  // they do not inflate the average.
+  LatencyHistogram histogram;
+  std::thread child_thread([&child, &parent, loop_size]() {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    ChildFlip(&child, parent, loop_size);
+  });
+  ParentFlip(&parent, child, loop_size, &histogram);
+  child_thread.join();
+
+  BenchmarkResult result = CalculateOneTripDuration(durations);
+  // Each loop of ParentFlip consists of four one-way trips.
+  result.percentiles = histogram.Percentiles(1e-9 / 4);
+  return result;
+}
+
+BenchmarkMatrix RunAtomicLatencyMatrixBenchmark(int num_iterations,
+                                                int num_warmups,
+                                                uint64_t loop_size,
+                                                const std::vector<int> &cpus) {
+  const std::optional<CpuPlacement> previous_placement = GetCpuPlacement();
+
+  BenchmarkMatrix matrix{
+      .labels = cpus,
+      .values = std::vector<std::vector<std::optional<double>>>(
+          cpus.size(), std::vector<std::optional<double>>(cpus.size())),
+  };
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    for (size_t j = 0; j < cpus.size(); ++j) {
+      if (i == j) {
+        continue;
+      }
+      SetCpuPlacement(CpuPlacement{
+          .spec = std::format("{},{}", cpus[i], cpus[j]),
+          .cpus = {cpus[i], cpus[j]},
+      });
+      const BenchmarkResult result =
+          RunAtomicLatencyBenchmark(num_iterations, num_warmups, loop_size);
+      matrix.values[i][j] = result.average * 2;
+      AKLOG(aklog::LogLevel::DEBUG,
+            std::format("CPU {} -> CPU {}: {:.3f} ns", cpus[i], cpus[j],
+                        result.average * 2 * 1e9));
+    }
+  }
+
+  SetCpuPlacement(previous_placement);
+  return matrix;
 }
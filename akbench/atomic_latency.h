@@ -1,8 +1,18 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 #include "common.h"
 
 BenchmarkResult RunAtomicLatencyBenchmark(int num_iterations, int num_warmups,
                                           uint64_t loop_size);
+
+// Round-trip latencies in seconds between every ordered pair of CPUs. The
+// labels of the result are the CPUs and values[i][j] is measured with the
+// parent thread on cpus[i] and the child thread on cpus[j]. The diagonal is not
+// measured.
+BenchmarkMatrix RunAtomicLatencyMatrixBenchmark(int num_iterations,
+                                                int num_warmups,
+                                                uint64_t loop_size,
+                                                const std::vector<int> &cpus);
@@ -3,6 +3,7 @@
 #include <cstdint>
 
 #include "aklog.h"
+#include "topology.h"
 
 int main(int argc, char *argv[]) {
 
@@ -14,6 +15,20 @@ int main(int argc, char *argv[]) {
       RunAtomicLatencyBenchmark(num_iterations, num_warmups, loop_size);
 
   AKCHECK(result.average >= 0.0, "Latency should be non-negative");
+
+  // Both peers on the first allowed CPU so that this also runs on machines
+  // with a single CPU.
+  const int cpu = AllowedCpus().front();
+  const BenchmarkMatrix matrix = RunAtomicLatencyMatrixBenchmark(
+      num_iterations, num_warmups, loop_size, {cpu, cpu});
+  AKCHECK(matrix.values.size() == 2 && matrix.values[0].size() == 2,
+          "Matrix should be 2x2");
+  AKCHECK(!matrix.values[0][0].has_value() &&
+              !matrix.values[1][1].has_value(),
+          "Diagonal should not be measured");
+  AKCHECK(matrix.values[0][1].value() >= 0.0 &&
+              matrix.values[1][0].value() >= 0.0,
+          "Round-trip latency should be non-negative");
   AKLOG(aklog::LogLevel::INFO, "atomic_latency test passed");
 
   return 0;
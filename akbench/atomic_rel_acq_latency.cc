@@ -9,11 +9,15 @@
 #include "aklog.h"
 
 #include "common.h"
+#include "histogram.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 
 void ParentFlip(std::atomic<bool> *parent, const std::atomic<bool> &child,
-                const uint64_t loop_size) {
+                const uint64_t loop_size, LatencyHistogram *histogram) {
+  LatencyRecorder recorder(histogram);
   for (uint64_t i = 0; i < loop_size; ++i) {
     parent->store(true, std::memory_order_relaxed);
     while (!child.load(std::memory_order_acquire)) {
@@ -23,6 +27,7 @@ void ParentFlip(std::atomic<bool> *parent, const std::atomic<bool> &child,
     while (child.load(std::memory_order_acquire)) {
       ;
     }
+    recorder.Tick();
   }
 }
 
@@ -45,19 +50,29 @@ void ChildFlip(std::atomic<bool> *child, const std::atomic<bool> &parent,
 BenchmarkResult RunAtomicRelAcqLatencyBenchmark(int num_iterations,
                                                 int num_warmups,
                                                 uint64_t loop_size) {
+  ScopedPeerAffinity affinity(PARENT_PEER);
   std::atomic<bool> parent{false}, child{false};
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   std::vector<double> durations;
   for (int i = 0; i < num_iterations + num_warmups; i++) {
     AKLOG(aklog::LogLevel::DEBUG, std::format("Starting iteration {}/{}", i + 1,
                                               num_iterations + num_warmups));
-    std::thread child_thread([&child, &parent, loop_size]() {
+    const bool is_warmup = i < num_warmups;
+    std::thread child_thread([&child, &parent, loop_size, is_warmup]() {
+      ScopedPeerAffinity affinity(CHILD_PEER);
+      // The child thread lives for one iteration only.
+      PerfCounters child_counters(CHILD_PEER, is_warmup ? 1 : 0);
+      child_counters.Start();
       ChildFlip(&child, parent, loop_size);
+      child_counters.Stop();
     });
 
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
-    ParentFlip(&parent, child, loop_size);
+    ParentFlip(&parent, child, loop_size, nullptr);
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     child_thread.join();
     AKLOG(aklog::LogLevel::DEBUG,
@@ -71,5 +86,19 @@ BenchmarkResult RunAtomicRelAcqLatencyBenchmark(int num_iterations,
     }
   }
 
-  return CalculateOneTripDuration(durations);
+  // Time each loop separately in one more pass to get the latency
+  // distribution. The clock reads are kept out of the passes above so that
+  // they do not inflate the average.
+  LatencyHistogram histogram;
+  std::thread child_thread([&child, &parent, loop_size]() {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    ChildFlip(&child, parent, loop_size);
+  });
+  ParentFlip(&parent, child, loop_size, &histogram);
+  child_thread.join();
+
+  BenchmarkResult result = CalculateOneTripDuration(durations);
+  // Each loop of ParentFlip consists of four one-way trips.
+  result.percentiles = histogram.Percentiles(1e-9 / 4);
+  return result;
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "atomic_wait_latency.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "common.h"
+#include "topology.h"
+#include "wakeup_latency.h"
+
+namespace {
+
+// Each side counts its flips and waits until the other side catches up, so
+// the counters need no reset between iterations.
+class AtomicWaitEndpoint : public WakeupEndpoint {
+public:
+  AtomicWaitEndpoint(std::atomic<uint32_t> *send_word,
+                     const std::atomic<uint32_t> *receive_word)
+      : send_word_(send_word), receive_word_(receive_word) {}
+
+  void Wake() override {
+    send_word_->store(send_word_->load() + 1);
+    send_word_->notify_one();
+  }
+
+  void Wait() override {
+    ++received_;
+    uint32_t value;
+    while ((value = receive_word_->load()) != received_) {
+      receive_word_->wait(value);
+    }
+  }
+
+private:
+  std::atomic<uint32_t> *const send_word_;
+  const std::atomic<uint32_t> *const receive_word_;
+  // Number of wake-ups received so far, the value to wait for
+  uint32_t received_ = 0;
+};
+
+} // namespace
+
+BenchmarkResult RunAtomicWaitLatencyBenchmark(int num_iterations,
+                                              int num_warmups,
+                                              uint64_t loop_size) {
+  std::atomic<uint32_t> parent{0}, child{0};
+  return RunWakeupLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, WakeupPeers::THREADS,
+      [&parent, &child](int peer) {
+        return peer == PARENT_PEER
+                   ? std::make_unique<AtomicWaitEndpoint>(&parent, &child)
+                   : std::make_unique<AtomicWaitEndpoint>(&child, &parent);
+      });
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common.h"
+
+// Ping-pong between two threads with std::atomic::wait and notify_one.
+BenchmarkResult RunAtomicWaitLatencyBenchmark(int num_iterations,
+                                              int num_warmups,
+                                              uint64_t loop_size);
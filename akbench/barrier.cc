@@ -3,11 +3,51 @@
 #include <fcntl.h>
 #include <sys/mman.h>
 
+#include <climits>
 #include <cstring>
 #include <format>
 #include <thread>
 
 #include "aklog.h"
+#include "futex.h"
+
+namespace {
+std::atomic<BarrierImpl> g_default_impl{BarrierImpl::SEM};
+
+// Number of polls before a FUTEX waiter goes to sleep. Most barriers in the
+// bandwidth benchmarks complete within this window when the peer is running.
+constexpr int FUTEX_SPIN_COUNT = 1024;
+} // namespace
+
+const char *BarrierImplToString(BarrierImpl impl) {
+  switch (impl) {
+  case BarrierImpl::SEM:
+    return "sem";
+  case BarrierImpl::FUTEX:
+    return "futex";
+  case BarrierImpl::SPIN:
+    return "spin";
+  }
+  return "unknown";
+}
+
+std::optional<BarrierImpl> StringToBarrierImpl(const std::string &impl_str) {
+  if (impl_str == "sem")
+    return BarrierImpl::SEM;
+  if (impl_str == "futex")
+    return BarrierImpl::FUTEX;
+  if (impl_str == "spin")
+    return BarrierImpl::SPIN;
+  return std::nullopt;
+}
+
+void SenseReversingBarrier::SetDefaultImpl(BarrierImpl impl) {
+  g_default_impl.store(impl);
+}
+
+BarrierImpl SenseReversingBarrier::GetDefaultImpl() {
+  return g_default_impl.load();
+}
 
 void SenseReversingBarrier::ClearResource(const std::string &id) {
   const std::string init_sem_id = id + "_init_sem";
@@ -19,8 +59,12 @@ void SenseReversingBarrier::ClearResource(const std::string &id) {
 }
 
 SenseReversingBarrier::SenseReversingBarrier(int n, const std::string &id)
-    : n_(n), init_sem_id_(id + "_init_sem"), shm_sem_id_(id + "_shm_sem"),
-      shm_id_(id + "_shm") {
+    : SenseReversingBarrier(n, id, GetDefaultImpl()) {}
+
+SenseReversingBarrier::SenseReversingBarrier(int n, const std::string &id,
+                                             BarrierImpl impl)
+    : n_(n), impl_(impl), init_sem_id_(id + "_init_sem"),
+      shm_sem_id_(id + "_shm_sem"), shm_id_(id + "_shm") {
   shm_sem_ = sem_open(shm_sem_id_.c_str(), O_CREAT, 0644, 1);
   AKCHECK(shm_sem_ != SEM_FAILED,
           std::format("Failed to create semaphore with id '{}': {}",
@@ -45,6 +89,10 @@ SenseReversingBarrier::SenseReversingBarrier(int n, const std::string &id)
     shm_data_->count_ = 0;
     shm_data_->shared_sense_ = false;
     shm_data_->n_users_ = 0;
+    shm_data_->impl_ = impl_;
+    shm_data_->atomic_count_.store(0);
+    shm_data_->atomic_sense_.store(0);
+    shm_data_->futex_waiters_.store(0);
   } else if (shm_fd_ < 0) {
     if (errno == EEXIST) {
       AKLOG(
@@ -64,6 +112,11 @@ SenseReversingBarrier::SenseReversingBarrier(int n, const std::string &id)
           shm_data_ != MAP_FAILED,
           std::format("Failed to map existing shared memory with id '{}': {}",
                       shm_id_, strerror(errno)));
+      AKCHECK(shm_data_->impl_ == impl_,
+              std::format("Barrier with id '{}' uses {} but this user "
+                          "requested {}",
+                          shm_id_, BarrierImplToString(shm_data_->impl_),
+                          BarrierImplToString(impl_)));
     } else {
       AKCHECK(false,
               std::format("Failed to create shared memory with id '{}': {}",
@@ -97,6 +150,14 @@ SenseReversingBarrier::SenseReversingBarrier(int n, const std::string &id)
 }
 
 void SenseReversingBarrier::Wait() {
+  if (impl_ == BarrierImpl::SEM) {
+    WaitSem();
+  } else {
+    WaitAtomic();
+  }
+}
+
+void SenseReversingBarrier::WaitSem() {
   bool last_user = false;
   sem_wait(shm_sem_);
   shm_data_->count_++;
@@ -132,6 +193,44 @@ void SenseReversingBarrier::Wait() {
   sense_ = !sense_;
 }
 
+void SenseReversingBarrier::WaitAtomic() {
+  const uint32_t sense = sense_ ? 1 : 0;
+  std::atomic<uint32_t> &shared_sense = shm_data_->atomic_sense_;
+
+  if (shm_data_->atomic_count_.fetch_add(1) + 1 == n_) {
+    // Reset the count before publishing the new sense so that users released
+    // by the store below see zero when they arrive at the next barrier.
+    shm_data_->atomic_count_.store(0, std::memory_order_relaxed);
+    shared_sense.store(sense);
+    if (impl_ == BarrierImpl::FUTEX && shm_data_->futex_waiters_.load() > 0) {
+      FutexWake(&shared_sense, INT_MAX, /*private_futex=*/false);
+    }
+  } else if (impl_ == BarrierImpl::SPIN) {
+    while (shared_sense.load(std::memory_order_acquire) != sense) {
+      CpuRelax();
+    }
+  } else {
+    bool reversed = false;
+    for (int i = 0; i < FUTEX_SPIN_COUNT && !reversed; ++i) {
+      reversed = shared_sense.load(std::memory_order_acquire) == sense;
+      CpuRelax();
+    }
+    if (!reversed) {
+      // Register as a waiter before the final check. Together with the
+      // sequentially consistent store of the sense above, either the last
+      // user sees our registration and wakes us, or we see the new sense
+      // here, or FUTEX_WAIT returns EAGAIN.
+      shm_data_->futex_waiters_.fetch_add(1);
+      while (shared_sense.load() != sense) {
+        FutexWait(&shared_sense, 1 - sense, /*private_futex=*/false);
+      }
+      shm_data_->futex_waiters_.fetch_sub(1);
+    }
+  }
+
+  sense_ = !sense_;
+}
+
 SenseReversingBarrier::~SenseReversingBarrier() {
   sem_wait(shm_sem_);
   uint64_t remaining_users = shm_data_->n_users_;
@@ -1,21 +1,49 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <optional>
 #include <semaphore.h>
 #include <string>
 
+// How waiters in SenseReversingBarrier::Wait() block.
+//   SEM:   Poll the shared sense under the named semaphore.
+//   FUTEX: Spin for a while on an atomic sense word, then sleep with
+//          FUTEX_WAIT until the last user wakes us with FUTEX_WAKE.
+//   SPIN:  Busy-wait on the atomic sense word.
+enum class BarrierImpl { SEM = 0, FUTEX = 1, SPIN = 2 };
+
+const char *BarrierImplToString(BarrierImpl impl);
+std::optional<BarrierImpl> StringToBarrierImpl(const std::string &impl_str);
+
 class SenseReversingBarrier {
 public:
   SenseReversingBarrier(int n, const std::string &id);
+  SenseReversingBarrier(int n, const std::string &id, BarrierImpl impl);
   ~SenseReversingBarrier();
   void Wait();
   static void ClearResource(const std::string &id);
 
+  // The implementation used by the constructor without an explicit
+  // BarrierImpl. Set it before forking so that all users agree.
+  static void SetDefaultImpl(BarrierImpl impl);
+  static BarrierImpl GetDefaultImpl();
+
 private:
+  void WaitSem();
+  void WaitAtomic();
+
   struct ShmData {
     uint64_t count_{0};
     bool shared_sense_{false};
     uint64_t n_users_{0};
+    BarrierImpl impl_{BarrierImpl::SEM};
+
+    // Used by FUTEX and SPIN without taking shm_sem_. Each word has its own
+    // cache line so that arrivals do not invalidate the line waiters poll.
+    alignas(64) std::atomic<uint32_t> atomic_count_{0};
+    alignas(64) std::atomic<uint32_t> atomic_sense_{0};
+    alignas(64) std::atomic<uint32_t> futex_waiters_{0};
   };
 
   sem_t *shm_sem_;
@@ -24,6 +52,7 @@ private:
   bool sense_ = true;
 
   const uint64_t n_;
+  const BarrierImpl impl_;
   const std::string init_sem_id_;
   const std::string shm_sem_id_;
   const std::string shm_id_;
@@ -11,18 +11,24 @@
 
 #include "barrier.h"
 #include "common.h"
+#include "histogram.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 
 const std::string BARRIER_ID = GenerateUniqueName("/BarrierLatencyTest");
 const int NUM_PROCESSES = 2;
 
-void ChildBarrierProcess(uint64_t loop_size) {
+void ChildBarrierProcess(uint64_t loop_size, bool is_measured) {
   SenseReversingBarrier barrier(NUM_PROCESSES, BARRIER_ID);
 
+  PerfCounters counters(CHILD_PEER, is_measured ? 0 : 1);
+  counters.Start();
   for (uint64_t i = 0; i < loop_size; ++i) {
     barrier.Wait();
   }
+  counters.Stop();
 }
 
 } // namespace
@@ -38,7 +44,9 @@ BenchmarkResult RunBarrierLatencyBenchmark(int num_iterations, int num_warmups,
           "Running barrier latency benchmark with {} processes, {} iterations",
           NUM_PROCESSES, loop_size));
 
-  auto RunSingleBenchmark = [&]() -> double {
+  // Only measured runs add to the perf counters.
+  auto RunSingleBenchmark = [&](LatencyHistogram *histogram,
+                                bool is_measured) -> double {
     std::vector<int> pids;
 
     // Fork child processes (only 1 child process for 2-process barrier)
@@ -48,7 +56,8 @@ BenchmarkResult RunBarrierLatencyBenchmark(int num_iterations, int num_warmups,
 
       if (pid == 0) {
         // Child process
-        ChildBarrierProcess(loop_size);
+        ScopedPeerAffinity affinity(CHILD_PEER);
+        ChildBarrierProcess(loop_size, is_measured);
         exit(0);
       } else {
         pids.push_back(pid);
@@ -56,15 +65,21 @@ BenchmarkResult RunBarrierLatencyBenchmark(int num_iterations, int num_warmups,
     }
 
     // Parent process runs the benchmark
+    ScopedPeerAffinity affinity(PARENT_PEER);
     SenseReversingBarrier barrier(NUM_PROCESSES, BARRIER_ID);
 
+    PerfCounters counters(PARENT_PEER, is_measured ? 0 : 1);
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
+    LatencyRecorder recorder(histogram);
     for (uint64_t i = 0; i < loop_size; ++i) {
       barrier.Wait();
+      recorder.Tick();
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     // Wait for all child processes to finish
     for (int child_pid : pids) {
@@ -83,7 +98,7 @@ BenchmarkResult RunBarrierLatencyBenchmark(int num_iterations, int num_warmups,
   for (int i = 0; i < num_warmups; ++i) {
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("Warmup iteration {}/{}", i + 1, num_warmups));
-    RunSingleBenchmark();
+    RunSingleBenchmark(nullptr, false);
     SenseReversingBarrier::ClearResource(BARRIER_ID);
   }
 
@@ -92,19 +107,25 @@ BenchmarkResult RunBarrierLatencyBenchmark(int num_iterations, int num_warmups,
   for (int i = 0; i < num_iterations; ++i) {
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("Measurement iteration {}/{}", i + 1, num_iterations));
-    double latency_ns = RunSingleBenchmark();
-    measurements.push_back(latency_ns);
+    double latency_ns = RunSingleBenchmark(nullptr, true);
+    // Convert from nanoseconds to seconds
+    measurements.push_back(latency_ns / 1e9);
     SenseReversingBarrier::ClearResource(BARRIER_ID);
   }
 
+  // Time each barrier operation separately in one more run to get the latency
+  // distribution. The clock reads are kept out of the runs above so that they
+  // do not inflate the average.
+  LatencyHistogram histogram;
+  RunSingleBenchmark(&histogram, false);
+  SenseReversingBarrier::ClearResource(BARRIER_ID);
+
   // Calculate and return latency statistics
   BenchmarkResult result = CalculateOneTripDuration(measurements);
   AKLOG(aklog::LogLevel::DEBUG,
-        std::format("Barrier latency (average): {} ns", result.average));
-
-  // Convert from nanoseconds to seconds
-  result.average /= 1e9;
-  result.stddev /= 1e9;
+        std::format("Barrier latency (average): {} ns",
+                    result.average * 1e9));
+  result.percentiles = histogram.Percentiles(1e-9);
 
   return result;
 }
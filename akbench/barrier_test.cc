@@ -1,6 +1,7 @@
 #include <getopt.h>
 #include <string>
 #include <sys/wait.h>
+#include <unistd.h>
 
 #include <cstdlib>
 #include <cstring>
@@ -19,7 +20,9 @@
 
 namespace {
 
-const std::string BRRIER_ID = "/TestBarrier";
+// Unique to this run, which the forked processes share, so that tests run
+// in parallel by ctest do not meet at one barrier.
+const std::string BRRIER_ID = std::format("/TestBarrier_{}", getpid());
 
 void TestConstructor() {
   int pid = fork();
@@ -282,6 +285,7 @@ void TestWaitWithRandomSleep(int num_processes, int num_iterations) {
 static std::string g_test_type = "constructor";
 static int g_num_processes = 2;
 static int g_num_iterations = 20;
+static std::string g_barrier_impl = "sem";
 
 void PrintUsage(const char *program_name) {
   std::cout << R"(Usage: )" << program_name << R"( [OPTIONS]
@@ -294,6 +298,8 @@ Options:
                            wait_with_random_sleep, wait_without_sleep
   -p, --num-processes=N    Number of processes for wait test (default: 2)
   -i, --num-iterations=N   Number of iterations for wait test (default: 20)
+  -b, --barrier-impl=IMPL  Barrier implementation: sem, futex, spin
+                           (default: sem)
   -h, --help               Display this help message
 )";
 }
@@ -306,13 +312,14 @@ int main(int argc, char *argv[]) {
       {"test-type", required_argument, nullptr, 't'},
       {"num-processes", required_argument, nullptr, 'p'},
       {"num-iterations", required_argument, nullptr, 'i'},
+      {"barrier-impl", required_argument, nullptr, 'b'},
       {"help", no_argument, nullptr, 'h'},
       {nullptr, 0, nullptr, 0}};
 
   // Parse command line options
   int opt;
   int option_index = 0;
-  while ((opt = getopt_long(argc, argv, "t:p:i:h", long_options,
+  while ((opt = getopt_long(argc, argv, "t:p:i:b:h", long_options,
                             &option_index)) != -1) {
     try {
       switch (opt) {
@@ -325,6 +332,9 @@ int main(int argc, char *argv[]) {
       case 'i':
         g_num_iterations = ParseInt(optarg);
         break;
+      case 'b':
+        g_barrier_impl = optarg;
+        break;
       case 'h':
         PrintUsage(program_name);
         return 0;
@@ -347,6 +357,17 @@ int main(int argc, char *argv[]) {
 
   const std::string &test_type = g_test_type;
 
+  const std::optional<BarrierImpl> barrier_impl =
+      StringToBarrierImpl(g_barrier_impl);
+  if (!barrier_impl.has_value()) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("Unknown barrier implementation: {}. Available "
+                      "implementations: sem, futex, spin",
+                      g_barrier_impl));
+    return 1;
+  }
+  SenseReversingBarrier::SetDefaultImpl(barrier_impl.value());
+
   SenseReversingBarrier::ClearResource(BRRIER_ID);
 
   if (test_type == "constructor") {
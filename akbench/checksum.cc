@@ -0,0 +1,213 @@
+#include "checksum.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <format>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "aklog.h"
+#include "parallel.h"
+
+namespace {
+std::atomic<ChecksumKind> g_checksum_kind{ChecksumKind::XOR};
+
+constexpr uint32_t CRC32C_POLYNOMIAL = 0x82f63b78; // Reflected 0x1edc6f41
+
+std::array<uint32_t, 256> MakeCrc32cTable() {
+  std::array<uint32_t, 256> table;
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+    }
+    table[i] = crc;
+  }
+  return table;
+}
+
+uint32_t Crc32cUpdateSoftware(uint32_t crc, std::span<const uint8_t> data) {
+  static const std::array<uint32_t, 256> table = MakeCrc32cTable();
+  for (uint8_t byte : data) {
+    crc = (crc >> 8) ^ table[(crc ^ byte) & 0xff];
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) uint32_t
+Crc32cUpdateHardware(uint32_t crc, std::span<const uint8_t> data) {
+  uint64_t crc64 = crc;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data.data() + i, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  for (; i < data.size(); ++i) {
+    crc = _mm_crc32_u8(crc, data[i]);
+  }
+  return crc;
+}
+#endif
+
+// Updates an unfinished CRC32C, i.e. one that starts at ~0 and is inverted at
+// the end.
+uint32_t Crc32cUpdate(uint32_t crc, std::span<const uint8_t> data) {
+#if defined(__x86_64__)
+  static const bool has_hardware_crc32c = HasHardwareCrc32c();
+  if (has_hardware_crc32c) {
+    return Crc32cUpdateHardware(crc, data);
+  }
+#endif
+  return Crc32cUpdateSoftware(crc, data);
+}
+
+// XORs piece, which starts at byte offset of the context, into folded.
+void FoldXor(std::span<const uint8_t> piece, uint64_t offset,
+             std::array<uint64_t, CHECKSUM_SIZE / sizeof(uint64_t)> &folded) {
+  uint8_t *folded_bytes = reinterpret_cast<uint8_t *>(folded.data());
+  size_t i = 0;
+  for (; i < piece.size() && (offset + i) % CHECKSUM_SIZE != 0; ++i) {
+    folded_bytes[(offset + i) % CHECKSUM_SIZE] ^= piece[i];
+  }
+  // Whole blocks of CHECKSUM_SIZE bytes word by word. The inner loop has a
+  // fixed trip count and no dependency between words, so the compiler
+  // unrolls and vectorizes it.
+  std::array<uint64_t, CHECKSUM_SIZE / sizeof(uint64_t)> block_xor = {};
+  for (; i + CHECKSUM_SIZE <= piece.size(); i += CHECKSUM_SIZE) {
+    for (size_t w = 0; w < block_xor.size(); ++w) {
+      uint64_t word;
+      memcpy(&word, piece.data() + i + w * sizeof(uint64_t), sizeof(word));
+      block_xor[w] ^= word;
+    }
+  }
+  for (size_t w = 0; w < block_xor.size(); ++w) {
+    folded[w] ^= block_xor[w];
+  }
+  for (; i < piece.size(); ++i) {
+    folded_bytes[(offset + i) % CHECKSUM_SIZE] ^= piece[i];
+  }
+}
+
+} // namespace
+
+const char *ChecksumKindToString(ChecksumKind kind) {
+  switch (kind) {
+  case ChecksumKind::XOR:
+    return "xor";
+  case ChecksumKind::CRC32C:
+    return "crc32c";
+  }
+  return "unknown";
+}
+
+std::optional<ChecksumKind> StringToChecksumKind(const std::string &kind_str) {
+  if (kind_str == "xor")
+    return ChecksumKind::XOR;
+  if (kind_str == "crc32c")
+    return ChecksumKind::CRC32C;
+  return std::nullopt;
+}
+
+void SetChecksumKind(ChecksumKind kind) { g_checksum_kind.store(kind); }
+
+ChecksumKind GetChecksumKind() { return g_checksum_kind.load(); }
+
+bool HasHardwareCrc32c() {
+#if defined(__x86_64__)
+  return __builtin_cpu_supports("sse4.2");
+#else
+  return false;
+#endif
+}
+
+uint32_t Crc32c(std::span<const uint8_t> data) {
+  return ~Crc32cUpdate(~0u, data);
+}
+
+uint64_t Crc32cChunkBegin(uint64_t chunk, uint64_t context_size) {
+  return context_size / CRC32C_CHUNKS * chunk +
+         context_size % CRC32C_CHUNKS * chunk / CRC32C_CHUNKS;
+}
+
+ChecksumState::ChecksumState(ChecksumKind kind, uint64_t context_size)
+    : kind_(kind), context_size_(context_size) {
+  crc_.fill(~0u);
+}
+
+void ChecksumState::Update(std::span<const uint8_t> piece, uint64_t offset) {
+  AKCHECK(offset + piece.size() <= context_size_,
+          std::format("Piece [{}, {}) is outside of the context of {} bytes",
+                      offset, offset + piece.size(), context_size_));
+  if (kind_ == ChecksumKind::XOR) {
+    FoldXor(piece, offset, folded_);
+    return;
+  }
+  // Split piece at the chunk boundaries.
+  uint64_t chunk = 0;
+  while (Crc32cChunkBegin(chunk + 1, context_size_) <= offset &&
+         chunk + 1 < CRC32C_CHUNKS) {
+    ++chunk;
+  }
+  size_t i = 0;
+  while (i < piece.size()) {
+    const uint64_t chunk_end = Crc32cChunkBegin(chunk + 1, context_size_);
+    const size_t length =
+        std::min<uint64_t>(piece.size() - i, chunk_end - (offset + i));
+    crc_[chunk] = Crc32cUpdate(crc_[chunk], piece.subspan(i, length));
+    i += length;
+    ++chunk;
+  }
+}
+
+std::array<uint8_t, CHECKSUM_SIZE> ChecksumState::Finish() const {
+  std::array<uint8_t, CHECKSUM_SIZE> checksum;
+  if (kind_ == ChecksumKind::XOR) {
+    memcpy(checksum.data(), folded_.data(), CHECKSUM_SIZE);
+    return checksum;
+  }
+  for (size_t chunk = 0; chunk < CRC32C_CHUNKS; ++chunk) {
+    const uint32_t crc = ~crc_[chunk];
+    for (size_t byte = 0; byte < sizeof(uint32_t); ++byte) {
+      checksum[chunk * sizeof(uint32_t) + byte] = (crc >> (8 * byte)) & 0xff;
+    }
+  }
+  return checksum;
+}
+
+std::array<uint8_t, CHECKSUM_SIZE>
+CalcChecksum(std::span<const uint8_t> context) {
+  const ChecksumKind kind = GetChecksumKind();
+  const uint64_t context_size = context.size();
+  const uint64_t num_threads =
+      ParallelThreadCount(context_size, CRC32C_CHUNKS);
+
+  // Each thread takes whole CRC32C chunks, so that no chunk is split.
+  std::vector<ChecksumState> states(num_threads,
+                                    ChecksumState(kind, context_size));
+  auto fold = [&](uint64_t thread) {
+    const uint64_t begin = Crc32cChunkBegin(
+        thread * CRC32C_CHUNKS / num_threads, context_size);
+    const uint64_t end = Crc32cChunkBegin(
+        (thread + 1) * CRC32C_CHUNKS / num_threads, context_size);
+    states[thread].Update(context.subspan(begin, end - begin), begin);
+  };
+  RunInParallel(num_threads, fold);
+
+  // Chunks that a state did not update finish as zeros, so XOR combines both
+  // kinds.
+  std::array<uint8_t, CHECKSUM_SIZE> checksum = {};
+  for (const ChecksumState &state : states) {
+    const std::array<uint8_t, CHECKSUM_SIZE> part = state.Finish();
+    for (size_t i = 0; i < CHECKSUM_SIZE; ++i) {
+      checksum[i] ^= part[i];
+    }
+  }
+  return checksum;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+// The last CHECKSUM_SIZE bytes of the data of a bandwidth benchmark are a
+// checksum of the bytes before them, the context.
+constexpr uint64_t CHECKSUM_SIZE = 128;
+
+// How the checksum is computed.
+//   XOR:    Byte j is the XOR of all context bytes at offsets k with
+//           k % CHECKSUM_SIZE == j.
+//   CRC32C: The context is split into CRC32C_CHUNKS chunks of about equal
+//           size, and the checksum is the CRC32C of each chunk as a little
+//           endian uint32_t. This catches reordered words and errors that
+//           cancel out in XOR. Uses the SSE4.2 crc32 instruction if the CPU
+//           has it.
+enum class ChecksumKind { XOR = 0, CRC32C = 1 };
+
+constexpr uint64_t CRC32C_CHUNKS = CHECKSUM_SIZE / sizeof(uint32_t);
+
+const char *ChecksumKindToString(ChecksumKind kind);
+std::optional<ChecksumKind> StringToChecksumKind(const std::string &kind_str);
+
+// The kind used by GenerateDataToSend and the verifiers. Set it before forking
+// so that all peers agree.
+void SetChecksumKind(ChecksumKind kind);
+ChecksumKind GetChecksumKind();
+
+bool HasHardwareCrc32c();
+// CRC32C (Castagnoli) of data
+uint32_t Crc32c(std::span<const uint8_t> data);
+
+// Checksum of a context of context_size bytes that is fed in pieces. The
+// pieces of each CRC32C chunk must come in order, but pieces of different
+// chunks may go to different ChecksumStates, whose results are then XORed.
+class ChecksumState {
+public:
+  ChecksumState(ChecksumKind kind, uint64_t context_size);
+
+  // Add piece, which starts at byte offset of the context.
+  void Update(std::span<const uint8_t> piece, uint64_t offset);
+  std::array<uint8_t, CHECKSUM_SIZE> Finish() const;
+
+private:
+  const ChecksumKind kind_;
+  const uint64_t context_size_;
+  // XOR checksum as words
+  std::array<uint64_t, CHECKSUM_SIZE / sizeof(uint64_t)> folded_ = {};
+  // Unfinished CRC32C of each chunk
+  std::array<uint32_t, CRC32C_CHUNKS> crc_;
+};
+
+// Byte offset of the first byte of CRC32C chunk chunk in a context of
+// context_size bytes. Chunk CRC32C_CHUNKS starts at context_size.
+uint64_t Crc32cChunkBegin(uint64_t chunk, uint64_t context_size);
+
+// Checksum of context with the current ChecksumKind. Large contexts are split
+// among threads on the CPUs the calling thread may run on.
+std::array<uint8_t, CHECKSUM_SIZE>
+CalcChecksum(std::span<const uint8_t> context);
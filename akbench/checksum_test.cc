@@ -0,0 +1,137 @@
+#include "checksum.h"
+
+#include <cstring>
+#include <format>
+#include <print>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "aklog.h"
+
+namespace {
+
+std::vector<uint8_t> RandomBytes(uint64_t size, uint32_t seed) {
+  std::mt19937 engine(seed);
+  std::vector<uint8_t> data(size);
+  for (uint8_t &byte : data) {
+    byte = static_cast<uint8_t>(engine());
+  }
+  return data;
+}
+
+std::array<uint8_t, CHECKSUM_SIZE> NaiveXor(std::span<const uint8_t> data) {
+  std::array<uint8_t, CHECKSUM_SIZE> checksum = {};
+  for (size_t i = 0; i < data.size(); ++i) {
+    checksum[i % CHECKSUM_SIZE] ^= data[i];
+  }
+  return checksum;
+}
+
+uint32_t NaiveCrc32c(std::span<const uint8_t> data) {
+  uint32_t crc = ~0u;
+  for (uint8_t byte : data) {
+    crc ^= byte;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (crc & 1 ? 0x82f63b78 : 0);
+    }
+  }
+  return ~crc;
+}
+
+std::array<uint8_t, CHECKSUM_SIZE> NaiveCrc32cChunks(
+    std::span<const uint8_t> data) {
+  std::array<uint8_t, CHECKSUM_SIZE> checksum = {};
+  for (uint64_t chunk = 0; chunk < CRC32C_CHUNKS; ++chunk) {
+    const uint64_t begin = Crc32cChunkBegin(chunk, data.size());
+    const uint64_t end = Crc32cChunkBegin(chunk + 1, data.size());
+    const uint32_t crc = NaiveCrc32c(data.subspan(begin, end - begin));
+    memcpy(checksum.data() + chunk * sizeof(uint32_t), &crc, sizeof(crc));
+  }
+  return checksum;
+}
+
+void testCrc32c() {
+  const std::string_view check = "123456789";
+  AKCHECK(Crc32c({reinterpret_cast<const uint8_t *>(check.data()),
+                  check.size()}) == 0xe3069283,
+          "CRC32C of 123456789 should be the standard check value");
+  const std::vector<uint8_t> data = RandomBytes(1000, 1);
+  for (size_t size : {0, 1, 7, 8, 9, 1000}) {
+    const std::span<const uint8_t> piece(data.data(), size);
+    AKCHECK(Crc32c(piece) == NaiveCrc32c(piece),
+            std::format("CRC32C mismatch for {} bytes (hardware: {})", size,
+                        HasHardwareCrc32c()));
+  }
+  AKCHECK(Crc32cChunkBegin(0, 100) == 0 &&
+              Crc32cChunkBegin(CRC32C_CHUNKS, 100) == 100,
+          "Chunks should cover the context");
+  std::print("testCrc32c passed\n");
+}
+
+void testCalcChecksum() {
+  // Large enough to be split among threads where there are several CPUs
+  for (uint64_t size : {1, 127, 128, 129, 4099, (40 << 20) + 3}) {
+    const std::vector<uint8_t> data = RandomBytes(size, size);
+    SetChecksumKind(ChecksumKind::XOR);
+    AKCHECK(CalcChecksum(data) == NaiveXor(data),
+            std::format("XOR checksum mismatch for {} bytes", size));
+    SetChecksumKind(ChecksumKind::CRC32C);
+    AKCHECK(CalcChecksum(data) == NaiveCrc32cChunks(data),
+            std::format("CRC32C checksum mismatch for {} bytes", size));
+  }
+  SetChecksumKind(ChecksumKind::XOR);
+  std::print("testCalcChecksum passed\n");
+}
+
+void testChecksumStateInPieces() {
+  const std::vector<uint8_t> data = RandomBytes(100003, 2);
+  std::mt19937 engine(3);
+  for (ChecksumKind kind : {ChecksumKind::XOR, ChecksumKind::CRC32C}) {
+    ChecksumState state(kind, data.size());
+    uint64_t offset = 0;
+    while (offset < data.size()) {
+      const uint64_t length =
+          std::min<uint64_t>(engine() % 5000, data.size() - offset);
+      state.Update(std::span(data).subspan(offset, length), offset);
+      offset += length;
+    }
+    const auto expected = kind == ChecksumKind::XOR ? NaiveXor(data)
+                                                    : NaiveCrc32cChunks(data);
+    AKCHECK(state.Finish() == expected,
+            std::format("{} checksum in pieces should match",
+                        ChecksumKindToString(kind)));
+  }
+
+  // A swap of two words keeps the XOR checksum but not the CRC32C one.
+  std::vector<uint8_t> swapped = data;
+  std::swap_ranges(swapped.begin(), swapped.begin() + 8,
+                   swapped.begin() + CHECKSUM_SIZE);
+  AKCHECK(NaiveXor(swapped) == NaiveXor(data) &&
+              NaiveCrc32cChunks(swapped) != NaiveCrc32cChunks(data),
+          "CRC32C should catch words swapped CHECKSUM_SIZE bytes apart");
+  std::print("testChecksumStateInPieces passed\n");
+}
+
+void testChecksumKindConversion() {
+  for (ChecksumKind kind : {ChecksumKind::XOR, ChecksumKind::CRC32C}) {
+    AKCHECK(StringToChecksumKind(ChecksumKindToString(kind)) == kind,
+            "Round trip should give the same kind");
+  }
+  AKCHECK(!StringToChecksumKind("md5").has_value(), "md5 should be rejected");
+  std::print("testChecksumKindConversion passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running checksum tests...\n");
+
+  testCrc32c();
+  testCalcChecksum();
+  testChecksumStateInPieces();
+  testChecksumKindConversion();
+
+  std::print("All checksum tests passed!\n");
+  return 0;
+}
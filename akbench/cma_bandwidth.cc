@@ -0,0 +1,200 @@
+#include "cma_bandwidth.h"
+
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <string>
+#include <vector>
+
+#include "aklog.h"
+
+#include "barrier.h"
+#include "common.h"
+#include "perf_counters.h"
+#include "topology.h"
+
+namespace {
+
+const std::string BARRIER_ID = GenerateUniqueName("/cma_benchmark");
+
+// Copies data_size bytes between local and the remote buffer at
+// remote_address of pid, iov_count chunks of buffer_size bytes per call.
+void CopyWithCma(CmaDirection direction, pid_t pid, uint8_t *local,
+                 uintptr_t remote_address, uint64_t data_size,
+                 uint64_t buffer_size, uint64_t iov_count) {
+  std::vector<iovec> local_iov(iov_count);
+  std::vector<iovec> remote_iov(iov_count);
+  uint64_t done = 0;
+  while (done < data_size) {
+    size_t num_iov = 0;
+    for (uint64_t offset = done; num_iov < iov_count && offset < data_size;
+         ++num_iov) {
+      const uint64_t length = std::min(buffer_size, data_size - offset);
+      local_iov[num_iov] = {.iov_base = local + offset, .iov_len = length};
+      remote_iov[num_iov] = {
+          .iov_base = reinterpret_cast<void *>(remote_address + offset),
+          .iov_len = length};
+      offset += length;
+    }
+    const ssize_t copied =
+        direction == CmaDirection::READ
+            ? process_vm_readv(pid, local_iov.data(), num_iov,
+                               remote_iov.data(), num_iov, 0)
+            : process_vm_writev(pid, local_iov.data(), num_iov,
+                                remote_iov.data(), num_iov, 0);
+    if (copied <= 0) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("{}: {}",
+                        direction == CmaDirection::READ ? "process_vm_readv"
+                                                        : "process_vm_writev",
+                        copied == 0 ? "no progress" : strerror(errno)));
+    }
+    done += copied;
+  }
+}
+
+// The child only owns the buffer. With READ it holds the data to send and
+// with WRITE it receives the data and verifies it.
+void ChildProcess(CmaDirection direction, int address_fd, int num_warmups,
+                  int num_iterations, uint64_t data_size) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+
+  // A private copy of the data, as the buffer is also the destination in the
+  // other direction.
+  std::vector<uint8_t> buffer(data_size, 0);
+  if (direction == CmaDirection::READ) {
+    std::ranges::copy(GenerateDataToSend(data_size), buffer.begin());
+  }
+  const uintptr_t address = reinterpret_cast<uintptr_t>(buffer.data());
+  if (write(address_fd, &address, sizeof(address)) != sizeof(address)) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("child: write address: {}", strerror(errno)));
+  }
+  close(address_fd);
+
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    barrier.Wait();
+    barrier.Wait();
+    if (direction == CmaDirection::WRITE) {
+      if (!VerifyDataReceived(buffer, data_size)) {
+        AKLOG(aklog::LogLevel::FATAL, std::format("{}Data verification failed!",
+                                                  SendPrefix(iteration)));
+      }
+      std::fill(buffer.begin(), buffer.end(), 0);
+    }
+    barrier.Wait();
+  }
+}
+
+BenchmarkResult ParentProcess(CmaDirection direction, pid_t child_pid,
+                              int address_fd, int num_warmups,
+                              int num_iterations, uint64_t data_size,
+                              uint64_t buffer_size, uint64_t iov_count) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+
+  uintptr_t remote_address = 0;
+  if (read(address_fd, &remote_address, sizeof(remote_address)) !=
+      sizeof(remote_address)) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("parent: read address: {}", strerror(errno)));
+  }
+  close(address_fd);
+
+  // As in ChildProcess, a private copy of the data.
+  std::vector<uint8_t> buffer(data_size, 0);
+  if (direction == CmaDirection::WRITE) {
+    std::ranges::copy(GenerateDataToSend(data_size), buffer.begin());
+  }
+  std::vector<double> durations;
+
+  PerfCounters counters(PARENT_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    bool is_warmup = iteration < num_warmups;
+
+    if (direction == CmaDirection::READ) {
+      std::fill(buffer.begin(), buffer.end(), 0);
+    }
+    barrier.Wait();
+    counters.Start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    CopyWithCma(direction, child_pid, buffer.data(), remote_address, data_size,
+                buffer_size, iov_count);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
+    barrier.Wait();
+
+    if (!is_warmup) {
+      std::chrono::duration<double> elapsed_time = end_time - start_time;
+      durations.push_back(elapsed_time.count());
+      AKLOG(aklog::LogLevel::DEBUG,
+            std::format("{}Time taken: {} ms.", ReceivePrefix(iteration),
+                        elapsed_time.count() * 1000));
+    }
+
+    if (direction == CmaDirection::READ &&
+        !VerifyDataReceived(buffer, data_size)) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("{}Data verification failed!",
+                                                ReceivePrefix(iteration)));
+    }
+    // With WRITE, the child verifies before this barrier.
+    barrier.Wait();
+  }
+
+  BenchmarkResult result =
+      CalculateBandwidth(durations, num_iterations, data_size);
+  AKLOG(aklog::LogLevel::INFO,
+        std::format("{} bandwidth: {:.3f} ± {:.3f}{}.",
+                    direction == CmaDirection::READ ? "Read" : "Write",
+                    result.average / (1 << 30), result.stddev / (1 << 30),
+                    GIBYTE_PER_SEC_UNIT));
+  return result;
+}
+
+} // namespace
+
+BenchmarkResult RunCmaBandwidthBenchmark(CmaDirection direction,
+                                         int num_iterations, int num_warmups,
+                                         uint64_t data_size,
+                                         uint64_t buffer_size,
+                                         uint64_t iov_count) {
+  SenseReversingBarrier::ClearResource(BARRIER_ID);
+
+  // The child publishes the address of its buffer through this pipe.
+  int address_fds[2];
+  if (pipe(address_fds) == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("pipe: {}", strerror(errno)));
+  }
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("Fork failed: {}", strerror(errno)));
+  }
+
+  if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    close(address_fds[0]);
+    ChildProcess(direction, address_fds[1], num_warmups, num_iterations,
+                 data_size);
+    exit(0);
+  }
+
+  ScopedPeerAffinity affinity(PARENT_PEER);
+  close(address_fds[1]);
+  BenchmarkResult result =
+      ParentProcess(direction, pid, address_fds[0], num_warmups,
+                    num_iterations, data_size, buffer_size, iov_count);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    AKLOG(aklog::LogLevel::FATAL, "The child process failed");
+  }
+  return result;
+}
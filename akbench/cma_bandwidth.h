@@ -0,0 +1,17 @@
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+
+// Whether the parent pulls the data out of the child with process_vm_readv
+// or pushes it into the child with process_vm_writev.
+enum class CmaDirection { READ, WRITE };
+
+// Copies data_size bytes between the address spaces of a parent and a child
+// process with cross memory attach, one system call per iov_count iovecs of
+// buffer_size bytes each. iov_count is at most IOV_MAX.
+BenchmarkResult RunCmaBandwidthBenchmark(CmaDirection direction,
+                                         int num_iterations, int num_warmups,
+                                         uint64_t data_size,
+                                         uint64_t buffer_size,
+                                         uint64_t iov_count);
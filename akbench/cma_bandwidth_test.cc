@@ -0,0 +1,26 @@
+#include "cma_bandwidth.h"
+
+#include <cstdint>
+
+#include "aklog.h"
+
+int main(int argc, char *argv[]) {
+
+  constexpr int num_iterations = 3;
+  constexpr int num_warmups = 1;
+  // Several calls with a tail that does not fill an iovec
+  constexpr uint64_t data_size = (1 << 16) + 100;
+  constexpr uint64_t buffer_size = 4096;
+
+  for (CmaDirection direction : {CmaDirection::READ, CmaDirection::WRITE}) {
+    for (uint64_t iov_count : {1, 4}) {
+      const BenchmarkResult result =
+          RunCmaBandwidthBenchmark(direction, num_iterations, num_warmups,
+                                   data_size, buffer_size, iov_count);
+      AKCHECK(result.average >= 0.0, "Bandwidth should be non-negative");
+    }
+  }
+  AKLOG(aklog::LogLevel::INFO, "cma_bandwidth test passed");
+
+  return 0;
+}
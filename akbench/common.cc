@@ -1,67 +1,145 @@
 #include "common.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <algorithm>
-#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <format>
-#include <numeric>
+#include <memory>
+#include <new>
 #include <random>
-#include <unistd.h>
 
 #include "aklog.h"
 
-std::vector<uint8_t> CalcChecksum(const std::vector<uint8_t> &data,
-                                  uint64_t data_size) {
-  AKCHECK(data_size > CHECKSUM_SIZE,
-          std::format("data_size ({}) must be greater than CHECKSUM_SIZE ({})",
-                      data_size, CHECKSUM_SIZE));
-  uint64_t context_size = data_size - CHECKSUM_SIZE;
-  std::vector<uint8_t> checksum(CHECKSUM_SIZE, 0);
-  for (size_t i = 0; i < context_size; ++i) {
-    checksum[i % CHECKSUM_SIZE] ^= data[i];
+#include "barrier.h"
+#include "data_generator.h"
+
+namespace {
+
+struct VerificationTotals {
+  std::atomic<uint64_t> nanoseconds;
+  std::atomic<uint64_t> count;
+};
+
+VerificationTotals *MapVerificationTotals() {
+  void *totals =
+      mmap(nullptr, sizeof(VerificationTotals), PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  AKCHECK(totals != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+  return new (totals) VerificationTotals{};
+}
+
+// Mapped before main so that every forked peer shares it
+VerificationTotals *const g_verification_totals = MapVerificationTotals();
+
+// The data last returned by GenerateDataToSend, mapped read-only from a
+// sealed memfd. Forked peers inherit the mapping and share its pages.
+struct Payload {
+  const uint8_t *data = nullptr;
+  uint64_t data_size = 0;
+  uint64_t seed = 0;
+  ChecksumKind checksum_kind = ChecksumKind::XOR;
+};
+
+Payload g_payload;
+
+void AddVerificationTime(std::chrono::steady_clock::duration elapsed) {
+  g_verification_totals->nanoseconds.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+      std::memory_order_relaxed);
+}
+
+// Adds the time from construction to destruction to the verification time.
+class ScopedVerificationTimer {
+public:
+  ScopedVerificationTimer() : start_(std::chrono::steady_clock::now()) {}
+  ~ScopedVerificationTimer() {
+    AddVerificationTime(std::chrono::steady_clock::now() - start_);
   }
-  return checksum;
+
+private:
+  const std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace
+
+void ResetVerificationTime() {
+  g_verification_totals->nanoseconds.store(0);
+  g_verification_totals->count.store(0);
 }
 
-std::vector<uint8_t> GenerateDataToSend(uint64_t data_size) {
+double GetVerificationTime() {
+  return g_verification_totals->nanoseconds.load() * 1e-9;
+}
+
+uint64_t GetNumVerifications() { return g_verification_totals->count.load(); }
+
+std::span<const uint8_t> GenerateDataToSend(uint64_t data_size) {
   AKCHECK(data_size > CHECKSUM_SIZE,
           std::format("data_size ({}) must be greater than CHECKSUM_SIZE ({})",
                       data_size, CHECKSUM_SIZE));
-  uint64_t context_size = data_size - CHECKSUM_SIZE;
-  AKLOG(aklog::LogLevel::DEBUG, "Generating data to send...");
-  std::random_device seed_gen;
-  std::mt19937 engine(seed_gen());
-  std::uniform_int_distribution<uint64_t> dist(0, UINT64_MAX);
-  std::vector<uint8_t> data(data_size, 0);
-
-  size_t i = 0;
-  for (i = 0; i + 8 < context_size; i += 8) {
-    uint64_t *d = reinterpret_cast<uint64_t *>(&data[i]);
-    *d = dist(engine);
+  const uint64_t seed = GetDataSeed();
+  const ChecksumKind checksum_kind = GetChecksumKind();
+  if (g_payload.data != nullptr && g_payload.data_size == data_size &&
+      g_payload.seed == seed && g_payload.checksum_kind == checksum_kind) {
+    return {g_payload.data, data_size};
   }
-  for (; i < context_size; ++i) {
-    data[i] = static_cast<uint8_t>(dist(engine) & 0xFF);
+  if (g_payload.data != nullptr) {
+    munmap(const_cast<uint8_t *>(g_payload.data), g_payload.data_size);
+    g_payload.data = nullptr;
   }
+
+  uint64_t context_size = data_size - CHECKSUM_SIZE;
+  AKLOG(aklog::LogLevel::DEBUG, "Generating data to send...");
+  const int fd =
+      memfd_create("akbench_payload", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  AKCHECK(fd >= 0, std::format("memfd_create: {}", strerror(errno)));
+  AKCHECK(ftruncate(fd, data_size) == 0,
+          std::format("ftruncate: {}", strerror(errno)));
+  void *writable =
+      mmap(nullptr, data_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  AKCHECK(writable != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+  const std::span<uint8_t> data(static_cast<uint8_t *>(writable), data_size);
+  FillData(data.first(context_size), seed);
   AKLOG(
       aklog::LogLevel::DEBUG,
       std::format("Context data generated. Size: {} bytes. Filling checksum...",
                   context_size));
-  const std::vector<uint8_t> checksum = CalcChecksum(data, data_size);
-  for (size_t j = 0; j < CHECKSUM_SIZE; ++j) {
-    data[context_size + j] = checksum[j];
-  }
+  const std::array<uint8_t, CHECKSUM_SIZE> checksum =
+      CalcChecksum(data.first(context_size));
+  std::copy(checksum.begin(), checksum.end(), data.begin() + context_size);
+  munmap(writable, data_size);
+
+  // Sealed, so that no benchmark can change the data of the others.
+  AKCHECK(fcntl(fd, F_ADD_SEALS,
+                F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == 0,
+          std::format("fcntl(F_ADD_SEALS): {}", strerror(errno)));
+  void *readable = mmap(nullptr, data_size, PROT_READ, MAP_SHARED, fd, 0);
+  AKCHECK(readable != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+  close(fd);
+  g_payload = {.data = static_cast<const uint8_t *>(readable),
+               .data_size = data_size,
+               .seed = seed,
+               .checksum_kind = checksum_kind};
   AKLOG(aklog::LogLevel::DEBUG,
         std::format("Data generation complete. Data size: {} GiByte, Checksum "
                     "size: {} bytes.",
-                    static_cast<double>(data.size()) / (1 << 30),
+                    static_cast<double>(data_size) / (1 << 30),
                     CHECKSUM_SIZE));
 
-  return data;
+  return {g_payload.data, data_size};
 }
 
-bool VerifyDataReceived(const std::vector<uint8_t> &data, uint64_t data_size) {
+bool VerifyDataReceived(std::span<const uint8_t> data, uint64_t data_size) {
   AKCHECK(data_size > CHECKSUM_SIZE,
           std::format("data_size ({}) must be greater than CHECKSUM_SIZE ({})",
                       data_size, CHECKSUM_SIZE));
+  ScopedVerificationTimer timer;
+  g_verification_totals->count.fetch_add(1, std::memory_order_relaxed);
   uint64_t context_size = data_size - CHECKSUM_SIZE;
   if (data.size() != data_size) {
     AKLOG(aklog::LogLevel::ERROR,
@@ -70,7 +148,8 @@ bool VerifyDataReceived(const std::vector<uint8_t> &data, uint64_t data_size) {
     return false;
   }
 
-  std::vector<uint8_t> checksum = CalcChecksum(data, data_size);
+  const std::array<uint8_t, CHECKSUM_SIZE> checksum =
+      CalcChecksum(data.first(context_size));
   for (size_t i = 0; i < CHECKSUM_SIZE; ++i) {
     if (data[context_size + i] != checksum[i]) {
       AKLOG(aklog::LogLevel::ERROR,
@@ -83,6 +162,64 @@ bool VerifyDataReceived(const std::vector<uint8_t> &data, uint64_t data_size) {
   return true;
 }
 
+StreamingVerifier::StreamingVerifier(uint64_t data_size)
+    : data_size_(data_size),
+      state_(GetChecksumKind(), data_size - CHECKSUM_SIZE) {
+  AKCHECK(data_size > CHECKSUM_SIZE,
+          std::format("data_size ({}) must be greater than CHECKSUM_SIZE ({})",
+                      data_size, CHECKSUM_SIZE));
+}
+
+void StreamingVerifier::Update(std::span<const uint8_t> piece) {
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t context_size = data_size_ - CHECKSUM_SIZE;
+  if (offset_ < context_size) {
+    const size_t length = std::min<uint64_t>(piece.size(),
+                                             context_size - offset_);
+    state_.Update(piece.first(length), offset_);
+    piece = piece.subspan(length);
+    offset_ += length;
+  }
+  if (offset_ < data_size_) {
+    const size_t length = std::min<uint64_t>(piece.size(),
+                                             data_size_ - offset_);
+    std::copy_n(piece.begin(), length,
+                received_checksum_.begin() + (offset_ - context_size));
+    piece = piece.subspan(length);
+    offset_ += length;
+  }
+  offset_ += piece.size();
+  update_time_ += std::chrono::steady_clock::now() - start;
+}
+
+bool StreamingVerifier::Verify() {
+  ScopedVerificationTimer timer;
+  AddVerificationTime(update_time_);
+  update_time_ = {};
+  g_verification_totals->count.fetch_add(1, std::memory_order_relaxed);
+  if (offset_ != data_size_) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("Data size mismatch: expected {}, got {}", data_size_,
+                      offset_));
+    return false;
+  }
+  if (state_.Finish() != received_checksum_) {
+    AKLOG(aklog::LogLevel::ERROR, "Checksum mismatch");
+    return false;
+  }
+  return true;
+}
+
+BenchmarkResult SummarizeSamples(const std::vector<double> &samples) {
+  const SampleStatistics statistics = ComputeSampleStatistics(samples);
+  return BenchmarkResult{
+      .average = statistics.trimmed_mean,
+      .stddev = statistics.trimmed_stddev,
+      .samples = samples,
+      .statistics = statistics,
+  };
+}
+
 BenchmarkResult CalculateBandwidth(const std::vector<double> &durations,
                                    int num_iterations, uint64_t data_size) {
   AKCHECK(durations.size() == num_iterations,
@@ -90,43 +227,21 @@ BenchmarkResult CalculateBandwidth(const std::vector<double> &durations,
                       durations.size(), num_iterations));
   AKCHECK(num_iterations >= 1, "num_iterations must be at least 1");
 
-  double average_duration =
-      std::accumulate(durations.begin(), durations.end(), 0.0) /
-      durations.size();
-
-  // Calculate standard deviation
-  double variance = 0.0;
+  // Summarize the bandwidth of each iteration rather than propagating the
+  // spread of the durations to first order.
+  std::vector<double> bandwidths;
+  bandwidths.reserve(durations.size());
   for (const auto &duration : durations) {
-    variance += std::pow(duration - average_duration, 2);
+    bandwidths.push_back(data_size / duration);
   }
-  variance /= durations.size();
-  double stddev_duration = std::sqrt(variance);
-
-  double bandwidth = data_size / average_duration;
-  double bandwidth_stddev =
-      data_size * stddev_duration / (average_duration * average_duration);
-
-  return BenchmarkResult{bandwidth, bandwidth_stddev};
+  return SummarizeSamples(bandwidths);
 }
 
 BenchmarkResult CalculateOneTripDuration(const std::vector<double> &durations) {
   AKCHECK(durations.size() >= 1,
           std::format("durations.size() ({}) must be at least 1",
                       durations.size()));
-  // Calculate average of filtered durations
-  double average_duration =
-      std::accumulate(durations.begin() + 1, durations.end() - 1, 0.0) /
-      durations.size();
-
-  // Calculate standard deviation of filtered durations
-  double variance = 0.0;
-  for (size_t i = 1; i < durations.size() - 1; ++i) {
-    variance += std::pow(durations[i] - average_duration, 2);
-  }
-  variance /= durations.size();
-  double stddev_duration = std::sqrt(variance);
-
-  return BenchmarkResult{average_duration, stddev_duration};
+  return SummarizeSamples(durations);
 }
 
 std::string ReceivePrefix(int iteration) {
@@ -158,3 +273,35 @@ std::string GenerateUniqueName(const std::string &base_name) {
     return base_name + "_" + hex_suffix;
   }
 }
+
+namespace {
+std::optional<PairGroup> g_pair_group = std::nullopt;
+} // namespace
+
+void SetPairGroup(const std::optional<PairGroup> &group) {
+  g_pair_group = group;
+}
+
+int GetPairIndex() {
+  return g_pair_group.has_value() ? g_pair_group->index : 0;
+}
+
+std::string PairName(const std::string &name) {
+  if (!g_pair_group.has_value()) {
+    return name;
+  }
+  return std::format("{}_pair{}", name, g_pair_group->index);
+}
+
+void WaitForAllPairs() {
+  if (!g_pair_group.has_value()) {
+    return;
+  }
+  // Opened on first use in each peer, i.e. after the benchmark forks
+  static std::unique_ptr<SenseReversingBarrier> gate;
+  if (!gate) {
+    gate = std::make_unique<SenseReversingBarrier>(
+        2 * g_pair_group->num_pairs, g_pair_group->gate_id);
+  }
+  gate->Wait();
+}
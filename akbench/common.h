@@ -1,22 +1,121 @@
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
-constexpr uint64_t CHECKSUM_SIZE = 128;
+#include "checksum.h"
+#include "stats.h"
+
 constexpr const char *GIBYTE_PER_SEC_UNIT = " GiByte/sec";
 
+// Distribution of per-operation latencies in seconds.
+struct LatencyPercentiles {
+  double min;
+  double p50;
+  double p90;
+  double p99;
+  double p999;
+  double max;
+};
+
 struct BenchmarkResult {
   double average;
   double stddev;
+  std::optional<LatencyPercentiles> percentiles = std::nullopt;
+  // Per-iteration values (one-trip durations or bandwidths) that average and
+  // stddev summarize.
+  std::vector<double> samples = {};
+  std::optional<SampleStatistics> statistics = std::nullopt;
+  // Operations per iteration of a latency benchmark
+  std::optional<uint64_t> loop_size = std::nullopt;
+  // Data and buffer sizes in bytes of a bandwidth benchmark in a size sweep
+  std::optional<uint64_t> data_size = std::nullopt;
+  std::optional<uint64_t> buffer_size = std::nullopt;
+  // Additional named values, e.g. the copy time of each thread in seconds
+  std::vector<std::pair<std::string, double>> metrics = {};
 };
 
-std::vector<uint8_t> GenerateDataToSend(uint64_t data_size);
-bool VerifyDataReceived(const std::vector<uint8_t> &data, uint64_t data_size);
+// Square matrix of results between pairs of CPUs or NUMA nodes. values[i][j]
+// is measured between labels[i] (row) and labels[j] (column). Cells that are
+// not measured are std::nullopt.
+struct BenchmarkMatrix {
+  std::vector<int> labels;
+  std::vector<std::vector<std::optional<double>>> values;
+};
+
+// The data to send: data_size bytes from the data generator, ending with the
+// checksum of the bytes before them. The data is generated once for each
+// data_size, seed and ChecksumKind into a read-only shared mapping, which
+// forked peers inherit, so generate it before forking. The span stays valid
+// until the next call with other parameters.
+std::span<const uint8_t> GenerateDataToSend(uint64_t data_size);
+bool VerifyDataReceived(std::span<const uint8_t> data, uint64_t data_size);
+
+// Time spent in VerifyDataReceived and StreamingVerifier by all processes
+// since the last reset, and the number of verified buffers. The totals are in
+// memory mapped at startup, so forked peers add to them.
+void ResetVerificationTime();
+double GetVerificationTime();
+uint64_t GetNumVerifications();
+
+// Verifies data from GenerateDataToSend that arrives in pieces, e.g. in pages
+// mapped from a socket, without assembling it in one buffer.
+class StreamingVerifier {
+public:
+  explicit StreamingVerifier(uint64_t data_size);
+
+  // Add the next piece of the data. The time spent here is only summed in this
+  // object, as Update usually runs in the timed region.
+  void Update(std::span<const uint8_t> piece);
+  // Whether all data_size bytes have arrived and match the checksum. Adds the
+  // time spent in Update and here to the verification time.
+  bool Verify();
+  // Time spent in Update since the last Verify
+  std::chrono::steady_clock::duration update_time() const {
+    return update_time_;
+  }
+
+private:
+  const uint64_t data_size_;
+  uint64_t offset_ = 0;
+  // Checksum of the data so far
+  ChecksumState state_;
+  std::array<uint8_t, CHECKSUM_SIZE> received_checksum_ = {};
+  // Time spent in Update since the last Verify
+  std::chrono::steady_clock::duration update_time_ = {};
+};
 BenchmarkResult CalculateBandwidth(const std::vector<double> &durations,
                                    int num_iterations, uint64_t data_size);
 BenchmarkResult CalculateOneTripDuration(const std::vector<double> &durations);
+// average is the trimmed mean and stddev the trimmed standard deviation of the
+// samples after outlier rejection.
+BenchmarkResult SummarizeSamples(const std::vector<double> &samples);
 std::string ReceivePrefix(int iteration);
 std::string SendPrefix(int iteration);
 std::string GenerateUniqueName(const std::string &base_name);
+
+// Sender/receiver pairs of a bandwidth benchmark that run at the same time
+// with --num-pairs. The benchmark of each pair runs in its own process, which
+// sets its group before the benchmark forks the other peer.
+struct PairGroup {
+  int index;
+  int num_pairs;
+  // SenseReversingBarrier that all 2 * num_pairs peers wait on
+  std::string gate_id;
+};
+
+void SetPairGroup(const std::optional<PairGroup> &group);
+// Index of the pair of the calling process, 0 without --num-pairs
+int GetPairIndex();
+// name made distinct for each pair, so that pairs do not share sockets, files
+// or barriers. Unchanged without --num-pairs.
+std::string PairName(const std::string &name);
+// Waits until the peers of all pairs arrive, so that the timed regions of the
+// pairs start together. Does nothing without --num-pairs.
+void WaitForAllPairs();
@@ -10,13 +10,17 @@
 #include "aklog.h"
 
 #include "common.h"
+#include "histogram.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 
 void ParentFlip(std::condition_variable *parent_cv,
                 std::condition_variable *child_cv, std::mutex *parent_mutex,
                 std::mutex *child_mutex, bool *parent_ready, bool *child_ready,
-                const uint64_t loop_size) {
+                const uint64_t loop_size, LatencyHistogram *histogram) {
+  LatencyRecorder recorder(histogram);
   for (uint64_t i = 0; i < loop_size; ++i) {
     {
       std::lock_guard<std::mutex> lock(*parent_mutex);
@@ -29,6 +33,7 @@ void ParentFlip(std::condition_variable *parent_cv,
       child_cv->wait(lock, [child_ready] { return *child_ready; });
       *child_ready = false;
     }
+    recorder.Tick();
   }
 }
 
@@ -56,23 +61,33 @@ void ChildFlip(std::condition_variable *parent_cv,
 BenchmarkResult RunConditionVariableLatencyBenchmark(int num_iterations,
                                                      int num_warmups,
                                                      uint64_t loop_size) {
+  ScopedPeerAffinity affinity(PARENT_PEER);
   std::condition_variable parent_cv, child_cv;
   std::mutex parent_mutex, child_mutex;
   bool parent_ready = false, child_ready = false;
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   std::vector<double> durations;
   for (int i = 0; i < num_iterations + num_warmups; i++) {
     AKLOG(aklog::LogLevel::DEBUG, std::format("Starting iteration {}/{}", i + 1,
                                               (num_iterations + num_warmups)));
+    const bool is_warmup = i < num_warmups;
     std::thread child_thread([&]() {
+      ScopedPeerAffinity affinity(CHILD_PEER);
+      // The child thread lives for one iteration only.
+      PerfCounters child_counters(CHILD_PEER, is_warmup ? 1 : 0);
+      child_counters.Start();
       ChildFlip(&parent_cv, &child_cv, &parent_mutex, &child_mutex,
                 &parent_ready, &child_ready, loop_size);
+      child_counters.Stop();
     });
 
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
     ParentFlip(&parent_cv, &child_cv, &parent_mutex, &child_mutex,
-               &parent_ready, &child_ready, loop_size);
+               &parent_ready, &child_ready, loop_size, nullptr);
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     child_thread.join();
     AKLOG(aklog::LogLevel::DEBUG,
@@ -90,5 +105,21 @@ BenchmarkResult RunConditionVariableLatencyBenchmark(int num_iterations,
     child_ready = false;
   }
 
-  return CalculateOneTripDuration(durations);
+  // Time each round trip separately in one more pass to get the latency
+  // distribution. The clock reads are kept out of the passes above so that
+  // they do not inflate the average.
+  LatencyHistogram histogram;
+  std::thread child_thread([&]() {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    ChildFlip(&parent_cv, &child_cv, &parent_mutex, &child_mutex,
+              &parent_ready, &child_ready, loop_size);
+  });
+  ParentFlip(&parent_cv, &child_cv, &parent_mutex, &child_mutex, &parent_ready,
+             &child_ready, loop_size, &histogram);
+  child_thread.join();
+
+  BenchmarkResult result = CalculateOneTripDuration(durations);
+  // Each recorded round trip consists of two one-way trips.
+  result.percentiles = histogram.Percentiles(1e-9 / 2);
+  return result;
 }
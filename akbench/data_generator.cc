@@ -0,0 +1,78 @@
+#include "data_generator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "parallel.h"
+
+namespace {
+
+constexpr uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15;
+
+uint64_t RandomSeed() {
+  std::random_device seed_gen;
+  return (static_cast<uint64_t>(seed_gen()) << 32) | seed_gen();
+}
+
+std::atomic<uint64_t> g_data_seed{RandomSeed()};
+
+// Fill out, which starts at a word boundary, single threaded. The loop has no
+// dependency between iterations, so the compiler vectorizes it.
+void FillWords(std::span<uint8_t> out, uint64_t seed, uint64_t first_word) {
+  const size_t num_words = out.size() / sizeof(uint64_t);
+  uint8_t *const bytes = out.data();
+  for (size_t i = 0; i < num_words; ++i) {
+    const uint64_t word = DataWord(seed, first_word + i);
+    memcpy(bytes + i * sizeof(uint64_t), &word, sizeof(word));
+  }
+  const uint64_t last = DataWord(seed, first_word + num_words);
+  for (size_t i = num_words * sizeof(uint64_t); i < out.size(); ++i) {
+    out[i] = (last >> (8 * (i % sizeof(uint64_t)))) & 0xff;
+  }
+}
+
+} // namespace
+
+uint64_t DataWord(uint64_t seed, uint64_t index) {
+  uint64_t z = seed + (index + 1) * GOLDEN_GAMMA;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+void FillData(std::span<uint8_t> out, uint64_t seed, uint64_t offset) {
+  // Bytes before the first word boundary
+  size_t head = 0;
+  if (offset % sizeof(uint64_t) != 0) {
+    const uint64_t word = DataWord(seed, offset / sizeof(uint64_t));
+    for (; head < out.size() && (offset + head) % sizeof(uint64_t) != 0;
+         ++head) {
+      out[head] = (word >> (8 * ((offset + head) % sizeof(uint64_t)))) & 0xff;
+    }
+  }
+  const std::span<uint8_t> rest = out.subspan(head);
+  const uint64_t first_word = (offset + head) / sizeof(uint64_t);
+
+  const uint64_t num_words = rest.size() / sizeof(uint64_t);
+  const uint64_t num_threads = ParallelThreadCount(rest.size(), num_words);
+
+  // Each thread takes whole words. The last one also takes the tail.
+  auto fill = [&](uint64_t thread) {
+    const uint64_t begin = thread * num_words / num_threads;
+    const uint64_t end = thread + 1 == num_threads
+                             ? rest.size()
+                             : (thread + 1) * num_words / num_threads *
+                                   sizeof(uint64_t);
+    FillWords(rest.subspan(begin * sizeof(uint64_t),
+                           end - begin * sizeof(uint64_t)),
+              seed, first_word + begin);
+  };
+  RunInParallel(num_threads, fill);
+}
+
+void SetDataSeed(uint64_t seed) { g_data_seed.store(seed); }
+
+uint64_t GetDataSeed() { return g_data_seed.load(); }
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// The context of a bandwidth benchmark is a stream of 64-bit words, each a
+// function of the seed and its index only (SplitMix64 of a counter). Any part
+// of the stream can thus be generated independently, by several threads or
+// again by the receiver.
+
+// Word index of the stream of seed
+uint64_t DataWord(uint64_t seed, uint64_t index);
+
+// Fill out with the bytes of the stream of seed from byte offset on. The words
+// are stored little endian. Large buffers are split among threads on the CPUs
+// the calling thread may run on.
+void FillData(std::span<uint8_t> out, uint64_t seed, uint64_t offset = 0);
+
+// The seed used by GenerateDataToSend. It is random unless set. Set it before
+// forking so that all peers agree.
+void SetDataSeed(uint64_t seed);
+uint64_t GetDataSeed();
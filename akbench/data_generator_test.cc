@@ -0,0 +1,71 @@
+#include "data_generator.h"
+
+#include <algorithm>
+#include <format>
+#include <print>
+#include <vector>
+
+#include "aklog.h"
+
+namespace {
+
+// Byte offset of the stream of seed, from DataWord alone
+uint8_t NaiveByte(uint64_t seed, uint64_t offset) {
+  return (DataWord(seed, offset / 8) >> (8 * (offset % 8))) & 0xff;
+}
+
+void testFillDataMatchesWords() {
+  // Large enough to be split among threads where there are several CPUs
+  for (uint64_t size : {0, 1, 7, 8, 9, 1000, (20 << 20) + 5}) {
+    std::vector<uint8_t> data(size);
+    FillData(data, 42);
+    for (uint64_t i = 0; i < size; ++i) {
+      AKCHECK(data[i] == NaiveByte(42, i),
+              std::format("Byte {} of {} bytes should match DataWord", i,
+                          size));
+    }
+  }
+  std::print("testFillDataMatchesWords passed\n");
+}
+
+void testFillDataAtOffset() {
+  std::vector<uint8_t> whole(10000);
+  FillData(whole, 7);
+  for (uint64_t offset : {0, 1, 5, 8, 13, 4096}) {
+    for (uint64_t size : {0, 1, 3, 8, 100}) {
+      std::vector<uint8_t> part(size);
+      FillData(part, 7, offset);
+      AKCHECK(std::equal(part.begin(), part.end(), whole.begin() + offset),
+              std::format("{} bytes at offset {} should match the whole data",
+                          size, offset));
+    }
+  }
+  std::print("testFillDataAtOffset passed\n");
+}
+
+void testSeeds() {
+  std::vector<uint8_t> a(1024);
+  std::vector<uint8_t> b(1024);
+  FillData(a, 1);
+  FillData(b, 2);
+  AKCHECK(a != b, "Different seeds should give different data");
+  FillData(b, 1);
+  AKCHECK(a == b, "The same seed should give the same data");
+
+  SetDataSeed(123);
+  AKCHECK(GetDataSeed() == 123, "The seed should be set");
+  std::print("testSeeds passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running data generator tests...\n");
+
+  testFillDataMatchesWords();
+  testFillDataAtOffset();
+  testSeeds();
+
+  std::print("All data generator tests passed!\n");
+  return 0;
+}
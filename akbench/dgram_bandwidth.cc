@@ -0,0 +1,338 @@
+#include "dgram_bandwidth.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "aklog.h"
+
+#include "barrier.h"
+#include "common.h"
+#include "perf_counters.h"
+#include "topology.h"
+
+namespace {
+
+const std::string BARRIER_ID = GenerateUniqueName("/dgram_benchmark");
+const std::string LOOPBACK_IP = "127.0.0.1";
+
+enum class DgramTransport { UDS_DGRAM, UDS_SEQPACKET, UDP };
+
+// Precedes the payload of every packet. Packets of an earlier iteration that
+// are still queued are told apart by iteration.
+struct PacketHeader {
+  uint32_t iteration;
+  // The packet only tells the receiver that the sender has sent everything.
+  uint32_t is_end;
+  uint64_t sequence;
+};
+
+// The sender repeats the end packet, which may be dropped as well, until the
+// receiver has set done.
+struct SharedState {
+  std::atomic<uint32_t> done;
+};
+
+// Loss and order of the packets of one iteration
+struct PacketStats {
+  uint64_t received = 0;
+  uint64_t reordered = 0;
+};
+
+// Creates a connected pair of sockets, the first for the receiver.
+std::pair<int, int> CreateSocketPair(DgramTransport transport) {
+  if (transport != DgramTransport::UDP) {
+    int fds[2];
+    const int type = transport == DgramTransport::UDS_DGRAM ? SOCK_DGRAM
+                                                            : SOCK_SEQPACKET;
+    if (socketpair(AF_UNIX, type, 0, fds) == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("socketpair: {}", strerror(errno)));
+    }
+    return {fds[0], fds[1]};
+  }
+
+  int fds[2];
+  sockaddr_in addrs[2];
+  for (int i = 0; i < 2; ++i) {
+    fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fds[i] == -1) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("socket: {}", strerror(errno)));
+    }
+    memset(&addrs[i], 0, sizeof(addrs[i]));
+    addrs[i].sin_family = AF_INET;
+    addrs[i].sin_addr.s_addr = inet_addr(LOOPBACK_IP.c_str());
+    addrs[i].sin_port = 0;
+    socklen_t length = sizeof(addrs[i]);
+    if (bind(fds[i], (struct sockaddr *)&addrs[i], sizeof(addrs[i])) == -1 ||
+        getsockname(fds[i], (struct sockaddr *)&addrs[i], &length) == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("bind UDP socket: {}", strerror(errno)));
+    }
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (connect(fds[i], (struct sockaddr *)&addrs[1 - i],
+                sizeof(addrs[1 - i])) == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("connect UDP socket: {}", strerror(errno)));
+    }
+  }
+  return {fds[0], fds[1]};
+}
+
+BenchmarkResult ReceiveProcess(int fd, SharedState *state, int num_warmups,
+                               int num_iterations, uint64_t data_size,
+                               uint64_t packet_size,
+                               std::span<const uint8_t> expected_data) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+  const uint64_t payload_size = packet_size - sizeof(PacketHeader);
+  const uint64_t num_packets = (data_size + payload_size - 1) / payload_size;
+  std::vector<uint8_t> packet(packet_size);
+  std::vector<uint8_t> received_data(data_size, 0);
+  std::vector<bool> is_received(num_packets);
+  std::vector<double> durations;
+  std::vector<double> delivered_durations;
+  double total_packets_per_sec = 0;
+  uint64_t total_dropped = 0;
+  uint64_t total_reordered = 0;
+
+  PerfCounters counters(PARENT_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    bool is_warmup = iteration < num_warmups;
+
+    std::fill(received_data.begin(), received_data.end(), 0);
+    std::fill(is_received.begin(), is_received.end(), false);
+    PacketStats stats;
+    uint64_t max_sequence = 0;
+    state->done.store(0);
+    barrier.Wait();
+    counters.Start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    while (stats.received < num_packets) {
+      const ssize_t length = recv(fd, packet.data(), packet.size(), 0);
+      if (length < static_cast<ssize_t>(sizeof(PacketHeader))) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("{}recv: {}", ReceivePrefix(iteration),
+                          length == -1 ? strerror(errno) : "short packet"));
+      }
+      PacketHeader header;
+      memcpy(&header, packet.data(), sizeof(header));
+      if (header.iteration != static_cast<uint32_t>(iteration)) {
+        continue;
+      }
+      if (header.is_end) {
+        break;
+      }
+      AKCHECK(header.sequence < num_packets && !is_received[header.sequence],
+              std::format("Unexpected packet {}", header.sequence));
+      if (stats.received > 0 && header.sequence < max_sequence) {
+        ++stats.reordered;
+      }
+      max_sequence = std::max(max_sequence, header.sequence);
+      is_received[header.sequence] = true;
+      ++stats.received;
+      memcpy(received_data.data() + header.sequence * payload_size,
+             packet.data() + sizeof(header), length - sizeof(header));
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
+    state->done.store(1);
+    barrier.Wait();
+
+    const uint64_t dropped = num_packets - stats.received;
+    if (!is_warmup) {
+      std::chrono::duration<double> elapsed_time = end_time - start_time;
+      durations.push_back(elapsed_time.count());
+      total_packets_per_sec += stats.received / elapsed_time.count();
+      total_dropped += dropped;
+      total_reordered += stats.reordered;
+      AKLOG(aklog::LogLevel::DEBUG,
+            std::format("{}Time taken: {} ms. Dropped {} and reordered {} of "
+                        "{} packets.",
+                        ReceivePrefix(iteration), elapsed_time.count() * 1000,
+                        dropped, stats.reordered, num_packets));
+    }
+
+    // With drops, compare the delivered packets with the data sent instead.
+    bool verified = true;
+    if (dropped == 0) {
+      verified = VerifyDataReceived(received_data, data_size);
+    } else {
+      for (uint64_t sequence = 0; sequence < num_packets; ++sequence) {
+        const uint64_t offset = sequence * payload_size;
+        const uint64_t length = std::min(payload_size, data_size - offset);
+        if (is_received[sequence] &&
+            memcmp(received_data.data() + offset,
+                   expected_data.data() + offset, length) != 0) {
+          verified = false;
+        }
+      }
+    }
+    if (!verified) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("{}Data verification failed!",
+                                                ReceivePrefix(iteration)));
+    }
+
+    if (!is_warmup) {
+      // Scale the duration so that CalculateBandwidth yields the delivered
+      // bandwidth of the iteration.
+      AKCHECK(stats.received > 0,
+              std::format("{}All packets were dropped",
+                          ReceivePrefix(iteration)));
+      const uint64_t delivered_bytes =
+          std::min(data_size, stats.received * payload_size);
+      delivered_durations.push_back(durations.back() * data_size /
+                                    delivered_bytes);
+    }
+  }
+
+  BenchmarkResult result =
+      CalculateBandwidth(delivered_durations, num_iterations, data_size);
+  result.metrics.emplace_back("packets_per_sec",
+                              total_packets_per_sec / num_iterations);
+  result.metrics.emplace_back("dropped_packets",
+                              static_cast<double>(total_dropped) /
+                                  num_iterations);
+  result.metrics.emplace_back("reordered_packets",
+                              static_cast<double>(total_reordered) /
+                                  num_iterations);
+  AKLOG(aklog::LogLevel::INFO,
+        std::format("Receive bandwidth: {:.3f} ± {:.3f}{}.",
+                    result.average / (1 << 30), result.stddev / (1 << 30),
+                    GIBYTE_PER_SEC_UNIT));
+  return result;
+}
+
+void SendPacket(int fd, std::vector<uint8_t> *packet, size_t length) {
+  // UDP drops what does not fit instead of blocking, so only other errors
+  // are fatal.
+  if (send(fd, packet->data(), length, 0) == -1 && errno != ENOBUFS) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("send: {}", strerror(errno)));
+  }
+}
+
+void SendProcess(int fd, SharedState *state, int num_warmups,
+                 int num_iterations, uint64_t data_size, uint64_t packet_size,
+                 std::span<const uint8_t> data_to_send) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+  const uint64_t payload_size = packet_size - sizeof(PacketHeader);
+  std::vector<uint8_t> packet(packet_size);
+
+  PerfCounters counters(CHILD_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    barrier.Wait();
+    counters.Start();
+    uint64_t sequence = 0;
+    for (uint64_t offset = 0; offset < data_size;
+         offset += payload_size, ++sequence) {
+      const uint64_t length = std::min(payload_size, data_size - offset);
+      const PacketHeader header = {
+          .iteration = static_cast<uint32_t>(iteration),
+          .is_end = 0,
+          .sequence = sequence};
+      memcpy(packet.data(), &header, sizeof(header));
+      memcpy(packet.data() + sizeof(header), data_to_send.data() + offset,
+             length);
+      SendPacket(fd, &packet, sizeof(header) + length);
+    }
+    const PacketHeader end = {.iteration = static_cast<uint32_t>(iteration),
+                              .is_end = 1,
+                              .sequence = sequence};
+    memcpy(packet.data(), &end, sizeof(end));
+    while (state->done.load() == 0) {
+      SendPacket(fd, &packet, sizeof(end));
+      usleep(100);
+    }
+    counters.Stop();
+    barrier.Wait();
+  }
+}
+
+BenchmarkResult RunDgramBandwidth(DgramTransport transport, int num_iterations,
+                                  int num_warmups, uint64_t data_size,
+                                  uint64_t buffer_size) {
+  AKCHECK(buffer_size > sizeof(PacketHeader),
+          std::format("buffer_size ({}) must be greater than the packet "
+                      "header ({} bytes)",
+                      buffer_size, sizeof(PacketHeader)));
+  const uint64_t packet_size = std::min(buffer_size, MAX_DGRAM_PACKET_SIZE);
+  if (packet_size < buffer_size) {
+    AKLOG(aklog::LogLevel::DEBUG,
+          std::format("Clamped the packet size to {} bytes", packet_size));
+  }
+  SenseReversingBarrier::ClearResource(BARRIER_ID);
+
+  void *mapped = mmap(nullptr, sizeof(SharedState), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mapped == MAP_FAILED) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("mmap: {}", strerror(errno)));
+  }
+  SharedState *state = new (mapped) SharedState;
+  const auto [receive_fd, send_fd] = CreateSocketPair(transport);
+  // Generated before the fork so that the receiver can check the delivered
+  // packets when others are dropped.
+  const std::span<const uint8_t> data = GenerateDataToSend(data_size);
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("fork: {}", strerror(errno)));
+  }
+
+  if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    close(receive_fd);
+    SendProcess(send_fd, state, num_warmups, num_iterations, data_size,
+                packet_size, data);
+    exit(0);
+  }
+
+  ScopedPeerAffinity affinity(PARENT_PEER);
+  close(send_fd);
+  BenchmarkResult result =
+      ReceiveProcess(receive_fd, state, num_warmups, num_iterations, data_size,
+                     packet_size, data);
+  waitpid(pid, nullptr, 0);
+  close(receive_fd);
+  munmap(mapped, sizeof(SharedState));
+  return result;
+}
+
+} // namespace
+
+BenchmarkResult RunUdsDgramBandwidthBenchmark(int num_iterations,
+                                              int num_warmups,
+                                              uint64_t data_size,
+                                              uint64_t buffer_size) {
+  return RunDgramBandwidth(DgramTransport::UDS_DGRAM, num_iterations,
+                           num_warmups, data_size, buffer_size);
+}
+
+BenchmarkResult RunUdsSeqpacketBandwidthBenchmark(int num_iterations,
+                                                  int num_warmups,
+                                                  uint64_t data_size,
+                                                  uint64_t buffer_size) {
+  return RunDgramBandwidth(DgramTransport::UDS_SEQPACKET, num_iterations,
+                           num_warmups, data_size, buffer_size);
+}
+
+BenchmarkResult RunUdpBandwidthBenchmark(int num_iterations, int num_warmups,
+                                         uint64_t data_size,
+                                         uint64_t buffer_size) {
+  return RunDgramBandwidth(DgramTransport::UDP, num_iterations, num_warmups,
+                           data_size, buffer_size);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+
+// Largest packet of the datagram benchmarks, the largest UDP payload over
+// IPv4. Larger buffer sizes are clamped to it.
+constexpr uint64_t MAX_DGRAM_PACKET_SIZE = 65507;
+
+// The datagram benchmarks send data_size bytes in sequence-numbered packets
+// of buffer_size bytes, header included. The bandwidth counts only the bytes
+// that are delivered. The metrics packets_per_sec, dropped_packets and
+// reordered_packets are per second or per iteration.
+
+// Over a Unix domain socket pair of type SOCK_DGRAM.
+BenchmarkResult RunUdsDgramBandwidthBenchmark(int num_iterations,
+                                              int num_warmups,
+                                              uint64_t data_size,
+                                              uint64_t buffer_size);
+
+// Over a Unix domain socket pair of type SOCK_SEQPACKET, which is reliable.
+BenchmarkResult RunUdsSeqpacketBandwidthBenchmark(int num_iterations,
+                                                  int num_warmups,
+                                                  uint64_t data_size,
+                                                  uint64_t buffer_size);
+
+// Over UDP on the loopback interface.
+BenchmarkResult RunUdpBandwidthBenchmark(int num_iterations, int num_warmups,
+                                         uint64_t data_size,
+                                         uint64_t buffer_size);
@@ -0,0 +1,56 @@
+#include "dgram_bandwidth.h"
+
+#include <cstdint>
+#include <string>
+
+#include "aklog.h"
+
+namespace {
+
+double GetMetric(const BenchmarkResult &result, const std::string &name) {
+  for (const auto &[key, value] : result.metrics) {
+    if (key == name) {
+      return value;
+    }
+  }
+  AKLOG(aklog::LogLevel::FATAL, "Missing metric " + name);
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+
+  constexpr int num_iterations = 3;
+  constexpr int num_warmups = 1;
+  // Many packets, with a tail that does not fill one
+  constexpr uint64_t data_size = (1 << 18) + 100;
+  constexpr uint64_t buffer_size = 1024;
+
+  for (auto run : {RunUdsDgramBandwidthBenchmark,
+                   RunUdsSeqpacketBandwidthBenchmark,
+                   RunUdpBandwidthBenchmark}) {
+    const BenchmarkResult result =
+        run(num_iterations, num_warmups, data_size, buffer_size);
+    AKCHECK(result.average > 0.0, "Bandwidth should be positive");
+    AKCHECK(GetMetric(result, "packets_per_sec") > 0.0,
+            "Packets should be delivered");
+    AKCHECK(GetMetric(result, "dropped_packets") >= 0.0,
+            "Drops should be non-negative");
+  }
+
+  // Unix domain sockets block instead of dropping.
+  const BenchmarkResult seqpacket_result = RunUdsSeqpacketBandwidthBenchmark(
+      num_iterations, num_warmups, data_size, buffer_size);
+  AKCHECK(GetMetric(seqpacket_result, "dropped_packets") == 0.0 &&
+              GetMetric(seqpacket_result, "reordered_packets") == 0.0,
+          "SOCK_SEQPACKET should neither drop nor reorder");
+
+  // Buffer sizes above the largest datagram are clamped.
+  const BenchmarkResult large_result = RunUdpBandwidthBenchmark(
+      num_iterations, num_warmups, 1 << 20, 1 << 20);
+  AKCHECK(large_result.average > 0.0, "Bandwidth should be positive");
+  AKLOG(aklog::LogLevel::INFO, "dgram_bandwidth test passed");
+
+  return 0;
+}
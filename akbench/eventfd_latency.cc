@@ -0,0 +1,105 @@
+#include "eventfd_latency.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <format>
+#include <memory>
+
+#include "aklog.h"
+
+#include "common.h"
+#include "topology.h"
+#include "wakeup_latency.h"
+
+namespace {
+
+// One side of the ping-pong. It signals the other side through send_fd and
+// waits for it on receive_fd, through an epoll instance if use_epoll is set.
+// It closes both eventfds, which each process has a copy of.
+class EventfdEndpoint : public WakeupEndpoint {
+public:
+  EventfdEndpoint(int send_fd, int receive_fd, bool use_epoll)
+      : send_fd_(send_fd), receive_fd_(receive_fd) {
+    if (!use_epoll) {
+      return;
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    AKCHECK(epoll_fd_ != -1,
+            std::format("epoll_create1: {}", strerror(errno)));
+    epoll_event event = {.events = EPOLLIN, .data = {.fd = receive_fd_}};
+    AKCHECK(epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, receive_fd_, &event) == 0,
+            std::format("epoll_ctl: {}", strerror(errno)));
+  }
+
+  ~EventfdEndpoint() override {
+    if (epoll_fd_ != -1) {
+      close(epoll_fd_);
+    }
+    close(send_fd_);
+    close(receive_fd_);
+  }
+
+  void Wake() override {
+    const uint64_t one = 1;
+    if (write(send_fd_, &one, sizeof(one)) != sizeof(one)) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("write eventfd: {}", strerror(errno)));
+    }
+  }
+
+  void Wait() override {
+    if (epoll_fd_ != -1) {
+      epoll_event event;
+      int ready;
+      while ((ready = epoll_wait(epoll_fd_, &event, 1, -1)) == -1 &&
+             errno == EINTR) {
+      }
+      AKCHECK(ready == 1, std::format("epoll_wait: {}", strerror(errno)));
+    }
+    uint64_t value;
+    if (read(receive_fd_, &value, sizeof(value)) != sizeof(value)) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("read eventfd: {}", strerror(errno)));
+    }
+  }
+
+private:
+  const int send_fd_;
+  const int receive_fd_;
+  int epoll_fd_ = -1;
+};
+
+BenchmarkResult RunEventfdLatency(bool use_epoll, int num_iterations,
+                                  int num_warmups, uint64_t loop_size) {
+  const int parent_fd = eventfd(0, EFD_CLOEXEC);
+  const int child_fd = eventfd(0, EFD_CLOEXEC);
+  AKCHECK(parent_fd != -1 && child_fd != -1,
+          std::format("Failed to create eventfds: {}", strerror(errno)));
+
+  // The epoll instance is created in the process that uses it.
+  return RunWakeupLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, WakeupPeers::PROCESSES,
+      [parent_fd, child_fd, use_epoll](int peer) {
+        return peer == PARENT_PEER
+                   ? std::make_unique<EventfdEndpoint>(child_fd, parent_fd,
+                                                       use_epoll)
+                   : std::make_unique<EventfdEndpoint>(parent_fd, child_fd,
+                                                       use_epoll);
+      });
+}
+
+} // namespace
+
+BenchmarkResult RunEventfdLatencyBenchmark(int num_iterations, int num_warmups,
+                                           uint64_t loop_size) {
+  return RunEventfdLatency(false, num_iterations, num_warmups, loop_size);
+}
+
+BenchmarkResult RunEventfdEpollLatencyBenchmark(int num_iterations,
+                                                int num_warmups,
+                                                uint64_t loop_size) {
+  return RunEventfdLatency(true, num_iterations, num_warmups, loop_size);
+}
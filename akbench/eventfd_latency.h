@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common.h"
+
+// Ping-pong between a parent and a forked child over a pair of eventfds,
+// waiting in a blocking read().
+BenchmarkResult RunEventfdLatencyBenchmark(int num_iterations, int num_warmups,
+                                           uint64_t loop_size);
+
+// Same as RunEventfdLatencyBenchmark, but each side waits in epoll_wait()
+// before reading its eventfd.
+BenchmarkResult RunEventfdEpollLatencyBenchmark(int num_iterations,
+                                                int num_warmups,
+                                                uint64_t loop_size);
@@ -9,12 +9,16 @@
 #include <chrono>
 #include <cstring>
 #include <format>
+#include <memory>
 #include <vector>
 
 #include "aklog.h"
 
 #include "barrier.h"
 #include "common.h"
+#include "message_latency.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 
@@ -23,11 +27,13 @@ const std::string FIFO_PATH = GenerateUniqueName("/tmp/fifo_benchmark_pipe");
 
 void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
                  uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
+  const std::string fifo_path = PairName(FIFO_PATH);
 
-  std::vector<uint8_t> data_to_send = GenerateDataToSend(data_size);
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
   std::vector<double> durations;
 
+  PerfCounters counters(CHILD_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -43,7 +49,7 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
     }
 
     // Open FIFO for writing
-    int write_fd = open(FIFO_PATH.c_str(), O_WRONLY);
+    int write_fd = open(fifo_path.c_str(), O_WRONLY);
     if (write_fd == -1) {
       AKLOG(aklog::LogLevel::FATAL,
             std::format("send: open FIFO for writing: {}", strerror(errno)));
@@ -51,6 +57,8 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
 
     barrier.Wait();
     size_t total_sent = 0;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     while (total_sent < data_size) {
@@ -65,6 +73,7 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (!is_warmup) {
       std::chrono::duration<double> elapsed_time = end_time - start_time;
@@ -90,10 +99,12 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
 
 BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
                                uint64_t data_size, uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
+  const std::string fifo_path = PairName(FIFO_PATH);
 
   std::vector<double> durations;
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -113,7 +124,7 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     received_data.reserve(data_size);
 
     // Open FIFO for reading
-    int read_fd = open(FIFO_PATH.c_str(), O_RDONLY);
+    int read_fd = open(fifo_path.c_str(), O_RDONLY);
     if (read_fd == -1) {
       AKLOG(aklog::LogLevel::FATAL,
             std::format("receive: open FIFO for reading: {}", strerror(errno)));
@@ -121,6 +132,8 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
 
     barrier.Wait();
     size_t total_received = 0;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     while (total_received < data_size) {
@@ -143,6 +156,7 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (!is_warmup) {
       std::chrono::duration<double> elapsed_time = end_time - start_time;
@@ -181,11 +195,12 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
 BenchmarkResult RunFifoBandwidthBenchmark(int num_iterations, int num_warmups,
                                           uint64_t data_size,
                                           uint64_t buffer_size) {
+  const std::string fifo_path = PairName(FIFO_PATH);
   // Remove any existing FIFO
-  unlink(FIFO_PATH.c_str());
+  unlink(fifo_path.c_str());
 
   // Create FIFO
-  if (mkfifo(FIFO_PATH.c_str(), 0666) == -1) {
+  if (mkfifo(fifo_path.c_str(), 0666) == -1) {
     AKLOG(aklog::LogLevel::FATAL, std::format("mkfifo: {}", strerror(errno)));
   }
 
@@ -197,18 +212,56 @@ BenchmarkResult RunFifoBandwidthBenchmark(int num_iterations, int num_warmups,
 
   if (pid == 0) {
     // Child process: sender
+    ScopedPeerAffinity affinity(CHILD_PEER);
     SendProcess(num_warmups, num_iterations, data_size, buffer_size);
     exit(0);
   } else {
     // Parent process: receiver
+    ScopedPeerAffinity affinity(PARENT_PEER);
     BenchmarkResult result =
         ReceiveProcess(num_warmups, num_iterations, data_size, buffer_size);
     waitpid(pid, nullptr, 0);
 
     // Clean up FIFO
-    unlink(FIFO_PATH.c_str());
-    SenseReversingBarrier::ClearResource(BARRIER_ID);
+    unlink(fifo_path.c_str());
+    SenseReversingBarrier::ClearResource(PairName(BARRIER_ID));
 
     return result;
   }
 }
+
+BenchmarkResult RunFifoLatencyBenchmark(int num_iterations, int num_warmups,
+                                        uint64_t loop_size,
+                                        uint64_t message_size) {
+  const std::string to_child_path = FIFO_PATH + ".to_child";
+  const std::string to_parent_path = FIFO_PATH + ".to_parent";
+  for (const std::string &path : {to_child_path, to_parent_path}) {
+    unlink(path.c_str());
+    if (mkfifo(path.c_str(), 0666) == -1) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("mkfifo: {}", strerror(errno)));
+    }
+  }
+
+  // Both sides open the FIFO to the child first, since opening one end
+  // blocks until the other end is opened.
+  BenchmarkResult result = RunMessageLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, message_size,
+      [&](int peer) -> std::unique_ptr<MessageEndpoint> {
+        const bool is_parent = peer == PARENT_PEER;
+        const int to_child_fd =
+            open(to_child_path.c_str(), is_parent ? O_WRONLY : O_RDONLY);
+        const int to_parent_fd =
+            open(to_parent_path.c_str(), is_parent ? O_RDONLY : O_WRONLY);
+        AKCHECK(to_child_fd != -1 && to_parent_fd != -1,
+                std::format("open FIFO: {}", strerror(errno)));
+        if (is_parent) {
+          return std::make_unique<FdMessageEndpoint>(to_child_fd,
+                                                     to_parent_fd);
+        }
+        return std::make_unique<FdMessageEndpoint>(to_parent_fd, to_child_fd);
+      });
+
+  unlink(to_child_path.c_str());
+  unlink(to_parent_path.c_str());
+  return result;
+}
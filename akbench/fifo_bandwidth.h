@@ -6,3 +6,9 @@
 BenchmarkResult RunFifoBandwidthBenchmark(int num_iterations, int num_warmups,
                                           uint64_t data_size,
                                           uint64_t buffer_size);
+
+// Round trips of message_size bytes over a pair of named pipes. Reports the
+// one-trip latency.
+BenchmarkResult RunFifoLatencyBenchmark(int num_iterations, int num_warmups,
+                                        uint64_t loop_size,
+                                        uint64_t message_size);
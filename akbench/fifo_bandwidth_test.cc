@@ -15,6 +15,10 @@ int main(int argc, char *argv[]) {
       num_iterations, num_warmups, data_size, buffer_size);
 
   AKCHECK(result.average >= 0.0, "Bandwidth should be non-negative");
+
+  const BenchmarkResult latency_result =
+      RunFifoLatencyBenchmark(num_iterations, num_warmups, 10, 64);
+  AKCHECK(latency_result.average > 0.0, "Latency should be positive");
   AKLOG(aklog::LogLevel::INFO, "fifo_bandwidth test passed");
 
   return 0;
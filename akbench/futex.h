@@ -0,0 +1,39 @@
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+
+// Thin wrappers around the futex(2) system call. Set private_futex to false
+// when the word lives in memory shared between processes.
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+// Sleep while *word == expected. Returns immediately if the value differs.
+inline long FutexWait(std::atomic<uint32_t> *word, uint32_t expected,
+                      bool private_futex) {
+  const int op = private_futex ? (FUTEX_WAIT | FUTEX_PRIVATE_FLAG) : FUTEX_WAIT;
+  return syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), op, expected,
+                 nullptr, nullptr, 0);
+}
+
+// Wake up to n_waiters waiters sleeping on word.
+inline long FutexWake(std::atomic<uint32_t> *word, int n_waiters,
+                      bool private_futex) {
+  const int op = private_futex ? (FUTEX_WAKE | FUTEX_PRIVATE_FLAG) : FUTEX_WAKE;
+  return syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), op, n_waiters,
+                 nullptr, nullptr, 0);
+}
+
+// Hint to the CPU that we are in a spin-wait loop.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
@@ -0,0 +1,83 @@
+#include "futex_latency.h"
+
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cstring>
+#include <format>
+#include <memory>
+
+#include "aklog.h"
+
+#include "common.h"
+#include "futex.h"
+#include "topology.h"
+#include "wakeup_latency.h"
+
+namespace {
+
+// Each side counts its flips in its own word and sleeps on the word of the
+// other side until it catches up, so the words need no reset between
+// iterations.
+struct FlipWords {
+  alignas(64) std::atomic<uint32_t> parent{0};
+  alignas(64) std::atomic<uint32_t> child{0};
+};
+
+class FutexEndpoint : public WakeupEndpoint {
+public:
+  FutexEndpoint(FlipWords *words, int peer, bool private_futex)
+      : send_word_(peer == PARENT_PEER ? &words->parent : &words->child),
+        receive_word_(peer == PARENT_PEER ? &words->child : &words->parent),
+        private_futex_(private_futex) {}
+
+  void Wake() override {
+    send_word_->store(send_word_->load() + 1);
+    FutexWake(send_word_, 1, private_futex_);
+  }
+
+  void Wait() override {
+    ++received_;
+    uint32_t value;
+    while ((value = receive_word_->load()) != received_) {
+      FutexWait(receive_word_, value, private_futex_);
+    }
+  }
+
+private:
+  std::atomic<uint32_t> *const send_word_;
+  std::atomic<uint32_t> *const receive_word_;
+  const bool private_futex_;
+  // Number of wake-ups received so far, the value to wait for
+  uint32_t received_ = 0;
+};
+
+} // namespace
+
+BenchmarkResult RunFutexLatencyBenchmark(int num_iterations, int num_warmups,
+                                         uint64_t loop_size) {
+  FlipWords words;
+  return RunWakeupLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, WakeupPeers::THREADS,
+      [&words](int peer) {
+        return std::make_unique<FutexEndpoint>(&words, peer, true);
+      });
+}
+
+BenchmarkResult RunFutexSharedLatencyBenchmark(int num_iterations,
+                                               int num_warmups,
+                                               uint64_t loop_size) {
+  void *mapped = mmap(nullptr, sizeof(FlipWords), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  AKCHECK(mapped != MAP_FAILED,
+          std::format("Failed to map futex words: {}", strerror(errno)));
+  FlipWords *words = new (mapped) FlipWords;
+
+  BenchmarkResult result = RunWakeupLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, WakeupPeers::PROCESSES,
+      [words](int peer) {
+        return std::make_unique<FutexEndpoint>(words, peer, false);
+      });
+  munmap(mapped, sizeof(FlipWords));
+  return result;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+#include "common.h"
+
+// Ping-pong with raw FUTEX_WAIT and FUTEX_WAKE between two threads, with
+// private futexes.
+BenchmarkResult RunFutexLatencyBenchmark(int num_iterations, int num_warmups,
+                                         uint64_t loop_size);
+
+// Ping-pong with raw FUTEX_WAIT and FUTEX_WAKE between a parent and a forked
+// child, with shared futexes in a shared anonymous mapping.
+BenchmarkResult RunFutexSharedLatencyBenchmark(int num_iterations,
+                                               int num_warmups,
+                                               uint64_t loop_size);
@@ -0,0 +1,23 @@
+#include "futex_latency.h"
+
+#include <cstdint>
+
+#include "aklog.h"
+
+int main(int argc, char *argv[]) {
+
+  constexpr int num_iterations = 3;
+  constexpr int num_warmups = 1;
+  constexpr uint64_t loop_size = 10;
+
+  const BenchmarkResult result =
+      RunFutexLatencyBenchmark(num_iterations, num_warmups, loop_size);
+  AKCHECK(result.average >= 0.0, "Latency should be non-negative");
+
+  const BenchmarkResult shared_result =
+      RunFutexSharedLatencyBenchmark(num_iterations, num_warmups, loop_size);
+  AKCHECK(shared_result.average >= 0.0, "Latency should be non-negative");
+  AKLOG(aklog::LogLevel::INFO, "futex_latency test passed");
+
+  return 0;
+}
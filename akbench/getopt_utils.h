@@ -1,15 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <cctype>
 #include <charconv>
 #include <cstdint>
 #include <format>
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 // Helper functions for parsing command line arguments with getopt_long
 
-// Parse a string to uint64_t
+// Parse a string to uint64_t. Sizes can have a binary suffix K, M, G or T,
+// e.g. "64K" for 65536, or be written as a shift like "1 << 30".
 inline std::optional<uint64_t> ParseUint64(const std::string &str) {
   if (str.empty()) {
     return std::nullopt;
@@ -22,6 +28,21 @@ inline std::optional<uint64_t> ParseUint64(const std::string &str) {
     return value;
   }
 
+  // Try to parse sizes like "64K" or "1G"
+  static const std::pair<char, int> suffixes[] = {
+      {'K', 10}, {'M', 20}, {'G', 30}, {'T', 40}};
+  for (const auto &[suffix, shift] : suffixes) {
+    if (str.size() < 2 || std::toupper(str.back()) != suffix) {
+      continue;
+    }
+    const char *end = str.data() + str.size() - 1;
+    auto [number_ptr, number_ec] = std::from_chars(str.data(), end, value);
+    if (number_ec == std::errc() && number_ptr == end &&
+        value <= (UINT64_MAX >> shift)) {
+      return value << shift;
+    }
+  }
+
   // Try to parse expressions like "1 << 30" for 1GB
   if (str.find("<<") != std::string::npos) {
     size_t pos = str.find("<<");
@@ -50,6 +71,58 @@ inline std::optional<uint64_t> ParseUint64(const std::string &str) {
   throw std::invalid_argument(std::format("Invalid uint64_t value: '{}'", str));
 }
 
+// Parse a single size or a geometric range "FIRST:LAST:xFACTOR" to the list
+// of sizes. For example "64:1G:x2" is 64, 128, 256, ..., 1G. FACTOR defaults to
+// 2 and may be fractional, e.g. "x1.5". LAST is included only if the
+// progression reaches it exactly.
+inline std::vector<uint64_t> ParseUint64Range(const std::string &str) {
+  const size_t first_colon = str.find(':');
+  if (first_colon == std::string::npos) {
+    return {ParseUint64(str).value()};
+  }
+
+  const size_t second_colon = str.find(':', first_colon + 1);
+  const std::optional<uint64_t> first =
+      ParseUint64(str.substr(0, first_colon));
+  const std::optional<uint64_t> last = ParseUint64(
+      str.substr(first_colon + 1, second_colon == std::string::npos
+                                      ? std::string::npos
+                                      : second_colon - first_colon - 1));
+  double factor = 2.0;
+  if (second_colon != std::string::npos) {
+    const std::string step = str.substr(second_colon + 1);
+    const auto invalid_step = [&] {
+      return std::invalid_argument(
+          std::format("Invalid range step: '{}', expected e.g. x2", step));
+    };
+    if (step.size() < 2 || step[0] != 'x') {
+      throw invalid_step();
+    }
+    auto [ptr, ec] =
+        std::from_chars(step.data() + 1, step.data() + step.size(), factor);
+    if (ec != std::errc() || ptr != step.data() + step.size()) {
+      throw invalid_step();
+    }
+  }
+  if (!first.has_value() || !last.has_value() || first.value() == 0 ||
+      first.value() > last.value() || factor <= 1.0) {
+    throw std::invalid_argument(std::format("Invalid range: '{}'", str));
+  }
+
+  std::vector<uint64_t> values;
+  uint64_t value = first.value();
+  while (value <= last.value()) {
+    values.push_back(value);
+    const double next = static_cast<double>(value) * factor;
+    if (next > static_cast<double>(last.value())) {
+      break;
+    }
+    // Round, but always make progress with small values and factors
+    value = std::max(static_cast<uint64_t>(next + 0.5), value + 1);
+  }
+  return values;
+}
+
 // Parse a string to int
 inline int ParseInt(const std::string &str) {
   if (str.empty()) {
@@ -66,6 +139,52 @@ inline int ParseInt(const std::string &str) {
   throw std::invalid_argument(std::format("Invalid int value: '{}'", str));
 }
 
+// Parse a fraction given either as a percentage like "2%" or as a plain
+// number like "0.02"
+inline double ParseFraction(const std::string &str) {
+  if (str.empty()) {
+    throw std::invalid_argument("Empty string cannot be parsed as fraction");
+  }
+
+  const bool is_percentage = str.back() == '%';
+  const size_t length = is_percentage ? str.size() - 1 : str.size();
+  double value;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + length, value);
+
+  if (ec == std::errc() && ptr == str.data() + length && length > 0) {
+    return is_percentage ? value / 100.0 : value;
+  }
+
+  throw std::invalid_argument(std::format("Invalid fraction value: '{}'", str));
+}
+
+// Parse a duration like "50ms" to seconds. Supported units are ns, us, ms and
+// s. A number without a unit is in seconds.
+inline double ParseDuration(const std::string &str) {
+  static const std::pair<const char *, double> units[] = {
+      {"ns", 1e-9}, {"us", 1e-6}, {"ms", 1e-3}, {"s", 1.0}};
+
+  size_t length = str.size();
+  double scale = 1.0;
+  for (const auto &[suffix, unit_scale] : units) {
+    const std::string_view suffix_view(suffix);
+    if (std::string_view(str).ends_with(suffix_view)) {
+      length -= suffix_view.size();
+      scale = unit_scale;
+      break;
+    }
+  }
+
+  double value;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + length, value);
+
+  if (ec == std::errc() && ptr == str.data() + length && length > 0) {
+    return value * scale;
+  }
+
+  throw std::invalid_argument(std::format("Invalid duration value: '{}'", str));
+}
+
 // Helper to print an error message and exit
 inline void PrintErrorAndExit(const std::string &program_name,
                               const std::string &error_msg) {
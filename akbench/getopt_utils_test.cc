@@ -0,0 +1,72 @@
+#include "getopt_utils.h"
+
+#include <functional>
+#include <print>
+
+#include "aklog.h"
+
+namespace {
+
+bool Throws(const std::function<void()> &f) {
+  try {
+    f();
+  } catch (const std::invalid_argument &) {
+    return true;
+  }
+  return false;
+}
+
+void testParseUint64() {
+  AKCHECK(ParseUint64("4096") == 4096, "4096 should be parsed");
+  AKCHECK(ParseUint64("64K") == 64 << 10, "64K should be parsed");
+  AKCHECK(ParseUint64("1m") == 1 << 20, "1m should be parsed");
+  AKCHECK(ParseUint64("1G") == 1ULL << 30, "1G should be parsed");
+  AKCHECK(ParseUint64("2T") == 2ULL << 40, "2T should be parsed");
+  AKCHECK(ParseUint64("1 << 30") == 1ULL << 30, "1 << 30 should be parsed");
+  AKCHECK(Throws([] { ParseUint64("K"); }), "K should be rejected");
+  AKCHECK(Throws([] { ParseUint64("1X"); }), "1X should be rejected");
+  AKCHECK(Throws([] { ParseUint64("20000000T"); }),
+          "Overflowing size should be rejected");
+  std::print("testParseUint64 passed\n");
+}
+
+void testParseUint64Range() {
+  AKCHECK(ParseUint64Range("1M") == std::vector<uint64_t>({1 << 20}),
+          "A single size should be a range of one");
+  AKCHECK(ParseUint64Range("64:1K:x2") ==
+              std::vector<uint64_t>({64, 128, 256, 512, 1024}),
+          "64:1K:x2 should be parsed");
+  AKCHECK(ParseUint64Range("1K:4K") ==
+              std::vector<uint64_t>({1024, 2048, 4096}),
+          "The factor should default to 2");
+  AKCHECK(ParseUint64Range("100:1000:x4") ==
+              std::vector<uint64_t>({100, 400}),
+          "LAST should only be included if it is reached");
+  AKCHECK(ParseUint64Range("1:3:x1.1") == std::vector<uint64_t>({1, 2, 3}),
+          "Small factors should still make progress");
+  AKCHECK(Throws([] { ParseUint64Range("1K:64"); }),
+          "Descending range should be rejected");
+  AKCHECK(Throws([] { ParseUint64Range("64:1K:x1"); }),
+          "Factor 1 should be rejected");
+  AKCHECK(Throws([] { ParseUint64Range("64:1K:+2"); }),
+          "Non-geometric step should be rejected");
+  AKCHECK(Throws([] { ParseUint64Range("64:1G:"); }),
+          "Empty step should be rejected");
+  AKCHECK(Throws([] { ParseUint64Range("64:1G:x"); }),
+          "Step without a factor should be rejected");
+  AKCHECK(Throws([] { ParseUint64Range("0:1K"); }),
+          "Range starting at 0 should be rejected");
+  std::print("testParseUint64Range passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running getopt_utils tests...\n");
+
+  testParseUint64();
+  testParseUint64Range();
+
+  std::print("All getopt_utils tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+
+#include "aklog.h"
+
+LatencyHistogram::LatencyHistogram() : counts_(NUM_BUCKETS, 0) {}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  total_count_ += other.total_count_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+  if (index < SUB_BUCKET_COUNT) {
+    return index;
+  }
+  const int shift = index / SUB_BUCKET_HALF_COUNT - 1;
+  const uint64_t top = index - shift * SUB_BUCKET_HALF_COUNT;
+  return ((top + 1) << shift) - 1;
+}
+
+uint64_t LatencyHistogram::ValueAtPercentile(double percentile) const {
+  AKCHECK(0.0 <= percentile && percentile <= 100.0,
+          std::format("percentile ({}) must be in [0, 100]", percentile));
+  if (total_count_ == 0) {
+    return 0;
+  }
+
+  const uint64_t target = std::clamp<uint64_t>(
+      static_cast<uint64_t>(std::ceil(percentile / 100.0 * total_count_)), 1,
+      total_count_);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+    cumulative += counts_[i];
+    if (cumulative >= target) {
+      return std::clamp(BucketUpperBound(i), min_, max_);
+    }
+  }
+  return max_;
+}
+
+LatencyPercentiles LatencyHistogram::Percentiles(double scale) const {
+  AKCHECK(total_count_ > 0, "Histogram must not be empty");
+  return LatencyPercentiles{
+      .min = min_ * scale,
+      .p50 = ValueAtPercentile(50.0) * scale,
+      .p90 = ValueAtPercentile(90.0) * scale,
+      .p99 = ValueAtPercentile(99.0) * scale,
+      .p999 = ValueAtPercentile(99.9) * scale,
+      .max = max_ * scale,
+  };
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common.h"
+
+// Log-bucketed histogram in the style of HdrHistogram. Values smaller than
+// SUB_BUCKET_COUNT are recorded exactly. Larger values share a bucket with
+// others that have the same SUB_BUCKET_BITS most significant bits, so the
+// relative error is below 1 / SUB_BUCKET_HALF_COUNT (about 1.6%).
+class LatencyHistogram {
+public:
+  LatencyHistogram();
+
+  void Record(uint64_t value) {
+    counts_[BucketIndex(value)]++;
+    total_count_++;
+    if (value < min_) {
+      min_ = value;
+    }
+    if (value > max_) {
+      max_ = value;
+    }
+  }
+
+  void Merge(const LatencyHistogram &other);
+  uint64_t Count() const { return total_count_; }
+  uint64_t Min() const { return min_; }
+  uint64_t Max() const { return max_; }
+
+  // Smallest bucket upper bound such that at least percentile% of the
+  // recorded values are less than or equal to it.
+  uint64_t ValueAtPercentile(double percentile) const;
+
+  // Summary of the recorded values, each multiplied by scale. For example,
+  // pass 1e-9 / 2 when recording round trips in nanoseconds to get one-trip
+  // latencies in seconds.
+  LatencyPercentiles Percentiles(double scale) const;
+
+private:
+  static constexpr int SUB_BUCKET_BITS = 7;
+  static constexpr uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+  static constexpr uint64_t SUB_BUCKET_HALF_COUNT = SUB_BUCKET_COUNT / 2;
+  static constexpr size_t NUM_BUCKETS =
+      (64 - SUB_BUCKET_BITS + 2) * SUB_BUCKET_HALF_COUNT;
+
+  static size_t BucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+      return value;
+    }
+    const int shift = std::bit_width(value) - SUB_BUCKET_BITS;
+    return shift * SUB_BUCKET_HALF_COUNT + (value >> shift);
+  }
+  static uint64_t BucketUpperBound(size_t index);
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_count_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+};
+
+// Records the time between consecutive calls to Tick() into a histogram in
+// nanoseconds. Tick() is a no-op when the histogram is nullptr so that the
+// same loop can run with and without per-operation timing.
+class LatencyRecorder {
+public:
+  explicit LatencyRecorder(LatencyHistogram *histogram)
+      : histogram_(histogram) {
+    if (histogram_ != nullptr) {
+      last_ = std::chrono::high_resolution_clock::now();
+    }
+  }
+
+  void Tick() {
+    if (histogram_ == nullptr) {
+      return;
+    }
+    const auto now = std::chrono::high_resolution_clock::now();
+    histogram_->Record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_)
+            .count());
+    last_ = now;
+  }
+
+private:
+  LatencyHistogram *histogram_;
+  std::chrono::high_resolution_clock::time_point last_;
+};
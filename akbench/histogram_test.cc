@@ -0,0 +1,88 @@
+#include "histogram.h"
+
+#include <cmath>
+#include <format>
+#include <print>
+
+#include "aklog.h"
+
+namespace {
+
+bool IsClose(double actual, double expected, double relative_error) {
+  return std::abs(actual - expected) <= expected * relative_error;
+}
+
+void testSmallValuesAreExact() {
+  LatencyHistogram histogram;
+  for (uint64_t v = 1; v <= 100; ++v) {
+    histogram.Record(v);
+  }
+  AKCHECK(histogram.Count() == 100, "Count should be 100");
+  AKCHECK(histogram.Min() == 1, "Min should be 1");
+  AKCHECK(histogram.Max() == 100, "Max should be 100");
+  AKCHECK(histogram.ValueAtPercentile(50.0) == 50,
+          std::format("p50 should be 50, got {}",
+                      histogram.ValueAtPercentile(50.0)));
+  AKCHECK(histogram.ValueAtPercentile(99.0) == 99,
+          std::format("p99 should be 99, got {}",
+                      histogram.ValueAtPercentile(99.0)));
+  AKCHECK(histogram.ValueAtPercentile(100.0) == 100, "p100 should be 100");
+  std::print("testSmallValuesAreExact passed\n");
+}
+
+void testLargeValuesWithinPrecision() {
+  LatencyHistogram histogram;
+  for (uint64_t v = 1; v <= 1000000; ++v) {
+    histogram.Record(v * 1000);
+  }
+  const double p50 = histogram.ValueAtPercentile(50.0);
+  const double p999 = histogram.ValueAtPercentile(99.9);
+  AKCHECK(IsClose(p50, 500000000.0, 0.02),
+          std::format("p50 should be close to 5e8, got {}", p50));
+  AKCHECK(IsClose(p999, 999000000.0, 0.02),
+          std::format("p99.9 should be close to 9.99e8, got {}", p999));
+  AKCHECK(histogram.Max() == 1000000000ULL, "Max should be exact");
+  std::print("testLargeValuesWithinPrecision passed\n");
+}
+
+void testTail() {
+  LatencyHistogram histogram;
+  for (int i = 0; i < 990; ++i) {
+    histogram.Record(100);
+  }
+  for (int i = 0; i < 10; ++i) {
+    histogram.Record(100000);
+  }
+  AKCHECK(histogram.ValueAtPercentile(50.0) == 100, "p50 should be 100");
+  AKCHECK(histogram.ValueAtPercentile(99.0) == 100, "p99 should be 100");
+  AKCHECK(IsClose(histogram.ValueAtPercentile(99.9), 100000.0, 0.02),
+          "p99.9 should be close to 100000");
+  std::print("testTail passed\n");
+}
+
+void testMergeAndPercentiles() {
+  LatencyHistogram a, b;
+  a.Record(10);
+  b.Record(30);
+  a.Merge(b);
+  AKCHECK(a.Count() == 2, "Merged count should be 2");
+  const LatencyPercentiles p = a.Percentiles(0.5);
+  AKCHECK(p.min == 5.0, std::format("Scaled min should be 5, got {}", p.min));
+  AKCHECK(p.max == 15.0, std::format("Scaled max should be 15, got {}", p.max));
+  AKCHECK(p.p50 == 5.0, std::format("Scaled p50 should be 5, got {}", p.p50));
+  std::print("testMergeAndPercentiles passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running histogram tests...\n");
+
+  testSmallValuesAreExact();
+  testLargeValuesWithinPrecision();
+  testTail();
+  testMergeAndPercentiles();
+
+  std::print("All histogram tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,265 @@
+#include "huge_pages.h"
+
+#include <linux/mman.h>
+#include <sys/mman.h>
+
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <sstream>
+
+#include "aklog.h"
+
+#include "getopt_utils.h"
+
+namespace {
+
+constexpr uint64_t HUGE_PAGE_SIZE_2M = 2ULL << 20;
+constexpr uint64_t HUGE_PAGE_SIZE_1G = 1ULL << 30;
+
+uint64_t HugePageBytes(PageSize page_size) {
+  return page_size == PageSize::HUGE_1G ? HUGE_PAGE_SIZE_1G
+                                        : HUGE_PAGE_SIZE_2M;
+}
+
+bool IsHugetlb(PageSize page_size) {
+  return page_size == PageSize::HUGE_2M || page_size == PageSize::HUGE_1G;
+}
+
+// Value of a line like "Hugepagesize:       2048 kB" in bytes
+std::optional<uint64_t> ParseKbField(const std::string &line,
+                                     const std::string &key) {
+  if (!line.starts_with(key + ":")) {
+    return std::nullopt;
+  }
+  std::istringstream stream(line.substr(key.size() + 1));
+  uint64_t value = 0;
+  std::string unit;
+  if (!(stream >> value >> unit) || unit != "kB") {
+    return std::nullopt;
+  }
+  return value << 10;
+}
+
+std::optional<uint64_t> DefaultHugePageSize(const std::string &meminfo_path) {
+  std::ifstream meminfo(meminfo_path);
+  std::string line;
+  while (std::getline(meminfo, line)) {
+    if (const auto value = ParseKbField(line, "Hugepagesize")) {
+      return value;
+    }
+  }
+  return std::nullopt;
+}
+
+} // namespace
+
+std::string PageSizeToString(PageSize page_size) {
+  switch (page_size) {
+  case PageSize::DEFAULT:
+    return "4k";
+  case PageSize::THP:
+    return "thp";
+  case PageSize::HUGE_2M:
+    return "2m";
+  case PageSize::HUGE_1G:
+    return "1g";
+  }
+  return "unknown";
+}
+
+std::optional<PageSize> StringToPageSize(const std::string &str) {
+  if (str == "4k") {
+    return PageSize::DEFAULT;
+  } else if (str == "thp") {
+    return PageSize::THP;
+  } else if (str == "2m") {
+    return PageSize::HUGE_2M;
+  } else if (str == "1g") {
+    return PageSize::HUGE_1G;
+  }
+  return std::nullopt;
+}
+
+uint64_t RoundUpToPageSize(uint64_t size, PageSize page_size) {
+  if (page_size == PageSize::DEFAULT) {
+    return size;
+  }
+  const uint64_t page_bytes = HugePageBytes(page_size);
+  return (size + page_bytes - 1) / page_bytes * page_bytes;
+}
+
+std::optional<PageBacking> GetPageBacking(const void *address,
+                                          const std::string &smaps_path) {
+  std::ifstream smaps(smaps_path);
+  if (!smaps) {
+    return std::nullopt;
+  }
+  const uintptr_t target = reinterpret_cast<uintptr_t>(address);
+  bool in_mapping = false;
+  std::optional<PageBacking> backing;
+  std::string line;
+  while (std::getline(smaps, line)) {
+    // A mapping starts with a line like "7f1c2a000000-7f1c6a000000 rw-p ...",
+    // followed by lines like "Rss:  1048576 kB".
+    uintptr_t start = 0;
+    uintptr_t end = 0;
+    char dash = 0;
+    std::istringstream header(line);
+    if (header >> std::hex >> start >> dash >> end && dash == '-') {
+      if (in_mapping) {
+        break;
+      }
+      in_mapping = start <= target && target < end;
+      if (in_mapping) {
+        backing = PageBacking{};
+      }
+      continue;
+    }
+    if (!in_mapping) {
+      continue;
+    }
+    const std::string key = line.substr(0, line.find(':'));
+    const std::optional<uint64_t> value = ParseKbField(line, key);
+    if (!value.has_value()) {
+      continue;
+    }
+    if (key == "KernelPageSize") {
+      backing->kernel_page_size = *value;
+    } else if (key == "Rss") {
+      backing->mapped_bytes += *value;
+    } else if (key == "Private_Hugetlb" || key == "Shared_Hugetlb") {
+      backing->mapped_bytes += *value;
+      backing->huge_bytes += *value;
+    } else if (key == "AnonHugePages" || key == "ShmemPmdMapped" ||
+               key == "FilePmdMapped") {
+      backing->huge_bytes += *value;
+    }
+  }
+  return backing;
+}
+
+void AddPageBackingMetrics(std::vector<std::pair<std::string, double>> &metrics,
+                           const std::string &prefix, const void *address,
+                           PageSize page_size) {
+  const std::optional<PageBacking> backing = GetPageBacking(address);
+  if (!backing.has_value()) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("Cannot read the page backing of {} from {}", prefix,
+                      PROC_SELF_SMAPS));
+    return;
+  }
+  const double huge_page_fraction =
+      backing->mapped_bytes == 0
+          ? 0.0
+          : static_cast<double>(backing->huge_bytes) / backing->mapped_bytes;
+  if (page_size != PageSize::DEFAULT && huge_page_fraction < 1.0) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("Only {:.1f}% of {} is backed by huge pages although "
+                      "--page-size={} was requested",
+                      huge_page_fraction * 100, prefix,
+                      PageSizeToString(page_size)));
+  }
+  metrics.emplace_back(prefix + "_kernel_page_size",
+                       static_cast<double>(backing->kernel_page_size));
+  metrics.emplace_back(prefix + "_huge_page_fraction", huge_page_fraction);
+}
+
+std::optional<std::string>
+FindHugetlbfsMount(PageSize page_size, const std::string &mounts_path,
+                   const std::string &meminfo_path) {
+  if (!IsHugetlb(page_size)) {
+    return std::nullopt;
+  }
+  std::ifstream mounts(mounts_path);
+  std::string line;
+  while (std::getline(mounts, line)) {
+    // e.g. "hugetlbfs /dev/hugepages hugetlbfs rw,relatime,pagesize=2M 0 0"
+    std::istringstream stream(line);
+    std::string device, mount_point, type, options;
+    if (!(stream >> device >> mount_point >> type >> options) ||
+        type != "hugetlbfs") {
+      continue;
+    }
+    std::optional<uint64_t> mount_page_size;
+    std::istringstream option_stream(options);
+    std::string option;
+    while (std::getline(option_stream, option, ',')) {
+      if (option.starts_with("pagesize=")) {
+        mount_page_size = ParseUint64(option.substr(strlen("pagesize=")));
+      }
+    }
+    if (!mount_page_size.has_value()) {
+      mount_page_size = DefaultHugePageSize(meminfo_path);
+    }
+    if (mount_page_size == HugePageBytes(page_size)) {
+      return mount_point;
+    }
+  }
+  return std::nullopt;
+}
+
+std::string HugePagePath(const std::string &path, PageSize page_size) {
+  if (!IsHugetlb(page_size)) {
+    return path;
+  }
+  const std::optional<std::string> mount = FindHugetlbfsMount(page_size);
+  if (!mount.has_value()) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("No hugetlbfs with {} pages is mounted. Using {}.",
+                      PageSizeToString(page_size), path));
+    return path;
+  }
+  return *mount + path.substr(path.rfind('/'));
+}
+
+void AdviseHugePages(void *address, uint64_t size, PageSize page_size) {
+  if (page_size == PageSize::THP &&
+      madvise(address, size, MADV_HUGEPAGE) == -1) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("madvise(MADV_HUGEPAGE): {}", strerror(errno)));
+  }
+}
+
+PageBuffer::PageBuffer(uint64_t size, PageSize page_size)
+    : size_(size), mapped_size_(RoundUpToPageSize(size, page_size)) {
+  void *addr = MAP_FAILED;
+  if (IsHugetlb(page_size)) {
+    const int huge_flag =
+        page_size == PageSize::HUGE_1G ? MAP_HUGE_1GB : MAP_HUGE_2MB;
+    addr = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | huge_flag, -1, 0);
+    if (addr == MAP_FAILED) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("mmap with {} hugetlb pages: {}. Using base pages.",
+                        PageSizeToString(page_size), strerror(errno)));
+      mapped_size_ = size;
+    }
+  }
+  if (addr == MAP_FAILED && page_size == PageSize::THP) {
+    // Align the buffer to a huge page so that all of it can be promoted.
+    const uint64_t reserved = mapped_size_ + HUGE_PAGE_SIZE_2M;
+    void *reservation = mmap(nullptr, reserved, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    AKCHECK(reservation != MAP_FAILED,
+            std::format("mmap: {}", strerror(errno)));
+    const uintptr_t start = reinterpret_cast<uintptr_t>(reservation);
+    const uintptr_t aligned =
+        (start + HUGE_PAGE_SIZE_2M - 1) / HUGE_PAGE_SIZE_2M * HUGE_PAGE_SIZE_2M;
+    if (aligned > start) {
+      munmap(reservation, aligned - start);
+    }
+    munmap(reinterpret_cast<void *>(aligned + mapped_size_),
+           start + reserved - aligned - mapped_size_);
+    addr = reinterpret_cast<void *>(aligned);
+    AdviseHugePages(addr, mapped_size_, page_size);
+  }
+  if (addr == MAP_FAILED) {
+    addr = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    AKCHECK(addr != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+  }
+  data_ = static_cast<uint8_t *>(addr);
+}
+
+PageBuffer::~PageBuffer() { munmap(data_, mapped_size_); }
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr const char *PROC_SELF_SMAPS = "/proc/self/smaps";
+constexpr const char *PROC_MOUNTS = "/proc/mounts";
+constexpr const char *PROC_MEMINFO = "/proc/meminfo";
+
+// Pages that back the buffers of a benchmark.
+//   DEFAULT:  Base pages, 4 KiB on most machines.
+//   THP:      Transparent huge pages requested with madvise(MADV_HUGEPAGE).
+//   HUGE_2M:  hugetlb pages of 2 MiB, with MAP_HUGETLB or on hugetlbfs.
+//   HUGE_1G:  hugetlb pages of 1 GiB, with MAP_HUGETLB or on hugetlbfs.
+enum class PageSize { DEFAULT, THP, HUGE_2M, HUGE_1G };
+
+// "4k", "thp", "2m" and "1g"
+std::string PageSizeToString(PageSize page_size);
+std::optional<PageSize> StringToPageSize(const std::string &str);
+
+// Size rounded up to whole huge pages, 2 MiB ones for THP. Unchanged for
+// DEFAULT.
+uint64_t RoundUpToPageSize(uint64_t size, PageSize page_size);
+
+// Where the pages of one mapping come from, from /proc/self/smaps.
+struct PageBacking {
+  // KernelPageSize in bytes. THP mappings keep the base page size here.
+  uint64_t kernel_page_size = 0;
+  // Resident bytes, including hugetlb pages
+  uint64_t mapped_bytes = 0;
+  // Resident bytes in huge pages, either hugetlb or THP
+  uint64_t huge_bytes = 0;
+};
+
+// Backing of the mapping that contains address, or std::nullopt when smaps
+// cannot be read.
+std::optional<PageBacking>
+GetPageBacking(const void *address,
+               const std::string &smaps_path = PROC_SELF_SMAPS);
+
+// Appends the backing of the mapping that contains address to metrics as
+// <prefix>_kernel_page_size and <prefix>_huge_page_fraction. Warns when huge
+// pages were requested but the mapping is not fully backed by them, so that
+// a fallback to base pages shows up in the results.
+void AddPageBackingMetrics(std::vector<std::pair<std::string, double>> &metrics,
+                           const std::string &prefix, const void *address,
+                           PageSize page_size);
+
+// Mount point of a hugetlbfs with pages of page_size, HUGE_2M or HUGE_1G.
+// Mounts without a pagesize option use the default huge page size of
+// meminfo_path.
+std::optional<std::string>
+FindHugetlbfsMount(PageSize page_size,
+                   const std::string &mounts_path = PROC_MOUNTS,
+                   const std::string &meminfo_path = PROC_MEMINFO);
+
+// Path for a file that is mapped shared with pages of page_size: path itself,
+// or a file of the same name on a hugetlbfs mount for HUGE_2M and HUGE_1G.
+// Falls back to path with a warning when there is no such mount.
+std::string HugePagePath(const std::string &path, PageSize page_size);
+
+// Asks for transparent huge pages on a mapping when page_size is THP.
+void AdviseHugePages(void *address, uint64_t size, PageSize page_size);
+
+// Anonymous memory backed by pages of page_size. When the kernel refuses
+// hugetlb pages, e.g. because none are reserved, base pages are used with a
+// warning.
+class PageBuffer {
+public:
+  PageBuffer(uint64_t size, PageSize page_size);
+  ~PageBuffer();
+  PageBuffer(const PageBuffer &) = delete;
+  PageBuffer &operator=(const PageBuffer &) = delete;
+
+  uint8_t *data() { return data_; }
+  const uint8_t *data() const { return data_; }
+  uint64_t size() const { return size_; }
+  std::span<uint8_t> span() { return {data_, size_}; }
+  std::span<const uint8_t> span() const { return {data_, size_}; }
+
+private:
+  uint8_t *data_;
+  uint64_t size_;
+  // Length of the mapping, size_ rounded up to whole pages
+  uint64_t mapped_size_;
+};
@@ -0,0 +1,148 @@
+#include "huge_pages.h"
+
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <unistd.h>
+
+#include "aklog.h"
+
+namespace {
+
+std::string WriteTemporaryFile(const std::string &name,
+                               const std::string &contents) {
+  const std::string path =
+      (std::filesystem::temp_directory_path() /
+       std::format("huge_pages_test_{}_{}", getpid(), name))
+          .string();
+  std::ofstream(path) << contents;
+  return path;
+}
+
+void testPageSizeConversion() {
+  for (const PageSize page_size : {PageSize::DEFAULT, PageSize::THP,
+                                   PageSize::HUGE_2M, PageSize::HUGE_1G}) {
+    AKCHECK(StringToPageSize(PageSizeToString(page_size)) == page_size,
+            std::format("Round trip failed for {}",
+                        PageSizeToString(page_size)));
+  }
+  AKCHECK(!StringToPageSize("8k").has_value(), "8k should be rejected");
+  AKCHECK(RoundUpToPageSize(1, PageSize::DEFAULT) == 1,
+          "DEFAULT should not round");
+  AKCHECK(RoundUpToPageSize(1, PageSize::THP) == (2 << 20),
+          "THP should round up to 2 MiB");
+  AKCHECK(RoundUpToPageSize((2 << 20) + 1, PageSize::HUGE_2M) == (4 << 20),
+          "2m should round up to 4 MiB");
+  AKCHECK(RoundUpToPageSize(1, PageSize::HUGE_1G) == (1 << 30),
+          "1g should round up to 1 GiB");
+  std::print("testPageSizeConversion passed\n");
+}
+
+void testGetPageBacking() {
+  const std::string smaps = WriteTemporaryFile(
+      "smaps", "1000-3000 rw-p 00000000 00:00 0\n"
+               "Rss:                   8 kB\n"
+               "KernelPageSize:        4 kB\n"
+               "AnonHugePages:         0 kB\n"
+               "7f0000000000-7f0000400000 rw-p 00000000 00:00 0\n"
+               "Size:               4096 kB\n"
+               "KernelPageSize:        4 kB\n"
+               "Rss:                4096 kB\n"
+               "AnonHugePages:      2048 kB\n"
+               "VmFlags: rd wr mr mw me ac hg\n"
+               "7f0000400000-7f0000800000 rw-s 00000000 00:0f 1 /mnt/huge/x\n"
+               "KernelPageSize:     2048 kB\n"
+               "Rss:                   0 kB\n"
+               "Shared_Hugetlb:     4096 kB\n");
+
+  const auto thp =
+      GetPageBacking(reinterpret_cast<void *>(0x7f0000001000), smaps);
+  AKCHECK(thp.has_value(), "THP mapping should be found");
+  AKCHECK(thp->kernel_page_size == 4096 && thp->mapped_bytes == (4 << 20) &&
+              thp->huge_bytes == (2 << 20),
+          std::format("Unexpected THP backing {} {} {}", thp->kernel_page_size,
+                      thp->mapped_bytes, thp->huge_bytes));
+
+  const auto hugetlb =
+      GetPageBacking(reinterpret_cast<void *>(0x7f0000400000), smaps);
+  AKCHECK(hugetlb.has_value(), "hugetlb mapping should be found");
+  AKCHECK(hugetlb->kernel_page_size == (2 << 20) &&
+              hugetlb->mapped_bytes == (4 << 20) &&
+              hugetlb->huge_bytes == (4 << 20),
+          "hugetlb mapping should be fully backed by huge pages");
+
+  AKCHECK(!GetPageBacking(reinterpret_cast<void *>(0x10), smaps).has_value(),
+          "Unmapped address should not be found");
+  AKCHECK(!GetPageBacking(nullptr, "/nonexistent").has_value(),
+          "Missing smaps should give nothing");
+  std::filesystem::remove(smaps);
+  std::print("testGetPageBacking passed\n");
+}
+
+void testFindHugetlbfsMount() {
+  const std::string mounts = WriteTemporaryFile(
+      "mounts", "proc /proc proc rw,nosuid 0 0\n"
+                "hugetlbfs /dev/hugepages hugetlbfs rw,relatime 0 0\n"
+                "none /mnt/huge1g hugetlbfs rw,relatime,pagesize=1024M 0 0\n");
+  const std::string meminfo =
+      WriteTemporaryFile("meminfo", "MemTotal:       16384 kB\n"
+                                    "Hugepagesize:       2048 kB\n");
+
+  AKCHECK(FindHugetlbfsMount(PageSize::HUGE_2M, mounts, meminfo) ==
+              "/dev/hugepages",
+          "Mount without pagesize should use the default huge page size");
+  AKCHECK(FindHugetlbfsMount(PageSize::HUGE_1G, mounts, meminfo) ==
+              "/mnt/huge1g",
+          "Mount with pagesize=1024M should be used for 1g");
+  AKCHECK(!FindHugetlbfsMount(PageSize::THP, mounts, meminfo).has_value(),
+          "THP does not use hugetlbfs");
+  AKCHECK(!FindHugetlbfsMount(PageSize::HUGE_2M, "/nonexistent", meminfo)
+               .has_value(),
+          "Missing mounts should give nothing");
+  std::filesystem::remove(mounts);
+  std::filesystem::remove(meminfo);
+  std::print("testFindHugetlbfsMount passed\n");
+}
+
+void testPageBuffer() {
+  // Huge pages may not be available here, so only check that every kind of
+  // buffer is usable and that its backing can be read.
+  for (const PageSize page_size : {PageSize::DEFAULT, PageSize::THP,
+                                   PageSize::HUGE_2M}) {
+    PageBuffer buffer((4 << 20) + 1, page_size);
+    std::memset(buffer.data(), 0xAB, buffer.size());
+    AKCHECK(buffer.span().size() == (4 << 20) + 1,
+            "Buffer size should be as requested");
+    AKCHECK(buffer.data()[buffer.size() - 1] == 0xAB,
+            "Buffer should be usable");
+    if (page_size == PageSize::THP) {
+      AKCHECK(reinterpret_cast<uintptr_t>(buffer.data()) % (2 << 20) == 0,
+              "THP buffer should be aligned to 2 MiB");
+    }
+    const auto backing = GetPageBacking(buffer.data());
+    AKCHECK(backing.has_value(), "Buffer should appear in smaps");
+    AKCHECK(backing->mapped_bytes > 0, "Touched buffer should be resident");
+    std::vector<std::pair<std::string, double>> metrics;
+    AddPageBackingMetrics(metrics, "buffer", buffer.data(), page_size);
+    AKCHECK(metrics.size() == 2 &&
+                metrics[0].first == "buffer_kernel_page_size",
+            "There should be two backing metrics");
+  }
+  std::print("testPageBuffer passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running huge_pages tests...\n");
+
+  testPageSizeConversion();
+  testGetPageBacking();
+  testFindHugetlbfsMount();
+  testPageBuffer();
+
+  std::print("All huge_pages tests passed!\n");
+  return 0;
+}
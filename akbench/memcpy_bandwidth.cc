@@ -1,6 +1,5 @@
 #include "memcpy_bandwidth.h"
 
-#include <algorithm>
 #include <chrono>
 #include <cstring>
 #include <format>
@@ -9,22 +8,32 @@
 #include "aklog.h"
 
 #include "common.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 BenchmarkResult RunMemcpyBandwidthBenchmark(int num_iterations, int num_warmups,
-                                            uint64_t data_size) {
-  std::vector<uint8_t> src = GenerateDataToSend(data_size);
-  std::vector<uint8_t> dst(data_size, 0);
+                                            uint64_t data_size,
+                                            PageSize page_size,
+                                            const MemcpyKernel &kernel) {
+  ScopedPeerAffinity affinity(PARENT_PEER);
+  PageBuffer src(data_size, page_size);
+  PageBuffer dst(data_size, page_size);
+  const std::span<const uint8_t> data = GenerateDataToSend(data_size);
+  std::memcpy(src.data(), data.data(), data_size);
   std::vector<double> durations;
+  PerfCounters counters(PARENT_PEER, num_warmups);
 
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
-    std::fill(dst.begin(), dst.end(), 0);
+    std::memset(dst.data(), 0, data_size);
+    counters.Start();
     const auto start = std::chrono::high_resolution_clock::now();
-    std::memcpy(dst.data(), src.data(), data_size);
+    kernel.copy(dst.data(), src.data(), data_size);
     const auto end = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
-    AKCHECK(VerifyDataReceived(src, data_size),
-            "Data verification failed before memcpy.");
+    AKCHECK(VerifyDataReceived(dst.span(), data_size),
+            std::format("Data verification failed after {}.", kernel.name));
     if (num_warmups <= iteration) {
       const double duration =
           std::chrono::duration<double>(end - start).count();
@@ -34,9 +43,12 @@ BenchmarkResult RunMemcpyBandwidthBenchmark(int num_iterations, int num_warmups,
 
   BenchmarkResult result =
       CalculateBandwidth(durations, num_iterations, data_size);
+  AddPageBackingMetrics(result.metrics, "src", src.data(), page_size);
+  AddPageBackingMetrics(result.metrics, "dst", dst.data(), page_size);
   AKLOG(aklog::LogLevel::INFO,
-        std::format("Bandwidth: {:.3f} ± {:.3f}{}", result.average / (1 << 30),
-                    result.stddev / (1 << 30), GIBYTE_PER_SEC_UNIT));
+        std::format("{} bandwidth: {:.3f} ± {:.3f}{}", kernel.name,
+                    result.average / (1 << 30), result.stddev / (1 << 30),
+                    GIBYTE_PER_SEC_UNIT));
 
   return result;
 }
@@ -1,7 +1,13 @@
 #pragma once
 
 #include "common.h"
+#include "huge_pages.h"
+#include "memcpy_kernels.h"
 #include <cstdint>
 
-BenchmarkResult RunMemcpyBandwidthBenchmark(int num_iterations, int num_warmups,
-                                            uint64_t data_size);
+// Copies between two buffers backed by pages of page_size with kernel. Reports
+// the backing actually obtained as metrics.
+BenchmarkResult RunMemcpyBandwidthBenchmark(
+    int num_iterations, int num_warmups, uint64_t data_size,
+    PageSize page_size = PageSize::DEFAULT,
+    const MemcpyKernel &kernel = DefaultMemcpyKernel());
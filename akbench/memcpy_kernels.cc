@@ -0,0 +1,187 @@
+#include "memcpy_kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+bool Always() { return true; }
+
+void CopyGlibc(void *dst, const void *src, size_t size) {
+  std::memcpy(dst, src, size);
+}
+
+void CopyStd(void *dst, const void *src, size_t size) {
+  const uint8_t *s = static_cast<const uint8_t *>(src);
+  std::copy(s, s + size, static_cast<uint8_t *>(dst));
+}
+
+void CopyNaive(void *dst, const void *src, size_t size) {
+  uint8_t *d = static_cast<uint8_t *>(dst);
+  const uint8_t *s = static_cast<const uint8_t *>(src);
+  for (size_t i = 0; i < size; ++i) {
+    d[i] = s[i];
+    // Keeps the compiler from turning the loop into memcpy or vectorizing it
+    asm volatile("" ::: "memory");
+  }
+}
+
+#if defined(__x86_64__)
+
+// Number of bytes from p to the next multiple of alignment, at most size
+size_t BytesToAlignment(const uint8_t *p, size_t alignment, size_t size) {
+  return std::min(
+      size, (alignment - reinterpret_cast<uintptr_t>(p) % alignment) %
+                alignment);
+}
+
+bool HasErms() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (ebx >> 9) & 1;
+}
+
+bool HasAvx2() { return __builtin_cpu_supports("avx2"); }
+
+bool HasAvx512() { return __builtin_cpu_supports("avx512f"); }
+
+void CopyErms(void *dst, const void *src, size_t size) {
+  asm volatile("rep movsb" : "+D"(dst), "+S"(src), "+c"(size) : : "memory");
+}
+
+__attribute__((target("avx2"))) void CopyAvx2(void *dst, const void *src,
+                                              size_t size) {
+  uint8_t *d = static_cast<uint8_t *>(dst);
+  const uint8_t *s = static_cast<const uint8_t *>(src);
+  for (; size >= 4 * sizeof(__m256i); size -= 4 * sizeof(__m256i)) {
+    const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+    const __m256i v1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32));
+    const __m256i v2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 64));
+    const __m256i v3 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 96));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), v0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 32), v1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 64), v2);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 96), v3);
+    d += 4 * sizeof(__m256i);
+    s += 4 * sizeof(__m256i);
+  }
+  std::memcpy(d, s, size);
+}
+
+// Non-temporal stores need an aligned destination, so the bytes up to the
+// first 32-byte boundary of dst are copied with memcpy. The same goes for
+// CopyAvx512Nt with 64 bytes.
+__attribute__((target("avx2"))) void CopyAvx2Nt(void *dst, const void *src,
+                                                size_t size) {
+  uint8_t *d = static_cast<uint8_t *>(dst);
+  const uint8_t *s = static_cast<const uint8_t *>(src);
+  const size_t head = BytesToAlignment(d, sizeof(__m256i), size);
+  std::memcpy(d, s, head);
+  d += head;
+  s += head;
+  size -= head;
+  for (; size >= 4 * sizeof(__m256i); size -= 4 * sizeof(__m256i)) {
+    const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+    const __m256i v1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32));
+    const __m256i v2 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 64));
+    const __m256i v3 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 96));
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(d), v0);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(d + 32), v1);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(d + 64), v2);
+    _mm256_stream_si256(reinterpret_cast<__m256i *>(d + 96), v3);
+    d += 4 * sizeof(__m256i);
+    s += 4 * sizeof(__m256i);
+  }
+  _mm_sfence();
+  std::memcpy(d, s, size);
+}
+
+__attribute__((target("avx512f"))) void CopyAvx512(void *dst, const void *src,
+                                                   size_t size) {
+  uint8_t *d = static_cast<uint8_t *>(dst);
+  const uint8_t *s = static_cast<const uint8_t *>(src);
+  for (; size >= 4 * sizeof(__m512i); size -= 4 * sizeof(__m512i)) {
+    const __m512i v0 = _mm512_loadu_si512(s);
+    const __m512i v1 = _mm512_loadu_si512(s + 64);
+    const __m512i v2 = _mm512_loadu_si512(s + 128);
+    const __m512i v3 = _mm512_loadu_si512(s + 192);
+    _mm512_storeu_si512(d, v0);
+    _mm512_storeu_si512(d + 64, v1);
+    _mm512_storeu_si512(d + 128, v2);
+    _mm512_storeu_si512(d + 192, v3);
+    d += 4 * sizeof(__m512i);
+    s += 4 * sizeof(__m512i);
+  }
+  std::memcpy(d, s, size);
+}
+
+__attribute__((target("avx512f"))) void CopyAvx512Nt(void *dst,
+                                                     const void *src,
+                                                     size_t size) {
+  uint8_t *d = static_cast<uint8_t *>(dst);
+  const uint8_t *s = static_cast<const uint8_t *>(src);
+  const size_t head = BytesToAlignment(d, sizeof(__m512i), size);
+  std::memcpy(d, s, head);
+  d += head;
+  s += head;
+  size -= head;
+  for (; size >= 4 * sizeof(__m512i); size -= 4 * sizeof(__m512i)) {
+    const __m512i v0 = _mm512_loadu_si512(s);
+    const __m512i v1 = _mm512_loadu_si512(s + 64);
+    const __m512i v2 = _mm512_loadu_si512(s + 128);
+    const __m512i v3 = _mm512_loadu_si512(s + 192);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(d), v0);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(d + 64), v1);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(d + 128), v2);
+    _mm512_stream_si512(reinterpret_cast<__m512i *>(d + 192), v3);
+    d += 4 * sizeof(__m512i);
+    s += 4 * sizeof(__m512i);
+  }
+  _mm_sfence();
+  std::memcpy(d, s, size);
+}
+
+#endif
+
+} // namespace
+
+const std::vector<MemcpyKernel> &MemcpyKernels() {
+  static const std::vector<MemcpyKernel> kernels = {
+      {"glibc", "std::memcpy", CopyGlibc, Always},
+      {"std-copy", "std::copy", CopyStd, Always},
+      {"naive", "Byte loop", CopyNaive, Always},
+#if defined(__x86_64__)
+      {"erms", "rep movsb", CopyErms, HasErms},
+      {"avx2", "AVX2 loads and stores", CopyAvx2, HasAvx2},
+      {"avx2-nt", "AVX2 non-temporal stores", CopyAvx2Nt, HasAvx2},
+      {"avx512", "AVX-512 loads and stores", CopyAvx512, HasAvx512},
+      {"avx512-nt", "AVX-512 non-temporal stores", CopyAvx512Nt, HasAvx512},
+#endif
+  };
+  return kernels;
+}
+
+const MemcpyKernel *FindMemcpyKernel(const std::string &name) {
+  for (const MemcpyKernel &kernel : MemcpyKernels()) {
+    if (kernel.name == name) {
+      return &kernel;
+    }
+  }
+  return nullptr;
+}
+
+const MemcpyKernel &DefaultMemcpyKernel() { return MemcpyKernels().front(); }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// A routine that copies size bytes from src to dst, which do not overlap.
+struct MemcpyKernel {
+  std::string name;
+  std::string description;
+  void (*copy)(void *dst, const void *src, size_t size);
+  // Whether this CPU can run the kernel, from CPUID
+  bool (*is_supported)();
+};
+
+// All kernels built for this architecture, glibc first. Kernels that need
+// non-temporal stores end with -nt and finish with sfence, so that the data
+// is globally visible when copy returns.
+//   glibc:     std::memcpy
+//   std-copy:  std::copy
+//   naive:     One byte per iteration, not turned into a call to memcpy
+//   erms:      rep movsb, fast with Enhanced REP MOVSB (x86-64)
+//   avx2:      32-byte loads and stores (x86-64)
+//   avx2-nt:   32-byte loads and non-temporal stores (x86-64)
+//   avx512:    64-byte loads and stores (x86-64)
+//   avx512-nt: 64-byte loads and non-temporal stores (x86-64)
+const std::vector<MemcpyKernel> &MemcpyKernels();
+
+// The kernel named name, or nullptr if there is none
+const MemcpyKernel *FindMemcpyKernel(const std::string &name);
+
+// glibc, which the memcpy benchmarks use by default
+const MemcpyKernel &DefaultMemcpyKernel();
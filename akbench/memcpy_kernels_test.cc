@@ -0,0 +1,66 @@
+#include "memcpy_kernels.h"
+
+#include <cstdint>
+#include <format>
+#include <print>
+#include <vector>
+
+#include "aklog.h"
+
+namespace {
+
+void testKernelsCopy() {
+  std::vector<uint8_t> src(4096 + 64);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<uint8_t>(i * 131 + 7);
+  }
+  for (const MemcpyKernel &kernel : MemcpyKernels()) {
+    if (!kernel.is_supported()) {
+      std::print("Skipping {}: not supported by this CPU\n", kernel.name);
+      continue;
+    }
+    // Misaligned ends and sizes around the vector widths
+    for (size_t dst_offset : {0, 1, 31, 33}) {
+      for (size_t src_offset : {0, 3}) {
+        for (size_t size : {0, 1, 63, 64, 255, 256, 257, 4000}) {
+          std::vector<uint8_t> dst(src.size(), 0xaa);
+          kernel.copy(dst.data() + dst_offset, src.data() + src_offset, size);
+          for (size_t i = 0; i < dst.size(); ++i) {
+            const bool copied = dst_offset <= i && i < dst_offset + size;
+            const uint8_t expected =
+                copied ? src[i - dst_offset + src_offset] : 0xaa;
+            AKCHECK(dst[i] == expected,
+                    std::format("{}: byte {} wrong for size {}, dst offset {}, "
+                                "src offset {}",
+                                kernel.name, i, size, dst_offset, src_offset));
+          }
+        }
+      }
+    }
+  }
+  std::print("testKernelsCopy passed\n");
+}
+
+void testFindMemcpyKernel() {
+  AKCHECK(DefaultMemcpyKernel().name == "glibc", "glibc should be the default");
+  AKCHECK(DefaultMemcpyKernel().is_supported(),
+          "The default should always be supported");
+  for (const MemcpyKernel &kernel : MemcpyKernels()) {
+    AKCHECK(FindMemcpyKernel(kernel.name) == &kernel,
+            std::format("{} should be found", kernel.name));
+  }
+  AKCHECK(FindMemcpyKernel("all") == nullptr, "all should not be a kernel");
+  std::print("testFindMemcpyKernel passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running memcpy kernel tests...\n");
+
+  testKernelsCopy();
+  testFindMemcpyKernel();
+
+  std::print("All memcpy kernel tests passed!\n");
+  return 0;
+}
@@ -4,47 +4,55 @@
 #include <chrono>
 #include <cstring>
 #include <format>
-#include <thread>
+#include <numeric>
 #include <vector>
 
 #include "aklog.h"
 
 #include "common.h"
+#include "worker_pool.h"
 
 BenchmarkResult MemcpyInMultiThread(uint64_t n_threads, int num_warmups,
-                                    int num_iterations, uint64_t data_size) {
-  std::vector<uint8_t> src = GenerateDataToSend(data_size);
-  std::vector<uint8_t> dst(data_size, 0x00);
+                                    int num_iterations, uint64_t data_size,
+                                    PageSize page_size,
+                                    const MemcpyKernel &kernel) {
+  PageBuffer src(data_size, page_size);
+  PageBuffer dst(data_size, page_size);
+  const std::span<const uint8_t> data = GenerateDataToSend(data_size);
+  std::memcpy(src.data(), data.data(), data_size);
   uint64_t chunk_size = data_size / n_threads;
 
   auto copy_chunk = [&](uint64_t thread_id) {
     uint64_t start = thread_id * chunk_size;
     uint64_t end =
         (thread_id == n_threads - 1) ? data_size : start + chunk_size;
-    std::memcpy(dst.data() + start, src.data() + start, end - start);
+    kernel.copy(dst.data() + start, src.data() + start, end - start);
   };
+  WorkerPool pool(n_threads, copy_chunk, /*pin_workers=*/true);
 
   std::vector<double> durations;
-  for (size_t i = 0; i < num_warmups + num_iterations; ++i) {
-    std::fill(dst.begin(), dst.end(), 0x00);
+  std::vector<double> thread_durations(n_threads, 0.0);
+  double imbalance = 0.0;
+  for (int i = 0; i < num_warmups + num_iterations; ++i) {
+    std::memset(dst.data(), 0x00, data_size);
 
-    auto start = std::chrono::high_resolution_clock::now();
-    std::vector<std::thread> threads;
-    for (uint64_t j = 0; j < n_threads; ++j) {
-      threads.emplace_back(copy_chunk, j);
-    }
-    for (auto &t : threads) {
-      t.join();
-    }
-    auto end = std::chrono::high_resolution_clock::now();
+    const WorkerPoolTimes times = pool.Run();
 
     if (num_warmups <= i) {
-      const double duration =
-          std::chrono::duration<double>(end - start).count();
-      durations.push_back(duration);
+      durations.push_back(times.total);
+      for (uint64_t j = 0; j < n_threads; ++j) {
+        thread_durations[j] += times.per_worker[j] / num_iterations;
+      }
+      const double slowest =
+          *std::max_element(times.per_worker.begin(), times.per_worker.end());
+      const double mean =
+          std::accumulate(times.per_worker.begin(), times.per_worker.end(),
+                          0.0) /
+          n_threads;
+      imbalance += slowest / mean / num_iterations;
 
       // Verify copied data
-      if (!VerifyDataReceived(dst, data_size)) {
+      if (!VerifyDataReceived(dst.span(), data_size)) {
         AKLOG(aklog::LogLevel::ERROR,
               std::format("Data verification failed for iteration {}",
                           i - num_warmups + 1));
@@ -58,10 +66,18 @@ BenchmarkResult MemcpyInMultiThread(uint64_t n_threads, int num_warmups,
 
   BenchmarkResult result =
       CalculateBandwidth(durations, num_iterations, data_size);
+  for (uint64_t j = 0; j < n_threads; ++j) {
+    result.metrics.emplace_back(std::format("thread_{}_copy_time", j),
+                                thread_durations[j]);
+  }
+  // Slowest thread over the mean of all threads, 1.0 when balanced
+  result.metrics.emplace_back("thread_imbalance", imbalance);
+  AddPageBackingMetrics(result.metrics, "src", src.data(), page_size);
+  AddPageBackingMetrics(result.metrics, "dst", dst.data(), page_size);
   AKLOG(aklog::LogLevel::INFO,
-        std::format("{} threads bandwidth: {:.3f} ± {:.3f}{}.", n_threads,
-                    result.average / (1 << 30), result.stddev / (1 << 30),
-                    GIBYTE_PER_SEC_UNIT));
+        std::format("{} threads {} bandwidth: {:.3f} ± {:.3f}{}.", n_threads,
+                    kernel.name, result.average / (1 << 30),
+                    result.stddev / (1 << 30), GIBYTE_PER_SEC_UNIT));
 
   return result;
 }
@@ -69,13 +85,16 @@ BenchmarkResult MemcpyInMultiThread(uint64_t n_threads, int num_warmups,
 BenchmarkResult RunMemcpyMtBandwidthBenchmark(int num_iterations,
                                               int num_warmups,
                                               uint64_t data_size,
-                                              uint64_t num_threads) {
+                                              uint64_t num_threads,
+                                              PageSize page_size,
+                                              const MemcpyKernel &kernel) {
   AKLOG(aklog::LogLevel::DEBUG,
         std::format(
             "Starting multi-threaded memcpy bandwidth test with {} threads...",
             num_threads));
   BenchmarkResult result =
-      MemcpyInMultiThread(num_threads, num_warmups, num_iterations, data_size);
+      MemcpyInMultiThread(num_threads, num_warmups, num_iterations, data_size,
+                          page_size, kernel);
 
   return result;
 }
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "common.h"
+#include "huge_pages.h"
+#include "memcpy_kernels.h"
 #include <cstdint>
 
-BenchmarkResult RunMemcpyMtBandwidthBenchmark(int num_iterations,
-                                              int num_warmups,
-                                              uint64_t data_size,
-                                              uint64_t num_threads);
+// Copies with kernel, each of num_threads threads taking a contiguous chunk.
+BenchmarkResult RunMemcpyMtBandwidthBenchmark(
+    int num_iterations, int num_warmups, uint64_t data_size,
+    uint64_t num_threads, PageSize page_size = PageSize::DEFAULT,
+    const MemcpyKernel &kernel = DefaultMemcpyKernel());
@@ -0,0 +1,84 @@
+#include "memcpy_numa_bandwidth.h"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <vector>
+
+#include "aklog.h"
+
+#include "common.h"
+#include "numa.h"
+#include "topology.h"
+#include "worker_pool.h"
+
+namespace {
+
+BenchmarkResult MemcpyBetweenNodes(int num_iterations, int num_warmups,
+                                   uint64_t data_size, uint64_t num_threads,
+                                   int src_node, int dst_node) {
+  NumaBuffer src(data_size, src_node);
+  NumaBuffer dst(data_size, dst_node);
+  const std::span<const uint8_t> data = GenerateDataToSend(data_size);
+  std::memcpy(src.data(), data.data(), data_size);
+
+  const uint64_t chunk_size = data_size / num_threads;
+  auto copy_chunk = [&](uint64_t thread_id) {
+    const uint64_t start = thread_id * chunk_size;
+    const uint64_t end =
+        (thread_id == num_threads - 1) ? data_size : start + chunk_size;
+    std::memcpy(dst.data() + start, src.data() + start, end - start);
+  };
+
+  // Workers inherit the CPU affinity of the caller.
+  WorkerPool pool(num_threads, copy_chunk, /*pin_workers=*/false);
+
+  std::vector<double> durations;
+  for (int i = 0; i < num_warmups + num_iterations; ++i) {
+    std::fill(dst.data(), dst.data() + data_size, 0x00);
+
+    const WorkerPoolTimes times = pool.Run();
+
+    if (num_warmups <= i) {
+      durations.push_back(times.total);
+      AKCHECK(VerifyDataReceived(dst.span(), data_size),
+              std::format("Data verification failed for iteration {}",
+                          i - num_warmups + 1));
+    }
+  }
+
+  return CalculateBandwidth(durations, num_iterations, data_size);
+}
+
+} // namespace
+
+BenchmarkMatrix
+RunMemcpyNumaBandwidthBenchmark(int num_iterations, int num_warmups,
+                                uint64_t data_size, uint64_t num_threads,
+                                const std::optional<int> &cpu_node,
+                                const std::vector<int> &nodes) {
+  BenchmarkMatrix matrix{
+      .labels = nodes,
+      .values = std::vector<std::vector<std::optional<double>>>(
+          nodes.size(), std::vector<std::optional<double>>(nodes.size())),
+  };
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const std::vector<int> cpus = GetNumaNodeCpus(cpu_node.value_or(nodes[i]));
+    std::optional<ScopedCpuAffinity> affinity;
+    if (!cpus.empty()) {
+      affinity.emplace(cpus);
+    }
+
+    for (size_t j = 0; j < nodes.size(); ++j) {
+      const BenchmarkResult result =
+          MemcpyBetweenNodes(num_iterations, num_warmups, data_size,
+                             num_threads, nodes[i], nodes[j]);
+      matrix.values[i][j] = result.average;
+      AKLOG(aklog::LogLevel::INFO,
+            std::format("Node {} -> node {}: {:.3f} ± {:.3f}{}", nodes[i],
+                        nodes[j], result.average / (1 << 30),
+                        result.stddev / (1 << 30), GIBYTE_PER_SEC_UNIT));
+    }
+  }
+  return matrix;
+}
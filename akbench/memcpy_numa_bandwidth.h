@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "common.h"
+
+// memcpy bandwidth in Byte/sec from a source buffer bound to NUMA node
+// nodes[i] to a destination buffer bound to nodes[j], for every pair (i, j).
+// The copy is split among num_threads threads that run on the CPUs of
+// cpu_node, or of the source node when cpu_node is std::nullopt.
+BenchmarkMatrix
+RunMemcpyNumaBandwidthBenchmark(int num_iterations, int num_warmups,
+                                uint64_t data_size, uint64_t num_threads,
+                                const std::optional<int> &cpu_node,
+                                const std::vector<int> &nodes);
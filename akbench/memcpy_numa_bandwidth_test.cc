@@ -0,0 +1,30 @@
+#include "memcpy_numa_bandwidth.h"
+
+#include <cstdint>
+#include <format>
+
+#include "aklog.h"
+#include "numa.h"
+
+int main(int argc, char *argv[]) {
+  constexpr int num_iterations = 3;
+  constexpr int num_warmups = 1;
+  constexpr uint64_t data_size = 1 << 20;
+  constexpr uint64_t num_threads = 2;
+
+  const std::vector<int> nodes = GetNumaNodes();
+  const BenchmarkMatrix matrix = RunMemcpyNumaBandwidthBenchmark(
+      num_iterations, num_warmups, data_size, num_threads, std::nullopt, nodes);
+
+  AKCHECK(matrix.values.size() == nodes.size(),
+          std::format("Matrix should have {} rows", nodes.size()));
+  for (const auto &row : matrix.values) {
+    for (const auto &value : row) {
+      AKCHECK(value.has_value() && value.value() > 0.0,
+              "Bandwidth should be positive");
+    }
+  }
+  AKLOG(aklog::LogLevel::INFO, "memcpy_numa_bandwidth test passed");
+
+  return 0;
+}
@@ -0,0 +1,230 @@
+#include "memfd_bandwidth.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <string>
+#include <vector>
+
+#include "aklog.h"
+
+#include "barrier.h"
+#include "common.h"
+#include "perf_counters.h"
+#include "topology.h"
+
+namespace {
+
+const std::string BARRIER_ID = GenerateUniqueName("/memfd_benchmark");
+
+// The receiver can rely on the contents and the size of a memfd with these
+// seals staying as they are while it reads it.
+constexpr int REQUIRED_SEALS =
+    F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+// Sends fd and the length of its contents in one message.
+void SendFd(int sock, int fd, uint64_t length) {
+  iovec iov = {.iov_base = &length, .iov_len = sizeof(length)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  if (sendmsg(sock, &msg, 0) != sizeof(length)) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("sendmsg(SCM_RIGHTS): {}", strerror(errno)));
+  }
+}
+
+// Receives a message of SendFd and returns the fd. Its length goes to length.
+int ReceiveFd(int sock, uint64_t *length) {
+  iovec iov = {.iov_base = length, .iov_len = sizeof(*length)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  const ssize_t received = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (received != sizeof(*length)) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("recvmsg(SCM_RIGHTS): {}",
+                      received == -1 ? strerror(errno) : "short message"));
+  }
+  const cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS || (msg.msg_flags & MSG_CTRUNC)) {
+    AKLOG(aklog::LogLevel::FATAL, "recvmsg(SCM_RIGHTS): no file descriptor");
+  }
+  int fd = -1;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return fd;
+}
+
+BenchmarkResult ReceiveProcess(int sock, int num_warmups, int num_iterations,
+                               uint64_t data_size) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+  std::vector<double> durations;
+
+  PerfCounters counters(PARENT_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    bool is_warmup = iteration < num_warmups;
+
+    StreamingVerifier verifier(data_size);
+    barrier.Wait();
+    uint64_t bytes_received = 0;
+    counters.Start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    while (bytes_received < data_size) {
+      uint64_t length = 0;
+      const int fd = ReceiveFd(sock, &length);
+      if ((fcntl(fd, F_GET_SEALS) & REQUIRED_SEALS) != REQUIRED_SEALS) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("{}Received a memfd without the write seals",
+                          ReceivePrefix(iteration)));
+      }
+      // Map the pages in here, so that the checksum, which is left out of the
+      // time below, does not take the page faults with it.
+      void *mapped = mmap(nullptr, length, PROT_READ,
+                          MAP_SHARED | MAP_POPULATE, fd, 0);
+      if (mapped == MAP_FAILED) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("mmap memfd: {}", strerror(errno)));
+      }
+      verifier.Update({static_cast<const uint8_t *>(mapped), length});
+      munmap(mapped, length);
+      close(fd);
+      bytes_received += length;
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
+    barrier.Wait();
+
+    if (!is_warmup) {
+      std::chrono::duration<double> elapsed_time =
+          end_time - start_time - verifier.update_time();
+      durations.push_back(elapsed_time.count());
+
+      AKLOG(aklog::LogLevel::DEBUG,
+            std::format("{}Time taken: {} ms.", ReceivePrefix(iteration),
+                        elapsed_time.count() * 1000));
+    }
+
+    // Verify received data (always, even during warmup)
+    if (!verifier.Verify()) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("{}Data verification failed!",
+                                                ReceivePrefix(iteration)));
+    } else {
+      AKLOG(aklog::LogLevel::DEBUG, std::format("{}Data verification passed.",
+                                                ReceivePrefix(iteration)));
+    }
+  }
+
+  BenchmarkResult result =
+      CalculateBandwidth(durations, num_iterations, data_size);
+  AKLOG(aklog::LogLevel::INFO,
+        std::format("Receive bandwidth: {:.3f} ± {:.3f}{}.",
+                    result.average / (1 << 30), result.stddev / (1 << 30),
+                    GIBYTE_PER_SEC_UNIT));
+
+  return result;
+}
+
+void SendProcess(int sock, int num_warmups, int num_iterations,
+                 uint64_t data_size, uint64_t buffer_size) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
+
+  PerfCounters counters(CHILD_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    barrier.Wait();
+    uint64_t bytes_sent = 0;
+    counters.Start();
+    while (bytes_sent < data_size) {
+      const uint64_t size_to_send =
+          std::min(data_size - bytes_sent, buffer_size);
+      const int fd = memfd_create("akbench", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+      if (fd == -1) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("memfd_create: {}", strerror(errno)));
+      }
+      // write() rather than a mapping, which would keep F_SEAL_WRITE from
+      // being added until it is unmapped.
+      for (uint64_t written = 0; written < size_to_send;) {
+        const ssize_t n = write(fd, data_to_send.data() + bytes_sent + written,
+                                size_to_send - written);
+        if (n == -1) {
+          AKLOG(aklog::LogLevel::FATAL,
+                std::format("write memfd: {}", strerror(errno)));
+        }
+        written += n;
+      }
+      if (fcntl(fd, F_ADD_SEALS, REQUIRED_SEALS) == -1) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("fcntl(F_ADD_SEALS): {}", strerror(errno)));
+      }
+      SendFd(sock, fd, size_to_send);
+      close(fd);
+      bytes_sent += size_to_send;
+    }
+    counters.Stop();
+    barrier.Wait();
+  }
+}
+
+} // namespace
+
+BenchmarkResult RunMemfdBandwidthBenchmark(int num_iterations, int num_warmups,
+                                           uint64_t data_size,
+                                           uint64_t buffer_size) {
+  SenseReversingBarrier::ClearResource(BARRIER_ID);
+
+  // SOCK_SEQPACKET keeps each fd with the length of its contents.
+  int socks[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, socks) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("socketpair: {}", strerror(errno)));
+  }
+
+  pid_t pid = fork();
+
+  if (pid == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("Fork failed: {}", strerror(errno)));
+  }
+
+  if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    close(socks[0]);
+    SendProcess(socks[1], num_warmups, num_iterations, data_size, buffer_size);
+    close(socks[1]);
+    exit(0);
+  }
+
+  ScopedPeerAffinity affinity(PARENT_PEER);
+  close(socks[1]);
+  BenchmarkResult result =
+      ReceiveProcess(socks[0], num_warmups, num_iterations, data_size);
+  close(socks[0]);
+  waitpid(pid, nullptr, 0);
+
+  const uint64_t num_messages = (data_size + buffer_size - 1) / buffer_size;
+  result.metrics.emplace_back("messages_per_sec",
+                              result.average / data_size * num_messages);
+  return result;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+
+// Hands data_size bytes to another process in memfds of buffer_size bytes.
+// The sender creates, fills and seals one memfd per message and passes it over
+// a Unix domain socket with SCM_RIGHTS. The receiver maps and verifies it in
+// place. The metric messages_per_sec is the number of memfds handed over.
+BenchmarkResult RunMemfdBandwidthBenchmark(int num_iterations, int num_warmups,
+                                           uint64_t data_size,
+                                           uint64_t buffer_size);
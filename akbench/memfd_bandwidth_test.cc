@@ -0,0 +1,25 @@
+#include "memfd_bandwidth.h"
+
+#include <cstdint>
+
+#include "aklog.h"
+
+int main(int argc, char *argv[]) {
+
+  constexpr int num_iterations = 3;
+  constexpr int num_warmups = 1;
+  // The last memfd is shorter than the others
+  constexpr uint64_t data_size = (1 << 16) + 100;
+  constexpr uint64_t buffer_size = 4096;
+
+  const BenchmarkResult result = RunMemfdBandwidthBenchmark(
+      num_iterations, num_warmups, data_size, buffer_size);
+  AKCHECK(result.average >= 0.0, "Bandwidth should be non-negative");
+  AKCHECK(result.metrics.size() == 1 &&
+              result.metrics[0].first == "messages_per_sec" &&
+              result.metrics[0].second > 0.0,
+          "messages_per_sec should be reported");
+  AKLOG(aklog::LogLevel::INFO, "memfd_bandwidth test passed");
+
+  return 0;
+}
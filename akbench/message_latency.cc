@@ -0,0 +1,261 @@
+#include "message_latency.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <vector>
+
+#include "aklog.h"
+
+#include "futex.h"
+#include "histogram.h"
+#include "perf_counters.h"
+#include "topology.h"
+
+namespace {
+
+// Number of polls before a shared memory endpoint sleeps on the futex. Kept
+// short since polling only pays off while the peer runs on another CPU.
+constexpr int MESSAGE_SPIN_COUNT = 128;
+
+// One direction of a shared memory endpoint
+struct Mailbox {
+  alignas(64) std::atomic<uint32_t> sequence;
+  // Whether the receiver is sleeping, or about to sleep, on sequence
+  std::atomic<uint32_t> sleeping;
+};
+
+struct SharedMessageRegion {
+  Mailbox to_child;
+  Mailbox to_parent;
+  // The messages to the child and then to the parent, each padded to a
+  // cache line
+  uint8_t messages[];
+};
+
+uint64_t PaddedMessageSize(uint64_t message_size) {
+  return (message_size + 63) / 64 * 64;
+}
+
+class SharedMemoryEndpoint : public MessageEndpoint {
+public:
+  SharedMemoryEndpoint(void *region, uint64_t message_size, int peer)
+      : region_(static_cast<SharedMessageRegion *>(region)),
+        region_size_(SharedMessageRegionSize(message_size)),
+        send_mailbox_(peer == PARENT_PEER ? &region_->to_child
+                                          : &region_->to_parent),
+        receive_mailbox_(peer == PARENT_PEER ? &region_->to_parent
+                                             : &region_->to_child),
+        send_slot_(region_->messages +
+                   (peer == PARENT_PEER ? 0 : PaddedMessageSize(message_size))),
+        receive_slot_(region_->messages + (peer == PARENT_PEER
+                                               ? PaddedMessageSize(message_size)
+                                               : 0)) {}
+
+  ~SharedMemoryEndpoint() override { munmap(region_, region_size_); }
+
+  void Send(std::span<const uint8_t> message) override {
+    memcpy(send_slot_, message.data(), message.size());
+    send_mailbox_->sequence.fetch_add(1);
+    if (send_mailbox_->sleeping.load() != 0) {
+      FutexWake(&send_mailbox_->sequence, 1, false);
+    }
+  }
+
+  void Receive(std::span<uint8_t> message) override {
+    ++received_;
+    if (!Poll()) {
+      receive_mailbox_->sleeping.store(1);
+      uint32_t sequence;
+      while ((sequence = receive_mailbox_->sequence.load()) != received_) {
+        FutexWait(&receive_mailbox_->sequence, sequence, false);
+      }
+      receive_mailbox_->sleeping.store(0);
+    }
+    memcpy(message.data(), receive_slot_, message.size());
+  }
+
+private:
+  bool Poll() const {
+    for (int i = 0; i < MESSAGE_SPIN_COUNT; ++i) {
+      if (receive_mailbox_->sequence.load() == received_) {
+        return true;
+      }
+      CpuRelax();
+    }
+    return false;
+  }
+
+  SharedMessageRegion *const region_;
+  const size_t region_size_;
+  Mailbox *const send_mailbox_;
+  Mailbox *const receive_mailbox_;
+  uint8_t *const send_slot_;
+  const uint8_t *const receive_slot_;
+  // Number of messages received so far, the sequence number to wait for
+  uint32_t received_ = 0;
+};
+
+void ParentFlip(MessageEndpoint *endpoint, std::span<const uint8_t> message,
+                std::span<uint8_t> reply, const uint64_t loop_size,
+                LatencyHistogram *histogram) {
+  LatencyRecorder recorder(histogram);
+  for (uint64_t i = 0; i < loop_size; ++i) {
+    endpoint->Send(message);
+    endpoint->Receive(reply);
+    recorder.Tick();
+  }
+}
+
+void ChildFlip(MessageEndpoint *endpoint, std::span<uint8_t> message,
+               const uint64_t loop_size) {
+  for (uint64_t i = 0; i < loop_size; ++i) {
+    endpoint->Receive(message);
+    endpoint->Send(message);
+  }
+}
+
+void VerifyReply(const std::vector<uint8_t> &message,
+                 std::vector<uint8_t> *reply, int iteration) {
+  if (*reply != message) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("{}The echoed message differs from the sent one",
+                      ReceivePrefix(iteration)));
+  }
+  std::fill(reply->begin(), reply->end(), 0);
+}
+
+} // namespace
+
+BenchmarkResult
+RunMessageLatencyBenchmark(int num_iterations, int num_warmups,
+                           uint64_t loop_size, uint64_t message_size,
+                           const MessageEndpointFactory &open_endpoint) {
+  AKCHECK(message_size > 0, "message_size must be positive");
+
+  pid_t pid = fork();
+
+  if (pid == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("Fork failed: {}", strerror(errno)));
+  }
+
+  if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    std::unique_ptr<MessageEndpoint> endpoint = open_endpoint(CHILD_PEER);
+    std::vector<uint8_t> message(message_size);
+    PerfCounters counters(CHILD_PEER, num_warmups);
+    for (int i = 0; i < num_iterations + num_warmups; ++i) {
+      counters.Start();
+      ChildFlip(endpoint.get(), message, loop_size);
+      counters.Stop();
+    }
+    // The histogram pass of the parent
+    ChildFlip(endpoint.get(), message, loop_size);
+    endpoint.reset();
+    exit(0);
+  }
+
+  ScopedPeerAffinity affinity(PARENT_PEER);
+  std::unique_ptr<MessageEndpoint> endpoint = open_endpoint(PARENT_PEER);
+  std::vector<uint8_t> message(message_size);
+  for (uint64_t i = 0; i < message_size; ++i) {
+    message[i] = static_cast<uint8_t>(i * 31 + 7);
+  }
+  std::vector<uint8_t> reply(message_size, 0);
+
+  PerfCounters counters(PARENT_PEER, num_warmups);
+  std::vector<double> durations;
+  for (int i = 0; i < num_iterations + num_warmups; ++i) {
+    AKLOG(aklog::LogLevel::DEBUG,
+          std::format("Parent: Starting iteration {}/{}", i + 1,
+                      num_iterations + num_warmups));
+
+    counters.Start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    ParentFlip(endpoint.get(), message, reply, loop_size, nullptr);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
+
+    if (i >= num_warmups) {
+      std::chrono::duration<double> duration = end_time - start_time;
+      durations.push_back(duration.count() / 2 / loop_size);
+      AKLOG(aklog::LogLevel::DEBUG,
+            std::format("Parent: Iteration {} takes {} seconds.", i + 1,
+                        duration.count()));
+    }
+    VerifyReply(message, &reply, i);
+  }
+
+  // Time each round trip separately in one more pass to get the latency
+  // distribution.
+  LatencyHistogram histogram;
+  ParentFlip(endpoint.get(), message, reply, loop_size, &histogram);
+  VerifyReply(message, &reply, num_iterations + num_warmups);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    AKLOG(aklog::LogLevel::FATAL, "The child process failed");
+  }
+  endpoint.reset();
+
+  BenchmarkResult result = CalculateOneTripDuration(durations);
+  // Each recorded round trip consists of two one-way trips.
+  result.percentiles = histogram.Percentiles(1e-9 / 2);
+  return result;
+}
+
+FdMessageEndpoint::FdMessageEndpoint(int send_fd, int receive_fd)
+    : send_fd_(send_fd), receive_fd_(receive_fd) {}
+
+FdMessageEndpoint::~FdMessageEndpoint() {
+  close(send_fd_);
+  if (receive_fd_ != send_fd_) {
+    close(receive_fd_);
+  }
+}
+
+void FdMessageEndpoint::Send(std::span<const uint8_t> message) {
+  size_t total_sent = 0;
+  while (total_sent < message.size()) {
+    const ssize_t bytes_sent = write(send_fd_, message.data() + total_sent,
+                                     message.size() - total_sent);
+    if (bytes_sent == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("Failed to send a message: {}", strerror(errno)));
+    }
+    total_sent += bytes_sent;
+  }
+}
+
+void FdMessageEndpoint::Receive(std::span<uint8_t> message) {
+  size_t total_received = 0;
+  while (total_received < message.size()) {
+    const ssize_t bytes_received =
+        read(receive_fd_, message.data() + total_received,
+             message.size() - total_received);
+    if (bytes_received <= 0) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("Failed to receive a message: {}",
+                        bytes_received == 0 ? "the peer closed the connection"
+                                            : strerror(errno)));
+    }
+    total_received += bytes_received;
+  }
+}
+
+size_t SharedMessageRegionSize(uint64_t message_size) {
+  return sizeof(SharedMessageRegion) + 2 * PaddedMessageSize(message_size);
+}
+
+std::unique_ptr<MessageEndpoint> OpenSharedMemoryEndpoint(void *region,
+                                                          uint64_t message_size,
+                                                          int peer) {
+  return std::make_unique<SharedMemoryEndpoint>(region, message_size, peer);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+
+#include "common.h"
+
+constexpr uint64_t DEFAULT_MESSAGE_SIZE = 64;
+
+// One end of a transport between a parent and a forked child that carries
+// messages of a fixed size.
+class MessageEndpoint {
+public:
+  virtual ~MessageEndpoint() = default;
+
+  // Send all of message.
+  virtual void Send(std::span<const uint8_t> message) = 0;
+  // Receive exactly message.size() bytes into message.
+  virtual void Receive(std::span<uint8_t> message) = 0;
+};
+
+// Opens the end of peer, PARENT_PEER or CHILD_PEER, in the process of that
+// peer after the fork.
+using MessageEndpointFactory =
+    std::function<std::unique_ptr<MessageEndpoint>(int peer)>;
+
+// Ping-pongs messages of message_size bytes between a parent and a forked
+// child over the endpoints of open_endpoint and reports the one-trip latency
+// in seconds. The child echoes each message and the parent verifies the echo.
+BenchmarkResult
+RunMessageLatencyBenchmark(int num_iterations, int num_warmups,
+                           uint64_t loop_size, uint64_t message_size,
+                           const MessageEndpointFactory &open_endpoint);
+
+// Endpoint over file descriptors, e.g. sockets, pipes or FIFOs, that reads
+// and writes until whole messages have crossed. It owns both descriptors,
+// which may be the same.
+class FdMessageEndpoint : public MessageEndpoint {
+public:
+  FdMessageEndpoint(int send_fd, int receive_fd);
+  ~FdMessageEndpoint() override;
+
+  void Send(std::span<const uint8_t> message) override;
+  void Receive(std::span<uint8_t> message) override;
+
+private:
+  const int send_fd_;
+  const int receive_fd_;
+};
+
+// Size of the shared region of OpenSharedMemoryEndpoint.
+size_t SharedMessageRegionSize(uint64_t message_size);
+
+// Endpoint over a zero-filled region of SharedMessageRegionSize(message_size)
+// bytes that is mapped MAP_SHARED in both processes. Each direction has one
+// message slot and a sequence number that the receiver polls before it sleeps
+// on a futex. The endpoint unmaps the region when it is destroyed.
+std::unique_ptr<MessageEndpoint> OpenSharedMemoryEndpoint(void *region,
+                                                          uint64_t message_size,
+                                                          int peer);
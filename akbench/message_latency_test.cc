@@ -0,0 +1,68 @@
+#include "message_latency.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <print>
+
+#include "aklog.h"
+
+#include "topology.h"
+
+namespace {
+
+constexpr int NUM_ITERATIONS = 3;
+constexpr int NUM_WARMUPS = 1;
+constexpr uint64_t LOOP_SIZE = 10;
+
+// Larger than a socket buffer so that messages cross in several pieces
+void testFdEndpoint() {
+  for (uint64_t message_size : {1, 64, 1 << 20}) {
+    int fds[2];
+    AKCHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0,
+            std::format("socketpair: {}", strerror(errno)));
+    const BenchmarkResult result = RunMessageLatencyBenchmark(
+        NUM_ITERATIONS, NUM_WARMUPS, LOOP_SIZE, message_size,
+        [&fds](int peer) -> std::unique_ptr<MessageEndpoint> {
+          const int fd = peer == PARENT_PEER ? fds[0] : fds[1];
+          close(peer == PARENT_PEER ? fds[1] : fds[0]);
+          return std::make_unique<FdMessageEndpoint>(fd, fd);
+        });
+    AKCHECK(result.average > 0.0, "Latency should be positive");
+  }
+  std::print("testFdEndpoint passed\n");
+}
+
+// Message sizes that are not a multiple of the cache line padding
+void testSharedMemoryEndpoint() {
+  for (uint64_t message_size : {1, 100, 4096}) {
+    const size_t region_size = SharedMessageRegionSize(message_size);
+    void *region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    AKCHECK(region != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+    const BenchmarkResult result = RunMessageLatencyBenchmark(
+        NUM_ITERATIONS, NUM_WARMUPS, LOOP_SIZE, message_size, [&](int peer) {
+          return OpenSharedMemoryEndpoint(region, message_size, peer);
+        });
+    AKCHECK(result.average > 0.0, "Latency should be positive");
+  }
+  std::print("testSharedMemoryEndpoint passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running message_latency tests...\n");
+  // Do not let the children flush what the parent has printed.
+  fflush(stdout);
+
+  testFdEndpoint();
+  fflush(stdout);
+  testSharedMemoryEndpoint();
+
+  std::print("All message_latency tests passed!\n");
+  return 0;
+}
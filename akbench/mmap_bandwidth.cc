@@ -16,6 +16,9 @@
 
 #include "barrier.h"
 #include "common.h"
+#include "message_latency.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 const std::string MMAP_FILE_PATH =
@@ -28,23 +31,26 @@ struct MmapBuffer {
 };
 
 void SendProcess(const int num_warmups, const int num_iterations,
-                 const uint64_t data_size, const uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+                 const uint64_t data_size, const uint64_t buffer_size,
+                 const PageSize page_size, const std::string &file_path) {
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
   barrier.Wait();
 
-  std::vector<uint8_t> data_to_send = GenerateDataToSend(data_size);
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
   std::vector<double> durations;
 
+  PerfCounters counters(CHILD_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
-    int fd = open(MMAP_FILE_PATH.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0666);
+    int fd = open(file_path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0666);
     if (fd == -1) {
       AKLOG(aklog::LogLevel::FATAL,
             std::format("send: open: {}", strerror(errno)));
       return;
     }
 
-    size_t total_size = sizeof(MmapBuffer) + 2 * buffer_size;
+    size_t total_size =
+        RoundUpToPageSize(sizeof(MmapBuffer) + 2 * buffer_size, page_size);
     if (ftruncate(fd, total_size) == -1) {
       AKLOG(aklog::LogLevel::FATAL,
             std::format("send: ftruncate: {}", strerror(errno)));
@@ -59,6 +65,7 @@ void SendProcess(const int num_warmups, const int num_iterations,
       AKLOG(aklog::LogLevel::FATAL,
             std::format("send: mmap: {}", strerror(errno)));
     }
+    AdviseHugePages(mapped_region, total_size, page_size);
     barrier.Wait();
 
     MmapBuffer *mmap_buffer = static_cast<MmapBuffer *>(mapped_region);
@@ -79,6 +86,8 @@ void SendProcess(const int num_warmups, const int num_iterations,
     uint64_t bytes_sent = 0;
     constexpr uint64_t PIPELINE_INDEX = 0;
     const uint64_t n_pipeline = (data_size + buffer_size - 1) / buffer_size + 1;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}n_pipeline: {}", SendPrefix(iteration), n_pipeline));
@@ -92,6 +101,7 @@ void SendProcess(const int num_warmups, const int num_iterations,
       bytes_sent += size_to_send;
     }
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
     barrier.Wait();
 
     if (!is_warmup) {
@@ -118,15 +128,19 @@ void SendProcess(const int num_warmups, const int num_iterations,
 
 BenchmarkResult ReceiveProcess(const int num_warmups, const int num_iterations,
                                const uint64_t data_size,
-                               const uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+                               const uint64_t buffer_size,
+                               const PageSize page_size,
+                               const std::string &file_path) {
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
   barrier.Wait();
   std::vector<double> durations;
+  std::vector<std::pair<std::string, double>> backing_metrics;
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     barrier.Wait();
-    int fd = open(MMAP_FILE_PATH.c_str(), O_RDWR);
+    int fd = open(file_path.c_str(), O_RDWR);
     if (fd == -1) {
       AKLOG(aklog::LogLevel::FATAL,
             std::format("receive: open: {}", strerror(errno)));
@@ -146,6 +160,7 @@ BenchmarkResult ReceiveProcess(const int num_warmups, const int num_iterations,
       AKLOG(aklog::LogLevel::FATAL,
             std::format("receive: mmap: {}", strerror(errno)));
     }
+    AdviseHugePages(mapped_region, total_size, page_size);
 
     MmapBuffer *mmap_buffer = static_cast<MmapBuffer *>(mapped_region);
 
@@ -166,6 +181,8 @@ BenchmarkResult ReceiveProcess(const int num_warmups, const int num_iterations,
     uint64_t bytes_received = 0;
     constexpr uint64_t PIPELINE_INDEX = 1;
     const uint64_t n_pipeline = (data_size + buffer_size - 1) / buffer_size + 1;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
     for (uint64_t i = 0; i < n_pipeline; ++i) {
       barrier.Wait();
@@ -178,6 +195,7 @@ BenchmarkResult ReceiveProcess(const int num_warmups, const int num_iterations,
       bytes_received += size_to_receive;
     }
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
     barrier.Wait();
 
     if (!is_warmup) {
@@ -198,12 +216,16 @@ BenchmarkResult ReceiveProcess(const int num_warmups, const int num_iterations,
                                                 ReceivePrefix(iteration)));
     }
 
+    if (iteration == num_warmups + num_iterations - 1) {
+      AddPageBackingMetrics(backing_metrics, "mmap", mapped_region, page_size);
+    }
     munmap(mapped_region, total_size);
     close(fd);
   }
 
   BenchmarkResult result =
       CalculateBandwidth(durations, num_iterations, data_size);
+  result.metrics = std::move(backing_metrics);
   AKLOG(aklog::LogLevel::INFO,
         std::format("Receive bandwidth: {:.3f} ± {:.3f}{}.",
                     result.average / (1 << 30), result.stddev / (1 << 30),
@@ -218,9 +240,12 @@ BenchmarkResult ReceiveProcess(const int num_warmups, const int num_iterations,
 
 BenchmarkResult RunMmapBandwidthBenchmark(int num_iterations, int num_warmups,
                                           uint64_t data_size,
-                                          uint64_t buffer_size) {
-  SenseReversingBarrier::ClearResource(BARRIER_ID);
-  unlink(MMAP_FILE_PATH.c_str());
+                                          uint64_t buffer_size,
+                                          PageSize page_size) {
+  SenseReversingBarrier::ClearResource(PairName(BARRIER_ID));
+  const std::string file_path =
+      HugePagePath(PairName(MMAP_FILE_PATH), page_size);
+  unlink(file_path.c_str());
 
   pid_t pid = fork();
 
@@ -229,13 +254,45 @@ BenchmarkResult RunMmapBandwidthBenchmark(int num_iterations, int num_warmups,
   }
 
   if (pid == 0) {
-    SendProcess(num_warmups, num_iterations, data_size, buffer_size);
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    SendProcess(num_warmups, num_iterations, data_size, buffer_size, page_size,
+                file_path);
     exit(0);
   } else {
+    ScopedPeerAffinity affinity(PARENT_PEER);
     BenchmarkResult result =
-        ReceiveProcess(num_warmups, num_iterations, data_size, buffer_size);
+        ReceiveProcess(num_warmups, num_iterations, data_size, buffer_size,
+                       page_size, file_path);
     waitpid(pid, nullptr, 0);
-    unlink(MMAP_FILE_PATH.c_str());
+    unlink(file_path.c_str());
     return result;
   }
 }
+
+BenchmarkResult RunMmapLatencyBenchmark(int num_iterations, int num_warmups,
+                                        uint64_t loop_size,
+                                        uint64_t message_size) {
+  unlink(MMAP_FILE_PATH.c_str());
+  const size_t region_size = SharedMessageRegionSize(message_size);
+  int fd = open(MMAP_FILE_PATH.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0666);
+  if (fd == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("open: {}", strerror(errno)));
+  }
+  if (ftruncate(fd, region_size) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("ftruncate: {}", strerror(errno)));
+  }
+  // The child inherits the mapping.
+  void *region =
+      mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (region == MAP_FAILED) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("mmap: {}", strerror(errno)));
+  }
+  close(fd);
+  unlink(MMAP_FILE_PATH.c_str());
+
+  return RunMessageLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, message_size, [&](int peer) {
+        return OpenSharedMemoryEndpoint(region, message_size, peer);
+      });
+}
@@ -1,8 +1,19 @@
 #pragma once
 
 #include "common.h"
+#include "huge_pages.h"
 #include <cstdint>
 
-BenchmarkResult RunMmapBandwidthBenchmark(int num_iterations, int num_warmups,
-                                          uint64_t data_size,
-                                          uint64_t buffer_size);
+// Streams data through a shared mapping of a file. With HUGE_2M or HUGE_1G the
+// file is on a hugetlbfs mount when one is available. Reports the backing
+// actually obtained as metrics.
+BenchmarkResult
+RunMmapBandwidthBenchmark(int num_iterations, int num_warmups,
+                          uint64_t data_size, uint64_t buffer_size,
+                          PageSize page_size = PageSize::DEFAULT);
+
+// Round trips of message_size bytes through a shared mapping of a file.
+// Reports the one-trip latency.
+BenchmarkResult RunMmapLatencyBenchmark(int num_iterations, int num_warmups,
+                                        uint64_t loop_size,
+                                        uint64_t message_size);
@@ -115,7 +115,7 @@ int main(int argc, char **argv) {
     return 1;
   }
 
-  std::vector<uint8_t> send_buffer = GenerateDataToSend(data_size);
+  const std::span<const uint8_t> send_buffer = GenerateDataToSend(data_size);
   std::vector<uint8_t> recv_buffer(data_size);
 
   if (rank == 0) {
@@ -10,25 +10,33 @@
 #include <chrono>
 #include <cstring>
 #include <format>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "aklog.h"
 
 #include "barrier.h"
 #include "common.h"
+#include "message_latency.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 
 const std::string BARRIER_ID = GenerateUniqueName("/mq_benchmark");
 const std::string MQ_NAME = GenerateUniqueName("/mq_benchmark_queue");
+// Default of /proc/sys/fs/mqueue/msgsize_max
+constexpr uint64_t MAX_MQ_MSG_SIZE = 8192;
 
 void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
                  uint64_t buffer_size) {
   SenseReversingBarrier barrier(2, BARRIER_ID);
 
-  std::vector<uint8_t> data_to_send = GenerateDataToSend(data_size);
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
   std::vector<double> durations;
 
+  PerfCounters counters(CHILD_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -52,6 +60,7 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
 
     barrier.Wait();
     size_t total_sent = 0;
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     while (total_sent < data_size) {
@@ -69,6 +78,7 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (!is_warmup) {
       std::chrono::duration<double> elapsed_time = end_time - start_time;
@@ -98,6 +108,7 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
 
   std::vector<double> durations;
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -125,6 +136,7 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
 
     barrier.Wait();
     size_t total_received = 0;
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     while (total_received < data_size) {
@@ -153,6 +165,7 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (!is_warmup) {
       std::chrono::duration<double> elapsed_time = end_time - start_time;
@@ -195,8 +208,7 @@ BenchmarkResult RunMqBandwidthBenchmark(int num_iterations, int num_warmups,
   mq_unlink(MQ_NAME.c_str());
 
   // Limit message size to system limits (typically 8192 bytes)
-  const size_t max_msg_size =
-      std::min(buffer_size, static_cast<uint64_t>(8192));
+  const size_t max_msg_size = std::min(buffer_size, MAX_MQ_MSG_SIZE);
 
   // Create message queue attributes
   struct mq_attr attr;
@@ -221,10 +233,12 @@ BenchmarkResult RunMqBandwidthBenchmark(int num_iterations, int num_warmups,
 
   if (pid == 0) {
     // Child process: sender
+    ScopedPeerAffinity affinity(CHILD_PEER);
     SendProcess(num_warmups, num_iterations, data_size, max_msg_size);
     exit(0);
   } else {
     // Parent process: receiver
+    ScopedPeerAffinity affinity(PARENT_PEER);
     BenchmarkResult result =
         ReceiveProcess(num_warmups, num_iterations, data_size, max_msg_size);
     waitpid(pid, nullptr, 0);
@@ -236,3 +250,103 @@ BenchmarkResult RunMqBandwidthBenchmark(int num_iterations, int num_warmups,
     return result;
   }
 }
+
+namespace {
+
+// Endpoint over one queue in each direction. Messages larger than the queue
+// allows are sent in pieces of mq_msgsize bytes.
+class MqMessageEndpoint : public MessageEndpoint {
+public:
+  MqMessageEndpoint(mqd_t send_mq, mqd_t receive_mq, uint64_t msg_size)
+      : send_mq_(send_mq), receive_mq_(receive_mq), msg_size_(msg_size),
+        piece_(msg_size) {}
+
+  ~MqMessageEndpoint() override {
+    mq_close(send_mq_);
+    mq_close(receive_mq_);
+  }
+
+  void Send(std::span<const uint8_t> message) override {
+    for (size_t offset = 0; offset < message.size(); offset += msg_size_) {
+      const size_t length = std::min(msg_size_, message.size() - offset);
+      if (mq_send(send_mq_,
+                  reinterpret_cast<const char *>(message.data() + offset),
+                  length, 0) == -1) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("mq_send: {}", strerror(errno)));
+      }
+    }
+  }
+
+  void Receive(std::span<uint8_t> message) override {
+    // mq_receive needs room for mq_msgsize bytes, which the tail of the
+    // message may not have.
+    for (size_t offset = 0; offset < message.size();) {
+      const bool fits = message.size() - offset >= msg_size_;
+      uint8_t *buffer = fits ? message.data() + offset : piece_.data();
+      const ssize_t length = mq_receive(
+          receive_mq_, reinterpret_cast<char *>(buffer), msg_size_, nullptr);
+      if (length == -1) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("mq_receive: {}", strerror(errno)));
+      }
+      if (!fits) {
+        memcpy(message.data() + offset, buffer, length);
+      }
+      offset += length;
+    }
+  }
+
+private:
+  const mqd_t send_mq_;
+  const mqd_t receive_mq_;
+  const size_t msg_size_;
+  std::vector<uint8_t> piece_;
+};
+
+} // namespace
+
+BenchmarkResult RunMqLatencyBenchmark(int num_iterations, int num_warmups,
+                                      uint64_t loop_size,
+                                      uint64_t message_size) {
+  const std::string to_child_name = MQ_NAME + "_to_child";
+  const std::string to_parent_name = MQ_NAME + "_to_parent";
+  const size_t msg_size = std::min(message_size, MAX_MQ_MSG_SIZE);
+
+  struct mq_attr attr;
+  attr.mq_flags = 0;
+  attr.mq_maxmsg = 10;
+  attr.mq_msgsize = msg_size;
+  attr.mq_curmsgs = 0;
+  for (const std::string &name : {to_child_name, to_parent_name}) {
+    mq_unlink(name.c_str());
+    mqd_t mq = mq_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666, &attr);
+    if (mq == (mqd_t)-1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("mq_open (create): {}", strerror(errno)));
+    }
+    mq_close(mq);
+  }
+
+  BenchmarkResult result = RunMessageLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, message_size,
+      [&](int peer) -> std::unique_ptr<MessageEndpoint> {
+        const bool is_parent = peer == PARENT_PEER;
+        const mqd_t to_child =
+            mq_open(to_child_name.c_str(), is_parent ? O_WRONLY : O_RDONLY);
+        const mqd_t to_parent =
+            mq_open(to_parent_name.c_str(), is_parent ? O_RDONLY : O_WRONLY);
+        AKCHECK(to_child != (mqd_t)-1 && to_parent != (mqd_t)-1,
+                std::format("mq_open: {}", strerror(errno)));
+        if (is_parent) {
+          return std::make_unique<MqMessageEndpoint>(to_child, to_parent,
+                                                     msg_size);
+        }
+        return std::make_unique<MqMessageEndpoint>(to_parent, to_child,
+                                                   msg_size);
+      });
+
+  mq_unlink(to_child_name.c_str());
+  mq_unlink(to_parent_name.c_str());
+  return result;
+}
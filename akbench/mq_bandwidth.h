@@ -6,3 +6,9 @@
 BenchmarkResult RunMqBandwidthBenchmark(int num_iterations, int num_warmups,
                                         uint64_t data_size,
                                         uint64_t buffer_size);
+
+// Round trips of message_size bytes over a pair of POSIX message queues, in
+// messages of at most 8 KiB each. Reports the one-trip latency.
+BenchmarkResult RunMqLatencyBenchmark(int num_iterations, int num_warmups,
+                                      uint64_t loop_size,
+                                      uint64_t message_size);
@@ -15,6 +15,11 @@ int main(int argc, char *argv[]) {
       num_iterations, num_warmups, data_size, buffer_size);
 
   AKCHECK(result.average >= 0.0, "Bandwidth should be non-negative");
+
+  // Larger than one message of the queue
+  const BenchmarkResult latency_result =
+      RunMqLatencyBenchmark(num_iterations, num_warmups, 10, 10000);
+  AKCHECK(latency_result.average > 0.0, "Latency should be positive");
   AKLOG(aklog::LogLevel::INFO, "mq_bandwidth test passed");
 
   return 0;
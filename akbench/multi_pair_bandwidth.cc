@@ -0,0 +1,132 @@
+#include "multi_pair_bandwidth.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "aklog.h"
+
+#include "barrier.h"
+#include "common.h"
+#include "topology.h"
+
+namespace {
+
+const std::string GATE_ID = GenerateUniqueName("/multi_pair_gate");
+
+// Placement of pair pair_index: the CPUs of --cpus rotated by two per pair
+std::optional<CpuPlacement> PairPlacement(int pair_index) {
+  std::optional<CpuPlacement> placement = GetCpuPlacement();
+  if (placement.has_value()) {
+    std::vector<int> &cpus = placement->cpus;
+    std::rotate(cpus.begin(), cpus.begin() + (2 * pair_index) % cpus.size(),
+                cpus.end());
+  }
+  return placement;
+}
+
+} // namespace
+
+double FairnessIndex(const std::vector<double> &bandwidths) {
+  const double sum =
+      std::accumulate(bandwidths.begin(), bandwidths.end(), 0.0);
+  const double sum_of_squares = std::inner_product(
+      bandwidths.begin(), bandwidths.end(), bandwidths.begin(), 0.0);
+  if (sum_of_squares == 0.0) {
+    return 1.0;
+  }
+  return sum * sum / (bandwidths.size() * sum_of_squares);
+}
+
+BenchmarkResult RunMultiPairBandwidthBenchmark(int num_iterations,
+                                               int num_warmups,
+                                               uint64_t data_size,
+                                               uint64_t buffer_size,
+                                               uint64_t num_pairs,
+                                               const BandwidthRun &run) {
+  AKCHECK(num_pairs >= 1, "num_pairs must be at least 1");
+  SenseReversingBarrier::ClearResource(GATE_ID);
+
+  // Bandwidth of each iteration of each pair, written by the pairs
+  const size_t samples_size = sizeof(double) * num_pairs * num_iterations;
+  double *samples =
+      static_cast<double *>(mmap(nullptr, samples_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  if (samples == MAP_FAILED) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("mmap: {}", strerror(errno)));
+  }
+
+  std::vector<pid_t> pids;
+  for (uint64_t pair = 0; pair < num_pairs; ++pair) {
+    pid_t pid = fork();
+    if (pid == -1) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("fork: {}", strerror(errno)));
+    }
+    if (pid == 0) {
+      SetPairGroup(PairGroup{.index = static_cast<int>(pair),
+                             .num_pairs = static_cast<int>(num_pairs),
+                             .gate_id = GATE_ID});
+      SetCpuPlacement(PairPlacement(pair));
+      const BenchmarkResult result =
+          run(num_iterations, num_warmups, data_size, buffer_size);
+      AKCHECK(result.samples.size() == static_cast<size_t>(num_iterations),
+              std::format("Pair {} reported {} samples, expected {}", pair,
+                          result.samples.size(), num_iterations));
+      std::copy(result.samples.begin(), result.samples.end(),
+                samples + pair * num_iterations);
+      exit(0);
+    }
+    pids.push_back(pid);
+  }
+
+  for (uint64_t pair = 0; pair < num_pairs; ++pair) {
+    int status = 0;
+    waitpid(pids[pair], &status, 0);
+    AKCHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+            std::format("Pair {} failed", pair));
+  }
+  SenseReversingBarrier::ClearResource(GATE_ID);
+
+  // All pairs start an iteration together, so the iteration takes as long as
+  // the slowest pair.
+  std::vector<double> durations;
+  for (int iteration = 0; iteration < num_iterations; ++iteration) {
+    double duration = 0.0;
+    for (uint64_t pair = 0; pair < num_pairs; ++pair) {
+      duration = std::max(
+          duration, data_size / samples[pair * num_iterations + iteration]);
+    }
+    durations.push_back(duration);
+  }
+  std::vector<double> pair_bandwidths;
+  for (uint64_t pair = 0; pair < num_pairs; ++pair) {
+    const std::vector<double> pair_samples(samples + pair * num_iterations,
+                                           samples +
+                                               (pair + 1) * num_iterations);
+    pair_bandwidths.push_back(SummarizeSamples(pair_samples).average);
+  }
+  munmap(samples, samples_size);
+
+  BenchmarkResult result =
+      CalculateBandwidth(durations, num_iterations, data_size * num_pairs);
+  for (uint64_t pair = 0; pair < num_pairs; ++pair) {
+    result.metrics.emplace_back(std::format("pair_{}_bandwidth", pair),
+                                pair_bandwidths[pair]);
+  }
+  result.metrics.emplace_back("fairness_index", FairnessIndex(pair_bandwidths));
+  AKLOG(aklog::LogLevel::INFO,
+        std::format("{} pairs aggregate bandwidth: {:.3f} ± {:.3f}{}, "
+                    "fairness index {:.3f}.",
+                    num_pairs, result.average / (1 << 30),
+                    result.stddev / (1 << 30), GIBYTE_PER_SEC_UNIT,
+                    FairnessIndex(pair_bandwidths)));
+
+  return result;
+}
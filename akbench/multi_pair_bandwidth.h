@@ -0,0 +1,29 @@
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+#include <functional>
+
+using BandwidthRun = std::function<BenchmarkResult(
+    int num_iterations, int num_warmups, uint64_t data_size,
+    uint64_t buffer_size)>;
+
+// Runs num_pairs copies of a fork-based bandwidth benchmark at the same time,
+// each with its own sockets, pipes or segments. The timed regions of all pairs
+// start together at one SenseReversingBarrier of 2 * num_pairs peers. With
+// --cpus, pair k pins its peers to the CPUs after the first 2 * k.
+//
+// The result is the aggregate bandwidth, i.e. the data of all pairs over the
+// time until the slowest pair finished. The metrics are the bandwidth of each
+// pair as pair_<k>_bandwidth and Jain's fairness index of them as
+// fairness_index, which is 1.0 when all pairs get the same bandwidth and
+// 1 / num_pairs when one pair gets all of it.
+BenchmarkResult RunMultiPairBandwidthBenchmark(int num_iterations,
+                                               int num_warmups,
+                                               uint64_t data_size,
+                                               uint64_t buffer_size,
+                                               uint64_t num_pairs,
+                                               const BandwidthRun &run);
+
+// Jain's fairness index (sum x)^2 / (n * sum x^2) of the given bandwidths
+double FairnessIndex(const std::vector<double> &bandwidths);
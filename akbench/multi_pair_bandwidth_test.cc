@@ -0,0 +1,53 @@
+#include "multi_pair_bandwidth.h"
+
+#include <cmath>
+#include <cstdint>
+#include <format>
+
+#include "aklog.h"
+
+#include "pipe_bandwidth.h"
+#include "uds_bandwidth.h"
+
+int main(int argc, char *argv[]) {
+  AKCHECK(FairnessIndex({1.0, 1.0, 1.0}) == 1.0,
+          "Equal bandwidths should be perfectly fair");
+  AKCHECK(std::abs(FairnessIndex({1.0, 0.0, 0.0, 0.0}) - 0.25) < 1e-12,
+          "One pair getting everything should give 1 / num_pairs");
+
+  constexpr int num_iterations = 3;
+  constexpr int num_warmups = 1;
+  constexpr uint64_t data_size = 1 << 20;
+  constexpr uint64_t buffer_size = 1 << 16;
+  constexpr uint64_t num_pairs = 3;
+
+  const std::pair<const char *, BandwidthRun> benchmarks[] = {
+      {"pipe", RunPipeBandwidthBenchmark},
+      {"uds", RunUdsBandwidthBenchmark},
+  };
+  for (const auto &[name, run] : benchmarks) {
+    const BenchmarkResult result = RunMultiPairBandwidthBenchmark(
+        num_iterations, num_warmups, data_size, buffer_size, num_pairs, run);
+    AKCHECK(result.average > 0.0,
+            std::format("{}: aggregate bandwidth should be positive", name));
+    AKCHECK(result.metrics.size() == num_pairs + 1,
+            std::format("{}: expected a bandwidth per pair and the fairness "
+                        "index",
+                        name));
+    for (uint64_t pair = 0; pair < num_pairs; ++pair) {
+      AKCHECK(result.metrics[pair].first ==
+                      std::format("pair_{}_bandwidth", pair) &&
+                  result.metrics[pair].second > 0.0,
+              std::format("{}: pair {} should report its bandwidth", name,
+                          pair));
+    }
+    const double fairness = result.metrics.back().second;
+    AKCHECK(result.metrics.back().first == "fairness_index" &&
+                fairness > 1.0 / num_pairs - 1e-9 && fairness <= 1.0 + 1e-9,
+            std::format("{}: fairness index out of range: {}", name,
+                        fairness));
+  }
+  AKLOG(aklog::LogLevel::INFO, "multi_pair_bandwidth test passed");
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include "numa.h"
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "aklog.h"
+#include "topology.h"
+
+namespace {
+
+// Number of nodes the node mask passed to mbind can hold.
+constexpr int MAX_NUMA_NODES = 1024;
+constexpr int BITS_PER_LONG = sizeof(unsigned long) * 8;
+
+std::optional<std::vector<int>> ReadCpuList(const std::string &path) {
+  std::ifstream file(path);
+  std::string line;
+  if (!file || !std::getline(file, line)) {
+    return std::nullopt;
+  }
+  // Nodes without CPUs have an empty cpulist.
+  if (line.empty()) {
+    return std::vector<int>{};
+  }
+  return ParseCpuList(line);
+}
+
+} // namespace
+
+std::vector<int> GetNumaNodes(const std::string &sysfs_node_dir) {
+  const std::optional<std::vector<int>> nodes =
+      ReadCpuList(sysfs_node_dir + "/online");
+  if (!nodes.has_value() || nodes->empty()) {
+    AKLOG(aklog::LogLevel::INFO,
+          std::format("No NUMA information in {}, assuming a single node",
+                      sysfs_node_dir));
+    return {0};
+  }
+  return nodes.value();
+}
+
+std::vector<int> GetNumaNodeCpus(int node, const std::string &sysfs_node_dir) {
+  const std::optional<std::vector<int>> cpus =
+      ReadCpuList(std::format("{}/node{}/cpulist", sysfs_node_dir, node));
+  if (!cpus.has_value()) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("Failed to read the CPUs of NUMA node {}", node));
+    return {};
+  }
+  return cpus.value();
+}
+
+NumaBuffer::NumaBuffer(uint64_t size, int node) : size_(size) {
+  AKCHECK(0 <= node && node < MAX_NUMA_NODES,
+          std::format("Invalid NUMA node: {}", node));
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  AKCHECK(addr != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+  data_ = static_cast<uint8_t *>(addr);
+
+  unsigned long node_mask[MAX_NUMA_NODES / BITS_PER_LONG] = {};
+  node_mask[node / BITS_PER_LONG] |= 1UL << (node % BITS_PER_LONG);
+  // The kernel reads maxnode - 1 bits of the mask.
+  if (syscall(SYS_mbind, data_, size_, MPOL_BIND, node_mask,
+              MAX_NUMA_NODES + 1, MPOL_MF_STRICT | MPOL_MF_MOVE) == 0) {
+    bound_ = true;
+  } else {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("mbind to NUMA node {} failed: {}. Using the default "
+                      "memory policy.",
+                      node, strerror(errno)));
+  }
+}
+
+NumaBuffer::~NumaBuffer() { munmap(data_, size_); }
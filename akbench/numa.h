@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+constexpr const char *SYSFS_NODE_DIR = "/sys/devices/system/node";
+
+// Online NUMA nodes. Returns {0} when the kernel exposes no NUMA information.
+std::vector<int>
+GetNumaNodes(const std::string &sysfs_node_dir = SYSFS_NODE_DIR);
+
+// CPUs of a NUMA node. Returns an empty vector for nodes without CPUs.
+std::vector<int>
+GetNumaNodeCpus(int node, const std::string &sysfs_node_dir = SYSFS_NODE_DIR);
+
+// Anonymous memory whose pages are bound to one NUMA node with mbind(2)
+// before they are first touched. mbind is called through syscall(2) so that
+// libnuma is not needed. If it fails, e.g. on kernels without NUMA support,
+// the memory is left to the default policy with a warning.
+class NumaBuffer {
+public:
+  NumaBuffer(uint64_t size, int node);
+  ~NumaBuffer();
+  NumaBuffer(const NumaBuffer &) = delete;
+  NumaBuffer &operator=(const NumaBuffer &) = delete;
+
+  uint8_t *data() { return data_; }
+  uint64_t size() const { return size_; }
+  std::span<uint8_t> span() { return {data_, size_}; }
+  bool bound() const { return bound_; }
+
+private:
+  uint8_t *data_;
+  uint64_t size_;
+  bool bound_ = false;
+};
@@ -0,0 +1,51 @@
+#include "numa.h"
+
+#include <cstring>
+#include <format>
+#include <linux/mempolicy.h>
+#include <print>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "aklog.h"
+
+namespace {
+
+void testGetNumaNodes() {
+  const std::vector<int> nodes = GetNumaNodes();
+  AKCHECK(!nodes.empty(), "There should be at least one NUMA node");
+  AKCHECK(GetNumaNodes("/nonexistent") == std::vector<int>({0}),
+          "Missing sysfs should give a single node");
+  std::print("testGetNumaNodes passed\n");
+}
+
+void testNumaBuffer() {
+  const int node = GetNumaNodes().front();
+  NumaBuffer buffer(1 << 20, node);
+  std::memset(buffer.data(), 0xAB, buffer.size());
+  AKCHECK(buffer.span().size() == (1 << 20), "Buffer size should be 1 MiB");
+  AKCHECK(buffer.data()[buffer.size() - 1] == 0xAB, "Buffer should be usable");
+
+  if (buffer.bound()) {
+    int actual_node = -1;
+    AKCHECK(syscall(SYS_get_mempolicy, &actual_node, nullptr, 0,
+                    buffer.data(), MPOL_F_NODE | MPOL_F_ADDR) == 0,
+            std::format("get_mempolicy: {}", strerror(errno)));
+    AKCHECK(actual_node == node,
+            std::format("Page should be on node {}, got {}", node,
+                        actual_node));
+  }
+  std::print("testNumaBuffer passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running numa tests...\n");
+
+  testGetNumaNodes();
+  testNumaBuffer();
+
+  std::print("All numa tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,25 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "topology.h"
+
+uint64_t ParallelThreadCount(uint64_t num_bytes, uint64_t max_threads) {
+  return std::clamp<uint64_t>(
+      std::min<uint64_t>(num_bytes / MIN_BYTES_PER_THREAD, AllowedCpuCount()),
+      1, std::max<uint64_t>(max_threads, 1));
+}
+
+void RunInParallel(uint64_t num_threads,
+                   const std::function<void(uint64_t)> &work) {
+  std::vector<std::thread> threads;
+  for (uint64_t thread = 1; thread < num_threads; ++thread) {
+    threads.emplace_back(work, thread);
+  }
+  work(0);
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
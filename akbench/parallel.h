@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Work on a buffer of num_bytes is split among threads only if each thread
+// gets at least this many bytes, as starting a thread costs about as much as
+// a pass over them.
+constexpr uint64_t MIN_BYTES_PER_THREAD = 8 << 20;
+
+// Number of threads for a pass over num_bytes: at most one per allowed CPU and
+// max_threads, and at least 1.
+uint64_t ParallelThreadCount(uint64_t num_bytes, uint64_t max_threads);
+
+// Calls work(0), ..., work(num_threads - 1) concurrently. work(0) runs on the
+// calling thread and the others on threads spawned for this call.
+void RunInParallel(uint64_t num_threads,
+                   const std::function<void(uint64_t)> &work);
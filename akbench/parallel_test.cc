@@ -0,0 +1,37 @@
+#include "parallel.h"
+
+#include <format>
+#include <print>
+#include <vector>
+
+#include "aklog.h"
+#include "topology.h"
+
+namespace {
+
+void testRunInParallel() {
+  AKCHECK(ParallelThreadCount(0, 32) == 1, "Empty buffers use one thread");
+  AKCHECK(ParallelThreadCount(MIN_BYTES_PER_THREAD * 1024, 1) == 1,
+          "max_threads should cap the thread count");
+  AKCHECK(ParallelThreadCount(MIN_BYTES_PER_THREAD * 1024, 1024) <=
+              static_cast<uint64_t>(AllowedCpuCount()),
+          "At most one thread per allowed CPU");
+
+  std::vector<int> calls(4, 0);
+  RunInParallel(calls.size(), [&](uint64_t thread) { ++calls[thread]; });
+  for (size_t i = 0; i < calls.size(); ++i) {
+    AKCHECK(calls[i] == 1, std::format("work({}) ran {} times", i, calls[i]));
+  }
+  std::print("testRunInParallel passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running parallel tests...\n");
+
+  testRunInParallel();
+
+  std::print("All parallel tests passed!\n");
+  return 0;
+}
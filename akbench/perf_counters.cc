@@ -0,0 +1,308 @@
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <linux/perf_event.h>
+#include <new>
+#include <optional>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "aklog.h"
+#include "topology.h"
+
+namespace {
+
+constexpr int MAX_PERF_COUNTERS = 16;
+constexpr int NUM_PERF_PEERS = 2;
+
+struct PerfEvent {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+};
+
+const PerfEvent PERF_EVENTS[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu-migrations", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+
+// The software event that replaces hardware events which cannot be opened
+const PerfEvent FALLBACK_EVENT = {"task-clock", PERF_TYPE_SOFTWARE,
+                                  PERF_COUNT_SW_TASK_CLOCK};
+
+struct ConfiguredEvent {
+  PerfEvent event;
+  // Whether only user space is counted because perf_event_paranoid forbids
+  // counting the kernel
+  bool exclude_kernel;
+};
+
+// Totals of each peer in memory shared by all forked processes
+struct PerfCounterTotals {
+  std::atomic<uint64_t> values[NUM_PERF_PEERS][MAX_PERF_COUNTERS];
+  std::atomic<uint64_t> num_regions[NUM_PERF_PEERS];
+};
+
+std::vector<ConfiguredEvent> g_events;
+std::vector<std::string> g_event_names;
+PerfCounterTotals *g_totals = nullptr;
+
+int OpenEvent(const ConfiguredEvent &configured, int group_fd) {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = configured.event.type;
+  attr.config = configured.event.config;
+  // The group is enabled with the leader in PerfCounters::Start().
+  attr.disabled = group_fd == -1;
+  attr.exclude_kernel = configured.exclude_kernel;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd,
+                 PERF_FLAG_FD_CLOEXEC);
+}
+
+// Open the event once to see whether it can be counted, with the kernel if
+// possible.
+std::optional<ConfiguredEvent> ProbeEvent(const PerfEvent &event) {
+  for (bool exclude_kernel : {false, true}) {
+    const ConfiguredEvent configured{.event = event,
+                                     .exclude_kernel = exclude_kernel};
+    const int fd = OpenEvent(configured, -1);
+    if (fd != -1) {
+      close(fd);
+      return configured;
+    }
+    if (errno != EACCES && errno != EPERM) {
+      break;
+    }
+  }
+  AKLOG(aklog::LogLevel::WARNING,
+        std::format("Cannot open perf event {}: {}", event.name,
+                    strerror(errno)));
+  return std::nullopt;
+}
+
+std::string ReadParanoidLevel() {
+  std::ifstream file(PERF_EVENT_PARANOID_PATH);
+  std::string level;
+  if (!file || !std::getline(file, level)) {
+    return "unknown";
+  }
+  return level;
+}
+
+} // namespace
+
+std::vector<std::string> GetAvailablePerfCounterNames() {
+  std::vector<std::string> names;
+  for (const PerfEvent &event : PERF_EVENTS) {
+    names.push_back(event.name);
+  }
+  return names;
+}
+
+bool SetPerfCounters(const std::vector<std::string> &names) {
+  g_events.clear();
+  g_event_names.clear();
+
+  bool needs_fallback = false;
+  for (const std::string &name : names) {
+    const PerfEvent *event =
+        std::find_if(std::begin(PERF_EVENTS), std::end(PERF_EVENTS),
+                     [&](const PerfEvent &e) { return name == e.name; });
+    if (event == std::end(PERF_EVENTS)) {
+      AKLOG(aklog::LogLevel::ERROR,
+            std::format("Unknown perf counter: {}", name));
+      g_events.clear();
+      g_event_names.clear();
+      return false;
+    }
+    if (std::find(g_event_names.begin(), g_event_names.end(), name) !=
+        g_event_names.end()) {
+      continue;
+    }
+    const std::optional<ConfiguredEvent> configured = ProbeEvent(*event);
+    if (!configured.has_value()) {
+      needs_fallback |= event->type == PERF_TYPE_HARDWARE;
+      continue;
+    }
+    g_events.push_back(configured.value());
+    g_event_names.push_back(name);
+  }
+
+  if (needs_fallback && std::find(g_event_names.begin(), g_event_names.end(),
+                                  FALLBACK_EVENT.name) ==
+                            g_event_names.end()) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("Hardware events are not available (perf_event_paranoid "
+                      "is {}), falling back to {}",
+                      ReadParanoidLevel(), FALLBACK_EVENT.name));
+    const std::optional<ConfiguredEvent> fallback = ProbeEvent(FALLBACK_EVENT);
+    if (fallback.has_value()) {
+      g_events.push_back(fallback.value());
+      g_event_names.push_back(FALLBACK_EVENT.name);
+    }
+  }
+
+  for (const ConfiguredEvent &configured : g_events) {
+    if (configured.exclude_kernel) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("perf_event_paranoid is {}, {} counts user space only",
+                        ReadParanoidLevel(), configured.event.name));
+    }
+  }
+
+  if (g_events.empty()) {
+    AKLOG(aklog::LogLevel::ERROR, "None of the perf counters can be opened");
+    return false;
+  }
+  if (g_events.size() > MAX_PERF_COUNTERS) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("At most {} perf counters are supported",
+                      MAX_PERF_COUNTERS));
+    g_events.clear();
+    g_event_names.clear();
+    return false;
+  }
+
+  if (g_totals == nullptr) {
+    void *totals = mmap(nullptr, sizeof(PerfCounterTotals),
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1,
+                        0);
+    AKCHECK(totals != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+    g_totals = new (totals) PerfCounterTotals();
+  }
+  ResetPerfCounters();
+  return true;
+}
+
+const std::vector<std::string> &GetPerfCounterNames() { return g_event_names; }
+
+void ResetPerfCounters() {
+  if (g_totals == nullptr) {
+    return;
+  }
+  for (int peer = 0; peer < NUM_PERF_PEERS; ++peer) {
+    for (int i = 0; i < MAX_PERF_COUNTERS; ++i) {
+      g_totals->values[peer][i] = 0;
+    }
+    g_totals->num_regions[peer] = 0;
+  }
+}
+
+std::vector<std::pair<std::string, double>>
+GetPerfCounterMetrics(const std::string &unit, double num_units) {
+  std::vector<std::pair<std::string, double>> metrics;
+  if (g_totals == nullptr || num_units <= 0) {
+    return metrics;
+  }
+  for (int peer : {PARENT_PEER, CHILD_PEER}) {
+    if (g_totals->num_regions[peer] == 0) {
+      continue;
+    }
+    for (size_t i = 0; i < g_event_names.size(); ++i) {
+      std::string name = g_event_names[i];
+      std::replace(name.begin(), name.end(), '-', '_');
+      metrics.emplace_back(
+          std::format("{}_{}_per_{}", peer == PARENT_PEER ? "parent" : "child",
+                      name, unit),
+          g_totals->values[peer][i] / num_units);
+    }
+  }
+  return metrics;
+}
+
+PerfCounters::PerfCounters(int peer, int num_warmups)
+    : peer_(peer), num_warmups_(num_warmups) {
+  AKCHECK(0 <= peer && peer < NUM_PERF_PEERS,
+          std::format("Invalid peer for perf counters: {}", peer));
+  for (const ConfiguredEvent &configured : g_events) {
+    const int fd = OpenEvent(configured, fds_.empty() ? -1 : fds_[0]);
+    if (fd == -1) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("Cannot open perf event {}: {}", configured.event.name,
+                        strerror(errno)));
+      for (int opened : fds_) {
+        close(opened);
+      }
+      fds_.clear();
+      return;
+    }
+    fds_.push_back(fd);
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds_) {
+    close(fd);
+  }
+}
+
+bool PerfCounters::Read(std::vector<uint64_t> *buffer) const {
+  buffer->resize(3 + fds_.size());
+  const ssize_t size =
+      read(fds_[0], buffer->data(), buffer->size() * sizeof(uint64_t));
+  if (size != static_cast<ssize_t>(buffer->size() * sizeof(uint64_t))) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("Failed to read perf counters: {}", strerror(errno)));
+    return false;
+  }
+  return true;
+}
+
+void PerfCounters::Start() {
+  if (fds_.empty()) {
+    return;
+  }
+  ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  std::vector<uint64_t> buffer;
+  if (Read(&buffer)) {
+    start_time_enabled_ = buffer[1];
+    start_time_running_ = buffer[2];
+  }
+  ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::Stop() {
+  if (fds_.empty()) {
+    return;
+  }
+  ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  if (num_regions_++ < num_warmups_) {
+    return;
+  }
+
+  std::vector<uint64_t> buffer;
+  if (!Read(&buffer)) {
+    return;
+  }
+  const uint64_t time_enabled = buffer[1] - start_time_enabled_;
+  const uint64_t time_running = buffer[2] - start_time_running_;
+  // Scale the counts up if the group was multiplexed with other events.
+  double scale = 0.0;
+  if (time_running != 0) {
+    scale = static_cast<double>(time_enabled) / time_running;
+  }
+  for (size_t i = 0; i < fds_.size(); ++i) {
+    g_totals->values[peer_][i] += std::llround(buffer[3 + i] * scale);
+  }
+  g_totals->num_regions[peer_]++;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr const char *PERF_EVENT_PARANOID_PATH =
+    "/proc/sys/kernel/perf_event_paranoid";
+
+// Names accepted by SetPerfCounters, e.g. for the help message.
+std::vector<std::string> GetAvailablePerfCounterNames();
+
+// Configure the counters that PerfCounters opens, e.g. {"cycles",
+// "instructions", "context-switches"}. This must happen before any benchmark
+// forks, because the totals live in memory shared with the forked peers.
+//
+// Every event is probed once here. If kernel events are not allowed by
+// perf_event_paranoid, only user space is counted. Hardware events that still
+// cannot be opened, e.g. in VMs without a PMU, are replaced by the software
+// event task-clock. Returns false if a name is unknown or no event can be
+// opened at all.
+bool SetPerfCounters(const std::vector<std::string> &names);
+
+// Names of the configured counters after the fallback. Empty if counting is
+// off.
+const std::vector<std::string> &GetPerfCounterNames();
+
+// Clear the totals of all peers.
+void ResetPerfCounters();
+
+// Totals since ResetPerfCounters() as metrics named
+// "<peer>_<counter>_per_<unit>", e.g. "child_cycles_per_byte", where peer is
+// parent or child. Peers that counted nothing are left out.
+std::vector<std::pair<std::string, double>>
+GetPerfCounterMetrics(const std::string &unit, double num_units);
+
+// A group of the configured counters for the calling thread. Start() and
+// Stop() bracket the timed region of one iteration and Stop() adds the counts
+// to the totals of the peer. The first num_warmups regions are not added.
+// Does nothing when counting is off.
+class PerfCounters {
+public:
+  PerfCounters(int peer, int num_warmups);
+  ~PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  void Start();
+  void Stop();
+
+private:
+  // Read nr, time_enabled, time_running and one value per event of the
+  // group. Returns false and warns if the read fails.
+  bool Read(std::vector<uint64_t> *buffer) const;
+
+  const int peer_;
+  const int num_warmups_;
+  int num_regions_ = 0;
+  std::vector<int> fds_;
+  // PERF_EVENT_IOC_RESET clears the counts but not the times, so Start()
+  // records them to scale the counts by the times of the region.
+  uint64_t start_time_enabled_ = 0;
+  uint64_t start_time_running_ = 0;
+};
@@ -0,0 +1,107 @@
+#include "perf_counters.h"
+
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <print>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "aklog.h"
+#include "topology.h"
+
+namespace {
+
+constexpr size_t PAGE_SIZE_BYTES = 4096;
+constexpr size_t NUM_PAGES = 64;
+
+double GetMetric(const std::vector<std::pair<std::string, double>> &metrics,
+                 const std::string &key) {
+  for (const auto &[name, value] : metrics) {
+    if (name == key) {
+      return value;
+    }
+  }
+  AKCHECK(false, std::format("Metric {} is missing", key));
+  return 0;
+}
+
+// Fault in NUM_PAGES fresh pages.
+void TouchFreshPages() {
+  const size_t size = PAGE_SIZE_BYTES * NUM_PAGES;
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  AKCHECK(memory != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+  for (size_t i = 0; i < NUM_PAGES; ++i) {
+    static_cast<volatile uint8_t *>(memory)[i * PAGE_SIZE_BYTES] = 1;
+  }
+  munmap(memory, size);
+}
+
+void testUnknownCounter() {
+  AKCHECK(!SetPerfCounters({"cycles", "no-such-counter"}),
+          "Unknown counter should be rejected");
+  AKCHECK(GetPerfCounterNames().empty(),
+          "No counter should be configured after an error");
+  std::print("testUnknownCounter passed\n");
+}
+
+void testCountsOfBothPeers() {
+  if (!SetPerfCounters({"page-faults"})) {
+    std::print("testCountsOfBothPeers skipped: perf_event_open is not "
+               "available\n");
+    return;
+  }
+
+  // Do not let the child flush what the parent has printed.
+  fflush(stdout);
+  pid_t pid = fork();
+  AKCHECK(pid != -1, std::format("fork: {}", strerror(errno)));
+  if (pid == 0) {
+    PerfCounters counters(CHILD_PEER, 0);
+    counters.Start();
+    TouchFreshPages();
+    counters.Stop();
+    exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+
+  {
+    // The first region is a warm-up and is not counted.
+    PerfCounters counters(PARENT_PEER, 1);
+    for (int i = 0; i < 3; ++i) {
+      counters.Start();
+      TouchFreshPages();
+      counters.Stop();
+    }
+  }
+
+  const std::vector<std::pair<std::string, double>> metrics =
+      GetPerfCounterMetrics("page", NUM_PAGES);
+  AKCHECK(metrics.size() == 2, "There should be one metric per peer");
+  const double child = GetMetric(metrics, "child_page_faults_per_page");
+  const double parent = GetMetric(metrics, "parent_page_faults_per_page");
+  AKCHECK(child >= 0.9,
+          std::format("Child should fault every page: {}", child));
+  AKCHECK(1.8 <= parent && parent < 3.0,
+          std::format("Parent should fault every page in two regions: {}",
+                      parent));
+
+  ResetPerfCounters();
+  AKCHECK(GetPerfCounterMetrics("page", NUM_PAGES).empty(),
+          "Reset should clear the totals");
+  std::print("testCountsOfBothPeers passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running perf_counters tests...\n");
+
+  testUnknownCounter();
+  testCountsOfBothPeers();
+
+  std::print("All perf_counters tests passed!\n");
+  return 0;
+}
@@ -1,30 +1,50 @@
 #include "pipe_bandwidth.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <format>
+#include <memory>
+#include <span>
 #include <vector>
 
 #include "aklog.h"
 
 #include "barrier.h"
 #include "common.h"
+#include "message_latency.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 
 const std::string BARRIER_ID = GenerateUniqueName("/pipe_benchmark");
 
-void SendProcess(int write_fd, int num_warmups, int num_iterations,
-                 uint64_t data_size, uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
-
-  std::vector<uint8_t> data_to_send = GenerateDataToSend(data_size);
+// How data enters and leaves the pipe.
+//   READ_WRITE: write() and read(), copying into and out of the pipe buffer.
+//   VMSPLICE:   The sender maps its page-aligned buffer into the pipe with
+//               vmsplice(SPLICE_F_GIFT), so only read() copies.
+//   SPLICE:     The receiver moves the pipe buffers into a memfd with
+//               splice() instead of reading them into user memory.
+enum class PipeMode { READ_WRITE, VMSPLICE, SPLICE };
+
+void SendProcess(PipeMode mode, int write_fd, int num_warmups,
+                 int num_iterations, uint64_t data_size, uint64_t buffer_size) {
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
+
+  // vmsplice() needs whole pages to avoid copying, and the pages must not
+  // change while they are in the pipe. The data is page aligned and sealed.
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
   std::vector<double> durations;
 
+  PerfCounters counters(CHILD_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -41,20 +61,33 @@ void SendProcess(int write_fd, int num_warmups, int num_iterations,
 
     barrier.Wait();
     size_t total_sent = 0;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     while (total_sent < data_size) {
       size_t bytes_to_send = std::min(buffer_size, data_size - total_sent);
-      ssize_t bytes_written =
-          write(write_fd, data_to_send.data() + total_sent, bytes_to_send);
+      ssize_t bytes_written;
+      if (mode == PipeMode::VMSPLICE) {
+        struct iovec iov = {.iov_base = const_cast<uint8_t *>(
+                                data_to_send.data() + total_sent),
+                            .iov_len = bytes_to_send};
+        bytes_written = vmsplice(write_fd, &iov, 1, SPLICE_F_GIFT);
+      } else {
+        bytes_written =
+            write(write_fd, data_to_send.data() + total_sent, bytes_to_send);
+      }
       if (bytes_written == -1) {
         AKLOG(aklog::LogLevel::FATAL,
-              std::format("send: write: {}", strerror(errno)));
+              std::format("send: {}: {}",
+                          mode == PipeMode::VMSPLICE ? "vmsplice" : "write",
+                          strerror(errno)));
       }
       total_sent += bytes_written;
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (!is_warmup) {
       std::chrono::duration<double> elapsed_time = end_time - start_time;
@@ -77,12 +110,44 @@ void SendProcess(int write_fd, int num_warmups, int num_iterations,
   AKLOG(aklog::LogLevel::DEBUG, std::format("{}Exiting.", SendPrefix(-1)));
 }
 
-BenchmarkResult ReceiveProcess(int read_fd, int num_warmups, int num_iterations,
-                               uint64_t data_size, uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+// Receives data_size bytes by splicing them from the pipe into sink_fd and
+// returns the number of bytes received.
+size_t SpliceToFile(int read_fd, int sink_fd, uint64_t data_size,
+                    uint64_t buffer_size) {
+  loff_t offset = 0;
+  while (static_cast<uint64_t>(offset) < data_size) {
+    const ssize_t bytes_spliced =
+        splice(read_fd, nullptr, sink_fd, &offset,
+               std::min<uint64_t>(buffer_size, data_size - offset),
+               SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (bytes_spliced == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("receive: splice: {}", strerror(errno)));
+    }
+    if (bytes_spliced == 0) {
+      break;
+    }
+  }
+  return offset;
+}
+
+BenchmarkResult ReceiveProcess(PipeMode mode, int read_fd, int num_warmups,
+                               int num_iterations, uint64_t data_size,
+                               uint64_t buffer_size) {
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
+
+  int sink_fd = -1;
+  if (mode == PipeMode::SPLICE) {
+    sink_fd = memfd_create("akbench_pipe_splice", MFD_CLOEXEC);
+    if (sink_fd == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("receive: memfd_create: {}", strerror(errno)));
+    }
+  }
 
   std::vector<double> durations;
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -97,15 +162,24 @@ BenchmarkResult ReceiveProcess(int read_fd, int num_warmups, int num_iterations,
                         iteration, num_iterations));
     }
 
-    std::vector<uint8_t> recv_buffer(buffer_size);
+    // The read() modes collect the data here. SPLICE verifies the memfd.
+    std::vector<uint8_t> recv_buffer;
     std::vector<uint8_t> received_data;
-    received_data.reserve(data_size);
+    if (mode != PipeMode::SPLICE) {
+      recv_buffer.resize(buffer_size);
+      received_data.reserve(data_size);
+    }
 
     barrier.Wait();
     size_t total_received = 0;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    while (total_received < data_size) {
+    if (mode == PipeMode::SPLICE) {
+      total_received = SpliceToFile(read_fd, sink_fd, data_size, buffer_size);
+    }
+    while (mode != PipeMode::SPLICE && total_received < data_size) {
       ssize_t bytes_read = read(read_fd, recv_buffer.data(), buffer_size);
       if (bytes_read == -1) {
         AKLOG(aklog::LogLevel::FATAL,
@@ -125,6 +199,7 @@ BenchmarkResult ReceiveProcess(int read_fd, int num_warmups, int num_iterations,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (!is_warmup) {
       std::chrono::duration<double> elapsed_time = end_time - start_time;
@@ -135,7 +210,24 @@ BenchmarkResult ReceiveProcess(int read_fd, int num_warmups, int num_iterations,
                         elapsed_time.count() * 1000));
     }
 
-    if (!VerifyDataReceived(received_data, data_size)) {
+    bool verified = false;
+    if (mode != PipeMode::SPLICE) {
+      verified = VerifyDataReceived(received_data, data_size);
+    } else if (total_received == data_size) {
+      // Verify the spliced data in place through a mapping of the memfd.
+      void *mapped =
+          mmap(nullptr, data_size, PROT_READ, MAP_SHARED, sink_fd, 0);
+      if (mapped == MAP_FAILED) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("receive: mmap: {}", strerror(errno)));
+      }
+      verified = VerifyDataReceived(
+          std::span<const uint8_t>(static_cast<const uint8_t *>(mapped),
+                                   data_size),
+          data_size);
+      munmap(mapped, data_size);
+    }
+    if (!verified) {
       AKLOG(aklog::LogLevel::FATAL, std::format("{}Data verification failed!",
                                                 ReceivePrefix(iteration)));
     } else {
@@ -152,16 +244,17 @@ BenchmarkResult ReceiveProcess(int read_fd, int num_warmups, int num_iterations,
                     GIBYTE_PER_SEC_UNIT));
 
   close(read_fd);
+  if (sink_fd != -1) {
+    close(sink_fd);
+  }
   AKLOG(aklog::LogLevel::DEBUG, std::format("{}Exiting.", ReceivePrefix(-1)));
 
   return result;
 }
 
-} // namespace
-
-BenchmarkResult RunPipeBandwidthBenchmark(int num_iterations, int num_warmups,
-                                          uint64_t data_size,
-                                          uint64_t buffer_size) {
+BenchmarkResult RunPipeBandwidth(PipeMode mode, int num_iterations,
+                                 int num_warmups, uint64_t data_size,
+                                 uint64_t buffer_size) {
   int pipe_fds[2];
   if (pipe(pipe_fds) == -1) {
     AKLOG(aklog::LogLevel::FATAL, std::format("pipe: {}", strerror(errno)));
@@ -177,15 +270,67 @@ BenchmarkResult RunPipeBandwidthBenchmark(int num_iterations, int num_warmups,
   }
 
   if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
     close(read_fd);
-    SendProcess(write_fd, num_warmups, num_iterations, data_size, buffer_size);
+    SendProcess(mode, write_fd, num_warmups, num_iterations, data_size,
+                buffer_size);
     exit(0);
   } else {
+    ScopedPeerAffinity affinity(PARENT_PEER);
     close(write_fd);
     BenchmarkResult result = ReceiveProcess(
-        read_fd, num_warmups, num_iterations, data_size, buffer_size);
+        mode, read_fd, num_warmups, num_iterations, data_size, buffer_size);
     waitpid(pid, nullptr, 0);
-    SenseReversingBarrier::ClearResource(BARRIER_ID);
+    SenseReversingBarrier::ClearResource(PairName(BARRIER_ID));
     return result;
   }
 }
+
+} // namespace
+
+BenchmarkResult RunPipeBandwidthBenchmark(int num_iterations, int num_warmups,
+                                          uint64_t data_size,
+                                          uint64_t buffer_size) {
+  return RunPipeBandwidth(PipeMode::READ_WRITE, num_iterations, num_warmups,
+                          data_size, buffer_size);
+}
+
+BenchmarkResult RunPipeVmspliceBandwidthBenchmark(int num_iterations,
+                                                  int num_warmups,
+                                                  uint64_t data_size,
+                                                  uint64_t buffer_size) {
+  return RunPipeBandwidth(PipeMode::VMSPLICE, num_iterations, num_warmups,
+                          data_size, buffer_size);
+}
+
+BenchmarkResult RunPipeSpliceBandwidthBenchmark(int num_iterations,
+                                                int num_warmups,
+                                                uint64_t data_size,
+                                                uint64_t buffer_size) {
+  return RunPipeBandwidth(PipeMode::SPLICE, num_iterations, num_warmups,
+                          data_size, buffer_size);
+}
+
+BenchmarkResult RunPipeLatencyBenchmark(int num_iterations, int num_warmups,
+                                        uint64_t loop_size,
+                                        uint64_t message_size) {
+  int to_child[2];
+  int to_parent[2];
+  if (pipe(to_child) == -1 || pipe(to_parent) == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("pipe: {}", strerror(errno)));
+  }
+
+  return RunMessageLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, message_size,
+      [&](int peer) -> std::unique_ptr<MessageEndpoint> {
+        if (peer == PARENT_PEER) {
+          close(to_child[0]);
+          close(to_parent[1]);
+          return std::make_unique<FdMessageEndpoint>(to_child[1],
+                                                     to_parent[0]);
+        }
+        close(to_child[1]);
+        close(to_parent[0]);
+        return std::make_unique<FdMessageEndpoint>(to_parent[1], to_child[0]);
+      });
+}
@@ -6,3 +6,21 @@
 BenchmarkResult RunPipeBandwidthBenchmark(int num_iterations, int num_warmups,
                                           uint64_t data_size,
                                           uint64_t buffer_size);
+
+// The sender maps its pages into the pipe with vmsplice(SPLICE_F_GIFT).
+BenchmarkResult RunPipeVmspliceBandwidthBenchmark(int num_iterations,
+                                                  int num_warmups,
+                                                  uint64_t data_size,
+                                                  uint64_t buffer_size);
+
+// The receiver splices the pipe into a memfd instead of reading it.
+BenchmarkResult RunPipeSpliceBandwidthBenchmark(int num_iterations,
+                                                int num_warmups,
+                                                uint64_t data_size,
+                                                uint64_t buffer_size);
+
+// Round trips of message_size bytes over a pair of anonymous pipes. Reports
+// the one-trip latency.
+BenchmarkResult RunPipeLatencyBenchmark(int num_iterations, int num_warmups,
+                                        uint64_t loop_size,
+                                        uint64_t message_size);
@@ -15,6 +15,22 @@ int main(int argc, char *argv[]) {
       num_iterations, num_warmups, data_size, buffer_size);
 
   AKCHECK(result.average >= 0.0, "Bandwidth should be non-negative");
+
+  // Several pages, with a tail that does not fill a page.
+  constexpr uint64_t splice_data_size = (1 << 18) + 100;
+  constexpr uint64_t splice_buffer_size = 1 << 16;
+  const BenchmarkResult vmsplice_result = RunPipeVmspliceBandwidthBenchmark(
+      num_iterations, num_warmups, splice_data_size, splice_buffer_size);
+  AKCHECK(vmsplice_result.average >= 0.0,
+          "vmsplice bandwidth should be non-negative");
+  const BenchmarkResult splice_result = RunPipeSpliceBandwidthBenchmark(
+      num_iterations, num_warmups, splice_data_size, splice_buffer_size);
+  AKCHECK(splice_result.average >= 0.0,
+          "splice bandwidth should be non-negative");
+
+  const BenchmarkResult latency_result =
+      RunPipeLatencyBenchmark(num_iterations, num_warmups, 10, 64);
+  AKCHECK(latency_result.average > 0.0, "Latency should be positive");
   AKLOG(aklog::LogLevel::INFO, "pipe_bandwidth test passed");
 
   return 0;
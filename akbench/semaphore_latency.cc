@@ -14,6 +14,9 @@
 #include "aklog.h"
 
 #include "common.h"
+#include "histogram.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 
@@ -26,7 +29,8 @@ void CleanupSemaphores() {
 }
 
 std::vector<double> ParentProcess(int num_iterations, int num_warmups,
-                                  uint64_t loop_size) {
+                                  uint64_t loop_size,
+                                  LatencyHistogram *histogram) {
   std::vector<double> durations;
 
   sem_t *parent_sem = sem_open(SEM_NAME_PARENT.c_str(), 0);
@@ -37,11 +41,13 @@ std::vector<double> ParentProcess(int num_iterations, int num_warmups,
   AKCHECK(child_sem != SEM_FAILED,
           std::format("Failed to open child semaphore: {}", strerror(errno)));
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   for (int i = 0; i < num_iterations + num_warmups; ++i) {
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("Parent: Starting iteration {}/{}", i + 1,
                       (num_iterations + num_warmups)));
 
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     for (uint64_t j = 0; j < loop_size; ++j) {
@@ -50,6 +56,7 @@ std::vector<double> ParentProcess(int num_iterations, int num_warmups,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (i >= num_warmups) {
       std::chrono::duration<double> duration = end_time - start_time;
@@ -60,13 +67,23 @@ std::vector<double> ParentProcess(int num_iterations, int num_warmups,
     }
   }
 
+  // Time each round trip separately in one more pass to get the latency
+  // distribution. The clock reads are kept out of the passes above so that
+  // they do not inflate the average.
+  LatencyRecorder recorder(histogram);
+  for (uint64_t j = 0; j < loop_size; ++j) {
+    sem_post(child_sem);
+    sem_wait(parent_sem);
+    recorder.Tick();
+  }
+
   sem_close(parent_sem);
   sem_close(child_sem);
 
   return durations;
 }
 
-void ChildProcess(uint64_t loop_size, int total_iterations) {
+void ChildProcess(int num_iterations, int num_warmups, uint64_t loop_size) {
   sem_t *parent_sem = sem_open(SEM_NAME_PARENT.c_str(), 0);
   AKCHECK(parent_sem != SEM_FAILED,
           std::format("Failed to open parent semaphore: {}", strerror(errno)));
@@ -75,14 +92,24 @@ void ChildProcess(uint64_t loop_size, int total_iterations) {
   AKCHECK(child_sem != SEM_FAILED,
           std::format("Failed to open child semaphore: {}", strerror(errno)));
 
-  for (int i = 0; i < total_iterations; ++i) {
-    AKLOG(aklog::LogLevel::DEBUG, std::format("Child: Starting iteration {}/{}",
-                                              i + 1, total_iterations));
+  PerfCounters counters(CHILD_PEER, num_warmups);
+  for (int i = 0; i < num_iterations + num_warmups; ++i) {
+    AKLOG(aklog::LogLevel::DEBUG,
+          std::format("Child: Starting iteration {}/{}", i + 1,
+                      num_iterations + num_warmups));
 
+    counters.Start();
     for (uint64_t j = 0; j < loop_size; ++j) {
       sem_wait(child_sem);
       sem_post(parent_sem);
     }
+    counters.Stop();
+  }
+
+  // The histogram pass of the parent
+  for (uint64_t j = 0; j < loop_size; ++j) {
+    sem_wait(child_sem);
+    sem_post(parent_sem);
   }
 
   sem_close(parent_sem);
@@ -117,14 +144,20 @@ BenchmarkResult RunSemaphoreLatencyBenchmark(int num_iterations,
   }
 
   if (pid == 0) {
-    ChildProcess(loop_size, num_iterations + num_warmups);
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    ChildProcess(num_iterations, num_warmups, loop_size);
     exit(0);
   } else {
+    ScopedPeerAffinity affinity(PARENT_PEER);
+    LatencyHistogram histogram;
     std::vector<double> durations =
-        ParentProcess(num_iterations, num_warmups, loop_size);
+        ParentProcess(num_iterations, num_warmups, loop_size, &histogram);
 
     waitpid(pid, nullptr, 0);
     CleanupSemaphores();
-    return CalculateOneTripDuration(durations);
+    BenchmarkResult result = CalculateOneTripDuration(durations);
+    // Each recorded round trip consists of two one-way trips.
+    result.percentiles = histogram.Percentiles(1e-9 / 2);
+    return result;
   }
 }
@@ -18,6 +18,9 @@
 
 #include "barrier.h"
 #include "common.h"
+#include "message_latency.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 const std::string SHM_NAME = GenerateUniqueName("/shm_bandwidth_test");
@@ -30,11 +33,36 @@ struct SharedBuffer {
 
 void CleanupResources() { shm_unlink(SHM_NAME.c_str()); }
 
+// Path of the segment on hugetlbfs, or empty for POSIX shared memory
+std::string SegmentPath(PageSize page_size) {
+  const std::string shm_path = "/dev/shm" + PairName(SHM_NAME);
+  const std::string path = HugePagePath(shm_path, page_size);
+  return path == shm_path ? "" : path;
+}
+
+int OpenSegment(const std::string &segment_path, int flags) {
+  return segment_path.empty()
+             ? shm_open(PairName(SHM_NAME).c_str(), flags, 0666)
+             : open(segment_path.c_str(), flags, 0666);
+}
+
+void RemoveSegment(const std::string &segment_path) {
+  if (segment_path.empty()) {
+    shm_unlink(PairName(SHM_NAME).c_str());
+  } else {
+    unlink(segment_path.c_str());
+  }
+}
+
 BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
-                               uint64_t data_size, uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+                               uint64_t data_size, uint64_t buffer_size,
+                               PageSize page_size,
+                               const std::string &segment_path) {
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
   std::vector<double> durations;
+  std::vector<std::pair<std::string, double>> backing_metrics;
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -49,8 +77,9 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     }
 
     // Create shared memory
-    const size_t shared_buffer_size = sizeof(SharedBuffer) + 2 * buffer_size;
-    int shm_fd = shm_open(SHM_NAME.c_str(), O_CREAT | O_RDWR, 0666);
+    const size_t shared_buffer_size = RoundUpToPageSize(
+        sizeof(SharedBuffer) + 2 * buffer_size, page_size);
+    int shm_fd = OpenSegment(segment_path, O_CREAT | O_RDWR);
     if (shm_fd == -1) {
       AKLOG(aklog::LogLevel::FATAL,
             std::format("receive: shm_open: {}", strerror(errno)));
@@ -64,11 +93,12 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     SharedBuffer *shared_buffer = static_cast<SharedBuffer *>(
         mmap(NULL, shared_buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED,
              shm_fd, 0));
-    memset(shared_buffer, 0, shared_buffer_size);
     if (shared_buffer == MAP_FAILED) {
       AKLOG(aklog::LogLevel::FATAL,
             std::format("receive: mmap: {}", strerror(errno)));
     }
+    AdviseHugePages(shared_buffer, shared_buffer_size, page_size);
+    memset(shared_buffer, 0, shared_buffer_size);
 
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}Shared memory and semaphores initialized",
@@ -81,6 +111,8 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     uint64_t bytes_received = 0;
     constexpr uint64_t PIPELINE_INDEX = 1;
     const uint64_t n_pipeline = (data_size + buffer_size - 1) / buffer_size + 1;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
     for (uint64_t i = 0; i < n_pipeline; ++i) {
       barrier.Wait();
@@ -91,6 +123,7 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
       bytes_received += shared_buffer->data_size[(i + PIPELINE_INDEX) % 2];
     }
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
     barrier.Wait();
 
     if (!is_warmup) {
@@ -111,13 +144,17 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
                                                 ReceivePrefix(iteration)));
     }
 
+    if (iteration == num_warmups + num_iterations - 1) {
+      AddPageBackingMetrics(backing_metrics, "shm", shared_buffer, page_size);
+    }
     munmap(shared_buffer, shared_buffer_size);
     close(shm_fd);
-    CleanupResources();
+    RemoveSegment(segment_path);
   }
 
   BenchmarkResult result =
       CalculateBandwidth(durations, num_iterations, data_size);
+  result.metrics = std::move(backing_metrics);
   AKLOG(aklog::LogLevel::INFO,
         std::format("Receive bandwidth: {:.3f} ± {:.3f}{}.",
                     result.average / (1 << 30), result.stddev / (1 << 30),
@@ -127,11 +164,13 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
 }
 
 void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
-                 uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
-  std::vector<uint8_t> data_to_send = GenerateDataToSend(data_size);
+                 uint64_t buffer_size, PageSize page_size,
+                 const std::string &segment_path) {
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
   std::vector<double> durations;
 
+  PerfCounters counters(CHILD_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -147,8 +186,9 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
 
     barrier.Wait();
     // Open existing shared memory
-    const size_t shared_buffer_size = sizeof(SharedBuffer) + 2 * buffer_size;
-    int shm_fd = shm_open(SHM_NAME.c_str(), O_RDWR, 0666);
+    const size_t shared_buffer_size = RoundUpToPageSize(
+        sizeof(SharedBuffer) + 2 * buffer_size, page_size);
+    int shm_fd = OpenSegment(segment_path, O_RDWR);
     if (shm_fd == -1) {
       AKLOG(aklog::LogLevel::FATAL,
             std::format("send: shm_open: {}", strerror(errno)));
@@ -166,6 +206,8 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
     uint64_t bytes_send = 0;
     constexpr uint64_t PIPELINE_INDEX = 0;
     const uint64_t n_pipeline = (data_size + buffer_size - 1) / buffer_size + 1;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}n_pipeline: {}", SendPrefix(iteration), n_pipeline));
@@ -179,6 +221,7 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
       bytes_send += size_to_send;
     }
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
     barrier.Wait();
 
     if (!is_warmup) {
@@ -205,9 +248,11 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
 
 BenchmarkResult RunShmBandwidthBenchmark(int num_iterations, int num_warmups,
                                          uint64_t data_size,
-                                         uint64_t buffer_size) {
-  SenseReversingBarrier::ClearResource(BARRIER_ID);
-  CleanupResources();
+                                         uint64_t buffer_size,
+                                         PageSize page_size) {
+  SenseReversingBarrier::ClearResource(PairName(BARRIER_ID));
+  const std::string segment_path = SegmentPath(page_size);
+  RemoveSegment(segment_path);
 
   pid_t pid = fork();
 
@@ -217,12 +262,44 @@ BenchmarkResult RunShmBandwidthBenchmark(int num_iterations, int num_warmups,
   }
 
   if (pid == 0) {
-    SendProcess(num_warmups, num_iterations, data_size, buffer_size);
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    SendProcess(num_warmups, num_iterations, data_size, buffer_size, page_size,
+                segment_path);
     exit(0);
   } else {
+    ScopedPeerAffinity affinity(PARENT_PEER);
     BenchmarkResult result =
-        ReceiveProcess(num_warmups, num_iterations, data_size, buffer_size);
+        ReceiveProcess(num_warmups, num_iterations, data_size, buffer_size,
+                       page_size, segment_path);
     waitpid(pid, nullptr, 0);
     return result;
   }
 }
+
+BenchmarkResult RunShmLatencyBenchmark(int num_iterations, int num_warmups,
+                                       uint64_t loop_size,
+                                       uint64_t message_size) {
+  CleanupResources();
+  const size_t region_size = SharedMessageRegionSize(message_size);
+  int shm_fd = shm_open(SHM_NAME.c_str(), O_CREAT | O_RDWR, 0666);
+  if (shm_fd == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("shm_open: {}", strerror(errno)));
+  }
+  if (ftruncate(shm_fd, region_size) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("ftruncate: {}", strerror(errno)));
+  }
+  // The child inherits the mapping.
+  void *region = mmap(nullptr, region_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, shm_fd, 0);
+  if (region == MAP_FAILED) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("mmap: {}", strerror(errno)));
+  }
+  close(shm_fd);
+  CleanupResources();
+
+  return RunMessageLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, message_size, [&](int peer) {
+        return OpenSharedMemoryEndpoint(region, message_size, peer);
+      });
+}
@@ -1,8 +1,19 @@
 #pragma once
 
 #include "common.h"
+#include "huge_pages.h"
 #include <cstdint>
 
-BenchmarkResult RunShmBandwidthBenchmark(int num_iterations, int num_warmups,
-                                         uint64_t data_size,
-                                         uint64_t buffer_size);
+// Streams data through a POSIX shared memory segment. With HUGE_2M or HUGE_1G
+// the segment is a file on a hugetlbfs mount when one is available. Reports
+// the backing actually obtained as metrics.
+BenchmarkResult
+RunShmBandwidthBenchmark(int num_iterations, int num_warmups,
+                         uint64_t data_size, uint64_t buffer_size,
+                         PageSize page_size = PageSize::DEFAULT);
+
+// Round trips of message_size bytes through POSIX shared memory. Reports the
+// one-trip latency.
+BenchmarkResult RunShmLatencyBenchmark(int num_iterations, int num_warmups,
+                                       uint64_t loop_size,
+                                       uint64_t message_size);
@@ -0,0 +1,137 @@
+#include "shm_ring_bandwidth.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <string>
+#include <vector>
+
+#include "aklog.h"
+
+#include "barrier.h"
+#include "common.h"
+#include "perf_counters.h"
+#include "topology.h"
+
+namespace {
+const std::string BARRIER_ID = GenerateUniqueName("/shm_ring_benchmark");
+
+BenchmarkResult ReceiveProcess(SpscRing &ring, int num_warmups,
+                               int num_iterations, uint64_t data_size) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+  std::vector<double> durations;
+  std::vector<uint8_t> received_data(data_size, 0);
+
+  PerfCounters counters(PARENT_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    bool is_warmup = iteration < num_warmups;
+
+    std::fill(received_data.begin(), received_data.end(), 0);
+    barrier.Wait();
+    uint64_t bytes_received = 0;
+    counters.Start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    while (bytes_received < data_size) {
+      const std::span<const uint8_t> slot = ring.BeginRead();
+      memcpy(received_data.data() + bytes_received, slot.data(), slot.size());
+      bytes_received += slot.size();
+      ring.EndRead();
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
+    ring.Flush();
+    barrier.Wait();
+
+    if (!is_warmup) {
+      std::chrono::duration<double> elapsed_time = end_time - start_time;
+      durations.push_back(elapsed_time.count());
+
+      AKLOG(aklog::LogLevel::DEBUG,
+            std::format("{}Time taken: {} ms.", ReceivePrefix(iteration),
+                        elapsed_time.count() * 1000));
+    }
+
+    // Verify received data (always, even during warmup)
+    if (!VerifyDataReceived(received_data, data_size)) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("{}Data verification failed!",
+                                                ReceivePrefix(iteration)));
+    } else {
+      AKLOG(aklog::LogLevel::DEBUG, std::format("{}Data verification passed.",
+                                                ReceivePrefix(iteration)));
+    }
+  }
+  AKLOG(aklog::LogLevel::DEBUG,
+        std::format("{}Slept {} times.", ReceivePrefix(-1), ring.num_sleeps()));
+
+  BenchmarkResult result =
+      CalculateBandwidth(durations, num_iterations, data_size);
+  AKLOG(aklog::LogLevel::INFO,
+        std::format("Receive bandwidth: {:.3f} ± {:.3f}{}.",
+                    result.average / (1 << 30), result.stddev / (1 << 30),
+                    GIBYTE_PER_SEC_UNIT));
+
+  return result;
+}
+
+void SendProcess(SpscRing &ring, int num_warmups, int num_iterations,
+                 uint64_t data_size) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
+
+  PerfCounters counters(CHILD_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    barrier.Wait();
+    uint64_t bytes_sent = 0;
+    counters.Start();
+    while (bytes_sent < data_size) {
+      const uint64_t size_to_send =
+          std::min(data_size - bytes_sent, ring.slot_size());
+      memcpy(ring.BeginWrite(), data_to_send.data() + bytes_sent,
+             size_to_send);
+      ring.EndWrite(size_to_send);
+      bytes_sent += size_to_send;
+    }
+    ring.Flush();
+    counters.Stop();
+    barrier.Wait();
+  }
+  AKLOG(aklog::LogLevel::DEBUG,
+        std::format("{}Slept {} times.", SendPrefix(-1), ring.num_sleeps()));
+}
+
+} // namespace
+
+BenchmarkResult RunShmRingBandwidthBenchmark(int num_iterations,
+                                             int num_warmups,
+                                             uint64_t data_size,
+                                             uint64_t buffer_size,
+                                             const ShmRingOptions &options) {
+  SenseReversingBarrier::ClearResource(BARRIER_ID);
+  SpscRing ring(options.num_slots, buffer_size, options.batch,
+                options.wait_strategy);
+
+  pid_t pid = fork();
+
+  if (pid == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("Fork failed: {}", strerror(errno)));
+  }
+
+  if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    SendProcess(ring, num_warmups, num_iterations, data_size);
+    exit(0);
+  } else {
+    ScopedPeerAffinity affinity(PARENT_PEER);
+    BenchmarkResult result =
+        ReceiveProcess(ring, num_warmups, num_iterations, data_size);
+    waitpid(pid, nullptr, 0);
+    return result;
+  }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "common.h"
+#include "spsc_ring.h"
+#include <cstdint>
+
+constexpr uint32_t DEFAULT_SHM_RING_SLOTS = 16;
+constexpr uint32_t DEFAULT_SHM_RING_BATCH = 4;
+
+struct ShmRingOptions {
+  // Number of slots in the ring, a power of two. Each slot holds buffer_size
+  // bytes.
+  uint32_t num_slots = DEFAULT_SHM_RING_SLOTS;
+  // Number of slots after which each side publishes its index
+  uint32_t batch = DEFAULT_SHM_RING_BATCH;
+  RingWaitStrategy wait_strategy = RingWaitStrategy::SPIN_FUTEX;
+};
+
+// Streams data_size bytes through a single-producer single-consumer ring in
+// shared memory. Unlike RunShmBandwidthBenchmark, the sender and receiver
+// only wait for each other when the ring is full or empty.
+BenchmarkResult RunShmRingBandwidthBenchmark(int num_iterations,
+                                             int num_warmups,
+                                             uint64_t data_size,
+                                             uint64_t buffer_size,
+                                             const ShmRingOptions &options);
@@ -0,0 +1,27 @@
+#include "shm_ring_bandwidth.h"
+
+#include <cstdint>
+
+#include "aklog.h"
+
+int main(int argc, char *argv[]) {
+
+  constexpr int num_iterations = 3;
+  constexpr int num_warmups = 1;
+  // More data than the ring holds, with a tail that does not fill a slot
+  constexpr uint64_t data_size = (1 << 16) + 100;
+  constexpr uint64_t buffer_size = 1024;
+
+  for (RingWaitStrategy strategy :
+       {RingWaitStrategy::SPIN, RingWaitStrategy::SPIN_FUTEX,
+        RingWaitStrategy::EVENTFD}) {
+    const ShmRingOptions options = {
+        .num_slots = 8, .batch = 3, .wait_strategy = strategy};
+    const BenchmarkResult result = RunShmRingBandwidthBenchmark(
+        num_iterations, num_warmups, data_size, buffer_size, options);
+    AKCHECK(result.average >= 0.0, "Bandwidth should be non-negative");
+  }
+  AKLOG(aklog::LogLevel::INFO, "shm_ring_bandwidth test passed");
+
+  return 0;
+}
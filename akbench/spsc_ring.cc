@@ -0,0 +1,221 @@
+#include "spsc_ring.h"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <new>
+
+#include "aklog.h"
+#include "futex.h"
+
+namespace {
+
+// Number of polls before SPIN_FUTEX and EVENTFD go to sleep
+constexpr int RING_SPIN_COUNT = 1024;
+constexpr size_t RING_PAGE_SIZE = 4096;
+
+std::string UniqueShmName() {
+  static std::atomic<uint32_t> counter{0};
+  return std::format("/akbench_spsc_ring_{}_{}", getpid(), counter++);
+}
+
+size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+const char *RingWaitStrategyToString(RingWaitStrategy strategy) {
+  switch (strategy) {
+  case RingWaitStrategy::SPIN:
+    return "spin";
+  case RingWaitStrategy::SPIN_FUTEX:
+    return "spin-futex";
+  case RingWaitStrategy::EVENTFD:
+    return "eventfd";
+  }
+  return "unknown";
+}
+
+std::optional<RingWaitStrategy>
+StringToRingWaitStrategy(const std::string &strategy_str) {
+  if (strategy_str == "spin")
+    return RingWaitStrategy::SPIN;
+  if (strategy_str == "spin-futex")
+    return RingWaitStrategy::SPIN_FUTEX;
+  if (strategy_str == "eventfd")
+    return RingWaitStrategy::EVENTFD;
+  return std::nullopt;
+}
+
+SpscRing::SpscRing(uint32_t num_slots, uint64_t slot_size, uint32_t batch,
+                   RingWaitStrategy strategy)
+    : num_slots_(num_slots), slot_size_(slot_size), batch_(batch),
+      strategy_(strategy), shm_name_(UniqueShmName()) {
+  // The indices wrap around at 2^32, which must be a multiple of num_slots.
+  AKCHECK(num_slots > 0 && (num_slots & (num_slots - 1)) == 0,
+          std::format("num_slots must be a power of two, got: {}", num_slots));
+  AKCHECK(0 < batch && batch <= num_slots,
+          std::format("batch must be between 1 and {}, got: {}", num_slots,
+                      batch));
+
+  const size_t lengths_offset = RoundUp(sizeof(Header), 64);
+  const size_t slots_offset = RoundUp(
+      lengths_offset + num_slots * sizeof(uint64_t), RING_PAGE_SIZE);
+  mapping_size_ = slots_offset + num_slots * slot_size;
+
+  const int shm_fd = shm_open(shm_name_.c_str(), O_CREAT | O_EXCL | O_RDWR,
+                              0600);
+  if (shm_fd == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("shm_open {}: {}", shm_name_, strerror(errno)));
+  }
+  if (ftruncate(shm_fd, mapping_size_) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("ftruncate {}: {}", shm_name_, strerror(errno)));
+  }
+  mapping_ = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  shm_fd, 0);
+  if (mapping_ == MAP_FAILED) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("mmap {}: {}", shm_name_, strerror(errno)));
+  }
+  // The forked peer inherits the mapping, so the name is not needed anymore.
+  close(shm_fd);
+  shm_unlink(shm_name_.c_str());
+
+  uint8_t *base = static_cast<uint8_t *>(mapping_);
+  header_ = new (base) Header();
+  lengths_ = reinterpret_cast<uint64_t *>(base + lengths_offset);
+  slots_ = base + slots_offset;
+
+  if (strategy_ == RingWaitStrategy::EVENTFD) {
+    data_event_fd_ = eventfd(0, EFD_CLOEXEC);
+    space_event_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (data_event_fd_ == -1 || space_event_fd_ == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("eventfd: {}", strerror(errno)));
+    }
+  }
+}
+
+SpscRing::~SpscRing() {
+  munmap(mapping_, mapping_size_);
+  if (data_event_fd_ != -1) {
+    close(data_event_fd_);
+    close(space_event_fd_);
+  }
+}
+
+uint8_t *SpscRing::BeginWrite() {
+  while (local_tail_ - cached_head_ == num_slots_) {
+    cached_head_ = header_->head.load(std::memory_order_acquire);
+    if (local_tail_ - cached_head_ == num_slots_) {
+      // The consumer may be waiting for the slots we have not published.
+      Flush();
+      WaitWhile(&header_->head, cached_head_, &header_->producer_sleeping,
+                space_event_fd_);
+    }
+  }
+  return slots_ + (local_tail_ % num_slots_) * slot_size_;
+}
+
+void SpscRing::EndWrite(uint64_t length) {
+  lengths_[local_tail_ % num_slots_] = length;
+  ++local_tail_;
+  if (local_tail_ - published_tail_ >= batch_) {
+    PublishTail();
+  }
+}
+
+std::span<const uint8_t> SpscRing::BeginRead() {
+  while (local_head_ == cached_tail_) {
+    cached_tail_ = header_->tail.load(std::memory_order_acquire);
+    if (local_head_ == cached_tail_) {
+      // The producer may be waiting for the slots we have not published.
+      Flush();
+      WaitWhile(&header_->tail, cached_tail_, &header_->consumer_sleeping,
+                data_event_fd_);
+    }
+  }
+  const uint32_t index = local_head_ % num_slots_;
+  return {slots_ + index * slot_size_, lengths_[index]};
+}
+
+void SpscRing::EndRead() {
+  ++local_head_;
+  if (local_head_ - published_head_ >= batch_) {
+    PublishHead();
+  }
+}
+
+void SpscRing::Flush() {
+  if (local_tail_ != published_tail_) {
+    PublishTail();
+  }
+  if (local_head_ != published_head_) {
+    PublishHead();
+  }
+}
+
+void SpscRing::PublishTail() {
+  published_tail_ = local_tail_;
+  // Sequentially consistent, so that either the consumer sees the new tail
+  // after it announces that it sleeps, or we see the announcement in Wake().
+  header_->tail.store(local_tail_);
+  Wake(&header_->tail, &header_->consumer_sleeping, data_event_fd_);
+}
+
+void SpscRing::PublishHead() {
+  published_head_ = local_head_;
+  header_->head.store(local_head_);
+  Wake(&header_->head, &header_->producer_sleeping, space_event_fd_);
+}
+
+void SpscRing::WaitWhile(std::atomic<uint32_t> *index, uint32_t value,
+                         std::atomic<uint32_t> *sleeping, int event_fd) {
+  for (int i = 0; i < RING_SPIN_COUNT || strategy_ == RingWaitStrategy::SPIN;
+       ++i) {
+    if (index->load(std::memory_order_acquire) != value) {
+      return;
+    }
+    CpuRelax();
+  }
+
+  sleeping->store(1);
+  while (index->load() == value) {
+    ++num_sleeps_;
+    if (strategy_ == RingWaitStrategy::SPIN_FUTEX) {
+      FutexWait(index, value, /*private_futex=*/false);
+    } else {
+      // A count left over from an earlier wake-up only makes us check again.
+      uint64_t count;
+      if (read(event_fd, &count, sizeof(count)) == -1 && errno != EINTR) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("read eventfd: {}", strerror(errno)));
+      }
+    }
+  }
+  sleeping->store(0);
+}
+
+void SpscRing::Wake(std::atomic<uint32_t> *index,
+                    std::atomic<uint32_t> *sleeping, int event_fd) {
+  if (strategy_ == RingWaitStrategy::SPIN || sleeping->load() == 0) {
+    return;
+  }
+  if (strategy_ == RingWaitStrategy::SPIN_FUTEX) {
+    FutexWake(index, 1, /*private_futex=*/false);
+  } else {
+    const uint64_t one = 1;
+    if (write(event_fd, &one, sizeof(one)) == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("write eventfd: {}", strerror(errno)));
+    }
+  }
+}
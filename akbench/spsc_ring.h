@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+// How a side of SpscRing waits for its peer.
+//   SPIN:       Busy-wait on the index of the peer.
+//   SPIN_FUTEX: Spin for a while, then sleep with FUTEX_WAIT on the index of
+//               the peer until it wakes us with FUTEX_WAKE.
+//   EVENTFD:    Spin for a while, then block in read(2) on an eventfd that
+//               the peer writes.
+enum class RingWaitStrategy { SPIN, SPIN_FUTEX, EVENTFD };
+
+const char *RingWaitStrategyToString(RingWaitStrategy strategy);
+std::optional<RingWaitStrategy>
+StringToRingWaitStrategy(const std::string &strategy_str);
+
+// A single-producer single-consumer ring of fixed-size slots in POSIX shared
+// memory. Create it before fork(). Then one process only produces and the
+// other only consumes through its copy of the object.
+//
+// The head and tail indices live on their own cache lines. Each side keeps
+// its progress private and publishes it every batch slots, or before it has
+// to wait, so that the peer's cache line is invalidated once per batch
+// rather than once per slot.
+class SpscRing {
+public:
+  SpscRing(uint32_t num_slots, uint64_t slot_size, uint32_t batch,
+           RingWaitStrategy strategy);
+  ~SpscRing();
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  // Producer: the next free slot of slot_size bytes, waiting for the
+  // consumer if the ring is full.
+  uint8_t *BeginWrite();
+  // Producer: pass the slot from BeginWrite() with length bytes of data on.
+  void EndWrite(uint64_t length);
+
+  // Consumer: the data of the next filled slot, waiting for the producer if
+  // the ring is empty.
+  std::span<const uint8_t> BeginRead();
+  // Consumer: return the slot from BeginRead() to the producer.
+  void EndRead();
+
+  // Publish the progress of the calling side that is not yet published.
+  void Flush();
+
+  uint64_t slot_size() const { return slot_size_; }
+  // Number of times the calling side went to sleep
+  uint64_t num_sleeps() const { return num_sleeps_; }
+
+private:
+  struct Header {
+    // Next slot the producer fills. Written by the producer.
+    alignas(64) std::atomic<uint32_t> tail{0};
+    // Next slot the consumer drains. Written by the consumer.
+    alignas(64) std::atomic<uint32_t> head{0};
+    // Whether the side is about to sleep and has to be woken up
+    alignas(64) std::atomic<uint32_t> consumer_sleeping{0};
+    alignas(64) std::atomic<uint32_t> producer_sleeping{0};
+  };
+
+  // Wait until the peer's index differs from value.
+  void WaitWhile(std::atomic<uint32_t> *index, uint32_t value,
+                 std::atomic<uint32_t> *sleeping, int event_fd);
+  void Wake(std::atomic<uint32_t> *index, std::atomic<uint32_t> *sleeping,
+            int event_fd);
+  void PublishTail();
+  void PublishHead();
+
+  const uint32_t num_slots_;
+  const uint64_t slot_size_;
+  const uint32_t batch_;
+  const RingWaitStrategy strategy_;
+  const std::string shm_name_;
+
+  void *mapping_ = nullptr;
+  size_t mapping_size_ = 0;
+  Header *header_ = nullptr;
+  uint64_t *lengths_ = nullptr;
+  uint8_t *slots_ = nullptr;
+  // Written by the producer when data arrives and the consumer when space
+  // frees up, with EVENTFD.
+  int data_event_fd_ = -1;
+  int space_event_fd_ = -1;
+
+  // Private progress of the calling side and its last view of the peer
+  uint32_t local_tail_ = 0;
+  uint32_t local_head_ = 0;
+  uint32_t cached_tail_ = 0;
+  uint32_t cached_head_ = 0;
+  uint32_t published_tail_ = 0;
+  uint32_t published_head_ = 0;
+  uint64_t num_sleeps_ = 0;
+};
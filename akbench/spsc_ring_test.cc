@@ -0,0 +1,84 @@
+#include "spsc_ring.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <print>
+
+#include "aklog.h"
+
+namespace {
+
+constexpr uint64_t NUM_MESSAGES = 10000;
+// SPIN only hands over when the scheduler switches on machines with one CPU.
+constexpr uint64_t NUM_SPIN_MESSAGES = 100;
+
+void testStringConversion() {
+  for (RingWaitStrategy strategy :
+       {RingWaitStrategy::SPIN, RingWaitStrategy::SPIN_FUTEX,
+        RingWaitStrategy::EVENTFD}) {
+    AKCHECK(StringToRingWaitStrategy(RingWaitStrategyToString(strategy)) ==
+                strategy,
+            "Wait strategies should round-trip through strings");
+  }
+  AKCHECK(!StringToRingWaitStrategy("sleep").has_value(),
+          "Unknown wait strategy should be rejected");
+  std::print("testStringConversion passed\n");
+}
+
+// The consumer should see every message of a forked producer in order, with
+// the length it was written with, while the ring wraps around many times.
+void testOrderAcrossProcesses(RingWaitStrategy strategy) {
+  SpscRing ring(4, sizeof(uint64_t), 3, strategy);
+  const uint64_t num_messages =
+      strategy == RingWaitStrategy::SPIN ? NUM_SPIN_MESSAGES : NUM_MESSAGES;
+
+  // Do not let the child flush what the parent has printed.
+  fflush(stdout);
+  pid_t pid = fork();
+  AKCHECK(pid != -1, std::format("fork: {}", strerror(errno)));
+  if (pid == 0) {
+    for (uint64_t i = 0; i < num_messages; ++i) {
+      memcpy(ring.BeginWrite(), &i, sizeof(i));
+      ring.EndWrite(i % sizeof(i) + 1);
+    }
+    ring.Flush();
+    exit(0);
+  }
+
+  for (uint64_t i = 0; i < num_messages; ++i) {
+    const std::span<const uint8_t> slot = ring.BeginRead();
+    AKCHECK(slot.size() == i % sizeof(i) + 1,
+            std::format("Message {} has length {}", i, slot.size()));
+    uint64_t value = 0;
+    memcpy(&value, slot.data(), slot.size());
+    const uint64_t mask =
+        slot.size() == sizeof(i) ? ~0ULL : (1ULL << (8 * slot.size())) - 1;
+    AKCHECK(value == (i & mask),
+            std::format("Message {} has value {}", i, value));
+    ring.EndRead();
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  AKCHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+          "Producer should exit normally");
+  std::print("testOrderAcrossProcesses({}) passed\n",
+             RingWaitStrategyToString(strategy));
+}
+
+} // namespace
+
+int main() {
+  std::print("Running spsc_ring tests...\n");
+
+  testStringConversion();
+  testOrderAcrossProcesses(RingWaitStrategy::SPIN);
+  testOrderAcrossProcesses(RingWaitStrategy::SPIN_FUTEX);
+  testOrderAcrossProcesses(RingWaitStrategy::EVENTFD);
+
+  std::print("All spsc_ring tests passed!\n");
+  return 0;
+}
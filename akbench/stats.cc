@@ -0,0 +1,110 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <numeric>
+#include <random>
+
+#include "aklog.h"
+
+namespace {
+
+// Scale factor that makes the MAD a consistent estimator of the standard
+// deviation for normally distributed samples.
+constexpr double MAD_TO_STDDEV = 1.4826;
+
+double MedianOfSorted(const std::vector<double> &sorted) {
+  const size_t n = sorted.size();
+  if (n % 2 == 1) {
+    return sorted[n / 2];
+  }
+  return (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0;
+}
+
+double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return MedianOfSorted(values);
+}
+
+// Mean of sorted values after dropping TRIM_FRACTION of them from each end.
+double TrimmedMeanOfSorted(const std::vector<double> &sorted) {
+  const size_t trim = static_cast<size_t>(sorted.size() * TRIM_FRACTION);
+  return std::accumulate(sorted.begin() + trim, sorted.end() - trim, 0.0) /
+         (sorted.size() - 2 * trim);
+}
+
+} // namespace
+
+SampleStatistics ComputeSampleStatistics(const std::vector<double> &samples) {
+  AKCHECK(!samples.empty(), "samples must not be empty");
+
+  std::vector<double> sorted = samples;
+  std::sort(sorted.begin(), sorted.end());
+  const double median = MedianOfSorted(sorted);
+
+  std::vector<double> deviations;
+  deviations.reserve(sorted.size());
+  for (double x : sorted) {
+    deviations.push_back(std::abs(x - median));
+  }
+  const double mad = Median(deviations);
+
+  // With MAD == 0 more than half of the samples are identical and the
+  // modified z-score is undefined, so keep everything.
+  std::vector<double> inliers;
+  inliers.reserve(sorted.size());
+  for (double x : sorted) {
+    if (mad == 0.0 ||
+        std::abs(x - median) / (MAD_TO_STDDEV * mad) <= OUTLIER_Z_SCORE) {
+      inliers.push_back(x);
+    }
+  }
+
+  const size_t trim = static_cast<size_t>(inliers.size() * TRIM_FRACTION);
+  const double trimmed_mean = TrimmedMeanOfSorted(inliers);
+  double variance = 0.0;
+  for (size_t i = trim; i < inliers.size() - trim; ++i) {
+    variance += std::pow(inliers[i] - trimmed_mean, 2);
+  }
+  variance /= inliers.size() - 2 * trim;
+
+  // Percentile bootstrap of the trimmed mean. The seed is fixed so that the
+  // same samples always give the same interval.
+  std::mt19937 engine(0);
+  std::uniform_int_distribution<size_t> index_dist(0, inliers.size() - 1);
+  std::vector<double> resample(inliers.size());
+  std::vector<double> estimates;
+  estimates.reserve(NUM_BOOTSTRAP_RESAMPLES);
+  for (int i = 0; i < NUM_BOOTSTRAP_RESAMPLES; ++i) {
+    for (double &x : resample) {
+      x = inliers[index_dist(engine)];
+    }
+    std::sort(resample.begin(), resample.end());
+    estimates.push_back(TrimmedMeanOfSorted(resample));
+  }
+  std::sort(estimates.begin(), estimates.end());
+  const double ci_low = estimates[static_cast<size_t>(
+      std::floor(0.025 * (NUM_BOOTSTRAP_RESAMPLES - 1)))];
+  const double ci_high = estimates[static_cast<size_t>(
+      std::ceil(0.975 * (NUM_BOOTSTRAP_RESAMPLES - 1)))];
+
+  return SampleStatistics{
+      .median = median,
+      .mad = mad,
+      .trimmed_mean = trimmed_mean,
+      .trimmed_stddev = std::sqrt(variance),
+      .ci_low = ci_low,
+      .ci_high = ci_high,
+      .num_samples = samples.size(),
+      .num_outliers = samples.size() - inliers.size(),
+  };
+}
+
+double RelativeCiHalfWidth(const SampleStatistics &statistics) {
+  if (statistics.trimmed_mean == 0.0) {
+    return 0.0;
+  }
+  return (statistics.ci_high - statistics.ci_low) / 2.0 /
+         std::abs(statistics.trimmed_mean);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Robust summary of per-iteration benchmark samples.
+struct SampleStatistics {
+  double median;
+  // Median absolute deviation from the median.
+  double mad;
+  // Mean and standard deviation of the inliers after dropping TRIM_FRACTION
+  // of them from each end.
+  double trimmed_mean;
+  double trimmed_stddev;
+  // Bootstrap 95% confidence interval of the trimmed mean.
+  double ci_low;
+  double ci_high;
+  size_t num_samples;
+  size_t num_outliers;
+};
+
+// Samples whose modified z-score |x - median| / (1.4826 * MAD) exceeds this
+// are treated as outliers (Iglewicz and Hoaglin).
+constexpr double OUTLIER_Z_SCORE = 3.5;
+constexpr double TRIM_FRACTION = 0.1;
+constexpr int NUM_BOOTSTRAP_RESAMPLES = 1000;
+
+SampleStatistics ComputeSampleStatistics(const std::vector<double> &samples);
+
+// Half width of the confidence interval relative to the trimmed mean.
+double RelativeCiHalfWidth(const SampleStatistics &statistics);
@@ -0,0 +1,75 @@
+#include "stats.h"
+
+#include <cmath>
+#include <format>
+#include <print>
+#include <vector>
+
+#include "aklog.h"
+
+namespace {
+
+void testConstantSamples() {
+  const std::vector<double> samples(10, 2.0);
+  const SampleStatistics s = ComputeSampleStatistics(samples);
+  AKCHECK(s.median == 2.0, std::format("median should be 2, got {}", s.median));
+  AKCHECK(s.mad == 0.0, std::format("mad should be 0, got {}", s.mad));
+  AKCHECK(s.trimmed_mean == 2.0, "trimmed_mean should be 2");
+  AKCHECK(s.trimmed_stddev == 0.0, "trimmed_stddev should be 0");
+  AKCHECK(s.ci_low == 2.0 && s.ci_high == 2.0, "CI should be [2, 2]");
+  AKCHECK(s.num_samples == 10, "num_samples should be 10");
+  AKCHECK(s.num_outliers == 0, "num_outliers should be 0");
+  AKCHECK(RelativeCiHalfWidth(s) == 0.0, "Relative CI should be 0");
+  std::print("testConstantSamples passed\n");
+}
+
+void testOutlierRejection() {
+  std::vector<double> samples;
+  for (int i = 0; i < 20; ++i) {
+    samples.push_back(100.0 + i % 5);
+  }
+  samples.push_back(10000.0);
+  const SampleStatistics s = ComputeSampleStatistics(samples);
+  AKCHECK(s.num_outliers == 1,
+          std::format("num_outliers should be 1, got {}", s.num_outliers));
+  AKCHECK(s.median == 102.0,
+          std::format("median should be 102, got {}", s.median));
+  AKCHECK(std::abs(s.trimmed_mean - 102.0) < 1.0,
+          std::format("trimmed_mean should be close to 102, got {}",
+                      s.trimmed_mean));
+  AKCHECK(s.ci_low <= s.trimmed_mean && s.trimmed_mean <= s.ci_high,
+          std::format("CI [{}, {}] should contain the trimmed mean {}",
+                      s.ci_low, s.ci_high, s.trimmed_mean));
+  std::print("testOutlierRejection passed\n");
+}
+
+void testConfidenceIntervalShrinks() {
+  std::vector<double> small, large;
+  for (int i = 0; i < 100; ++i) {
+    const double x = 100.0 + (i * 37 % 11);
+    if (i < 10) {
+      small.push_back(x);
+    }
+    large.push_back(x);
+  }
+  const double small_ci = RelativeCiHalfWidth(ComputeSampleStatistics(small));
+  const double large_ci = RelativeCiHalfWidth(ComputeSampleStatistics(large));
+  AKCHECK(large_ci < small_ci,
+          std::format("CI with 100 samples ({}) should be tighter than with 10 "
+                      "samples ({})",
+                      large_ci, small_ci));
+  std::print("testConfidenceIntervalShrinks passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running stats tests...\n");
+
+  testConstantSamples();
+  testOutlierRejection();
+  testConfidenceIntervalShrinks();
+
+  std::print("All stats tests passed!\n");
+  return 0;
+}
@@ -11,6 +11,9 @@
 #include "aklog.h"
 
 #include "common.h"
+#include "histogram.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 BenchmarkResult RunStatfsLatencyBenchmark(int num_iterations, int num_warmups,
                                           uint64_t loop_size) {
@@ -21,8 +24,10 @@ BenchmarkResult RunStatfsLatencyBenchmark(int num_iterations, int num_warmups,
 
   const char *path = ".";
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   std::vector<double> durations;
   for (int i = 0; i < num_iterations + num_warmups; i++) {
+    counters.Start();
     auto start = std::chrono::high_resolution_clock::now();
 
     struct statfs buf;
@@ -31,6 +36,7 @@ BenchmarkResult RunStatfsLatencyBenchmark(int num_iterations, int num_warmups,
     }
 
     auto end = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (i >= num_warmups) {
       std::chrono::duration<double> duration = end - start;
@@ -38,7 +44,19 @@ BenchmarkResult RunStatfsLatencyBenchmark(int num_iterations, int num_warmups,
     }
   }
 
-  return CalculateOneTripDuration(durations);
+  // Time each call separately in one more pass to get the latency
+  // distribution.
+  LatencyHistogram histogram;
+  LatencyRecorder recorder(&histogram);
+  struct statfs buf;
+  for (uint64_t j = 0; j < loop_size; ++j) {
+    statfs(path, &buf);
+    recorder.Tick();
+  }
+
+  BenchmarkResult result = CalculateOneTripDuration(durations);
+  result.percentiles = histogram.Percentiles(1e-9);
+  return result;
 }
 
 BenchmarkResult RunFstatfsLatencyBenchmark(int num_iterations, int num_warmups,
@@ -54,8 +72,10 @@ BenchmarkResult RunFstatfsLatencyBenchmark(int num_iterations, int num_warmups,
     return {-1.0, 0.0};
   }
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   std::vector<double> durations;
   for (int i = 0; i < num_iterations + num_warmups; i++) {
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     struct statfs buf;
@@ -64,6 +84,7 @@ BenchmarkResult RunFstatfsLatencyBenchmark(int num_iterations, int num_warmups,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (i >= num_warmups) {
       std::chrono::duration<double> duration = end_time - start_time;
@@ -71,8 +92,20 @@ BenchmarkResult RunFstatfsLatencyBenchmark(int num_iterations, int num_warmups,
     }
   }
 
+  // Time each call separately in one more pass to get the latency
+  // distribution.
+  LatencyHistogram histogram;
+  LatencyRecorder recorder(&histogram);
+  struct statfs buf;
+  for (uint64_t j = 0; j < loop_size; ++j) {
+    fstatfs(fd, &buf);
+    recorder.Tick();
+  }
+
   close(fd);
-  return CalculateOneTripDuration(durations);
+  BenchmarkResult result = CalculateOneTripDuration(durations);
+  result.percentiles = histogram.Percentiles(1e-9);
+  return result;
 }
 
 BenchmarkResult RunGetpidLatencyBenchmark(int num_iterations, int num_warmups,
@@ -82,8 +115,10 @@ BenchmarkResult RunGetpidLatencyBenchmark(int num_iterations, int num_warmups,
                     "and {} operations per iteration",
                     num_iterations, num_warmups, loop_size));
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   std::vector<double> durations;
   for (int i = 0; i < num_iterations + num_warmups; i++) {
+    counters.Start();
     auto start = std::chrono::high_resolution_clock::now();
 
     for (uint64_t j = 0; j < loop_size; ++j) {
@@ -91,6 +126,7 @@ BenchmarkResult RunGetpidLatencyBenchmark(int num_iterations, int num_warmups,
     }
 
     auto end = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     if (i >= num_warmups) {
       std::chrono::duration<double> duration = end - start;
@@ -98,5 +134,16 @@ BenchmarkResult RunGetpidLatencyBenchmark(int num_iterations, int num_warmups,
     }
   }
 
-  return CalculateOneTripDuration(durations);
+  // Time each call separately in one more pass to get the latency
+  // distribution.
+  LatencyHistogram histogram;
+  LatencyRecorder recorder(&histogram);
+  for (uint64_t j = 0; j < loop_size; ++j) {
+    getpid();
+    recorder.Tick();
+  }
+
+  BenchmarkResult result = CalculateOneTripDuration(durations);
+  result.percentiles = histogram.Percentiles(1e-9);
+  return result;
 }
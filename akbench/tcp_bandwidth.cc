@@ -1,7 +1,11 @@
 #include "tcp_bandwidth.h"
 
 #include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <linux/tcp.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -10,6 +14,8 @@
 #include <chrono>
 #include <cstring>
 #include <format>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -17,18 +23,220 @@
 
 #include "barrier.h"
 #include "common.h"
+#include "message_latency.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 namespace {
 const int PORT = 12345;
 const std::string LOOPBACK_IP = "127.0.0.1";
 const std::string BARRIER_ID = GenerateUniqueName("/tcp_benchmark");
 
-BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
-                               uint64_t data_size, uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+// Each pair of --num-pairs listens on its own port.
+int PairPort() { return PORT + GetPairIndex(); }
+
+// How data crosses the socket.
+//   COPY:     send() and recv() into a buffer, then memcpy into the result.
+//   ZEROCOPY: send() with MSG_ZEROCOPY and map received pages with
+//             TCP_ZEROCOPY_RECEIVE. Each part falls back to copying when the
+//             kernel refuses it.
+enum class TcpMode { COPY, ZEROCOPY };
+
+// Sends with MSG_ZEROCOPY and reaps the completion notifications from the
+// error queue of the socket. The kernel references the sent pages until their
+// notification arrives, so WaitForCompletions() must be called before the
+// data is modified or freed.
+class ZerocopySender {
+public:
+  explicit ZerocopySender(int fd) : fd_(fd) {
+    int one = 1;
+    enabled_ = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    if (!enabled_) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("setsockopt SO_ZEROCOPY: {}, falling back to send()",
+                        strerror(errno)));
+    }
+  }
+
+  ssize_t Send(const uint8_t *data, size_t size) {
+    while (enabled_) {
+      const ssize_t bytes_sent = send(fd_, data, size, MSG_ZEROCOPY);
+      if (bytes_sent >= 0) {
+        ++num_sends_;
+        Reap(false);
+        return bytes_sent;
+      }
+      if (errno != ENOBUFS) {
+        return -1;
+      }
+      // The notifications of earlier sends use up the socket option memory.
+      if (num_completed_ == num_sends_) {
+        break;
+      }
+      Reap(true);
+    }
+    return send(fd_, data, size, 0);
+  }
+
+  void WaitForCompletions() {
+    while (num_completed_ < num_sends_) {
+      Reap(true);
+    }
+  }
+
+  uint32_t num_sends() const { return num_sends_; }
+  // Sends that the kernel copied anyway, e.g. because the receiver is local
+  uint32_t num_copied() const { return num_copied_; }
+
+private:
+  void Reap(bool wait) {
+    if (wait) {
+      // A non-empty error queue is reported as POLLERR.
+      struct pollfd pfd = {.fd = fd_, .events = 0, .revents = 0};
+      poll(&pfd, 1, -1);
+    }
+    while (true) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (recvmsg(fd_, &msg, MSG_ERRQUEUE) == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return;
+        }
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("send: recvmsg MSG_ERRQUEUE: {}", strerror(errno)));
+      }
+      for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+           cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) {
+          continue;
+        }
+        const auto *err =
+            reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cmsg));
+        if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+          continue;
+        }
+        // Notifications of consecutive sends are merged into one range.
+        const uint32_t count = err->ee_data - err->ee_info + 1;
+        num_completed_ += count;
+        if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+          num_copied_ += count;
+        }
+      }
+    }
+  }
+
+  const int fd_;
+  bool enabled_;
+  uint32_t num_sends_ = 0;
+  uint32_t num_completed_ = 0;
+  uint32_t num_copied_ = 0;
+};
+
+// Receives by mapping the pages of the socket receive queue into a window of
+// buffer_size bytes (rounded up to pages) with TCP_ZEROCOPY_RECEIVE. Data that
+// cannot be mapped, e.g. a part of a page, is read with recv(). If the kernel
+// refuses to map, everything is read with recv().
+class ZerocopyReceiver {
+public:
+  ZerocopyReceiver(int fd, uint64_t buffer_size)
+      : fd_(fd), copy_buffer_(buffer_size) {
+    const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    window_size_ = (buffer_size + page_size - 1) / page_size * page_size;
+    window_ = mmap(nullptr, window_size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (window_ == MAP_FAILED) {
+      AKLOG(aklog::LogLevel::WARNING,
+            std::format("mmap of a TCP socket: {}, falling back to recv()",
+                        strerror(errno)));
+    }
+  }
+
+  ~ZerocopyReceiver() {
+    if (window_ != MAP_FAILED) {
+      munmap(window_, window_size_);
+    }
+  }
+
+  // Receives up to data_size bytes into verifier and returns the number of
+  // bytes received, which is less only if the sender closes early.
+  uint64_t Receive(uint64_t data_size, StreamingVerifier *verifier) {
+    uint64_t total_received = 0;
+    while (total_received < data_size) {
+      uint64_t bytes_to_copy = copy_buffer_.size();
+      if (window_ != MAP_FAILED) {
+        struct tcp_zerocopy_receive zc;
+        memset(&zc, 0, sizeof(zc));
+        zc.address = reinterpret_cast<uint64_t>(window_);
+        zc.length = window_size_;
+        socklen_t zc_len = sizeof(zc);
+        if (getsockopt(fd_, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &zc_len) ==
+            -1) {
+          AKLOG(aklog::LogLevel::WARNING,
+                std::format("getsockopt TCP_ZEROCOPY_RECEIVE: {}, falling back "
+                            "to recv()",
+                            strerror(errno)));
+          munmap(window_, window_size_);
+          window_ = MAP_FAILED;
+          continue;
+        }
+        if (zc.err != 0) {
+          AKLOG(aklog::LogLevel::FATAL,
+                std::format("receive: TCP_ZEROCOPY_RECEIVE: {}",
+                            strerror(zc.err)));
+        }
+        if (zc.length > 0) {
+          // The previous pages in the window are unmapped by the next call.
+          verifier->Update(
+              {static_cast<const uint8_t *>(window_), zc.length});
+          total_received += zc.length;
+          mapped_bytes_ += zc.length;
+        }
+        if (zc.recv_skip_hint > 0) {
+          bytes_to_copy = std::min<uint64_t>(bytes_to_copy, zc.recv_skip_hint);
+        } else if (zc.length > 0) {
+          continue;
+        }
+      }
+
+      // Nothing to map yet: block in recv() until data or EOF arrives.
+      const ssize_t bytes_received =
+          recv(fd_, copy_buffer_.data(), bytes_to_copy, 0);
+      if (bytes_received == -1) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("receive: recv: {}", strerror(errno)));
+      }
+      if (bytes_received == 0) {
+        break;
+      }
+      verifier->Update({copy_buffer_.data(),
+                        static_cast<size_t>(bytes_received)});
+      total_received += bytes_received;
+    }
+    return total_received;
+  }
+
+  // Bytes received by mapping pages rather than copying
+  uint64_t mapped_bytes() const { return mapped_bytes_; }
+
+private:
+  const int fd_;
+  uint64_t window_size_;
+  void *window_;
+  std::vector<uint8_t> copy_buffer_;
+  uint64_t mapped_bytes_ = 0;
+};
+
+BenchmarkResult ReceiveProcess(TcpMode mode, int num_warmups,
+                               int num_iterations, uint64_t data_size,
+                               uint64_t buffer_size) {
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
 
   std::vector<double> durations;
+  double mapped_fraction_sum = 0.0;
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     int listen_fd, conn_fd;
@@ -63,7 +271,7 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     memset(&receive_addr, 0, sizeof(receive_addr));
     receive_addr.sin_family = AF_INET;
     receive_addr.sin_addr.s_addr = inet_addr(LOOPBACK_IP.c_str());
-    receive_addr.sin_port = htons(PORT);
+    receive_addr.sin_port = htons(PairPort());
 
     // Bind the socket to the specified IP address and port
     if (bind(listen_fd, (struct sockaddr *)&receive_addr,
@@ -81,7 +289,7 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     barrier.Wait();
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}Listening on {}:{}", ReceivePrefix(iteration),
-                      LOOPBACK_IP, PORT));
+                      LOOPBACK_IP, PairPort()));
 
     // Accept a sender connection for this iteration
     conn_fd = accept(listen_fd, (struct sockaddr *)&send_addr, &send_len);
@@ -97,16 +305,28 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
                         ntohs(send_addr.sin_port)));
     }
 
-    std::vector<uint8_t> recv_buffer(buffer_size);
-    std::vector<uint8_t> received_data(data_size);
-    received_data.reserve(data_size);
+    std::vector<uint8_t> recv_buffer(mode == TcpMode::COPY ? buffer_size : 0);
+    std::vector<uint8_t> received_data(mode == TcpMode::COPY ? data_size : 0);
+    std::optional<ZerocopyReceiver> zerocopy_receiver;
+    StreamingVerifier verifier(data_size);
+    if (mode == TcpMode::ZEROCOPY) {
+      zerocopy_receiver.emplace(conn_fd, buffer_size);
+    }
 
     barrier.Wait();
     size_t total_received = 0;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
+    if (zerocopy_receiver.has_value()) {
+      // The data is checked as it arrives, since the mapped pages are gone
+      // after the next receive. The time of the checks is taken out of the
+      // duration below.
+      total_received = zerocopy_receiver->Receive(data_size, &verifier);
+    }
     // Receive data until data_size is reached
-    while (total_received < data_size) {
+    while (!zerocopy_receiver.has_value() && total_received < data_size) {
       ssize_t bytes_received =
           recv(conn_fd, recv_buffer.data(), buffer_size, 0);
       if (bytes_received == -1) {
@@ -127,11 +347,19 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
     barrier.Wait();
 
     if (!is_warmup) {
-      std::chrono::duration<double> elapsed_time = end_time - start_time;
+      // Leave out the verification, as COPY mode verifies after the clock
+      // stops.
+      std::chrono::duration<double> elapsed_time =
+          end_time - start_time - verifier.update_time();
       durations.push_back(elapsed_time.count());
+      if (zerocopy_receiver.has_value()) {
+        mapped_fraction_sum +=
+            static_cast<double>(zerocopy_receiver->mapped_bytes()) / data_size;
+      }
 
       AKLOG(aklog::LogLevel::DEBUG,
             std::format("{}Received {} GiB of data in {} ms.",
@@ -141,7 +369,10 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
     }
 
     // Verify received data (always, even during warmup)
-    if (!VerifyDataReceived(received_data, data_size)) {
+    const bool verified = zerocopy_receiver.has_value()
+                              ? verifier.Verify()
+                              : VerifyDataReceived(received_data, data_size);
+    if (!verified) {
       AKLOG(aklog::LogLevel::FATAL, std::format("{}Data verification failed!",
                                                 ReceivePrefix(iteration)));
     } else {
@@ -156,6 +387,10 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
 
   BenchmarkResult result =
       CalculateBandwidth(durations, num_iterations, data_size);
+  if (mode == TcpMode::ZEROCOPY) {
+    result.metrics.emplace_back("zerocopy_mapped_fraction",
+                                mapped_fraction_sum / num_iterations);
+  }
 
   AKLOG(aklog::LogLevel::INFO,
         std::format("Receive bandwidth: {:.3f} ± {:.3f}{}.",
@@ -165,13 +400,14 @@ BenchmarkResult ReceiveProcess(int num_warmups, int num_iterations,
   return result;
 }
 
-void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
-                 uint64_t buffer_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+void SendProcess(TcpMode mode, int num_warmups, int num_iterations,
+                 uint64_t data_size, uint64_t buffer_size) {
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
 
-  std::vector<uint8_t> data_to_send = GenerateDataToSend(data_size);
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
   std::vector<double> durations;
 
+  PerfCounters counters(CHILD_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     bool is_warmup = iteration < num_warmups;
@@ -183,7 +419,7 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
     } else {
       AKLOG(aklog::LogLevel::DEBUG,
             std::format("{}Connecting to receiver at {}:{}",
-                        SendPrefix(iteration), LOOPBACK_IP, PORT));
+                        SendPrefix(iteration), LOOPBACK_IP, PairPort()));
     }
 
     int sock_fd;
@@ -200,7 +436,7 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
     memset(&receive_addr, 0, sizeof(receive_addr));
     receive_addr.sin_family = AF_INET;
     receive_addr.sin_addr.s_addr = inet_addr(LOOPBACK_IP.c_str());
-    receive_addr.sin_port = htons(PORT);
+    receive_addr.sin_port = htons(PairPort());
 
     // Wait until the receiver is ready
     barrier.Wait();
@@ -221,22 +457,35 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
                         SendPrefix(iteration)));
     }
 
+    std::optional<ZerocopySender> zerocopy_sender;
+    if (mode == TcpMode::ZEROCOPY) {
+      zerocopy_sender.emplace(sock_fd);
+    }
+
     barrier.Wait();
     size_t total_sent = 0;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     while (total_sent < data_size) {
       size_t bytes_to_send = std::min(buffer_size, data_size - total_sent);
-      ssize_t bytes_sent =
-          send(sock_fd, data_to_send.data() + total_sent, bytes_to_send, 0);
+      const uint8_t *data = data_to_send.data() + total_sent;
+      ssize_t bytes_sent = zerocopy_sender.has_value()
+                               ? zerocopy_sender->Send(data, bytes_to_send)
+                               : send(sock_fd, data, bytes_to_send, 0);
       if (bytes_sent == -1) {
         AKLOG(aklog::LogLevel::FATAL,
               std::format("send: send: {}", strerror(errno)));
       }
       total_sent += bytes_sent;
     }
+    if (zerocopy_sender.has_value()) {
+      zerocopy_sender->WaitForCompletions();
+    }
     shutdown(sock_fd, SHUT_WR);
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
 
     barrier.Wait();
 
@@ -246,6 +495,12 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
       AKLOG(aklog::LogLevel::DEBUG,
             std::format("{}Time taken: {} ms.", SendPrefix(iteration),
                         elapsed_time.count() * 1000));
+      if (zerocopy_sender.has_value()) {
+        AKLOG(aklog::LogLevel::INFO,
+              std::format("{}The kernel copied {} of {} zero-copy sends.",
+                          SendPrefix(iteration), zerocopy_sender->num_copied(),
+                          zerocopy_sender->num_sends()));
+      }
     }
 
     close(sock_fd);
@@ -260,12 +515,10 @@ void SendProcess(int num_warmups, int num_iterations, uint64_t data_size,
                     GIBYTE_PER_SEC_UNIT));
 }
 
-} // namespace
-
-BenchmarkResult RunTcpBandwidthBenchmark(int num_iterations, int num_warmups,
-                                         uint64_t data_size,
-                                         uint64_t buffer_size) {
-  SenseReversingBarrier::ClearResource(BARRIER_ID);
+BenchmarkResult RunTcpBandwidth(TcpMode mode, int num_iterations,
+                                int num_warmups, uint64_t data_size,
+                                uint64_t buffer_size) {
+  SenseReversingBarrier::ClearResource(PairName(BARRIER_ID));
 
   pid_t pid = fork();
   if (pid == -1) {
@@ -273,12 +526,82 @@ BenchmarkResult RunTcpBandwidthBenchmark(int num_iterations, int num_warmups,
   }
 
   if (pid == 0) {
-    SendProcess(num_warmups, num_iterations, data_size, buffer_size);
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    SendProcess(mode, num_warmups, num_iterations, data_size, buffer_size);
     exit(0);
   } else {
-    BenchmarkResult result =
-        ReceiveProcess(num_warmups, num_iterations, data_size, buffer_size);
+    ScopedPeerAffinity affinity(PARENT_PEER);
+    BenchmarkResult result = ReceiveProcess(mode, num_warmups, num_iterations,
+                                            data_size, buffer_size);
     waitpid(pid, nullptr, 0);
     return result;
   }
 }
+
+} // namespace
+
+BenchmarkResult RunTcpBandwidthBenchmark(int num_iterations, int num_warmups,
+                                         uint64_t data_size,
+                                         uint64_t buffer_size) {
+  return RunTcpBandwidth(TcpMode::COPY, num_iterations, num_warmups, data_size,
+                         buffer_size);
+}
+
+BenchmarkResult RunTcpZerocopyBandwidthBenchmark(int num_iterations,
+                                                 int num_warmups,
+                                                 uint64_t data_size,
+                                                 uint64_t buffer_size) {
+  return RunTcpBandwidth(TcpMode::ZEROCOPY, num_iterations, num_warmups,
+                         data_size, buffer_size);
+}
+
+BenchmarkResult RunTcpLatencyBenchmark(int num_iterations, int num_warmups,
+                                       uint64_t loop_size,
+                                       uint64_t message_size) {
+  // Listen before the fork so that the child can connect right away.
+  const int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("socket: {}", strerror(errno)));
+  }
+  int optval = 1;
+  if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &optval,
+                 sizeof(optval)) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("setsockopt SO_REUSEADDR: {}", strerror(errno)));
+  }
+  struct sockaddr_in receive_addr;
+  memset(&receive_addr, 0, sizeof(receive_addr));
+  receive_addr.sin_family = AF_INET;
+  receive_addr.sin_addr.s_addr = inet_addr(LOOPBACK_IP.c_str());
+  receive_addr.sin_port = htons(PORT);
+  if (bind(listen_fd, (struct sockaddr *)&receive_addr,
+           sizeof(receive_addr)) == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("bind: {}", strerror(errno)));
+  }
+  if (listen(listen_fd, 1) == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("listen: {}", strerror(errno)));
+  }
+
+  return RunMessageLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, message_size,
+      [&](int peer) -> std::unique_ptr<MessageEndpoint> {
+        int fd;
+        if (peer == PARENT_PEER) {
+          fd = accept(listen_fd, nullptr, nullptr);
+          AKCHECK(fd != -1, std::format("accept: {}", strerror(errno)));
+        } else {
+          fd = socket(AF_INET, SOCK_STREAM, 0);
+          AKCHECK(fd != -1, std::format("socket: {}", strerror(errno)));
+          AKCHECK(connect(fd, (struct sockaddr *)&receive_addr,
+                          sizeof(receive_addr)) == 0,
+                  std::format("connect: {}", strerror(errno)));
+        }
+        close(listen_fd);
+        // Send each message as soon as it is written.
+        int one = 1;
+        AKCHECK(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) ==
+                    0,
+                std::format("setsockopt TCP_NODELAY: {}", strerror(errno)));
+        return std::make_unique<FdMessageEndpoint>(fd, fd);
+      });
+}
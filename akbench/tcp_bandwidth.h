@@ -6,3 +6,17 @@
 BenchmarkResult RunTcpBandwidthBenchmark(int num_iterations, int num_warmups,
                                          uint64_t data_size,
                                          uint64_t buffer_size);
+
+// Same as RunTcpBandwidthBenchmark but with MSG_ZEROCOPY sends and
+// TCP_ZEROCOPY_RECEIVE. Reports the fraction of bytes the receiver could map
+// as the metric zerocopy_mapped_fraction.
+BenchmarkResult RunTcpZerocopyBandwidthBenchmark(int num_iterations,
+                                                 int num_warmups,
+                                                 uint64_t data_size,
+                                                 uint64_t buffer_size);
+
+// Round trips of message_size bytes over a TCP connection on the loopback
+// interface with TCP_NODELAY. Reports the one-trip latency.
+BenchmarkResult RunTcpLatencyBenchmark(int num_iterations, int num_warmups,
+                                       uint64_t loop_size,
+                                       uint64_t message_size);
@@ -15,6 +15,15 @@ int main(int argc, char *argv[]) {
       num_iterations, num_warmups, data_size, buffer_size);
 
   AKCHECK(result.average >= 0.0, "Bandwidth should be non-negative");
+
+  const BenchmarkResult zerocopy_result = RunTcpZerocopyBandwidthBenchmark(
+      num_iterations, num_warmups, 1 << 20, 64 << 10);
+  AKCHECK(zerocopy_result.average >= 0.0,
+          "Zero-copy bandwidth should be non-negative");
+
+  const BenchmarkResult latency_result =
+      RunTcpLatencyBenchmark(num_iterations, num_warmups, 10, 64);
+  AKCHECK(latency_result.average > 0.0, "Latency should be positive");
   AKLOG(aklog::LogLevel::INFO, "tcp_bandwidth test passed");
 
   return 0;
@@ -0,0 +1,245 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <sstream>
+
+#include "aklog.h"
+
+namespace {
+
+std::optional<CpuPlacement> g_cpu_placement = std::nullopt;
+
+std::optional<std::string> ReadFirstLine(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  std::string line;
+  if (!file || !std::getline(file, line)) {
+    return std::nullopt;
+  }
+  return line;
+}
+
+std::optional<int> ParseNonNegativeInt(const std::string &str) {
+  int value;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (ec != std::errc() || ptr != str.data() + str.size() || value < 0) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+int ReadIntOr(const std::filesystem::path &path, int default_value) {
+  const std::optional<std::string> line = ReadFirstLine(path);
+  if (!line.has_value()) {
+    return default_value;
+  }
+  return ParseNonNegativeInt(line.value()).value_or(default_value);
+}
+
+std::string ReadL3Id(const std::filesystem::path &cpu_dir) {
+  std::error_code ec;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(cpu_dir / "cache", ec)) {
+    if (entry.path().filename().string().starts_with("index") &&
+        ReadIntOr(entry.path() / "level", 0) == 3) {
+      return ReadFirstLine(entry.path() / "shared_cpu_list").value_or("");
+    }
+  }
+  return "";
+}
+
+// First pair of CPUs (in CPU number order) for which matches returns true.
+std::optional<std::vector<int>>
+FindPair(const std::vector<CpuInfo> &topology,
+         const std::function<bool(const CpuInfo &, const CpuInfo &)> &matches) {
+  for (size_t i = 0; i < topology.size(); ++i) {
+    for (size_t j = i + 1; j < topology.size(); ++j) {
+      if (matches(topology[i], topology[j])) {
+        return std::vector<int>{topology[i].cpu, topology[j].cpu};
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+bool SameCore(const CpuInfo &a, const CpuInfo &b) {
+  return a.package_id == b.package_id && a.core_id == b.core_id;
+}
+
+} // namespace
+
+std::optional<std::vector<int>> ParseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    const size_t dash = item.find('-');
+    if (dash == std::string::npos) {
+      const std::optional<int> cpu = ParseNonNegativeInt(item);
+      if (!cpu.has_value()) {
+        return std::nullopt;
+      }
+      cpus.push_back(cpu.value());
+    } else {
+      const std::optional<int> first =
+          ParseNonNegativeInt(item.substr(0, dash));
+      const std::optional<int> last =
+          ParseNonNegativeInt(item.substr(dash + 1));
+      if (!first.has_value() || !last.has_value() || *first > *last) {
+        return std::nullopt;
+      }
+      for (int cpu = *first; cpu <= *last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  if (cpus.empty()) {
+    return std::nullopt;
+  }
+  return cpus;
+}
+
+std::vector<CpuInfo> ReadCpuTopology(const std::string &sysfs_cpu_dir) {
+  const std::filesystem::path root(sysfs_cpu_dir);
+  const std::optional<std::string> online = ReadFirstLine(root / "online");
+  AKCHECK(online.has_value(),
+          std::format("Failed to read {}", (root / "online").string()));
+  const std::optional<std::vector<int>> cpus = ParseCpuList(online.value());
+  AKCHECK(cpus.has_value(),
+          std::format("Invalid online CPU list: {}", online.value()));
+
+  std::vector<CpuInfo> topology;
+  for (int cpu : cpus.value()) {
+    const std::filesystem::path cpu_dir = root / std::format("cpu{}", cpu);
+    topology.push_back(CpuInfo{
+        .cpu = cpu,
+        .package_id = ReadIntOr(cpu_dir / "topology/physical_package_id", 0),
+        .core_id = ReadIntOr(cpu_dir / "topology/core_id", cpu),
+        .l3_id = ReadL3Id(cpu_dir),
+    });
+  }
+  return topology;
+}
+
+std::vector<int> AllowedCpus() {
+  cpu_set_t set;
+  AKCHECK(sched_getaffinity(0, sizeof(set), &set) == 0,
+          std::format("sched_getaffinity: {}", strerror(errno)));
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+int AllowedCpuCount() {
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+    return 1;
+  }
+  return CPU_COUNT(&set);
+}
+
+std::optional<CpuPlacement>
+ResolveCpuPlacement(const std::string &spec,
+                    const std::vector<CpuInfo> &topology,
+                    const std::vector<int> &allowed) {
+  const auto is_allowed = [&allowed](int cpu) {
+    return std::binary_search(allowed.begin(), allowed.end(), cpu);
+  };
+  std::vector<CpuInfo> allowed_topology;
+  std::copy_if(topology.begin(), topology.end(),
+               std::back_inserter(allowed_topology),
+               [&](const CpuInfo &info) { return is_allowed(info.cpu); });
+
+  std::optional<std::vector<int>> cpus;
+  if (spec == "same-core-smt") {
+    cpus = FindPair(allowed_topology, SameCore);
+  } else if (spec == "same-l3") {
+    cpus = FindPair(allowed_topology, [](const CpuInfo &a, const CpuInfo &b) {
+      return !SameCore(a, b) && !a.l3_id.empty() && a.l3_id == b.l3_id;
+    });
+  } else if (spec == "cross-l3") {
+    cpus = FindPair(allowed_topology, [](const CpuInfo &a, const CpuInfo &b) {
+      return a.package_id == b.package_id && a.l3_id != b.l3_id;
+    });
+  } else if (spec == "cross-socket") {
+    cpus = FindPair(allowed_topology, [](const CpuInfo &a, const CpuInfo &b) {
+      return a.package_id != b.package_id;
+    });
+  } else {
+    cpus = ParseCpuList(spec);
+    if (!cpus.has_value()) {
+      AKLOG(aklog::LogLevel::ERROR,
+            std::format("Invalid CPU list or preset: {}", spec));
+      return std::nullopt;
+    }
+    for (int cpu : cpus.value()) {
+      const bool online =
+          std::any_of(topology.begin(), topology.end(),
+                      [cpu](const CpuInfo &info) { return info.cpu == cpu; });
+      if (!online || cpu >= CPU_SETSIZE) {
+        AKLOG(aklog::LogLevel::ERROR, std::format("CPU {} is not online", cpu));
+        return std::nullopt;
+      }
+      if (!is_allowed(cpu)) {
+        AKLOG(aklog::LogLevel::ERROR,
+              std::format("CPU {} is not in the allowed CPUs of this process",
+                          cpu));
+        return std::nullopt;
+      }
+    }
+    return CpuPlacement{.spec = spec, .cpus = cpus.value()};
+  }
+
+  if (!cpus.has_value()) {
+    AKLOG(aklog::LogLevel::ERROR,
+          std::format("This machine has no pair of allowed CPUs for {}",
+                      spec));
+    return std::nullopt;
+  }
+  return CpuPlacement{.spec = spec, .cpus = cpus.value()};
+}
+
+void SetCpuPlacement(const std::optional<CpuPlacement> &placement) {
+  g_cpu_placement = placement;
+}
+
+const std::optional<CpuPlacement> &GetCpuPlacement() {
+  return g_cpu_placement;
+}
+
+ScopedCpuAffinity::ScopedCpuAffinity(const std::vector<int> &cpus) {
+  AKCHECK(sched_getaffinity(0, sizeof(previous_), &previous_) == 0,
+          std::format("sched_getaffinity: {}", strerror(errno)));
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  AKCHECK(sched_setaffinity(0, sizeof(set), &set) == 0,
+          std::format("sched_setaffinity: {}", strerror(errno)));
+}
+
+ScopedCpuAffinity::~ScopedCpuAffinity() {
+  sched_setaffinity(0, sizeof(previous_), &previous_);
+}
+
+ScopedPeerAffinity::ScopedPeerAffinity(int peer) {
+  if (!g_cpu_placement.has_value()) {
+    return;
+  }
+  const std::vector<int> &cpus = g_cpu_placement->cpus;
+  const int cpu = cpus[peer % cpus.size()];
+  affinity_.emplace(std::vector<int>{cpu});
+  AKLOG(aklog::LogLevel::DEBUG,
+        std::format("Pinned peer {} to CPU {}", peer, cpu));
+}
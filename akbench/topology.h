@@ -0,0 +1,84 @@
+#pragma once
+
+#include <optional>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+constexpr const char *SYSFS_CPU_DIR = "/sys/devices/system/cpu";
+
+// Peers of a two-party benchmark. The parent is the process or thread that
+// measures (ReceiveProcess, ParentFlip, ...) and the child is the forked
+// process or spawned thread on the other side.
+constexpr int PARENT_PEER = 0;
+constexpr int CHILD_PEER = 1;
+
+// Where an online CPU sits in the machine, read from sysfs.
+struct CpuInfo {
+  int cpu;
+  int package_id;
+  int core_id;
+  // shared_cpu_list of the L3 cache, or empty if the CPU has no L3
+  std::string l3_id;
+};
+
+// CPUs to pin peers to. Peer i runs on cpus[i % cpus.size()].
+struct CpuPlacement {
+  // The --cpus argument: a preset name or a CPU list like "0,2"
+  std::string spec;
+  std::vector<int> cpus;
+};
+
+// Parse a CPU list in the sysfs format, e.g. "0-3,8,10-11".
+std::optional<std::vector<int>> ParseCpuList(const std::string &list);
+
+// Read the topology of all online CPUs under sysfs_cpu_dir.
+std::vector<CpuInfo>
+ReadCpuTopology(const std::string &sysfs_cpu_dir = SYSFS_CPU_DIR);
+
+// CPUs the calling thread may run on, in increasing order
+std::vector<int> AllowedCpus();
+
+// Number of CPUs the calling thread may run on
+int AllowedCpuCount();
+
+// Resolve a CPU list or one of the presets below to a pair of CPUs.
+//   same-core-smt: SMT siblings of one core
+//   same-l3:       Different cores sharing an L3 cache
+//   cross-l3:      Different L3 caches in one package
+//   cross-socket:  Different packages
+// Only the CPUs in allowed, in increasing order, are picked or accepted, as
+// sched_setaffinity fails on the others. Returns std::nullopt if spec is
+// invalid or the machine has no such pair.
+std::optional<CpuPlacement>
+ResolveCpuPlacement(const std::string &spec,
+                    const std::vector<CpuInfo> &topology,
+                    const std::vector<int> &allowed);
+
+// The placement used by ScopedPeerAffinity. Set it before forking so that
+// all peers agree.
+void SetCpuPlacement(const std::optional<CpuPlacement> &placement);
+const std::optional<CpuPlacement> &GetCpuPlacement();
+
+// Pins the calling thread to the given CPUs with sched_setaffinity and
+// restores the previous affinity on destruction.
+class ScopedCpuAffinity {
+public:
+  explicit ScopedCpuAffinity(const std::vector<int> &cpus);
+  ~ScopedCpuAffinity();
+  ScopedCpuAffinity(const ScopedCpuAffinity &) = delete;
+  ScopedCpuAffinity &operator=(const ScopedCpuAffinity &) = delete;
+
+private:
+  cpu_set_t previous_;
+};
+
+// Pins the calling thread to the CPU of the given peer while it is in scope.
+// Does nothing when no placement is set.
+class ScopedPeerAffinity {
+public:
+  explicit ScopedPeerAffinity(int peer);
+
+private:
+  std::optional<ScopedCpuAffinity> affinity_;
+};
@@ -0,0 +1,154 @@
+#include "topology.h"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+#include <unistd.h>
+
+#include "aklog.h"
+
+namespace {
+
+void WriteFile(const std::filesystem::path &path, const std::string &content) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream file(path);
+  file << content << "\n";
+}
+
+// Five CPUs: 0 and 1 are SMT siblings, 2 is another core sharing their L3,
+// 3 is in the same package behind another L3 and 4 is in another package.
+std::filesystem::path CreateFakeSysfs() {
+  const std::filesystem::path root =
+      std::filesystem::temp_directory_path() /
+      std::format("akbench_topology_test_{}", getpid());
+  std::filesystem::remove_all(root);
+
+  struct FakeCpu {
+    int package_id;
+    int core_id;
+    std::string l3;
+  };
+  const FakeCpu cpus[] = {
+      {0, 0, "0-2"}, {0, 0, "0-2"}, {0, 1, "0-2"}, {0, 2, "3"}, {1, 0, "4"}};
+
+  WriteFile(root / "online", "0-4");
+  for (int cpu = 0; cpu < 5; ++cpu) {
+    const std::filesystem::path dir = root / std::format("cpu{}", cpu);
+    WriteFile(dir / "topology/physical_package_id",
+              std::to_string(cpus[cpu].package_id));
+    WriteFile(dir / "topology/core_id", std::to_string(cpus[cpu].core_id));
+    WriteFile(dir / "cache/index0/level", "1");
+    WriteFile(dir / "cache/index0/shared_cpu_list", std::to_string(cpu));
+    WriteFile(dir / "cache/index3/level", "3");
+    WriteFile(dir / "cache/index3/shared_cpu_list", cpus[cpu].l3);
+  }
+  return root;
+}
+
+void testParseCpuList() {
+  const auto cpus = ParseCpuList("0-2,5,7-8");
+  AKCHECK(cpus.has_value() &&
+              cpus.value() == std::vector<int>({0, 1, 2, 5, 7, 8}),
+          "0-2,5,7-8 should be parsed");
+  AKCHECK(!ParseCpuList("").has_value(), "Empty list should be rejected");
+  AKCHECK(!ParseCpuList("3-1").has_value(), "3-1 should be rejected");
+  AKCHECK(!ParseCpuList("a,b").has_value(), "a,b should be rejected");
+  std::print("testParseCpuList passed\n");
+}
+
+void testPresets() {
+  const std::filesystem::path root = CreateFakeSysfs();
+  const std::vector<CpuInfo> topology = ReadCpuTopology(root.string());
+  const std::vector<int> allowed = {0, 1, 2, 3, 4};
+  AKCHECK(topology.size() == 5,
+          std::format("Expected 5 CPUs, got {}", topology.size()));
+
+  const std::pair<const char *, std::vector<int>> expected[] = {
+      {"same-core-smt", {0, 1}},
+      {"same-l3", {0, 2}},
+      {"cross-l3", {0, 3}},
+      {"cross-socket", {0, 4}},
+      {"4,1", {4, 1}},
+  };
+  for (const auto &[spec, cpus] : expected) {
+    const std::optional<CpuPlacement> placement =
+        ResolveCpuPlacement(spec, topology, allowed);
+    AKCHECK(placement.has_value() && placement->cpus == cpus,
+            std::format("Unexpected placement for {}", spec));
+  }
+  AKCHECK(!ResolveCpuPlacement("5", topology, allowed).has_value(),
+          "Offline CPU should be rejected");
+  AKCHECK(!ResolveCpuPlacement("same-numa", topology, allowed).has_value(),
+          "Unknown preset should be rejected");
+
+  std::filesystem::remove_all(root);
+  std::print("testPresets passed\n");
+}
+
+void testRestrictedCpus() {
+  const std::filesystem::path root = CreateFakeSysfs();
+  const std::vector<CpuInfo> topology = ReadCpuTopology(root.string());
+  // As under taskset -c 1-4
+  const std::vector<int> allowed = {1, 2, 3, 4};
+
+  const std::optional<CpuPlacement> same_l3 =
+      ResolveCpuPlacement("same-l3", topology, allowed);
+  AKCHECK(same_l3.has_value() && same_l3->cpus == std::vector<int>({1, 2}),
+          "same-l3 should skip the CPU that is not allowed");
+  AKCHECK(!ResolveCpuPlacement("same-core-smt", topology, allowed).has_value(),
+          "CPU 1 has no allowed SMT sibling");
+  AKCHECK(!ResolveCpuPlacement("0,1", topology, allowed).has_value(),
+          "A CPU that is not allowed should be rejected");
+  AKCHECK(ResolveCpuPlacement("1,4", topology, allowed).has_value(),
+          "Allowed CPUs should be accepted");
+
+  std::filesystem::remove_all(root);
+  std::print("testRestrictedCpus passed\n");
+}
+
+void testMissingPair() {
+  const std::vector<CpuInfo> topology = {
+      {.cpu = 0, .package_id = 0, .core_id = 0, .l3_id = "0"}};
+  AKCHECK(!ResolveCpuPlacement("same-core-smt", topology, {0}).has_value(),
+          "One CPU has no SMT sibling");
+  AKCHECK(ResolveCpuPlacement("0", topology, {0}).has_value(),
+          "A single CPU should be accepted");
+  std::print("testMissingPair passed\n");
+}
+
+void testScopedPeerAffinity() {
+  cpu_set_t before;
+  sched_getaffinity(0, sizeof(before), &before);
+  const int cpu = AllowedCpus().front();
+
+  SetCpuPlacement(CpuPlacement{.spec = std::to_string(cpu), .cpus = {cpu}});
+  {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    cpu_set_t pinned;
+    sched_getaffinity(0, sizeof(pinned), &pinned);
+    AKCHECK(CPU_COUNT(&pinned) == 1 && CPU_ISSET(cpu, &pinned),
+            std::format("Thread should be pinned to CPU {}", cpu));
+  }
+  SetCpuPlacement(std::nullopt);
+
+  cpu_set_t after;
+  sched_getaffinity(0, sizeof(after), &after);
+  AKCHECK(CPU_EQUAL(&before, &after), "Affinity should be restored");
+  std::print("testScopedPeerAffinity passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running topology tests...\n");
+
+  testParseCpuList();
+  testPresets();
+  testRestrictedCpus();
+  testMissingPair();
+  testScopedPeerAffinity();
+
+  std::print("All topology tests passed!\n");
+  return 0;
+}
@@ -9,6 +9,7 @@
 #include <chrono>
 #include <cstring>
 #include <format>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,9 @@
 
 #include "barrier.h"
 #include "common.h"
+#include "message_latency.h"
+#include "perf_counters.h"
+#include "topology.h"
 
 const std::string SOCKET_PATH =
     GenerateUniqueName("/tmp/unix_domain_socket_test.sock");
@@ -24,11 +28,13 @@ const std::string BARRIER_ID = GenerateUniqueName("/uds_benchmark");
 
 BenchmarkResult ReceiveProcess(uint64_t buffer_size, int num_warmups,
                                int num_iterations, uint64_t data_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
+  const std::string socket_path = PairName(SOCKET_PATH);
 
   std::vector<double> durations;
   std::vector<uint8_t> read_data(data_size, 0x00);
 
+  PerfCounters counters(PARENT_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     int listen_fd, conn_fd;
@@ -37,28 +43,31 @@ BenchmarkResult ReceiveProcess(uint64_t buffer_size, int num_warmups,
     listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
     AKCHECK(listen_fd != -1, "Failed to create socket");
 
-    remove(SOCKET_PATH.c_str());
+    remove(socket_path.c_str());
 
     // Configure the socket address
     memset(&addr, 0, sizeof(addr));
     addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, SOCKET_PATH.c_str(), sizeof(addr.sun_path) - 1);
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
 
     // Bind the socket to the specified path
     if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
       AKLOG(aklog::LogLevel::FATAL,
-            std::format("Failed to bind socket to {}", SOCKET_PATH));
+            std::format("Failed to bind socket to {}", socket_path));
     }
 
     // Listen for incoming connections
     if (listen(listen_fd, 0) == -1) {
       AKLOG(aklog::LogLevel::FATAL,
-            std::format("Failed to listen on socket {}", SOCKET_PATH));
+            std::format("Failed to listen on socket {}", socket_path));
     }
 
+    // Let the sender connect only after the socket of this iteration is
+    // listening. Otherwise it may connect to the previous iteration's socket.
+    barrier.Wait();
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}Waiting for sender connection on {}",
-                      ReceivePrefix(iteration), SOCKET_PATH));
+                      ReceivePrefix(iteration), socket_path));
 
     conn_fd = accept(listen_fd, NULL, NULL);
     AKCHECK(conn_fd != -1, "Failed to accept connection");
@@ -70,6 +79,8 @@ BenchmarkResult ReceiveProcess(uint64_t buffer_size, int num_warmups,
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}Begin receiving data.", ReceivePrefix(iteration)));
     size_t total_received = 0;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     while (total_received < data_size) {
@@ -91,10 +102,11 @@ BenchmarkResult ReceiveProcess(uint64_t buffer_size, int num_warmups,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
     barrier.Wait();
     close(conn_fd);
     close(listen_fd);
-    remove(SOCKET_PATH.c_str());
+    remove(socket_path.c_str());
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}Finished receiving data.", ReceivePrefix(iteration)));
 
@@ -120,11 +132,13 @@ BenchmarkResult ReceiveProcess(uint64_t buffer_size, int num_warmups,
 
 void SendProcess(uint64_t buffer_size, int num_warmups, int num_iterations,
                  uint64_t data_size) {
-  SenseReversingBarrier barrier(2, BARRIER_ID);
+  SenseReversingBarrier barrier(2, PairName(BARRIER_ID));
+  const std::string socket_path = PairName(SOCKET_PATH);
 
-  std::vector<uint8_t> data_to_send = GenerateDataToSend(data_size);
+  const std::span<const uint8_t> data_to_send = GenerateDataToSend(data_size);
   std::vector<double> durations;
 
+  PerfCounters counters(CHILD_PEER, num_warmups);
   for (int iteration = 0; iteration < num_warmups + num_iterations;
        ++iteration) {
     int sock_fd;
@@ -135,11 +149,12 @@ void SendProcess(uint64_t buffer_size, int num_warmups, int num_iterations,
 
     memset(&addr, 0, sizeof(addr));
     addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, SOCKET_PATH.c_str(), sizeof(addr.sun_path) - 1);
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
 
+    barrier.Wait();
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}Connecting to receiver on {}", SendPrefix(iteration),
-                      SOCKET_PATH));
+                      socket_path));
     while (connect(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
       if (errno == ENOENT || errno == ECONNREFUSED) {
         AKLOG(aklog::LogLevel::DEBUG,
@@ -157,6 +172,8 @@ void SendProcess(uint64_t buffer_size, int num_warmups, int num_iterations,
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}Begin data transfer.", SendPrefix(iteration)));
     size_t total_sent = 0;
+    WaitForAllPairs();
+    counters.Start();
     auto start_time = std::chrono::high_resolution_clock::now();
 
     while (total_sent < data_size) {
@@ -175,6 +192,7 @@ void SendProcess(uint64_t buffer_size, int num_warmups, int num_iterations,
     }
 
     auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
     barrier.Wait();
     AKLOG(aklog::LogLevel::DEBUG,
           std::format("{}Finish data transfer", SendPrefix(iteration)));
@@ -200,18 +218,61 @@ void SendProcess(uint64_t buffer_size, int num_warmups, int num_iterations,
 BenchmarkResult RunUdsBandwidthBenchmark(int num_iterations, int num_warmups,
                                          uint64_t data_size,
                                          uint64_t buffer_size) {
-  SenseReversingBarrier::ClearResource(BARRIER_ID);
+  SenseReversingBarrier::ClearResource(PairName(BARRIER_ID));
 
   pid_t pid = fork();
   AKCHECK(pid != -1, "Failed to fork process");
 
   if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
     SendProcess(buffer_size, num_warmups, num_iterations, data_size);
     exit(0);
   } else {
+    ScopedPeerAffinity affinity(PARENT_PEER);
     BenchmarkResult result =
         ReceiveProcess(buffer_size, num_warmups, num_iterations, data_size);
     waitpid(pid, nullptr, 0);
     return result;
   }
 }
+
+BenchmarkResult RunUdsLatencyBenchmark(int num_iterations, int num_warmups,
+                                       uint64_t loop_size,
+                                       uint64_t message_size) {
+  // Listen before the fork so that the child can connect right away.
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  AKCHECK(listen_fd != -1, "Failed to create socket");
+  remove(SOCKET_PATH.c_str());
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, SOCKET_PATH.c_str(), sizeof(addr.sun_path) - 1);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("Failed to bind socket to {}", SOCKET_PATH));
+  }
+  if (listen(listen_fd, 1) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("Failed to listen on socket {}", SOCKET_PATH));
+  }
+
+  BenchmarkResult result = RunMessageLatencyBenchmark(
+      num_iterations, num_warmups, loop_size, message_size,
+      [&](int peer) -> std::unique_ptr<MessageEndpoint> {
+        int fd;
+        if (peer == PARENT_PEER) {
+          fd = accept(listen_fd, NULL, NULL);
+          AKCHECK(fd != -1, "Failed to accept connection");
+        } else {
+          fd = socket(AF_UNIX, SOCK_STREAM, 0);
+          AKCHECK(fd != -1, "Failed to create socket");
+          AKCHECK(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0,
+                  std::format("Failed to connect to {}: {}", SOCKET_PATH,
+                              strerror(errno)));
+        }
+        close(listen_fd);
+        return std::make_unique<FdMessageEndpoint>(fd, fd);
+      });
+  remove(SOCKET_PATH.c_str());
+  return result;
+}
@@ -6,3 +6,9 @@
 BenchmarkResult RunUdsBandwidthBenchmark(int num_iterations, int num_warmups,
                                          uint64_t data_size,
                                          uint64_t buffer_size);
+
+// Round trips of message_size bytes over a Unix domain stream socket.
+// Reports the one-trip latency.
+BenchmarkResult RunUdsLatencyBenchmark(int num_iterations, int num_warmups,
+                                       uint64_t loop_size,
+                                       uint64_t message_size);
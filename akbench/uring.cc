@@ -0,0 +1,226 @@
+#include "uring.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+
+#include "aklog.h"
+
+namespace {
+
+// Milliseconds the SQPOLL thread keeps polling before it goes to sleep
+constexpr unsigned SQ_THREAD_IDLE_MS = 1000;
+
+int IoUringSetup(unsigned entries, io_uring_params *params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+template <typename T> T *Offset(void *base, uint32_t offset) {
+  return reinterpret_cast<T *>(static_cast<uint8_t *>(base) + offset);
+}
+
+} // namespace
+
+bool IsIoUringSupported() {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  const int fd = IoUringSetup(1, &params);
+  if (fd == -1) {
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+bool IsMultishotRecvSupported() {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+    return false;
+  }
+  const uint8_t sent = 1;
+  if (write(fds[1], &sent, 1) != 1) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  // Declared before the ring, so that the armed recv is gone before it is
+  // freed.
+  uint8_t received = 0;
+  IoUring ring(2, false);
+  io_uring_sqe *sqe = ring.GetSqe();
+  sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe->fd = 1;
+  sqe->addr = reinterpret_cast<uint64_t>(&received);
+  sqe->len = 1;
+  sqe->flags = IOSQE_IO_LINK;
+  sqe = ring.GetSqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->fd = fds[0];
+  sqe->user_data = 1;
+  ring.Submit(2);
+
+  bool supported = false;
+  io_uring_cqe cqe;
+  while (ring.PopCompletion(&cqe)) {
+    if (cqe.user_data == 1) {
+      supported = cqe.res == 1 && (cqe.flags & IORING_CQE_F_MORE) != 0;
+    }
+  }
+  close(fds[0]);
+  close(fds[1]);
+  return supported;
+}
+
+IoUring::IoUring(unsigned queue_depth, bool sqpoll) : sqpoll_(sqpoll) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  if (sqpoll) {
+    params.flags |= IORING_SETUP_SQPOLL;
+    params.sq_thread_idle = SQ_THREAD_IDLE_MS;
+  }
+  fd_ = IoUringSetup(queue_depth, &params);
+  if (fd_ == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("io_uring_setup: {}", strerror(errno)));
+  }
+  sq_entries_ = params.sq_entries;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("mmap io_uring SQ ring: {}", strerror(errno)));
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("mmap io_uring CQ ring: {}", strerror(errno)));
+    }
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("mmap io_uring SQEs: {}", strerror(errno)));
+  }
+  sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  sq_head_ = Offset<unsigned>(sq_ring_, params.sq_off.head);
+  sq_tail_ = Offset<unsigned>(sq_ring_, params.sq_off.tail);
+  sq_flags_ = Offset<unsigned>(sq_ring_, params.sq_off.flags);
+  sq_mask_ = *Offset<unsigned>(sq_ring_, params.sq_off.ring_mask);
+  cq_head_ = Offset<unsigned>(cq_ring_, params.cq_off.head);
+  cq_tail_ = Offset<unsigned>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = *Offset<unsigned>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = Offset<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+  // Entry i of the submission queue always refers to SQE i.
+  unsigned *sq_array = Offset<unsigned>(sq_ring_, params.sq_off.array);
+  for (unsigned i = 0; i < params.sq_entries; ++i) {
+    sq_array[i] = i;
+  }
+  local_tail_ = *sq_tail_;
+}
+
+IoUring::~IoUring() {
+  munmap(sqes_, sqes_size_);
+  if (cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  munmap(sq_ring_, sq_ring_size_);
+  close(fd_);
+}
+
+bool IoUring::RegisterBuffers(const std::vector<iovec> &buffers) {
+  if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+              buffers.data(), buffers.size()) == -1) {
+    AKLOG(aklog::LogLevel::WARNING,
+          std::format("io_uring_register buffers: {}", strerror(errno)));
+    return false;
+  }
+  return true;
+}
+
+io_uring_sqe *IoUring::GetSqe() {
+  const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (local_tail_ - head >= sq_entries_) {
+    return nullptr;
+  }
+  io_uring_sqe *sqe = &sqes_[local_tail_ & sq_mask_];
+  memset(sqe, 0, sizeof(*sqe));
+  ++local_tail_;
+  return sqe;
+}
+
+void IoUring::Submit(unsigned wait_nr) {
+  const unsigned to_submit = local_tail_ - *sq_tail_;
+  __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+
+  if (sqpoll_) {
+    // The tail must be visible before the flag is checked, or the thread may
+    // go to sleep without seeing the new entries.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) {
+      Enter(0, 0, IORING_ENTER_SQ_WAKEUP);
+    }
+    while (NumReadyCompletions() < wait_nr) {
+      Enter(0, wait_nr - NumReadyCompletions(), IORING_ENTER_GETEVENTS);
+    }
+    return;
+  }
+
+  if (to_submit == 0 && NumReadyCompletions() >= wait_nr) {
+    return;
+  }
+  unsigned submitted = 0;
+  do {
+    const int ret = Enter(to_submit - submitted, wait_nr,
+                          wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0);
+    submitted += std::max(ret, 0);
+  } while (submitted < to_submit || NumReadyCompletions() < wait_nr);
+}
+
+bool IoUring::PopCompletion(io_uring_cqe *cqe) {
+  const unsigned head = *cq_head_;
+  if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  *cqe = cqes_[head & cq_mask_];
+  __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+int IoUring::Enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+  ++num_syscalls_;
+  const int ret = syscall(__NR_io_uring_enter, fd_, to_submit, min_complete,
+                          flags, nullptr, 0);
+  if (ret == -1 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("io_uring_enter: {}", strerror(errno)));
+  }
+  return ret;
+}
+
+unsigned IoUring::NumReadyCompletions() const {
+  return __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) - *cq_head_;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <vector>
+
+// Whether io_uring can be set up, e.g. it is not disabled by
+// /proc/sys/kernel/io_uring_disabled or a seccomp filter.
+bool IsIoUringSupported();
+
+// Whether a multishot IORING_OP_RECV can fill buffers provided with
+// IORING_OP_PROVIDE_BUFFERS, which needs Linux 6.0.
+bool IsMultishotRecvSupported();
+
+// A minimal io_uring on the raw system calls, so that no liburing is needed.
+// The submission queue entries are filled by the caller between GetSqe() and
+// Submit(). Every io_uring_enter(2) is counted, so that benchmarks can report
+// the number of system calls they needed.
+class IoUring {
+public:
+  // With sqpoll, a kernel thread polls the submission queue and Submit() only
+  // enters the kernel to wake it up or to wait for completions.
+  IoUring(unsigned queue_depth, bool sqpoll);
+  ~IoUring();
+  IoUring(const IoUring &) = delete;
+  IoUring &operator=(const IoUring &) = delete;
+
+  // Register buffers for the *_FIXED opcodes. Returns false if the kernel
+  // refuses, e.g. when they exceed RLIMIT_MEMLOCK.
+  bool RegisterBuffers(const std::vector<iovec> &buffers);
+
+  // A cleared entry at the tail of the submission queue, or nullptr if the
+  // queue is full.
+  io_uring_sqe *GetSqe();
+
+  // Submit the entries got since the last call and wait until at least
+  // wait_nr completions are available.
+  void Submit(unsigned wait_nr);
+
+  // Pop the oldest completion into cqe. Returns false if there is none.
+  bool PopCompletion(io_uring_cqe *cqe);
+
+  unsigned queue_depth() const { return sq_entries_; }
+  uint64_t num_syscalls() const { return num_syscalls_; }
+
+private:
+  int Enter(unsigned to_submit, unsigned min_complete, unsigned flags);
+  unsigned NumReadyCompletions() const;
+
+  int fd_ = -1;
+  bool sqpoll_;
+  unsigned sq_entries_ = 0;
+
+  void *sq_ring_ = nullptr;
+  size_t sq_ring_size_ = 0;
+  void *cq_ring_ = nullptr;
+  size_t cq_ring_size_ = 0;
+  io_uring_sqe *sqes_ = nullptr;
+  size_t sqes_size_ = 0;
+
+  unsigned *sq_head_;
+  unsigned *sq_tail_;
+  unsigned *sq_flags_;
+  unsigned sq_mask_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe *cqes_;
+
+  // Tail of the entries got but not yet submitted
+  unsigned local_tail_ = 0;
+  uint64_t num_syscalls_ = 0;
+};
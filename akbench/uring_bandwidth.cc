@@ -0,0 +1,445 @@
+#include "uring_bandwidth.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <utility>
+#include <vector>
+
+#include "aklog.h"
+
+#include "barrier.h"
+#include "common.h"
+#include "perf_counters.h"
+#include "topology.h"
+#include "uring.h"
+
+namespace {
+
+const std::string BARRIER_ID = GenerateUniqueName("/uring_benchmark");
+const std::string FIFO_PATH = GenerateUniqueName("/tmp/uring_benchmark_fifo");
+const std::string LOOPBACK_IP = "127.0.0.1";
+// The kernel refuses to register a single buffer larger than this.
+constexpr uint64_t MAX_REGISTERED_BUFFER_SIZE = 1ULL << 30;
+constexpr uint64_t GIB = 1ULL << 30;
+constexpr uint16_t RECEIVE_BUFFER_GROUP = 0;
+// The user_data of the operations that provide receive buffers
+constexpr uint64_t PROVIDE_USER_DATA = ~0ULL;
+
+struct StreamFds {
+  int read_fd;
+  int write_fd;
+};
+
+StreamFds ConnectTcp() {
+  const int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("socket: {}", strerror(errno)));
+  }
+  // Let the kernel pick a free port.
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = inet_addr(LOOPBACK_IP.c_str());
+  addr.sin_port = 0;
+  socklen_t addr_len = sizeof(addr);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(listen_fd, 1) == -1 ||
+      getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("listen on {}: {}", LOOPBACK_IP, strerror(errno)));
+  }
+
+  // The connection completes in the backlog, so accept() does not block.
+  const int write_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (write_fd == -1 ||
+      connect(write_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("connect: {}", strerror(errno)));
+  }
+  const int read_fd = accept(listen_fd, nullptr, nullptr);
+  if (read_fd == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("accept: {}", strerror(errno)));
+  }
+  close(listen_fd);
+  return {read_fd, write_fd};
+}
+
+StreamFds ConnectFifo() {
+  unlink(FIFO_PATH.c_str());
+  if (mkfifo(FIFO_PATH.c_str(), 0666) == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("mkfifo: {}", strerror(errno)));
+  }
+  // Opening the read end without O_NONBLOCK would wait for a writer.
+  const int read_fd = open(FIFO_PATH.c_str(), O_RDONLY | O_NONBLOCK);
+  const int write_fd = open(FIFO_PATH.c_str(), O_WRONLY);
+  if (read_fd == -1 || write_fd == -1 ||
+      fcntl(read_fd, F_SETFL, fcntl(read_fd, F_GETFL) & ~O_NONBLOCK) == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("open FIFO {}: {}", FIFO_PATH, strerror(errno)));
+  }
+  unlink(FIFO_PATH.c_str());
+  return {read_fd, write_fd};
+}
+
+// Connects both ends of the transport in this process, before the fork.
+StreamFds Connect(UringTransport transport) {
+  int fds[2];
+  switch (transport) {
+  case UringTransport::TCP:
+    return ConnectTcp();
+  case UringTransport::UDS:
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("socketpair: {}", strerror(errno)));
+    }
+    return {fds[0], fds[1]};
+  case UringTransport::PIPE:
+    if (pipe(fds) == -1) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("pipe: {}", strerror(errno)));
+    }
+    return {fds[0], fds[1]};
+  case UringTransport::FIFO:
+    return ConnectFifo();
+  }
+  AKLOG(aklog::LogLevel::FATAL, "Unknown io_uring transport");
+  return {-1, -1};
+}
+
+// Register data in pieces of at most MAX_REGISTERED_BUFFER_SIZE. Returns
+// false if the kernel refuses, and the operations then use unregistered
+// buffers.
+bool RegisterData(IoUring &ring, uint8_t *data, uint64_t data_size) {
+  std::vector<iovec> buffers;
+  for (uint64_t offset = 0; offset < data_size;
+       offset += MAX_REGISTERED_BUFFER_SIZE) {
+    buffers.push_back(
+        {.iov_base = data + offset,
+         .iov_len = std::min(MAX_REGISTERED_BUFFER_SIZE, data_size - offset)});
+  }
+  return ring.RegisterBuffers(buffers);
+}
+
+// Moves data_size bytes between fd and data with chains of linked reads or
+// writes of at most buffer_size bytes, one chain per batch of
+// ring.queue_depth() operations. The links keep the stream in order. A short
+// operation cancels the rest of its chain and the next chain starts where it
+// stopped. Returns the number of bytes moved, which is less than data_size
+// only if a read hits the end of the stream.
+uint64_t Transfer(IoUring &ring, bool is_write, bool registered, int fd,
+                  uint8_t *data, uint64_t data_size, uint64_t buffer_size) {
+  std::vector<uint32_t> lengths(ring.queue_depth());
+  std::vector<int32_t> results(ring.queue_depth());
+  uint64_t done = 0;
+  while (done < data_size) {
+    unsigned num_ops = 0;
+    for (uint64_t offset = done;
+         num_ops < ring.queue_depth() && offset < data_size; ++num_ops) {
+      // A fixed operation must stay in one registered buffer.
+      const uint64_t buffer_end =
+          (offset / MAX_REGISTERED_BUFFER_SIZE + 1) *
+          MAX_REGISTERED_BUFFER_SIZE;
+      lengths[num_ops] =
+          std::min({buffer_size, data_size - offset, buffer_end - offset});
+
+      io_uring_sqe *sqe = ring.GetSqe();
+      AKCHECK(sqe != nullptr, "io_uring submission queue is full");
+      if (registered) {
+        sqe->opcode = is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = offset / MAX_REGISTERED_BUFFER_SIZE;
+      } else {
+        sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+      }
+      sqe->fd = fd;
+      sqe->addr = reinterpret_cast<uint64_t>(data + offset);
+      sqe->len = lengths[num_ops];
+      // Streams have no file position.
+      sqe->off = -1;
+      sqe->user_data = num_ops;
+      offset += lengths[num_ops];
+      if (num_ops + 1 < ring.queue_depth() && offset < data_size) {
+        sqe->flags = IOSQE_IO_LINK;
+      }
+    }
+
+    ring.Submit(num_ops);
+    io_uring_cqe cqe;
+    for (unsigned i = 0; i < num_ops; ++i) {
+      AKCHECK(ring.PopCompletion(&cqe), "io_uring completion is missing");
+      results[cqe.user_data] = cqe.res;
+    }
+
+    for (unsigned i = 0; i < num_ops; ++i) {
+      if (results[i] == -ECANCELED) {
+        break;
+      }
+      if (results[i] < 0) {
+        AKLOG(aklog::LogLevel::FATAL,
+              std::format("io_uring {}: {}", is_write ? "write" : "read",
+                          strerror(-results[i])));
+      }
+      if (results[i] == 0) {
+        return done;
+      }
+      done += results[i];
+      if (static_cast<uint32_t>(results[i]) < lengths[i]) {
+        break;
+      }
+    }
+  }
+  return done;
+}
+
+// The buffers that a multishot recv fills, all provided to the kernel at
+// once. The completions of one request come in stream order, so the receiver
+// copies each buffer to the end of the data and provides it again.
+class ReceiveSlots {
+public:
+  ReceiveSlots(unsigned num_slots, uint64_t slot_size)
+      : num_slots_(num_slots), slot_size_(slot_size),
+        memory_(num_slots * slot_size) {}
+
+  unsigned num_slots() const { return num_slots_; }
+
+  const uint8_t *slot(unsigned id) const {
+    return memory_.data() + id * slot_size_;
+  }
+
+  // Provide num slots from first on with one operation, whose completion is
+  // only posted if it fails.
+  void Provide(IoUring &ring, unsigned first, unsigned num) {
+    io_uring_sqe *sqe = ring.GetSqe();
+    AKCHECK(sqe != nullptr, "io_uring submission queue is full");
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = num;
+    sqe->addr = reinterpret_cast<uint64_t>(slot(first));
+    sqe->len = slot_size_;
+    sqe->off = first;
+    sqe->buf_group = RECEIVE_BUFFER_GROUP;
+    sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+    sqe->user_data = PROVIDE_USER_DATA;
+  }
+
+private:
+  unsigned num_slots_;
+  uint64_t slot_size_;
+  std::vector<uint8_t> memory_;
+};
+
+// Receives data_size bytes from the socket fd into data with a multishot recv
+// on slots. The request stays armed between calls while armed is true.
+// Returns the number of bytes received, which is less than data_size only at
+// the end of the stream.
+uint64_t ReceiveMultishot(IoUring &ring, ReceiveSlots &slots, bool &armed,
+                          int fd, uint8_t *data, uint64_t data_size) {
+  uint64_t done = 0;
+  while (done < data_size) {
+    if (!armed) {
+      io_uring_sqe *sqe = ring.GetSqe();
+      AKCHECK(sqe != nullptr, "io_uring submission queue is full");
+      sqe->opcode = IORING_OP_RECV;
+      sqe->ioprio = IORING_RECV_MULTISHOT;
+      sqe->flags = IOSQE_BUFFER_SELECT;
+      sqe->buf_group = RECEIVE_BUFFER_GROUP;
+      sqe->fd = fd;
+      armed = true;
+    }
+
+    ring.Submit(1);
+    io_uring_cqe cqe;
+    AKCHECK(ring.PopCompletion(&cqe), "io_uring completion is missing");
+    if (cqe.user_data == PROVIDE_USER_DATA) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("io_uring provide buffers: {}", strerror(-cqe.res)));
+    }
+    armed = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    // Every slot was in use. The provides queued for the earlier completions
+    // run before the recv is armed again.
+    if (cqe.res == -ENOBUFS) {
+      continue;
+    }
+    if (cqe.res < 0) {
+      AKLOG(aklog::LogLevel::FATAL,
+            std::format("io_uring recv: {}", strerror(-cqe.res)));
+    }
+    if (cqe.res == 0) {
+      return done;
+    }
+    AKCHECK(cqe.flags & IORING_CQE_F_BUFFER, "io_uring recv has no buffer");
+    AKCHECK(done + cqe.res <= data_size, "io_uring recv got too much data");
+    const unsigned id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+    memcpy(data + done, slots.slot(id), cqe.res);
+    done += cqe.res;
+    slots.Provide(ring, id, 1);
+  }
+  return done;
+}
+
+void SendProcess(int write_fd, int num_warmups, int num_iterations,
+                 uint64_t data_size, uint64_t buffer_size,
+                 unsigned batch_size, bool sqpoll,
+                 uint64_t *num_send_syscalls) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+
+  // A private, writable copy of the data, as registering a buffer pins it for
+  // writing, which the read-only shared data does not allow.
+  const std::span<const uint8_t> data = GenerateDataToSend(data_size);
+  std::vector<uint8_t> data_to_send(data.begin(), data.end());
+  IoUring ring(batch_size, sqpoll);
+  const bool registered =
+      RegisterData(ring, data_to_send.data(), data_to_send.size());
+
+  PerfCounters counters(CHILD_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    barrier.Wait();
+    const uint64_t syscalls_before = ring.num_syscalls();
+    counters.Start();
+    const uint64_t total_sent =
+        Transfer(ring, true, registered, write_fd, data_to_send.data(),
+                 data_size, buffer_size);
+    counters.Stop();
+    if (num_warmups <= iteration) {
+      *num_send_syscalls += ring.num_syscalls() - syscalls_before;
+    }
+    AKLOG(aklog::LogLevel::DEBUG,
+          std::format("{}Sent {} bytes with {} system calls.",
+                      SendPrefix(iteration), total_sent,
+                      ring.num_syscalls() - syscalls_before));
+    barrier.Wait();
+  }
+  close(write_fd);
+}
+
+BenchmarkResult ReceiveProcess(UringTransport transport, int read_fd,
+                               int num_warmups, int num_iterations,
+                               uint64_t data_size, uint64_t buffer_size,
+                               unsigned batch_size, bool sqpoll) {
+  SenseReversingBarrier barrier(2, BARRIER_ID);
+
+  std::vector<uint8_t> received_data(data_size);
+  const bool multishot =
+      (transport == UringTransport::TCP || transport == UringTransport::UDS) &&
+      IsMultishotRecvSupported();
+  // Declared before the ring, so that an armed recv is gone before the slots
+  // are freed.
+  ReceiveSlots slots(multishot ? batch_size : 0,
+                     std::min({buffer_size, data_size,
+                               MAX_REGISTERED_BUFFER_SIZE}));
+  // With multishot, the queue has room for the recv and a provide per slot.
+  IoUring ring(multishot ? batch_size + 1 : batch_size, sqpoll);
+  if (multishot) {
+    slots.Provide(ring, 0, slots.num_slots());
+    ring.Submit(0);
+  }
+  const bool registered =
+      !multishot &&
+      RegisterData(ring, received_data.data(), received_data.size());
+  bool armed = false;
+  std::vector<double> durations;
+  uint64_t num_receive_syscalls = 0;
+
+  PerfCounters counters(PARENT_PEER, num_warmups);
+  for (int iteration = 0; iteration < num_warmups + num_iterations;
+       ++iteration) {
+    std::fill(received_data.begin(), received_data.end(), 0);
+
+    barrier.Wait();
+    const uint64_t syscalls_before = ring.num_syscalls();
+    counters.Start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    const uint64_t total_received =
+        multishot ? ReceiveMultishot(ring, slots, armed, read_fd,
+                                     received_data.data(), data_size)
+                  : Transfer(ring, false, registered, read_fd,
+                             received_data.data(), data_size, buffer_size);
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
+    barrier.Wait();
+
+    if (num_warmups <= iteration) {
+      std::chrono::duration<double> elapsed_time = end_time - start_time;
+      durations.push_back(elapsed_time.count());
+      num_receive_syscalls += ring.num_syscalls() - syscalls_before;
+      AKLOG(aklog::LogLevel::DEBUG,
+            std::format("{}Received {} bytes in {} ms.",
+                        ReceivePrefix(iteration), total_received,
+                        elapsed_time.count() * 1000));
+    }
+
+    if (!VerifyDataReceived(received_data, data_size)) {
+      AKLOG(aklog::LogLevel::FATAL, std::format("{}Data verification failed!",
+                                                ReceivePrefix(iteration)));
+    }
+  }
+  close(read_fd);
+
+  BenchmarkResult result =
+      CalculateBandwidth(durations, num_iterations, data_size);
+  result.metrics.emplace_back("receive_syscalls_per_gib",
+                              num_receive_syscalls /
+                                  (static_cast<double>(data_size) *
+                                   num_iterations / GIB));
+  AKLOG(aklog::LogLevel::INFO,
+        std::format("Receive bandwidth: {:.3f} ± {:.3f}{}.",
+                    result.average / (1 << 30), result.stddev / (1 << 30),
+                    GIBYTE_PER_SEC_UNIT));
+  return result;
+}
+
+} // namespace
+
+BenchmarkResult RunUringBandwidthBenchmark(UringTransport transport,
+                                           int num_iterations, int num_warmups,
+                                           uint64_t data_size,
+                                           uint64_t buffer_size,
+                                           unsigned batch_size, bool sqpoll) {
+  SenseReversingBarrier::ClearResource(BARRIER_ID);
+  const StreamFds fds = Connect(transport);
+
+  // The sender counts its system calls into memory shared with the receiver.
+  void *shared = mmap(nullptr, sizeof(uint64_t), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  AKCHECK(shared != MAP_FAILED, std::format("mmap: {}", strerror(errno)));
+  uint64_t *num_send_syscalls = static_cast<uint64_t *>(shared);
+  *num_send_syscalls = 0;
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    AKLOG(aklog::LogLevel::FATAL, std::format("fork: {}", strerror(errno)));
+  }
+
+  if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    close(fds.read_fd);
+    SendProcess(fds.write_fd, num_warmups, num_iterations, data_size,
+                buffer_size, batch_size, sqpoll, num_send_syscalls);
+    exit(0);
+  }
+
+  ScopedPeerAffinity affinity(PARENT_PEER);
+  close(fds.write_fd);
+  BenchmarkResult result =
+      ReceiveProcess(transport, fds.read_fd, num_warmups, num_iterations,
+                     data_size, buffer_size, batch_size, sqpoll);
+  waitpid(pid, nullptr, 0);
+
+  result.metrics.insert(
+      result.metrics.begin(),
+      {"send_syscalls_per_gib",
+       *num_send_syscalls /
+           (static_cast<double>(data_size) * num_iterations / GIB)});
+  munmap(shared, sizeof(uint64_t));
+  return result;
+}
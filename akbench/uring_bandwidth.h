@@ -0,0 +1,27 @@
+#pragma once
+
+#include "common.h"
+#include <cstdint>
+
+constexpr int DEFAULT_URING_BATCH_SIZE = 8;
+constexpr int MAX_URING_BATCH_SIZE = 4096;
+
+// The stream that the io_uring bandwidth benchmark sends through. Each one is
+// the transport of the blocking benchmark of the same name.
+enum class UringTransport { TCP, UDS, PIPE, FIFO };
+
+// Sends data_size bytes in buffer_size chunks through the transport with
+// io_uring. The sender submits chains of batch_size linked writes with one
+// io_uring_enter(2). The links make the kernel run them one after another, as
+// concurrent writes on one stream could interleave. On TCP and UDS the
+// receiver provides batch_size buffers to one multishot recv, so that that
+// many receives are in flight, and copies each filled one into the data in
+// stream order. On the pipe and FIFO, and before Linux 6.0, the receiver
+// reads with linked chains like the sender. The data buffers of linked chains
+// are registered where the kernel allows it. The metrics send_syscalls_per_gib
+// and receive_syscalls_per_gib count the io_uring_enter(2) calls of each side.
+BenchmarkResult RunUringBandwidthBenchmark(UringTransport transport,
+                                           int num_iterations, int num_warmups,
+                                           uint64_t data_size,
+                                           uint64_t buffer_size,
+                                           unsigned batch_size, bool sqpoll);
@@ -0,0 +1,42 @@
+#include "uring_bandwidth.h"
+
+#include <cstdint>
+#include <format>
+
+#include "aklog.h"
+#include "uring.h"
+
+int main(int argc, char *argv[]) {
+  if (!IsIoUringSupported()) {
+    AKLOG(aklog::LogLevel::INFO,
+          "uring_bandwidth test skipped: io_uring is not available");
+    return 0;
+  }
+
+  constexpr int num_iterations = 3;
+  constexpr int num_warmups = 1;
+  // Several chains of operations with a short tail
+  constexpr uint64_t data_size = (1 << 18) + 100;
+  constexpr uint64_t buffer_size = 1 << 14;
+
+  for (UringTransport transport :
+       {UringTransport::TCP, UringTransport::UDS, UringTransport::PIPE,
+        UringTransport::FIFO}) {
+    for (bool sqpoll : {false, true}) {
+      const BenchmarkResult result = RunUringBandwidthBenchmark(
+          transport, num_iterations, num_warmups, data_size, buffer_size,
+          DEFAULT_URING_BATCH_SIZE, sqpoll);
+      AKCHECK(result.average >= 0.0, "Bandwidth should be non-negative");
+      AKCHECK(result.metrics.size() == 2,
+              "Both sides should report their system calls");
+      // With SQPOLL, a side may never need to enter the kernel.
+      AKCHECK(sqpoll || (result.metrics[0].second > 0.0 &&
+                         result.metrics[1].second > 0.0),
+              std::format("System calls should be counted: {}, {}",
+                          result.metrics[0].second, result.metrics[1].second));
+    }
+  }
+  AKLOG(aklog::LogLevel::INFO, "uring_bandwidth test passed");
+
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include "uring.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <format>
+#include <print>
+#include <vector>
+
+#include "aklog.h"
+
+namespace {
+
+// Write and read back a message through a pipe with one linked chain.
+void testLinkedWriteRead(bool sqpoll) {
+  int fds[2];
+  AKCHECK(pipe(fds) == 0, std::format("pipe: {}", strerror(errno)));
+
+  IoUring ring(4, sqpoll);
+  const char message[] = "akbench io_uring";
+  std::vector<char> received(sizeof(message), 0);
+
+  io_uring_sqe *write_sqe = ring.GetSqe();
+  write_sqe->opcode = IORING_OP_WRITE;
+  write_sqe->fd = fds[1];
+  write_sqe->addr = reinterpret_cast<uint64_t>(message);
+  write_sqe->len = sizeof(message);
+  write_sqe->off = -1;
+  write_sqe->flags = IOSQE_IO_LINK;
+  write_sqe->user_data = 1;
+
+  io_uring_sqe *read_sqe = ring.GetSqe();
+  read_sqe->opcode = IORING_OP_READ;
+  read_sqe->fd = fds[0];
+  read_sqe->addr = reinterpret_cast<uint64_t>(received.data());
+  read_sqe->len = received.size();
+  read_sqe->off = -1;
+  read_sqe->user_data = 2;
+
+  ring.Submit(2);
+  for (int i = 0; i < 2; ++i) {
+    io_uring_cqe cqe;
+    AKCHECK(ring.PopCompletion(&cqe), "A completion should be available");
+    AKCHECK(cqe.res == static_cast<int>(sizeof(message)),
+            std::format("Operation {} moved {} bytes", cqe.user_data, cqe.res));
+  }
+  io_uring_cqe cqe;
+  AKCHECK(!ring.PopCompletion(&cqe), "There should be no more completions");
+  AKCHECK(memcmp(message, received.data(), sizeof(message)) == 0,
+          "The message should be read back");
+  AKCHECK(ring.num_syscalls() >= 1, "Submit should be counted");
+
+  close(fds[0]);
+  close(fds[1]);
+  std::print("testLinkedWriteRead(sqpoll={}) passed\n", sqpoll);
+}
+
+// Receive a message through a socket pair with a multishot recv that fills
+// provided buffers smaller than the message.
+void testMultishotRecv() {
+  if (!IsMultishotRecvSupported()) {
+    std::print("testMultishotRecv skipped: multishot recv is not available\n");
+    return;
+  }
+  int fds[2];
+  AKCHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0,
+          std::format("socketpair: {}", strerror(errno)));
+  const char message[] = "akbench io_uring";
+  AKCHECK(write(fds[1], message, sizeof(message)) ==
+              static_cast<ssize_t>(sizeof(message)),
+          std::format("write: {}", strerror(errno)));
+
+  constexpr unsigned num_buffers = 4;
+  constexpr unsigned buffer_size = 8;
+  // Declared before the ring, so that the armed recv is gone before they are
+  // freed.
+  std::vector<char> buffers(num_buffers * buffer_size);
+  IoUring ring(4, false);
+
+  io_uring_sqe *provide_sqe = ring.GetSqe();
+  provide_sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+  provide_sqe->fd = num_buffers;
+  provide_sqe->addr = reinterpret_cast<uint64_t>(buffers.data());
+  provide_sqe->len = buffer_size;
+  provide_sqe->flags = IOSQE_IO_LINK;
+  provide_sqe->user_data = 1;
+
+  io_uring_sqe *recv_sqe = ring.GetSqe();
+  recv_sqe->opcode = IORING_OP_RECV;
+  recv_sqe->ioprio = IORING_RECV_MULTISHOT;
+  recv_sqe->flags = IOSQE_BUFFER_SELECT;
+  recv_sqe->fd = fds[0];
+  recv_sqe->user_data = 2;
+
+  std::vector<char> received;
+  while (received.size() < sizeof(message)) {
+    ring.Submit(1);
+    io_uring_cqe cqe;
+    AKCHECK(ring.PopCompletion(&cqe), "A completion should be available");
+    if (cqe.user_data == 1) {
+      AKCHECK(cqe.res == 0,
+              std::format("provide buffers: {}", strerror(-cqe.res)));
+      continue;
+    }
+    AKCHECK(cqe.res > 0, std::format("recv: {}", strerror(-cqe.res)));
+    AKCHECK(cqe.flags & IORING_CQE_F_BUFFER, "recv should pick a buffer");
+    AKCHECK(cqe.flags & IORING_CQE_F_MORE, "recv should stay armed");
+    const char *buffer =
+        buffers.data() + (cqe.flags >> IORING_CQE_BUFFER_SHIFT) * buffer_size;
+    received.insert(received.end(), buffer, buffer + cqe.res);
+  }
+  AKCHECK(received.size() == sizeof(message) &&
+              memcmp(message, received.data(), sizeof(message)) == 0,
+          "The message should arrive in order");
+
+  close(fds[0]);
+  close(fds[1]);
+  std::print("testMultishotRecv passed\n");
+}
+
+void testQueueFull() {
+  IoUring ring(2, false);
+  for (unsigned i = 0; i < ring.queue_depth(); ++i) {
+    io_uring_sqe *sqe = ring.GetSqe();
+    AKCHECK(sqe != nullptr, "The queue should have room");
+    sqe->opcode = IORING_OP_NOP;
+  }
+  AKCHECK(ring.GetSqe() == nullptr, "The queue should be full");
+  ring.Submit(ring.queue_depth());
+  io_uring_cqe cqe;
+  while (ring.PopCompletion(&cqe)) {
+  }
+  AKCHECK(ring.GetSqe() != nullptr, "The queue should have room again");
+  std::print("testQueueFull passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running uring tests...\n");
+
+  if (!IsIoUringSupported()) {
+    std::print("uring tests skipped: io_uring is not available\n");
+    return 0;
+  }
+  testLinkedWriteRead(false);
+  testLinkedWriteRead(true);
+  testQueueFull();
+  testMultishotRecv();
+
+  std::print("All uring tests passed!\n");
+  return 0;
+}
@@ -0,0 +1,167 @@
+#include "wakeup_latency.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <thread>
+#include <vector>
+
+#include "aklog.h"
+
+#include "histogram.h"
+#include "perf_counters.h"
+#include "topology.h"
+
+namespace {
+
+void ParentFlip(WakeupEndpoint *endpoint, const uint64_t loop_size,
+                LatencyHistogram *histogram) {
+  LatencyRecorder recorder(histogram);
+  for (uint64_t i = 0; i < loop_size; ++i) {
+    endpoint->Wake();
+    endpoint->Wait();
+    recorder.Tick();
+  }
+}
+
+void ChildFlip(WakeupEndpoint *endpoint, const uint64_t loop_size) {
+  for (uint64_t i = 0; i < loop_size; ++i) {
+    endpoint->Wait();
+    endpoint->Wake();
+  }
+}
+
+// Runs num_warmups + num_iterations timed passes of the parent and then the
+// histogram pass. begin_pass(pass) is called before each pass and end_pass()
+// after it, e.g. to start and join the child thread of that pass.
+BenchmarkResult RunParentPasses(WakeupEndpoint *endpoint, int num_iterations,
+                                int num_warmups, uint64_t loop_size,
+                                const std::function<void(int)> &begin_pass,
+                                const std::function<void()> &end_pass) {
+  PerfCounters counters(PARENT_PEER, num_warmups);
+  std::vector<double> durations;
+  for (int i = 0; i < num_iterations + num_warmups; ++i) {
+    AKLOG(aklog::LogLevel::DEBUG,
+          std::format("Parent: Starting iteration {}/{}", i + 1,
+                      num_iterations + num_warmups));
+
+    begin_pass(i);
+    counters.Start();
+    auto start_time = std::chrono::high_resolution_clock::now();
+    ParentFlip(endpoint, loop_size, nullptr);
+    auto end_time = std::chrono::high_resolution_clock::now();
+    counters.Stop();
+    end_pass();
+
+    if (i >= num_warmups) {
+      std::chrono::duration<double> duration = end_time - start_time;
+      durations.push_back(duration.count() / 2 / loop_size);
+      AKLOG(aklog::LogLevel::DEBUG,
+            std::format("Parent: Iteration {} takes {} seconds.", i + 1,
+                        duration.count()));
+    }
+  }
+
+  // Time each round trip separately in one more pass to get the latency
+  // distribution. The clock reads are kept out of the passes above so that
+  // they do not inflate the average.
+  LatencyHistogram histogram;
+  begin_pass(num_iterations + num_warmups);
+  ParentFlip(endpoint, loop_size, &histogram);
+  end_pass();
+
+  BenchmarkResult result = CalculateOneTripDuration(durations);
+  // Each recorded round trip consists of two one-way trips.
+  result.percentiles = histogram.Percentiles(1e-9 / 2);
+  return result;
+}
+
+BenchmarkResult RunWithChildThread(int num_iterations, int num_warmups,
+                                   uint64_t loop_size,
+                                   const WakeupEndpointFactory &open_endpoint) {
+  ScopedPeerAffinity affinity(PARENT_PEER);
+  std::unique_ptr<WakeupEndpoint> parent = open_endpoint(PARENT_PEER);
+  std::unique_ptr<WakeupEndpoint> child = open_endpoint(CHILD_PEER);
+  const int num_timed_passes = num_iterations + num_warmups;
+
+  std::thread child_thread;
+  auto begin_pass = [&](int pass) {
+    child_thread = std::thread([&child, loop_size, num_warmups,
+                                num_timed_passes, pass]() {
+      ScopedPeerAffinity affinity(CHILD_PEER);
+      if (pass == num_timed_passes) {
+        // The histogram pass of the parent
+        ChildFlip(child.get(), loop_size);
+        return;
+      }
+      // The child thread lives for one pass only.
+      PerfCounters counters(CHILD_PEER, pass < num_warmups ? 1 : 0);
+      counters.Start();
+      ChildFlip(child.get(), loop_size);
+      counters.Stop();
+    });
+  };
+  auto end_pass = [&child_thread]() { child_thread.join(); };
+  return RunParentPasses(parent.get(), num_iterations, num_warmups, loop_size,
+                         begin_pass, end_pass);
+}
+
+BenchmarkResult
+RunWithChildProcess(int num_iterations, int num_warmups, uint64_t loop_size,
+                    const WakeupEndpointFactory &open_endpoint) {
+  pid_t pid = fork();
+
+  if (pid == -1) {
+    AKLOG(aklog::LogLevel::FATAL,
+          std::format("Fork failed: {}", strerror(errno)));
+  }
+
+  if (pid == 0) {
+    ScopedPeerAffinity affinity(CHILD_PEER);
+    std::unique_ptr<WakeupEndpoint> endpoint = open_endpoint(CHILD_PEER);
+    PerfCounters counters(CHILD_PEER, num_warmups);
+    for (int i = 0; i < num_iterations + num_warmups; ++i) {
+      counters.Start();
+      ChildFlip(endpoint.get(), loop_size);
+      counters.Stop();
+    }
+    // The histogram pass of the parent
+    ChildFlip(endpoint.get(), loop_size);
+    endpoint.reset();
+    exit(0);
+  }
+
+  ScopedPeerAffinity affinity(PARENT_PEER);
+  std::unique_ptr<WakeupEndpoint> endpoint = open_endpoint(PARENT_PEER);
+  BenchmarkResult result =
+      RunParentPasses(endpoint.get(), num_iterations, num_warmups, loop_size,
+                      [](int) {}, []() {});
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    AKLOG(aklog::LogLevel::FATAL, "The child process failed");
+  }
+  return result;
+}
+
+} // namespace
+
+BenchmarkResult
+RunWakeupLatencyBenchmark(int num_iterations, int num_warmups,
+                          uint64_t loop_size, WakeupPeers peers,
+                          const WakeupEndpointFactory &open_endpoint) {
+  switch (peers) {
+  case WakeupPeers::THREADS:
+    return RunWithChildThread(num_iterations, num_warmups, loop_size,
+                              open_endpoint);
+  case WakeupPeers::PROCESSES:
+    return RunWithChildProcess(num_iterations, num_warmups, loop_size,
+                               open_endpoint);
+  }
+  AKLOG(aklog::LogLevel::FATAL, "Unknown wake-up peers");
+  return {};
+}
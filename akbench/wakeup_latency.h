@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "common.h"
+
+// One side of a ping-pong that carries no data, only wake-ups.
+class WakeupEndpoint {
+public:
+  virtual ~WakeupEndpoint() = default;
+
+  // Wake the other side.
+  virtual void Wake() = 0;
+  // Sleep until the other side has woken this side once more.
+  virtual void Wait() = 0;
+};
+
+// Opens the end of peer, PARENT_PEER or CHILD_PEER. With
+// WakeupPeers::PROCESSES it is called in the process of that peer after the
+// fork; with WakeupPeers::THREADS both ends are opened in the calling thread
+// before the child thread starts.
+using WakeupEndpointFactory =
+    std::function<std::unique_ptr<WakeupEndpoint>(int peer)>;
+
+// Whether the child side of the ping-pong is a thread of this process or a
+// forked process.
+enum class WakeupPeers { THREADS, PROCESSES };
+
+// Ping-pongs wake-ups between a parent and a child over the endpoints of
+// open_endpoint and reports the one-trip latency in seconds. With
+// WakeupPeers::THREADS a child thread is started for each pass, so that its
+// perf counters cover one pass; with WakeupPeers::PROCESSES the child is
+// forked once and runs every pass, skipping the warm-ups in its counters.
+BenchmarkResult
+RunWakeupLatencyBenchmark(int num_iterations, int num_warmups,
+                          uint64_t loop_size, WakeupPeers peers,
+                          const WakeupEndpointFactory &open_endpoint);
@@ -0,0 +1,92 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <climits>
+#include <optional>
+
+#include "futex.h"
+#include "topology.h"
+
+namespace {
+
+// Number of spins before sleeping on the futex, like SenseReversingBarrier.
+constexpr int FUTEX_SPIN_COUNT = 1024;
+
+// Wait until *word != value, spinning first and then sleeping on the futex.
+uint32_t WaitWhileEqual(std::atomic<uint32_t> *word, uint32_t value) {
+  uint32_t current;
+  for (int i = 0; (current = word->load(std::memory_order_acquire)) == value;
+       ++i) {
+    if (i < FUTEX_SPIN_COUNT) {
+      CpuRelax();
+    } else {
+      FutexWait(word, value, true);
+    }
+  }
+  return current;
+}
+
+} // namespace
+
+WorkerPool::WorkerPool(uint64_t num_workers,
+                       std::function<void(uint64_t)> task, bool pin_workers)
+    : task_(std::move(task)), pin_workers_(pin_workers),
+      start_times_(num_workers), end_times_(num_workers) {
+  for (uint64_t i = 0; i < num_workers; ++i) {
+    threads_.emplace_back(&WorkerPool::WorkerLoop, this, i);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  stop_.store(true);
+  generation_.fetch_add(1, std::memory_order_release);
+  FutexWake(&generation_, INT_MAX, true);
+  for (auto &t : threads_) {
+    t.join();
+  }
+}
+
+WorkerPoolTimes WorkerPool::Run() {
+  remaining_.store(threads_.size(), std::memory_order_relaxed);
+  const auto gate_time = std::chrono::high_resolution_clock::now();
+  generation_.fetch_add(1, std::memory_order_release);
+  FutexWake(&generation_, INT_MAX, true);
+
+  uint32_t remaining;
+  while ((remaining = remaining_.load(std::memory_order_acquire)) != 0) {
+    WaitWhileEqual(&remaining_, remaining);
+  }
+
+  WorkerPoolTimes times{.total = 0.0, .per_worker = {}};
+  const auto last_end = *std::max_element(end_times_.begin(), end_times_.end());
+  times.total = std::chrono::duration<double>(last_end - gate_time).count();
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    times.per_worker.push_back(
+        std::chrono::duration<double>(end_times_[i] - start_times_[i])
+            .count());
+  }
+  return times;
+}
+
+void WorkerPool::WorkerLoop(uint64_t worker_id) {
+  std::optional<ScopedPeerAffinity> affinity;
+  if (pin_workers_) {
+    affinity.emplace(worker_id);
+  }
+
+  uint32_t seen = 0;
+  while (true) {
+    seen = WaitWhileEqual(&generation_, seen);
+    if (stop_.load()) {
+      return;
+    }
+
+    start_times_[worker_id] = std::chrono::high_resolution_clock::now();
+    task_(worker_id);
+    end_times_[worker_id] = std::chrono::high_resolution_clock::now();
+
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      FutexWake(&remaining_, 1, true);
+    }
+  }
+}
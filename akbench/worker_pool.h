@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Timing of one WorkerPool::Run() in seconds.
+struct WorkerPoolTimes {
+  // From opening the start gate to the completion of the last worker
+  double total;
+  // Duration of the task on each worker
+  std::vector<double> per_worker;
+};
+
+// Threads that are created once and then run the same task in rounds.
+// Run() releases all workers together through a futex start gate and waits
+// for the last one, so thread creation and join are not part of the time.
+class WorkerPool {
+public:
+  // When pin_workers is true, worker i runs on the CPU of peer i of the CPU
+  // placement (see ScopedPeerAffinity).
+  WorkerPool(uint64_t num_workers, std::function<void(uint64_t)> task,
+             bool pin_workers);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  WorkerPoolTimes Run();
+
+private:
+  void WorkerLoop(uint64_t worker_id);
+
+  const std::function<void(uint64_t)> task_;
+  const bool pin_workers_;
+  // Start gate. Run() increments it to release the workers.
+  alignas(64) std::atomic<uint32_t> generation_{0};
+  // Number of workers that have not finished the current round
+  alignas(64) std::atomic<uint32_t> remaining_{0};
+  std::atomic<bool> stop_{false};
+  std::vector<std::chrono::high_resolution_clock::time_point> start_times_;
+  std::vector<std::chrono::high_resolution_clock::time_point> end_times_;
+  std::vector<std::thread> threads_;
+};
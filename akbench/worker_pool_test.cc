@@ -0,0 +1,49 @@
+#include "worker_pool.h"
+
+#include <atomic>
+#include <format>
+#include <print>
+#include <vector>
+
+#include "aklog.h"
+
+namespace {
+
+void testEveryWorkerRunsEveryRound() {
+  constexpr uint64_t num_workers = 4;
+  constexpr int num_rounds = 100;
+  std::vector<std::atomic<int>> counts(num_workers);
+  WorkerPool pool(
+      num_workers, [&](uint64_t worker_id) { counts[worker_id]++; }, false);
+
+  for (int round = 0; round < num_rounds; ++round) {
+    const WorkerPoolTimes times = pool.Run();
+    AKCHECK(times.per_worker.size() == num_workers,
+            "There should be one duration per worker");
+    for (uint64_t i = 0; i < num_workers; ++i) {
+      AKCHECK(counts[i] == round + 1,
+              std::format("Worker {} should have run {} times, got {}", i,
+                          round + 1, counts[i].load()));
+      AKCHECK(0.0 <= times.per_worker[i] && times.per_worker[i] <= times.total,
+              "Worker duration should be within the total duration");
+    }
+  }
+  std::print("testEveryWorkerRunsEveryRound passed\n");
+}
+
+void testDestroyWithoutRun() {
+  { WorkerPool pool(3, [](uint64_t) {}, false); }
+  std::print("testDestroyWithoutRun passed\n");
+}
+
+} // namespace
+
+int main() {
+  std::print("Running worker_pool tests...\n");
+
+  testEveryWorkerRunsEveryRound();
+  testDestroyWithoutRun();
+
+  std::print("All worker_pool tests passed!\n");
+  return 0;
+}